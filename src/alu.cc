@@ -9,11 +9,170 @@
 
 #include "inst-decoder.h"
 
+#include <limits>
+#include <type_traits>
+
 #ifdef _MSC_VER
 /* MSVC intrinsics */
 #include <intrin.h>
 #endif
 
+namespace {
+
+/* High 64 bits of the 128-bit product. */
+uint64_t
+mulhu(uint64_t a, uint64_t b)
+{
+#ifdef _MSC_VER
+  uint64_t high;
+  _umul128(a, b, &high);
+  return high;
+#else
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#endif
+}
+
+uint64_t
+mulh(int64_t a, int64_t b)
+{
+#ifdef _MSC_VER
+  int64_t high;
+  _mul128(a, b, &high);
+  return static_cast<uint64_t>(high);
+#else
+  return static_cast<uint64_t>((static_cast<__int128>(a) * b) >> 64);
+#endif
+}
+
+/* The signed x unsigned product is derived from the unsigned product:
+ * a negative a contributes 2^64 * b less to the result.
+ */
+uint64_t
+mulhsu(int64_t a, uint64_t b)
+{
+  uint64_t high = mulhu(static_cast<uint64_t>(a), b);
+  if (a < 0)
+    high -= b;
+  return high;
+}
+
+/* Division never traps. Division by zero yields all ones for the
+ * quotient and the dividend as remainder; signed overflow yields the
+ * dividend as quotient and a zero remainder.
+ */
+template <typename T>
+T
+divide(T a, T b)
+{
+  if (b == 0)
+    return static_cast<T>(-1);
+  if (std::is_signed_v<T> && a == std::numeric_limits<T>::min() &&
+      b == static_cast<T>(-1))
+    return a;
+  return a / b;
+}
+
+template <typename T>
+T
+remainder(T a, T b)
+{
+  if (b == 0)
+    return a;
+  if (std::is_signed_v<T> && a == std::numeric_limits<T>::min() &&
+      b == static_cast<T>(-1))
+    return 0;
+  return a % b;
+}
+
+/* Bit counts of a 64-bit value, 64 for a zero value. */
+unsigned
+countLeadingZeros(uint64_t value)
+{
+  if (value == 0)
+    return 64;
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - index;
+#else
+  return __builtin_clzll(value);
+#endif
+}
+
+unsigned
+countTrailingZeros(uint64_t value)
+{
+  if (value == 0)
+    return 64;
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+unsigned
+populationCount(uint64_t value)
+{
+#ifdef _MSC_VER
+  return static_cast<unsigned>(__popcnt64(value));
+#else
+  return __builtin_popcountll(value);
+#endif
+}
+
+uint64_t
+byteSwap(uint64_t value)
+{
+#ifdef _MSC_VER
+  return _byteswap_uint64(value);
+#else
+  return __builtin_bswap64(value);
+#endif
+}
+
+/* Rotates by the lower bits of amount, like the shifts. */
+template <typename T>
+T
+rotateLeft(T value, unsigned amount)
+{
+  constexpr unsigned bits = 8 * sizeof(T);
+  amount &= bits - 1;
+  return amount == 0 ? value : (value << amount) | (value >> (bits - amount));
+}
+
+template <typename T>
+T
+rotateRight(T value, unsigned amount)
+{
+  constexpr unsigned bits = 8 * sizeof(T);
+  return rotateLeft(value, bits - (amount & (bits - 1)));
+}
+
+/* Every byte becomes 0xFF if it has any bit set, 0x00 otherwise. */
+uint64_t
+orCombineBytes(uint64_t value)
+{
+  uint64_t result = 0;
+  for (unsigned i = 0; i < 64; i += 8)
+    if ((value >> i) & 0xFF)
+      result |= 0xFFULL << i;
+  return result;
+}
+
+/* Sign extend the 32-bit result of a W instruction. */
+template <typename T>
+RegValue
+word(T value)
+{
+  return static_cast<RegValue>(
+      static_cast<int64_t>(static_cast<int32_t>(value)));
+}
+
+} // namespace
+
 ALU::ALU() : A(), B(), op() {}
 
 RegValue
@@ -102,6 +261,202 @@ ALU::getResult()
     result = static_cast<int64_t>(a32 >> shamt);
   } break;
 
+  case ALUOp::MUL:
+    result = A * B;
+    break;
+
+  case ALUOp::MULH:
+    result = mulh(static_cast<int64_t>(A), static_cast<int64_t>(B));
+    break;
+
+  case ALUOp::MULHSU:
+    result = mulhsu(static_cast<int64_t>(A), B);
+    break;
+
+  case ALUOp::MULHU:
+    result = mulhu(A, B);
+    break;
+
+  case ALUOp::DIV:
+    result = static_cast<RegValue>(
+        divide(static_cast<int64_t>(A), static_cast<int64_t>(B)));
+    break;
+
+  case ALUOp::DIVU:
+    result = divide(A, B);
+    break;
+
+  case ALUOp::REM:
+    result = static_cast<RegValue>(
+        remainder(static_cast<int64_t>(A), static_cast<int64_t>(B)));
+    break;
+
+  case ALUOp::REMU:
+    result = remainder(A, B);
+    break;
+
+  case ALUOp::MULW:
+    result = word(static_cast<uint32_t>(A) * static_cast<uint32_t>(B));
+    break;
+
+  case ALUOp::DIVW:
+    result = word(divide(static_cast<int32_t>(A), static_cast<int32_t>(B)));
+    break;
+
+  case ALUOp::DIVUW:
+    result =
+        word(divide(static_cast<uint32_t>(A), static_cast<uint32_t>(B)));
+    break;
+
+  case ALUOp::REMW:
+    result =
+        word(remainder(static_cast<int32_t>(A), static_cast<int32_t>(B)));
+    break;
+
+  case ALUOp::REMUW:
+    result =
+        word(remainder(static_cast<uint32_t>(A), static_cast<uint32_t>(B)));
+    break;
+
+  case ALUOp::SH1ADD:
+    result = (A << 1) + B;
+    break;
+
+  case ALUOp::SH2ADD:
+    result = (A << 2) + B;
+    break;
+
+  case ALUOp::SH3ADD:
+    result = (A << 3) + B;
+    break;
+
+  case ALUOp::ADDUW:
+    result = (A & 0xFFFFFFFF) + B;
+    break;
+
+  case ALUOp::SH1ADDUW:
+    result = ((A & 0xFFFFFFFF) << 1) + B;
+    break;
+
+  case ALUOp::SH2ADDUW:
+    result = ((A & 0xFFFFFFFF) << 2) + B;
+    break;
+
+  case ALUOp::SH3ADDUW:
+    result = ((A & 0xFFFFFFFF) << 3) + B;
+    break;
+
+  case ALUOp::SLLIUW:
+    result = (A & 0xFFFFFFFF) << (B & 0x3F);
+    break;
+
+  case ALUOp::ANDN:
+    result = A & ~B;
+    break;
+
+  case ALUOp::ORN:
+    result = A | ~B;
+    break;
+
+  case ALUOp::XNOR:
+    result = ~(A ^ B);
+    break;
+
+  /* Operations on a single operand ignore B. */
+  case ALUOp::CLZ:
+    result = countLeadingZeros(A);
+    break;
+
+  case ALUOp::CLZW:
+    result = countLeadingZeros(A << 32 | 0xFFFFFFFF);
+    break;
+
+  case ALUOp::CTZ:
+    result = countTrailingZeros(A);
+    break;
+
+  case ALUOp::CTZW:
+    result = countTrailingZeros(A | 0xFFFFFFFF00000000ULL);
+    break;
+
+  case ALUOp::CPOP:
+    result = populationCount(A);
+    break;
+
+  case ALUOp::CPOPW:
+    result = populationCount(A & 0xFFFFFFFF);
+    break;
+
+  case ALUOp::MIN:
+    result = static_cast<int64_t>(A) < static_cast<int64_t>(B) ? A : B;
+    break;
+
+  case ALUOp::MINU:
+    result = A < B ? A : B;
+    break;
+
+  case ALUOp::MAX:
+    result = static_cast<int64_t>(A) > static_cast<int64_t>(B) ? A : B;
+    break;
+
+  case ALUOp::MAXU:
+    result = A > B ? A : B;
+    break;
+
+  case ALUOp::SEXTB:
+    result = static_cast<int64_t>(static_cast<int8_t>(A));
+    break;
+
+  case ALUOp::SEXTH:
+    result = static_cast<int64_t>(static_cast<int16_t>(A));
+    break;
+
+  case ALUOp::ZEXTH:
+    result = A & 0xFFFF;
+    break;
+
+  case ALUOp::ROL:
+    result = rotateLeft(A, static_cast<unsigned>(B));
+    break;
+
+  case ALUOp::ROLW:
+    result = word(rotateLeft(static_cast<uint32_t>(A),
+                             static_cast<unsigned>(B)));
+    break;
+
+  case ALUOp::ROR:
+    result = rotateRight(A, static_cast<unsigned>(B));
+    break;
+
+  case ALUOp::RORW:
+    result = word(rotateRight(static_cast<uint32_t>(A),
+                              static_cast<unsigned>(B)));
+    break;
+
+  case ALUOp::ORCB:
+    result = orCombineBytes(A);
+    break;
+
+  case ALUOp::REV8:
+    result = byteSwap(A);
+    break;
+
+  case ALUOp::BCLR:
+    result = A & ~(1ULL << (B & 0x3F));
+    break;
+
+  case ALUOp::BEXT:
+    result = (A >> (B & 0x3F)) & 1;
+    break;
+
+  case ALUOp::BINV:
+    result = A ^ (1ULL << (B & 0x3F));
+    break;
+
+  case ALUOp::BSET:
+    result = A | (1ULL << (B & 0x3F));
+    break;
+
   default:
     throw IllegalInstruction("Unimplemented or unknown ALU operation");
   }
@@ -29,7 +29,62 @@ enum class ALUOp {
   SUBW, /* Sub word (32-bit) */
   SLLW, /* Shift left logical word */
   SRLW, /* Shift right logical word */
-  SRAW  /* Shift right arithmetic word */
+  SRAW, /* Shift right arithmetic word */
+
+  /* M extension */
+  MUL,
+  MULH,   /* High half of signed x signed */
+  MULHSU, /* High half of signed x unsigned */
+  MULHU,  /* High half of unsigned x unsigned */
+  DIV,
+  DIVU,
+  REM,
+  REMU,
+  MULW,
+  DIVW,
+  DIVUW,
+  REMW,
+  REMUW,
+
+  /* Zba: address generation */
+  SH1ADD,
+  SH2ADD,
+  SH3ADD,
+  ADDUW,    /* Add unsigned word */
+  SH1ADDUW,
+  SH2ADDUW,
+  SH3ADDUW,
+  SLLIUW,   /* Shift left unsigned word */
+
+  /* Zbb: basic bit manipulation */
+  ANDN,
+  ORN,
+  XNOR,
+  CLZ,  /* Count leading zeros */
+  CLZW,
+  CTZ,  /* Count trailing zeros */
+  CTZW,
+  CPOP, /* Population count */
+  CPOPW,
+  MIN,
+  MINU,
+  MAX,
+  MAXU,
+  SEXTB,
+  SEXTH,
+  ZEXTH,
+  ROL,
+  ROLW,
+  ROR,
+  RORW,
+  ORCB, /* Bitwise OR-combine of bytes */
+  REV8, /* Byte-reverse */
+
+  /* Zbs: single-bit instructions */
+  BCLR,
+  BEXT,
+  BINV,
+  BSET
 };
 
 /* The ALU component performs the specified operation on operands A and B
@@ -21,6 +21,21 @@ static constexpr size_t NumRegs = 32;
 using RegNumber = uint8_t;
 static constexpr size_t MaxRegs = 256;
 
+/* Within the pipeline, the floating-point registers are numbered after
+ * the integer registers, such that dependences through both register
+ * files are tracked alike.
+ */
+static constexpr size_t NumFloatRegs = 32;
+static constexpr RegNumber FloatRegBase = NumRegs;
+static constexpr size_t NumPipelineRegs = NumRegs + NumFloatRegs;
+
+/* Interrupt lines of the hart, as bits of the mip and mie CSRs. */
+enum InterruptLine : uint64_t {
+  SoftwareInterrupt = 1 << 3,
+  TimerInterrupt = 1 << 7,
+  ExternalInterrupt = 1 << 11
+};
+
 /* Magic codeword, which is an invalid RISC-V instruction, that we use
  * to mark the end of unit test cases.
  */
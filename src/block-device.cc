@@ -0,0 +1,233 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    block-device.cc - Block storage backed by a host image file.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "block-device.h"
+#include "memory-bus.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+BlockDevice::BlockDevice(const BlockDeviceConfig& config, MemoryBus& bus,
+                         const uint64_t& nCycles)
+    : base{config.base}, readOnly{config.readOnly}, latency{config.latency},
+      cyclesPerSector{config.cyclesPerSector}, bus{bus}, completion{nCycles}
+{
+  mapImage(config.image);
+}
+
+#ifndef _MSC_VER
+
+BlockDevice::~BlockDevice()
+{
+  if (image)
+    munmap(image, imageSize);
+}
+
+/* The mapping is shared, so written sectors end up in the image file. */
+void
+BlockDevice::mapImage(const std::string& filename)
+{
+  const int fd = open(filename.c_str(), readOnly ? O_RDONLY : O_RDWR);
+  if (fd < 0)
+    throw std::runtime_error("cannot open block device image " + filename +
+                             ": " + std::strerror(errno));
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size < off_t{SectorSize}) {
+    close(fd);
+    throw std::runtime_error("block device image " + filename +
+                             " is smaller than a sector");
+  }
+
+  imageSize = static_cast<size_t>(info.st_size);
+  const int protection = readOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+  void* mapping = mmap(nullptr, imageSize, protection, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error("cannot map block device image " + filename +
+                             ": " + std::strerror(errno));
+  image = static_cast<std::byte*>(mapping);
+}
+
+#else
+
+BlockDevice::~BlockDevice() = default;
+
+void
+BlockDevice::mapImage(const std::string&)
+{
+  throw std::runtime_error("the block device is not supported on Windows");
+}
+
+#endif /* _MSC_VER */
+
+void
+BlockDevice::start(uint64_t newCommand)
+{
+  if (completion.isBusy()) {
+    completion.reject();
+    return;
+  }
+
+  command = newCommand;
+  const bool succeeded = transfer();
+  completion.start(succeeded,
+                   latency + (succeeded ? count * cyclesPerSector : 0));
+}
+
+/* Copy count sectors between the image and the guest buffer in a single
+ * step. Returns false when the command is rejected.
+ */
+bool
+BlockDevice::transfer()
+{
+  const uint64_t capacity = imageSize / SectorSize;
+  if (sector > capacity || count > capacity - sector)
+    return false;
+  if (command != Read && command != Write)
+    return false;
+  if (command == Write && readOnly)
+    return false;
+
+  const size_t size = count * SectorSize;
+  if (size == 0)
+    return true;
+
+  std::byte* guest = bus.getHostPointer(buffer, size, command == Read);
+  if (!guest)
+    return false;
+
+  std::byte* sectors = image + sector * SectorSize;
+  if (command == Read) {
+    std::memcpy(guest, sectors, size);
+    nSectorsRead += count;
+  } else {
+    std::memcpy(sectors, guest, size);
+    nSectorsWritten += count;
+  }
+
+  return true;
+}
+
+/*
+ * MemoryInterface
+ */
+
+uint8_t
+BlockDevice::readByte(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+uint16_t
+BlockDevice::readHalfWord(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+uint32_t
+BlockDevice::readWord(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+uint64_t
+BlockDevice::readDoubleWord(MemAddress addr)
+{
+  switch (addr - base) {
+  case SectorOffset:
+    return sector;
+  case CountOffset:
+    return count;
+  case BufferOffset:
+    return buffer;
+  case CommandOffset:
+    return command;
+  case StatusOffset:
+    return completion.getStatus();
+  case CapacityOffset:
+    return imageSize / SectorSize;
+  case InterruptEnableOffset:
+    return interruptEnable;
+  default:
+    throw IllegalAccess("Invalid block device register");
+  }
+}
+
+void
+BlockDevice::writeByte(MemAddress addr, uint8_t value)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+void
+BlockDevice::writeHalfWord(MemAddress addr, uint16_t value)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+void
+BlockDevice::writeWord(MemAddress addr, uint32_t value)
+{
+  throw IllegalAccess("Not supported on block device");
+}
+
+void
+BlockDevice::writeDoubleWord(MemAddress addr, uint64_t value)
+{
+  switch (addr - base) {
+  case SectorOffset:
+    sector = value;
+    break;
+  case CountOffset:
+    count = value;
+    break;
+  case BufferOffset:
+    buffer = value;
+    break;
+  case CommandOffset:
+    start(value);
+    break;
+  case StatusOffset:
+    completion.acknowledge();
+    break;
+  case InterruptEnableOffset:
+    interruptEnable = value & 0x1;
+    break;
+  default:
+    throw IllegalAccess("Invalid block device register");
+  }
+}
+
+bool
+BlockDevice::contains(MemAddress addr) const
+{
+  return base <= addr && addr < base + Size;
+}
+
+uint64_t
+BlockDevice::getInterruptLines() const
+{
+  if (interruptEnable && completion.isDone())
+    return ExternalInterrupt;
+  return 0;
+}
+
+uint64_t
+BlockDevice::getNextEvent() const
+{
+  return completion.getNextEvent();
+}
@@ -0,0 +1,108 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    block-device.h - Block storage backed by a host image file.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __BLOCK_DEVICE_H__
+#define __BLOCK_DEVICE_H__
+
+#include "device-completion.h"
+#include "machine-config.h"
+#include "memory-interface.h"
+
+class MemoryBus;
+
+/* A block device with 512-byte sectors and the following 64-bit
+ * registers:
+ *
+ *   base + 0x00: sector, the first sector of the transfer
+ *   base + 0x08: count, the number of sectors
+ *   base + 0x10: buffer, the guest address of the data
+ *   base + 0x18: command (doorbell), a write starts the transfer, see
+ *                Command
+ *   base + 0x20: status, see DeviceCompletion; a write acknowledges the
+ *                completion and clears Done and Error
+ *   base + 0x28: capacity in sectors (read-only)
+ *   base + 0x30: interrupt enable, bit 0 raises the external interrupt
+ *                while Done is set
+ *
+ * The image file is mapped into the emulator, and a transfer is a single
+ * copy between the mapping and the host memory of the guest buffer. The
+ * data is copied when the command is written, but the command completes
+ * after the configured latency: the program must not access the buffer
+ * until then. A command is rejected with Error when it is written while
+ * the device is busy, when the sectors are beyond the end of the image,
+ * when the buffer is not contained in a single memory or when writing a
+ * read-only image.
+ */
+class BlockDevice : public MemoryInterface {
+public:
+  static constexpr size_t SectorSize = 512;
+
+  enum Command : uint64_t { Read = 1, Write = 2 };
+
+  BlockDevice(const BlockDeviceConfig& config, MemoryBus& bus,
+              const uint64_t& nCycles);
+  ~BlockDevice() override;
+
+  BlockDevice(const BlockDevice&) = delete;
+  BlockDevice& operator=(const BlockDevice&) = delete;
+
+  uint64_t getSectorsRead() const { return nSectorsRead; }
+  uint64_t getSectorsWritten() const { return nSectorsWritten; }
+
+  /* MemoryInterface */
+  uint8_t readByte(MemAddress addr) override;
+  uint16_t readHalfWord(MemAddress addr) override;
+  uint32_t readWord(MemAddress addr) override;
+  uint64_t readDoubleWord(MemAddress addr) override;
+
+  void writeByte(MemAddress addr, uint8_t value) override;
+  void writeHalfWord(MemAddress addr, uint16_t value) override;
+  void writeWord(MemAddress addr, uint32_t value) override;
+  void writeDoubleWord(MemAddress addr, uint64_t value) override;
+
+  bool contains(MemAddress addr) const override;
+
+  uint64_t getInterruptLines() const override;
+  uint64_t getNextEvent() const override;
+  bool isReadStable(MemAddress addr) const override { return true; }
+
+private:
+  static constexpr MemAddress SectorOffset = 0x00;
+  static constexpr MemAddress CountOffset = 0x08;
+  static constexpr MemAddress BufferOffset = 0x10;
+  static constexpr MemAddress CommandOffset = 0x18;
+  static constexpr MemAddress StatusOffset = 0x20;
+  static constexpr MemAddress CapacityOffset = 0x28;
+  static constexpr MemAddress InterruptEnableOffset = 0x30;
+  static constexpr MemAddress Size = 0x38;
+
+  const MemAddress base;
+  const bool readOnly;
+  const uint64_t latency;
+  const uint64_t cyclesPerSector;
+  MemoryBus& bus;
+
+  std::byte* image{};
+  size_t imageSize{};
+
+  uint64_t sector{};
+  uint64_t count{};
+  MemAddress buffer{};
+  uint64_t command{};
+  bool interruptEnable{};
+
+  DeviceCompletion completion;
+
+  uint64_t nSectorsRead{};
+  uint64_t nSectorsWritten{};
+
+  void mapImage(const std::string& filename);
+  void start(uint64_t newCommand);
+  bool transfer();
+};
+
+#endif /* __BLOCK_DEVICE_H__ */
@@ -0,0 +1,196 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    clint.cc - Core-local interruptor: machine timer and software
+ *               interrupt.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "clint.h"
+
+#include <stdexcept>
+
+CLINT::CLINT(const CLINTConfig& config, const uint64_t& nCycles)
+    : base{config.base}, cyclesPerTick{config.cyclesPerTick},
+      nCycles{nCycles}
+{
+  if (cyclesPerTick == 0)
+    throw std::out_of_range("clint cyclesPerTick must be at least 1");
+}
+
+uint64_t
+CLINT::getTime() const
+{
+  return timeBase + (nCycles - cycleBase) / cyclesPerTick;
+}
+
+void
+CLINT::setTime(uint64_t value)
+{
+  timeBase = value;
+  cycleBase = nCycles;
+}
+
+/* The first cycle in which getTime() >= mtimecmp. */
+void
+CLINT::scheduleTimerEvent()
+{
+  const uint64_t time = getTime();
+  if (mtimecmp <= time) {
+    timerEvent = nCycles;
+    return;
+  }
+
+  const uint64_t ticks = mtimecmp - timeBase;
+  if (ticks > (NoEvent - cycleBase) / cyclesPerTick)
+    timerEvent = NoEvent;
+  else
+    timerEvent = cycleBase + ticks * cyclesPerTick;
+}
+
+/* The register that contains the 32-bit word at offset. */
+MemAddress
+CLINT::getWordRegister(MemAddress offset) const
+{
+  const MemAddress reg = offset & ~MemAddress{0x7};
+  if ((offset & 0x3) || (reg == MsipOffset && offset != MsipOffset))
+    throw IllegalAccess("Invalid CLINT register");
+  return reg;
+}
+
+uint64_t
+CLINT::readRegister(MemAddress offset)
+{
+  switch (offset) {
+  case MsipOffset:
+    return msip;
+  case MtimecmpOffset:
+    return mtimecmp;
+  case MtimeOffset:
+    return getTime();
+  default:
+    throw IllegalAccess("Invalid CLINT register");
+  }
+}
+
+void
+CLINT::writeRegister(MemAddress offset, uint64_t value)
+{
+  switch (offset) {
+  case MsipOffset:
+    msip = value & 0x1;
+    return;
+  case MtimecmpOffset:
+    mtimecmp = value;
+    break;
+  case MtimeOffset:
+    setTime(value);
+    break;
+  default:
+    throw IllegalAccess("Invalid CLINT register");
+  }
+
+  scheduleTimerEvent();
+}
+
+/*
+ * MemoryInterface
+ */
+
+uint8_t
+CLINT::readByte(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on CLINT");
+}
+
+uint16_t
+CLINT::readHalfWord(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on CLINT");
+}
+
+/* msip, or either half of a 64-bit register; the upper half is at
+ * offset 4.
+ */
+uint32_t
+CLINT::readWord(MemAddress addr)
+{
+  const MemAddress offset = addr - base;
+  const MemAddress reg = getWordRegister(offset);
+
+  return readRegister(reg) >> (offset - reg) * 8;
+}
+
+uint64_t
+CLINT::readDoubleWord(MemAddress addr)
+{
+  const MemAddress offset = addr - base;
+  if (offset == MsipOffset)
+    throw IllegalAccess("msip is a 32-bit register");
+
+  return readRegister(offset);
+}
+
+void
+CLINT::writeByte(MemAddress addr, uint8_t value)
+{
+  throw IllegalAccess("Not supported on CLINT");
+}
+
+void
+CLINT::writeHalfWord(MemAddress addr, uint16_t value)
+{
+  throw IllegalAccess("Not supported on CLINT");
+}
+
+void
+CLINT::writeWord(MemAddress addr, uint32_t value)
+{
+  const MemAddress offset = addr - base;
+  const MemAddress reg = getWordRegister(offset);
+  const unsigned shift = (offset - reg) * 8;
+  const uint64_t mask = uint64_t{0xFFFFFFFF} << shift;
+
+  const uint64_t old = readRegister(reg);
+  writeRegister(reg, (old & ~mask) | (uint64_t{value} << shift));
+}
+
+void
+CLINT::writeDoubleWord(MemAddress addr, uint64_t value)
+{
+  const MemAddress offset = addr - base;
+  if (offset == MsipOffset)
+    throw IllegalAccess("msip is a 32-bit register");
+
+  writeRegister(offset, value);
+}
+
+bool
+CLINT::contains(MemAddress addr) const
+{
+  return base <= addr && addr < base + Size;
+}
+
+/* mtime changes by itself, the other registers only when written. */
+bool
+CLINT::isReadStable(MemAddress addr) const
+{
+  return addr - base < MtimeOffset;
+}
+
+uint64_t
+CLINT::getNextEvent() const
+{
+  return timerEvent > nCycles ? timerEvent : NoEvent;
+}
+
+uint64_t
+CLINT::getInterruptLines() const
+{
+  uint64_t lines = 0;
+  if (msip)
+    lines |= SoftwareInterrupt;
+  if (nCycles >= timerEvent)
+    lines |= TimerInterrupt;
+  return lines;
+}
@@ -0,0 +1,86 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    clint.h - Core-local interruptor: machine timer and software
+ *              interrupt.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __CLINT_H__
+#define __CLINT_H__
+
+#include "machine-config.h"
+#include "memory-interface.h"
+
+/* The registers of the CLINT of a single hart, at the offsets used by
+ * the SiFive CLINT and QEMU's virt machine:
+ *
+ *   base + 0x0000: msip (32-bit), bit 0 raises the software interrupt.
+ *   base + 0x4000: mtimecmp (64-bit)
+ *   base + 0xBFF8: mtime (64-bit)
+ *
+ * The 64-bit registers can also be accessed as two 32-bit halves. The
+ * timer interrupt is raised while mtime >= mtimecmp.
+ *
+ * mtime is not incremented every cycle, but derived from the processor's
+ * cycle counter: it advances once every cyclesPerTick cycles. The cycle
+ * in which mtime reaches mtimecmp is computed when either is written, so
+ * the timer interrupt is a comparison against that scheduled event.
+ */
+class CLINT : public MemoryInterface {
+public:
+  CLINT(const CLINTConfig& config, const uint64_t& nCycles);
+  ~CLINT() override = default;
+
+  uint64_t getTime() const;
+
+  /* The cycle in which the timer interrupt is raised, NoEvent if mtimecmp
+   * cannot be reached.
+   */
+  uint64_t getTimerEvent() const { return timerEvent; }
+
+  /* MemoryInterface */
+  uint8_t readByte(MemAddress addr) override;
+  uint16_t readHalfWord(MemAddress addr) override;
+  uint32_t readWord(MemAddress addr) override;
+  uint64_t readDoubleWord(MemAddress addr) override;
+
+  void writeByte(MemAddress addr, uint8_t value) override;
+  void writeHalfWord(MemAddress addr, uint16_t value) override;
+  void writeWord(MemAddress addr, uint32_t value) override;
+  void writeDoubleWord(MemAddress addr, uint64_t value) override;
+
+  bool contains(MemAddress addr) const override;
+
+  uint64_t getInterruptLines() const override;
+  uint64_t getNextEvent() const override;
+  bool isReadStable(MemAddress addr) const override;
+
+private:
+  static constexpr MemAddress MsipOffset = 0x0000;
+  static constexpr MemAddress MtimecmpOffset = 0x4000;
+  static constexpr MemAddress MtimeOffset = 0xBFF8;
+  static constexpr MemAddress Size = 0xC000;
+
+  const MemAddress base;
+  const uint64_t cyclesPerTick;
+  const uint64_t& nCycles;
+
+  uint32_t msip{};
+  uint64_t mtimecmp{NoEvent};
+
+  /* mtime was timeBase in cycle cycleBase. */
+  uint64_t timeBase{};
+  uint64_t cycleBase{};
+
+  uint64_t timerEvent{NoEvent};
+
+  void setTime(uint64_t value);
+  void scheduleTimerEvent();
+
+  MemAddress getWordRegister(MemAddress offset) const;
+  uint64_t readRegister(MemAddress offset);
+  void writeRegister(MemAddress offset, uint64_t value);
+};
+
+#endif /* __CLINT_H__ */
@@ -0,0 +1,215 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    csr.cc - Control and status registers, Zicsr extension.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "csr.h"
+#include "clint.h"
+
+#include "inst-decoder.h"
+
+const char*
+getCSRName(uint16_t csr)
+{
+  switch (csr) {
+  case CSRFflags:
+    return "fflags";
+  case CSRFrm:
+    return "frm";
+  case CSRFcsr:
+    return "fcsr";
+  case CSRCycle:
+    return "cycle";
+  case CSRTime:
+    return "time";
+  case CSRInstret:
+    return "instret";
+  case CSRVl:
+    return "vl";
+  case CSRVtype:
+    return "vtype";
+  case CSRVlenb:
+    return "vlenb";
+  case CSRMstatus:
+    return "mstatus";
+  case CSRMisa:
+    return "misa";
+  case CSRMie:
+    return "mie";
+  case CSRMtvec:
+    return "mtvec";
+  case CSRMscratch:
+    return "mscratch";
+  case CSRMepc:
+    return "mepc";
+  case CSRMcause:
+    return "mcause";
+  case CSRMtval:
+    return "mtval";
+  case CSRMip:
+    return "mip";
+  case CSRMhartid:
+    return "mhartid";
+  default:
+    return nullptr;
+  }
+}
+
+RegValue
+CSRFile::read(uint16_t csr) const
+{
+  switch (csr) {
+  case CSRFflags:
+    return fcsr.flags;
+  case CSRFrm:
+    return static_cast<RegValue>(fcsr.frm);
+  case CSRFcsr:
+    return static_cast<RegValue>(fcsr.frm) << 5 | fcsr.flags;
+  case CSRCycle:
+    return nCycles;
+  case CSRTime:
+    return timer ? timer->getTime() : nCycles;
+  case CSRInstret:
+    return nInstrCompleted;
+  case CSRVl:
+    return vectorUnit.getVL();
+  case CSRVtype:
+    return vectorUnit.getVType();
+  case CSRVlenb:
+    return vectorUnit.getVLENB();
+  case CSRMstatus:
+    return mstatus | MachineModeMPP;
+  case CSRMisa:
+    return MisaValue;
+  case CSRMie:
+    return mie;
+  case CSRMtvec:
+    return mtvec;
+  case CSRMscratch:
+    return mscratch;
+  case CSRMepc:
+    return mepc;
+  case CSRMcause:
+    return mcause;
+  case CSRMtval:
+    return mtval;
+  case CSRMip:
+    return mip;
+  case CSRMhartid:
+    return 0;
+  default:
+    throw IllegalInstruction("Unsupported CSR");
+  }
+}
+
+/* The top two bits of the CSR number are set for read-only CSRs. Fields
+ * that cannot be written keep their value (WARL).
+ */
+void
+CSRFile::write(uint16_t csr, RegValue value)
+{
+  if (isSupported(csr) && !isWritable(csr))
+    throw IllegalInstruction("Write to read-only CSR");
+
+  ++nWrites;
+  switch (csr) {
+  case CSRFflags:
+    fcsr.flags = value & 0x1F;
+    break;
+  case CSRFrm:
+    fcsr.frm = static_cast<RoundingMode>(value & 0x7);
+    break;
+  case CSRFcsr:
+    fcsr.flags = value & 0x1F;
+    fcsr.frm = static_cast<RoundingMode>((value >> 5) & 0x7);
+    break;
+  case CSRMstatus:
+    mstatus = value & (StatusMIE | StatusMPIE);
+    break;
+  case CSRMie:
+    mie = value & InterruptMask;
+    break;
+  case CSRMtvec:
+    /* Only the direct (0) and vectored (1) modes exist. */
+    mtvec = value & ~static_cast<RegValue>(0x2);
+    break;
+  case CSRMscratch:
+    mscratch = value;
+    break;
+  case CSRMepc:
+    mepc = value & ~static_cast<RegValue>(0x1);
+    break;
+  case CSRMcause:
+    mcause = value;
+    break;
+  case CSRMtval:
+    mtval = value;
+    break;
+  case CSRMisa:
+  case CSRMip:
+    break;
+  default:
+    throw IllegalInstruction("Unsupported CSR");
+  }
+}
+
+/* Priority as in the privileged specification: external, software, then
+ * timer interrupts.
+ */
+uint64_t
+CSRFile::getPendingInterrupt() const
+{
+  if (!(mstatus & StatusMIE))
+    return 0;
+
+  static constexpr uint64_t causes[] = {11, 3, 7};
+
+  const uint64_t pending = mip & mie;
+  for (uint64_t cause : causes)
+    if (pending & (1ULL << cause))
+      return TrapInterrupt | cause;
+  return 0;
+}
+
+MemAddress
+CSRFile::getTrapVector(uint64_t cause) const
+{
+  const MemAddress base = mtvec & ~static_cast<MemAddress>(0x3);
+  if ((mtvec & 0x1) && (cause & TrapInterrupt))
+    return base + 4 * (cause & ~TrapInterrupt);
+  return base;
+}
+
+void
+CSRFile::enterTrap(uint64_t cause, MemAddress epc, RegValue tval)
+{
+  ++nWrites;
+  mepc = epc;
+  mcause = cause;
+  mtval = tval;
+  mstatus = (mstatus & StatusMIE) ? StatusMPIE : 0;
+}
+
+void
+CSRFile::returnFromTrap()
+{
+  ++nWrites;
+  mstatus = ((mstatus & StatusMPIE) ? StatusMIE : 0) | StatusMPIE;
+}
+
+RegValue
+CSRFile::apply(CSROp op, RegValue oldValue, RegValue operand)
+{
+  switch (op) {
+  case CSROp::ReadWrite:
+    return operand;
+  case CSROp::ReadSet:
+    return oldValue | operand;
+  case CSROp::ReadClear:
+    return oldValue & ~operand;
+  default:
+    return oldValue;
+  }
+}
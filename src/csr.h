@@ -0,0 +1,171 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    csr.h - Control and status registers, Zicsr extension.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __CSR_H__
+#define __CSR_H__
+
+#include "arch.h"
+#include "fpu.h"
+#include "vector-unit.h"
+
+class CLINT;
+
+/* CSR instructions, funct3 under SYSTEM without the immediate bit. */
+enum class CSROp : uint8_t { None, ReadWrite, ReadSet, ReadClear };
+
+/* The other SYSTEM instructions, which are executed in EX. */
+enum class SystemOp : uint8_t { None, ECall, EBreak, MRet, WFI };
+
+/* Numbers of the supported CSRs. */
+enum CSRNumber : uint16_t {
+  CSRFflags = 0x001,
+  CSRFrm = 0x002,
+  CSRFcsr = 0x003,
+  CSRCycle = 0xC00,
+  CSRTime = 0xC01,
+  CSRInstret = 0xC02,
+  CSRVl = 0xC20,
+  CSRVtype = 0xC21,
+  CSRVlenb = 0xC22,
+  CSRMstatus = 0x300,
+  CSRMisa = 0x301,
+  CSRMie = 0x304,
+  CSRMtvec = 0x305,
+  CSRMscratch = 0x340,
+  CSRMepc = 0x341,
+  CSRMcause = 0x342,
+  CSRMtval = 0x343,
+  CSRMip = 0x344,
+  CSRMhartid = 0xF14
+};
+
+/* Values of mcause. Interrupts have the top bit set, the other bits hold
+ * the bit number of the interrupt line in mip.
+ */
+enum TrapCause : uint64_t {
+  TrapIllegalInstruction = 2,
+  TrapBreakpoint = 3,
+  TrapMachineECall = 11,
+  TrapInterrupt = 1ULL << 63
+};
+
+/* The assembler name of a CSR, nullptr for unsupported CSRs. */
+const char* getCSRName(uint16_t csr);
+
+/* Most CSRs are not stored here, but give access to the state kept by
+ * other components: the counters of the processor and pipeline, fcsr and
+ * the vector unit. time is mtime of the CLINT; without a CLINT it counts
+ * clock cycles like cycle.
+ *
+ * The machine-mode trap CSRs are kept here. The hart only runs in machine
+ * mode, so mstatus only holds MIE and MPIE; MPP always reads as machine
+ * mode. The bits of mip follow the interrupt lines of the devices and
+ * cannot be written.
+ *
+ * Accesses to unsupported CSRs and writes to read-only CSRs throw
+ * IllegalInstruction.
+ */
+class CSRFile {
+public:
+  CSRFile(const uint64_t& nCycles, const uint64_t& nInstrCompleted,
+          FloatStatus& fcsr, const VectorUnit& vectorUnit)
+      : nCycles{nCycles}, nInstrCompleted{nInstrCompleted}, fcsr{fcsr},
+        vectorUnit{vectorUnit}
+  {
+  }
+
+  bool isSupported(uint16_t csr) const { return getCSRName(csr) != nullptr; }
+  bool isWritable(uint16_t csr) const
+  {
+    return isSupported(csr) && (csr >> 10) != 0x3;
+  }
+
+  RegValue read(uint16_t csr) const;
+  void write(uint16_t csr, RegValue value);
+
+  void setInterruptLines(uint64_t lines)
+  {
+    mip = lines & InterruptMask;
+    if (hasInterruptToWake())
+      waiting = false;
+  }
+  void setTimer(const CLINT* newTimer) { timer = newTimer; }
+
+  /* Traps are only taken once software has installed a handler. */
+  bool hasTrapHandler() const { return mtvec != 0; }
+
+  /* The cause of the interrupt to take: the highest priority interrupt
+   * that is pending and enabled, 0 if there is none.
+   */
+  uint64_t getPendingInterrupt() const;
+
+  /* wfi waits until an interrupt is pending and enabled in mie, whether
+   * or not interrupts are enabled in mstatus.
+   */
+  bool hasInterruptToWake() const { return (mip & mie) != 0; }
+
+  /* Issued wfi: no instruction issues until the processor wakes up. */
+  void waitForInterrupt()
+  {
+    waiting = true;
+    waitStart = nCycles;
+  }
+  bool isWaiting() const { return waiting && !hasInterruptToWake(); }
+  uint64_t getWaitStart() const { return waitStart; }
+
+  /* The address of the handler for cause, in direct or vectored mode. */
+  MemAddress getTrapVector(uint64_t cause) const;
+
+  void enterTrap(uint64_t cause, MemAddress epc, RegValue tval);
+
+  /* mret: returns to mepc and restores the interrupt enable. */
+  MemAddress getReturnAddress() const { return mepc; }
+  void returnFromTrap();
+
+  /* The value written by a CSR instruction, given the old value of the
+   * CSR and the operand: rs1 or the zero-extended immediate.
+   */
+  static RegValue apply(CSROp op, RegValue oldValue, RegValue operand);
+
+  /* The number of writes, traps and trap returns, which change the state
+   * kept here.
+   */
+  uint64_t getWriteCount() const { return nWrites; }
+
+private:
+  const uint64_t& nCycles;
+  const uint64_t& nInstrCompleted;
+  FloatStatus& fcsr;
+  const VectorUnit& vectorUnit;
+  const CLINT* timer{};
+
+  static constexpr uint64_t StatusMIE = 1 << 3;
+  static constexpr uint64_t StatusMPIE = 1 << 7;
+  static constexpr uint64_t MachineModeMPP = 0x3 << 11;
+  /* RV64 with the A, C, D, F, I, M and V extensions */
+  static constexpr uint64_t MisaValue =
+      2ULL << 62 | 1 << 0 | 1 << 2 | 1 << 3 | 1 << 5 | 1 << 8 | 1 << 12 |
+      1 << 21;
+  static constexpr uint64_t InterruptMask =
+      SoftwareInterrupt | TimerInterrupt | ExternalInterrupt;
+
+  uint64_t mstatus{};
+  uint64_t mie{};
+  uint64_t mip{};
+  MemAddress mtvec{};
+  RegValue mscratch{};
+  MemAddress mepc{};
+  uint64_t mcause{};
+  RegValue mtval{};
+
+  uint64_t nWrites{};
+
+  bool waiting{};
+  uint64_t waitStart{};
+};
+
+#endif /* __CSR_H__ */
@@ -0,0 +1,76 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    device-completion.h - Completion of commands of memory-mapped devices.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __DEVICE_COMPLETION_H__
+#define __DEVICE_COMPLETION_H__
+
+#include "memory-interface.h"
+
+#include <cstdint>
+
+/* The status register of a device that performs one command at a time.
+ * A command is started by a write to the device's doorbell register and
+ * completes in a later cycle; from then on, the status shows Done until
+ * a write to the status register acknowledges the completion. A command
+ * that is started while another one is busy is rejected: the command in
+ * progress continues, but completes with Error.
+ */
+class DeviceCompletion {
+public:
+  enum Status : uint64_t {
+    Busy = 1 << 0,
+    Done = 1 << 1,
+    Error = 1 << 2
+  };
+
+  explicit DeviceCompletion(const uint64_t& nCycles) : nCycles{nCycles} {}
+
+  bool isBusy() const { return pending && nCycles < completion; }
+  bool isDone() const { return pending && nCycles >= completion; }
+
+  /* A command was started; it failed unless succeeded is set and
+   * completes after the given number of cycles.
+   */
+  void start(bool succeeded, uint64_t cycles)
+  {
+    pending = true;
+    failed = !succeeded;
+    completion = nCycles + cycles;
+  }
+
+  void reject() { failed = true; }
+
+  /* A busy command cannot be acknowledged. */
+  void acknowledge()
+  {
+    if (!isBusy()) {
+      pending = false;
+      failed = false;
+    }
+  }
+
+  uint64_t getStatus() const
+  {
+    if (!pending)
+      return 0;
+    return (isBusy() ? Busy : Done) | (failed ? Error : 0);
+  }
+
+  uint64_t getNextEvent() const
+  {
+    return isBusy() ? completion : MemoryInterface::NoEvent;
+  }
+
+private:
+  const uint64_t& nCycles;
+
+  bool pending{};
+  bool failed{};
+  uint64_t completion{};
+};
+
+#endif /* __DEVICE_COMPLETION_H__ */
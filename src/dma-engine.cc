@@ -0,0 +1,193 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dma-engine.cc - DMA controller for bulk copies in guest memory.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "dma-engine.h"
+#include "memory-bus.h"
+
+#include <cstring>
+#include <stdexcept>
+
+DMAEngine::DMAEngine(const DMAConfig& config, MemoryBus& bus,
+                     const uint64_t& nCycles)
+    : base{config.base}, latency{config.latency},
+      bytesPerCycle{config.bytesPerCycle}, bus{bus}, completion{nCycles}
+{
+  if (bytesPerCycle == 0)
+    throw std::out_of_range("dma bytesPerCycle must be at least 1");
+}
+
+void
+DMAEngine::start(uint64_t newControl)
+{
+  if (completion.isBusy()) {
+    completion.reject();
+    return;
+  }
+
+  control = newControl;
+
+  uint64_t bytes = 0;
+  bool succeeded;
+  if (control & Chain)
+    succeeded = copyChain(bytes);
+  else {
+    succeeded = copyBlock(source, destination, length);
+    if (succeeded)
+      bytes = length;
+  }
+
+  ++nTransfers;
+  nBytesCopied += bytes;
+  completion.start(succeeded,
+                   latency + (bytes + bytesPerCycle - 1) / bytesPerCycle);
+}
+
+/* The source and destination may overlap. */
+bool
+DMAEngine::copyBlock(MemAddress from, MemAddress to, uint64_t size)
+{
+  if (size == 0)
+    return true;
+
+  const std::byte* src = bus.getHostPointer(from, size, false);
+  std::byte* dst = bus.getHostPointer(to, size, true);
+  if (!src || !dst)
+    return false;
+
+  std::memmove(dst, src, size);
+  return true;
+}
+
+/* Adds the bytes of the blocks that were copied to bytes. */
+bool
+DMAEngine::copyChain(uint64_t& bytes)
+{
+  MemAddress next = source;
+  for (uint64_t i = 0; next != 0 && i < MaxDescriptors; ++i) {
+    Descriptor descriptor{};
+    const std::byte* ptr =
+        bus.getHostPointer(next, sizeof(descriptor), false);
+    if (!ptr)
+      return false;
+
+    std::memcpy(&descriptor, ptr, sizeof(descriptor));
+    if (!copyBlock(descriptor.source, descriptor.destination,
+                   descriptor.length))
+      return false;
+
+    bytes += descriptor.length;
+    next = descriptor.next;
+  }
+
+  return next == 0;
+}
+
+/*
+ * MemoryInterface
+ */
+
+uint8_t
+DMAEngine::readByte(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+uint16_t
+DMAEngine::readHalfWord(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+uint32_t
+DMAEngine::readWord(MemAddress addr)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+uint64_t
+DMAEngine::readDoubleWord(MemAddress addr)
+{
+  switch (addr - base) {
+  case SourceOffset:
+    return source;
+  case DestinationOffset:
+    return destination;
+  case LengthOffset:
+    return length;
+  case ControlOffset:
+    return control;
+  case StatusOffset:
+    return completion.getStatus();
+  default:
+    throw IllegalAccess("Invalid DMA engine register");
+  }
+}
+
+void
+DMAEngine::writeByte(MemAddress addr, uint8_t value)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+void
+DMAEngine::writeHalfWord(MemAddress addr, uint16_t value)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+void
+DMAEngine::writeWord(MemAddress addr, uint32_t value)
+{
+  throw IllegalAccess("Not supported on DMA engine");
+}
+
+void
+DMAEngine::writeDoubleWord(MemAddress addr, uint64_t value)
+{
+  switch (addr - base) {
+  case SourceOffset:
+    source = value;
+    break;
+  case DestinationOffset:
+    destination = value;
+    break;
+  case LengthOffset:
+    length = value;
+    break;
+  case ControlOffset:
+    if (value & Start)
+      start(value);
+    else
+      control = value;
+    break;
+  case StatusOffset:
+    completion.acknowledge();
+    break;
+  default:
+    throw IllegalAccess("Invalid DMA engine register");
+  }
+}
+
+bool
+DMAEngine::contains(MemAddress addr) const
+{
+  return base <= addr && addr < base + Size;
+}
+
+uint64_t
+DMAEngine::getInterruptLines() const
+{
+  if ((control & InterruptEnable) && completion.isDone())
+    return ExternalInterrupt;
+  return 0;
+}
+
+uint64_t
+DMAEngine::getNextEvent() const
+{
+  return completion.getNextEvent();
+}
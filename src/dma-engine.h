@@ -0,0 +1,114 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dma-engine.h - DMA controller for bulk copies in guest memory.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __DMA_ENGINE_H__
+#define __DMA_ENGINE_H__
+
+#include "device-completion.h"
+#include "machine-config.h"
+#include "memory-interface.h"
+
+class MemoryBus;
+
+/* A DMA controller with the following 64-bit registers:
+ *
+ *   base + 0x00: source address, or the address of the first descriptor
+ *   base + 0x08: destination address
+ *   base + 0x10: length in bytes
+ *   base + 0x18: control, see the Control bits; a write with Start set
+ *                starts the transfer
+ *   base + 0x20: status, see DeviceCompletion; a write acknowledges the
+ *                completion and clears Done and Error
+ *
+ * With Chain set, the transfer is described by a list of descriptors in
+ * memory, each a Descriptor of four doublewords; the destination and
+ * length registers are not used. The list ends at a descriptor with a
+ * next address of 0.
+ *
+ * Every block is copied at once between the host memories of the source
+ * and the destination, when the transfer is started. The transfer
+ * completes after the configured latency plus the time to move the
+ * bytes, and the program must not access the destination until then. A
+ * transfer is rejected with Error when it is started while the engine is
+ * busy, or when a block or descriptor is not contained in a single
+ * memory. The blocks of a chain before the failing descriptor have been
+ * copied.
+ */
+class DMAEngine : public MemoryInterface {
+public:
+  enum Control : uint64_t {
+    Start = 1 << 0,
+    Chain = 1 << 1,          /* scatter-gather descriptor list */
+    InterruptEnable = 1 << 2 /* raise the external interrupt when Done */
+  };
+
+  struct Descriptor {
+    uint64_t source;
+    uint64_t destination;
+    uint64_t length;
+    uint64_t next;
+  };
+
+  /* Bound on the length of a chain, which could contain a cycle. */
+  static constexpr uint64_t MaxDescriptors = 1 << 20;
+
+  DMAEngine(const DMAConfig& config, MemoryBus& bus,
+            const uint64_t& nCycles);
+  ~DMAEngine() override = default;
+
+  DMAEngine(const DMAEngine&) = delete;
+  DMAEngine& operator=(const DMAEngine&) = delete;
+
+  uint64_t getTransfers() const { return nTransfers; }
+  uint64_t getBytesCopied() const { return nBytesCopied; }
+
+  /* MemoryInterface */
+  uint8_t readByte(MemAddress addr) override;
+  uint16_t readHalfWord(MemAddress addr) override;
+  uint32_t readWord(MemAddress addr) override;
+  uint64_t readDoubleWord(MemAddress addr) override;
+
+  void writeByte(MemAddress addr, uint8_t value) override;
+  void writeHalfWord(MemAddress addr, uint16_t value) override;
+  void writeWord(MemAddress addr, uint32_t value) override;
+  void writeDoubleWord(MemAddress addr, uint64_t value) override;
+
+  bool contains(MemAddress addr) const override;
+
+  uint64_t getInterruptLines() const override;
+  uint64_t getNextEvent() const override;
+  bool isReadStable(MemAddress addr) const override { return true; }
+
+private:
+  static constexpr MemAddress SourceOffset = 0x00;
+  static constexpr MemAddress DestinationOffset = 0x08;
+  static constexpr MemAddress LengthOffset = 0x10;
+  static constexpr MemAddress ControlOffset = 0x18;
+  static constexpr MemAddress StatusOffset = 0x20;
+  static constexpr MemAddress Size = 0x28;
+
+  const MemAddress base;
+  const uint64_t latency;
+  const uint64_t bytesPerCycle;
+  MemoryBus& bus;
+
+  uint64_t source{};
+  uint64_t destination{};
+  uint64_t length{};
+  uint64_t control{};
+
+  DeviceCompletion completion;
+
+  uint64_t nTransfers{};
+  uint64_t nBytesCopied{};
+
+  void start(uint64_t newControl);
+  bool copyBlock(MemAddress from, MemAddress to, uint64_t size);
+  bool copyChain(uint64_t& bytes);
+};
+
+#endif /* __DMA_ENGINE_H__ */
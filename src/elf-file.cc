@@ -17,6 +17,7 @@
 
 #include "elf.h"
 
+#include <algorithm>
 #include <functional>
 #include <stdexcept>
 
@@ -264,3 +265,16 @@ ELFFile::getEntrypoint() const
 {
   return static_cast<Elf64_Ehdr*>(mapAddr)->e_entry;
 }
+
+MemAddress
+ELFFile::getProgramEnd() const
+{
+  MemAddress end = 0;
+
+  foreachSegment(mapAddr,
+                 [&end](const Elf64_Ehdr* elf, const Elf64_Shdr& header) {
+                   end = std::max(end, header.sh_addr + header.sh_size);
+                 });
+
+  return end;
+}
@@ -36,6 +36,9 @@ public:
                       MemAddress& segmentBase, size_t& segmentSize) const;
   uint64_t getEntrypoint() const;
 
+  /* The address following the highest section that is loaded. */
+  MemAddress getProgramEnd() const;
+
   ELFFile(const ELFFile&) = delete;
   ELFFile& operator=(const ELFFile&) = delete;
 
@@ -0,0 +1,395 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    fpu.cc - Floating-point unit component.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "fpu.h"
+
+#include <cfenv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+/* The host rounding mode is changed at run-time; the compiler may not
+ * move floating-point operations across these changes. For GCC and Clang
+ * this requires -frounding-math.
+ */
+#ifdef _MSC_VER
+#pragma fenv_access(on)
+#endif
+
+namespace {
+
+template <typename T>
+struct Format;
+
+template <>
+struct Format<float> {
+  using Bits = uint32_t;
+  static constexpr Bits CanonicalNaN = 0x7FC00000;
+  static constexpr Bits QuietBit = 1U << 22;
+  static constexpr Bits SignBit = 1U << 31;
+};
+
+template <>
+struct Format<double> {
+  using Bits = uint64_t;
+  static constexpr Bits CanonicalNaN = 0x7FF8000000000000ULL;
+  static constexpr Bits QuietBit = 1ULL << 51;
+  static constexpr Bits SignBit = 1ULL << 63;
+};
+
+/* Single-precision values occupy the low half of a register, the upper
+ * half is all ones. Values that are not properly boxed read as the
+ * canonical NaN.
+ */
+constexpr RegValue BoxMask = 0xFFFFFFFF00000000ULL;
+
+template <typename T>
+typename Format<T>::Bits
+unbox(RegValue value)
+{
+  if constexpr (std::is_same_v<T, float>) {
+    if ((value & BoxMask) != BoxMask)
+      return Format<float>::CanonicalNaN;
+    return static_cast<uint32_t>(value);
+  } else
+    return value;
+}
+
+template <typename T>
+RegValue
+box(typename Format<T>::Bits bits)
+{
+  if constexpr (std::is_same_v<T, float>)
+    return BoxMask | bits;
+  else
+    return bits;
+}
+
+template <typename T>
+T
+toFloat(typename Format<T>::Bits bits)
+{
+  T value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+template <typename T>
+typename Format<T>::Bits
+toBits(T value)
+{
+  typename Format<T>::Bits bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+template <typename T>
+bool
+isSignaling(typename Format<T>::Bits bits)
+{
+  return std::isnan(toFloat<T>(bits)) && !(bits & Format<T>::QuietBit);
+}
+
+/* NaN results of arithmetic operations are the canonical NaN. */
+template <typename T>
+RegValue
+canonical(T value)
+{
+  if (std::isnan(value))
+    return box<T>(Format<T>::CanonicalNaN);
+  return box<T>(toBits(value));
+}
+
+RegValue
+signExtendWord(uint32_t value)
+{
+  return static_cast<RegValue>(
+      static_cast<int64_t>(static_cast<int32_t>(value)));
+}
+
+/* Sets the host rounding mode and clears its exception flags for the
+ * lifetime of the object.
+ */
+class HostEnvironment {
+public:
+  explicit HostEnvironment(RoundingMode mode) : saved{std::fegetround()}
+  {
+    switch (mode) {
+    case RoundingMode::RTZ:
+      std::fesetround(FE_TOWARDZERO);
+      break;
+    case RoundingMode::RDN:
+      std::fesetround(FE_DOWNWARD);
+      break;
+    case RoundingMode::RUP:
+      std::fesetround(FE_UPWARD);
+      break;
+    default:
+      std::fesetround(FE_TONEAREST);
+      break;
+    }
+    std::feclearexcept(FE_ALL_EXCEPT);
+  }
+
+  ~HostEnvironment() { std::fesetround(saved); }
+
+  HostEnvironment(const HostEnvironment&) = delete;
+  HostEnvironment& operator=(const HostEnvironment&) = delete;
+
+  uint8_t getFlags() const
+  {
+    const int raised = std::fetestexcept(FE_ALL_EXCEPT);
+    uint8_t flags = 0;
+    if (raised & FE_INEXACT)
+      flags |= FlagInexact;
+    if (raised & FE_UNDERFLOW)
+      flags |= FlagUnderflow;
+    if (raised & FE_OVERFLOW)
+      flags |= FlagOverflow;
+    if (raised & FE_DIVBYZERO)
+      flags |= FlagDivideByZero;
+    if (raised & FE_INVALID)
+      flags |= FlagInvalid;
+    return flags;
+  }
+
+private:
+  int saved;
+};
+
+/* Conversion to an integer type, rounded in the current host rounding
+ * mode. NaN and out of range values saturate and are invalid.
+ */
+template <typename I, typename T>
+I
+toInteger(T value, uint8_t& flags)
+{
+  if (std::isnan(value)) {
+    flags |= FlagInvalid;
+    return std::numeric_limits<I>::max();
+  }
+
+  const T rounded = std::nearbyint(value);
+  const T upper = std::ldexp(T{1}, std::numeric_limits<I>::digits);
+  const T lower = std::is_signed_v<I> ? -upper : T{0};
+
+  if (rounded >= upper) {
+    flags |= FlagInvalid;
+    return std::numeric_limits<I>::max();
+  }
+  if (rounded < lower) {
+    flags |= FlagInvalid;
+    return std::numeric_limits<I>::min();
+  }
+
+  if (rounded != value)
+    flags |= FlagInexact;
+  return static_cast<I>(rounded);
+}
+
+template <typename T>
+RegValue
+minMax(FPUOp op, typename Format<T>::Bits a, typename Format<T>::Bits b,
+       uint8_t& flags)
+{
+  if (isSignaling<T>(a) || isSignaling<T>(b))
+    flags |= FlagInvalid;
+
+  const T x = toFloat<T>(a);
+  const T y = toFloat<T>(b);
+
+  if (std::isnan(x) && std::isnan(y))
+    return box<T>(Format<T>::CanonicalNaN);
+  if (std::isnan(x))
+    return box<T>(b);
+  if (std::isnan(y))
+    return box<T>(a);
+
+  /* -0.0 is considered smaller than +0.0 */
+  if (x == y) {
+    const bool aNegative = a & Format<T>::SignBit;
+    return box<T>((op == FPUOp::FMIN) == aNegative ? a : b);
+  }
+
+  return box<T>((x < y) == (op == FPUOp::FMIN) ? a : b);
+}
+
+/* Returns the fclass mask of a value. */
+template <typename T>
+RegValue
+classify(typename Format<T>::Bits bits)
+{
+  const bool negative = bits & Format<T>::SignBit;
+
+  switch (std::fpclassify(toFloat<T>(bits))) {
+  case FP_INFINITE:
+    return negative ? 1 << 0 : 1 << 7;
+  case FP_NORMAL:
+    return negative ? 1 << 1 : 1 << 6;
+  case FP_SUBNORMAL:
+    return negative ? 1 << 2 : 1 << 5;
+  case FP_ZERO:
+    return negative ? 1 << 3 : 1 << 4;
+  default:
+    return isSignaling<T>(bits) ? 1 << 8 : 1 << 9;
+  }
+}
+
+template <typename T>
+RegValue
+execute(FPUOp op, RegValue A, RegValue B, RegValue C, RoundingMode mode,
+        uint8_t& flags)
+{
+  using Bits = typename Format<T>::Bits;
+  constexpr Bits SignBit = Format<T>::SignBit;
+
+  const Bits bitsA = unbox<T>(A);
+  const Bits bitsB = unbox<T>(B);
+  const T a = toFloat<T>(bitsA);
+  const T b = toFloat<T>(bitsB);
+  const T c = toFloat<T>(unbox<T>(C));
+
+  /* Operations that do not round. */
+  switch (op) {
+  case FPUOp::FSGNJ:
+    return box<T>((bitsA & ~SignBit) | (bitsB & SignBit));
+  case FPUOp::FSGNJN:
+    return box<T>((bitsA & ~SignBit) | (~bitsB & SignBit));
+  case FPUOp::FSGNJX:
+    return box<T>(bitsA ^ (bitsB & SignBit));
+
+  case FPUOp::FMIN:
+  case FPUOp::FMAX:
+    return minMax<T>(op, bitsA, bitsB, flags);
+
+  /* Equality is a quiet comparison, the others signal on any NaN. */
+  case FPUOp::FEQ:
+    if (isSignaling<T>(bitsA) || isSignaling<T>(bitsB))
+      flags |= FlagInvalid;
+    return !std::isnan(a) && !std::isnan(b) && a == b;
+  case FPUOp::FLT:
+  case FPUOp::FLE:
+    if (std::isnan(a) || std::isnan(b)) {
+      flags |= FlagInvalid;
+      return 0;
+    }
+    return op == FPUOp::FLT ? a < b : a <= b;
+
+  case FPUOp::FCLASS:
+    return classify<T>(bitsA);
+
+  /* Moves copy the bits, without checking the NaN-boxing. */
+  case FPUOp::FMV_X_F:
+    if constexpr (std::is_same_v<T, float>)
+      return signExtendWord(static_cast<uint32_t>(A));
+    else
+      return A;
+  case FPUOp::FMV_F_X:
+    return box<T>(static_cast<Bits>(A));
+
+  default:
+    break;
+  }
+
+  /* The remaining operations are performed by the host FPU. */
+  HostEnvironment host{mode};
+  RegValue result{};
+
+  switch (op) {
+  case FPUOp::FADD:
+    result = canonical<T>(a + b);
+    break;
+  case FPUOp::FSUB:
+    result = canonical<T>(a - b);
+    break;
+  case FPUOp::FMUL:
+    result = canonical<T>(a * b);
+    break;
+  case FPUOp::FDIV:
+    result = canonical<T>(a / b);
+    break;
+  case FPUOp::FSQRT:
+    result = canonical<T>(std::sqrt(a));
+    break;
+
+  case FPUOp::FMADD:
+    result = canonical<T>(std::fma(a, b, c));
+    break;
+  case FPUOp::FMSUB:
+    result = canonical<T>(std::fma(a, b, -c));
+    break;
+  case FPUOp::FNMSUB:
+    result = canonical<T>(std::fma(-a, b, c));
+    break;
+  case FPUOp::FNMADD:
+    result = canonical<T>(std::fma(-a, b, -c));
+    break;
+
+  /* Word results are sign-extended, also when unsigned. */
+  case FPUOp::FCVT_W_F:
+    result = signExtendWord(toInteger<int32_t>(a, flags));
+    break;
+  case FPUOp::FCVT_WU_F:
+    result = signExtendWord(toInteger<uint32_t>(a, flags));
+    break;
+  case FPUOp::FCVT_L_F:
+    result = static_cast<RegValue>(toInteger<int64_t>(a, flags));
+    break;
+  case FPUOp::FCVT_LU_F:
+    result = toInteger<uint64_t>(a, flags);
+    break;
+
+  case FPUOp::FCVT_F_W:
+    result = canonical<T>(static_cast<T>(static_cast<int32_t>(A)));
+    break;
+  case FPUOp::FCVT_F_WU:
+    result = canonical<T>(static_cast<T>(static_cast<uint32_t>(A)));
+    break;
+  case FPUOp::FCVT_F_L:
+    result = canonical<T>(static_cast<T>(static_cast<int64_t>(A)));
+    break;
+  case FPUOp::FCVT_F_LU:
+    result = canonical<T>(static_cast<T>(A));
+    break;
+
+  case FPUOp::FCVT_F_F:
+    if constexpr (std::is_same_v<T, float>)
+      result = canonical<T>(static_cast<T>(toFloat<double>(unbox<double>(A))));
+    else
+      result = canonical<T>(static_cast<T>(toFloat<float>(unbox<float>(A))));
+    break;
+
+  default:
+    throw std::logic_error("Unknown FPU operation");
+  }
+
+  flags |= host.getFlags();
+  return result;
+}
+
+} // namespace
+
+FPU::FPU()
+    : A(), B(), C(), op(FPUOp::NOP), isDouble(), mode(RoundingMode::RNE),
+      flags()
+{
+}
+
+RegValue
+FPU::getResult()
+{
+  flags = 0;
+
+  if (op == FPUOp::NOP)
+    return 0;
+
+  if (isDouble)
+    return execute<double>(op, A, B, C, mode, flags);
+  return execute<float>(op, A, B, C, mode, flags);
+}
@@ -0,0 +1,120 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    fpu.h - Floating-point unit component.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __FPU_H__
+#define __FPU_H__
+
+#include "arch.h"
+
+enum class FPUOp {
+  NOP,
+  FADD,
+  FSUB,
+  FMUL,
+  FDIV,
+  FSQRT,
+  FSGNJ,
+  FSGNJN,
+  FSGNJX,
+  FMIN,
+  FMAX,
+
+  /* Fused multiply-add, with C as addend */
+  FMADD,
+  FMSUB,
+  FNMSUB,
+  FNMADD,
+
+  /* Comparisons and classification, the result is an integer */
+  FEQ,
+  FLT,
+  FLE,
+  FCLASS,
+
+  /* Conversions; for FCVT_F_F the source has the other precision */
+  FCVT_W_F,  /* float to signed word */
+  FCVT_WU_F, /* float to unsigned word */
+  FCVT_L_F,  /* float to signed double word */
+  FCVT_LU_F, /* float to unsigned double word */
+  FCVT_F_W,
+  FCVT_F_WU,
+  FCVT_F_L,
+  FCVT_F_LU,
+  FCVT_F_F,
+
+  /* Bit-wise moves between integer and floating-point registers */
+  FMV_X_F,
+  FMV_F_X
+};
+
+/* Rounding modes, as encoded in the rm field and the frm register. */
+enum class RoundingMode : uint8_t {
+  RNE = 0, /* to nearest, ties to even */
+  RTZ = 1, /* towards zero */
+  RDN = 2, /* down */
+  RUP = 3, /* up */
+  RMM = 4, /* to nearest, ties to max magnitude */
+  DYN = 7  /* use frm, only valid in instructions */
+};
+
+/* Exception flags, as accrued in fflags. */
+enum FloatFlags : uint8_t {
+  FlagInexact = 0x01,
+  FlagUnderflow = 0x02,
+  FlagOverflow = 0x04,
+  FlagDivideByZero = 0x08,
+  FlagInvalid = 0x10
+};
+
+/* The floating-point control and status register, fcsr. */
+struct FloatStatus {
+  uint8_t flags{};    /* fflags, accrued exception flags */
+  RoundingMode frm{}; /* dynamic rounding mode */
+};
+
+/* The FPU component performs the specified operation on operands A, B
+ * and C, similar to the ALU. Operands and results are the 64-bit register
+ * contents: single-precision values are NaN-boxed. The operation is
+ * performed by the host FPU with its rounding mode set accordingly; the
+ * exception flags raised are available after getResult.
+ *
+ * The host has no equivalent of RMM, which is performed as RNE. Results
+ * only differ for exact ties.
+ */
+class FPU {
+public:
+  FPU();
+
+  void setA(RegValue A) { this->A = A; }
+  void setB(RegValue B) { this->B = B; }
+  void setC(RegValue C) { this->C = C; }
+
+  void setOp(FPUOp op) { this->op = op; }
+
+  /* Operate on double-precision instead of single-precision values. */
+  void setDouble(bool isDouble) { this->isDouble = isDouble; }
+
+  /* Static rounding mode; DYN is resolved by the caller. */
+  void setRoundingMode(RoundingMode mode) { this->mode = mode; }
+
+  RegValue getResult();
+
+  uint8_t getFlags() const { return flags; }
+
+private:
+  RegValue A;
+  RegValue B;
+  RegValue C;
+
+  FPUOp op;
+  bool isDouble;
+  RoundingMode mode;
+
+  uint8_t flags;
+};
+
+#endif /* __FPU_H__ */
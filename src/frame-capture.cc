@@ -0,0 +1,206 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    frame-capture.cc - Capture of framebuffer frames to files.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "frame-capture.h"
+#include "framebuffer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+static bool
+hasSuffix(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+FrameCapture::FrameCapture(const std::string& filename, uint64_t interval,
+                           double clockFrequency)
+    : format{Format::PPM}, filename{filename}, interval{interval},
+      clockFrequency{clockFrequency}, stream{nullptr}
+{
+  if (interval == 0)
+    throw std::runtime_error("the framebuffer capture interval must be "
+                             "positive");
+
+  if (filename == "-" || hasSuffix(filename, ".y4m"))
+    format = Format::Y4M;
+  else if (hasSuffix(filename, ".rgba"))
+    format = Format::RGBA;
+  else
+    return;
+
+  if (filename == "-") {
+    stream.rdbuf(std::cout.rdbuf());
+    return;
+  }
+
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("cannot open framebuffer capture file " +
+                             filename);
+  stream.rdbuf(file.rdbuf());
+}
+
+void
+FrameCapture::write(const Frame& frame, const std::vector<uint8_t>& dirty,
+                    uint64_t cycle)
+{
+  if (!acceptResolution(frame)) {
+    converted = false;
+    return;
+  }
+
+  convert(frame, dirty);
+
+  bool written = false;
+  switch (format) {
+  case Format::Y4M:
+    written = writeY4M(cycle);
+    break;
+
+  case Format::RGBA:
+    written = bool(stream.write(reinterpret_cast<const char*>(rgba.data()),
+                                rgba.size()));
+    break;
+
+  case Format::PPM:
+    written = writePPM(cycle);
+    break;
+  }
+
+  if (written)
+    ++nFrames;
+  else if (!failed) {
+    /* A failed capture does not stop the simulation. */
+    std::cerr << "warning: cannot write framebuffer capture " << filename
+              << std::endl;
+    failed = true;
+  }
+}
+
+/* The first frame fixes the resolution of a video or stream. */
+bool
+FrameCapture::acceptResolution(const Frame& frame)
+{
+  if (format == Format::PPM || nFrames == 0) {
+    resx = frame.resx;
+    resy = frame.resy;
+    return true;
+  }
+
+  if (frame.resx == resx && frame.resy == resy)
+    return true;
+
+  if (!skipped) {
+    std::cerr << "warning: skipping framebuffer frames of " << frame.resx
+              << "x" << frame.resy << " in capture " << filename << " of "
+              << resx << "x" << resy << std::endl;
+    skipped = true;
+  }
+  return false;
+}
+
+/* Convert the rows that are dirty, or all rows when the frame was
+ * enabled again or the previous one was skipped. Consecutive dirty rows
+ * are converted together.
+ */
+void
+FrameCapture::convert(const Frame& frame, const std::vector<uint8_t>& dirty)
+{
+  const bool all = !converted || frame.generation != generation;
+  const size_t rowBytes = size_t{frame.resx} * 4;
+
+  rgba.resize(rowBytes * frame.resy);
+  generation = frame.generation;
+  converted = true;
+
+  uint32_t y = 0;
+  while (y < frame.resy) {
+    if (!all && !dirty[y]) {
+      ++y;
+      continue;
+    }
+
+    uint32_t end = y + 1;
+    while (end < frame.resy && (all || dirty[end]))
+      ++end;
+    frame.toRGBA(&rgba[y * rowBytes], y, end - y);
+    y = end;
+  }
+}
+
+/* The pixels are converted with the integer approximation of ITU-R BT.601
+ * to studio-range YCbCr, and written as three full-resolution planes.
+ */
+bool
+FrameCapture::writeY4M(uint64_t cycle)
+{
+  if (nFrames == 0) {
+    /* Without a clock frequency, the frame rate is a nominal 25 Hz. */
+    uint64_t rate = 25;
+    uint64_t scale = 1;
+    if (clockFrequency > 0) {
+      rate = static_cast<uint64_t>(std::llround(clockFrequency * 1000000));
+      scale = interval;
+      const uint64_t divisor = std::gcd(rate, scale);
+      rate /= divisor;
+      scale /= divisor;
+    }
+    stream << "YUV4MPEG2 W" << resx << " H" << resy << " F" << rate << ":"
+           << scale << " Ip A1:1 C444\n";
+  }
+  stream << "FRAME Xcycle=" << cycle << "\n";
+
+  const size_t count = size_t{resx} * resy;
+  pixels.resize(count * 3);
+  uint8_t* y = pixels.data();
+  uint8_t* u = y + count;
+  uint8_t* v = u + count;
+
+  for (size_t i = 0; i < count; ++i) {
+    const int r = rgba[i * 4];
+    const int g = rgba[i * 4 + 1];
+    const int b = rgba[i * 4 + 2];
+    y[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    u[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) +
+                                128);
+    v[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) +
+                                128);
+  }
+
+  return bool(stream.write(reinterpret_cast<const char*>(pixels.data()),
+                           pixels.size()));
+}
+
+bool
+FrameCapture::writePPM(uint64_t cycle)
+{
+  char name[16];
+  std::snprintf(name, sizeof(name), "%06llu.ppm",
+                static_cast<unsigned long long>(nFrames));
+
+  std::ofstream image{filename + name, std::ios::binary | std::ios::trunc};
+  if (!image)
+    return false;
+
+  const size_t count = size_t{resx} * resy;
+  pixels.resize(count * 3);
+  for (size_t i = 0; i < count; ++i) {
+    pixels[i * 3] = rgba[i * 4];
+    pixels[i * 3 + 1] = rgba[i * 4 + 1];
+    pixels[i * 3 + 2] = rgba[i * 4 + 2];
+  }
+
+  image << "P6\n# cycle " << cycle << "\n" << resx << " " << resy << "\n255\n";
+  image.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+  image.close();
+  return bool(image);
+}
@@ -0,0 +1,80 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    frame-capture.h - Capture of framebuffer frames to files.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __FRAME_CAPTURE_H__
+#define __FRAME_CAPTURE_H__
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Frame;
+
+/* Writes frames in one of the following formats, chosen by the file name:
+ *
+ *   *.y4m or "-": a YUV4MPEG2 video with 4:4:4 chroma; "-" is stdout.
+ *                 The frame rate is one frame per capture interval at
+ *                 the clock frequency. Unchanged frames are not written,
+ *                 so the Xcycle parameter of every frame header records
+ *                 the real cycle.
+ *   *.rgba:       raw pixels of 4 bytes (red, green, blue, alpha), one
+ *                 frame after the other.
+ *   otherwise:    binary PPM images named <filename>NNNNNN.ppm, with the
+ *                 cycle in a comment.
+ *
+ * The resolution of a video or stream is that of its first frame, frames
+ * of another resolution are skipped. Images can have any resolution.
+ */
+class FrameCapture {
+public:
+  FrameCapture(const std::string& filename, uint64_t interval,
+               double clockFrequency);
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  /* dirty flags the rows that were written since the previous call. */
+  void write(const Frame& frame, const std::vector<uint8_t>& dirty,
+             uint64_t cycle);
+
+  uint64_t getFramesWritten() const { return nFrames; }
+
+private:
+  enum class Format { Y4M, RGBA, PPM };
+
+  Format format;
+  std::string filename;
+  uint64_t interval;
+  double clockFrequency;
+
+  std::ofstream file{};
+  std::ostream stream;
+
+  uint32_t resx{};
+  uint32_t resy{};
+  bool skipped{}; /* warned about a resolution change */
+  bool failed{};  /* warned about a write error */
+
+  /* The converted pixels of the last frame, which are kept for the rows
+   * that did not change. They are of the frame with this generation.
+   */
+  std::vector<uint8_t> rgba{};
+  uint64_t generation{};
+  bool converted{};
+
+  std::vector<uint8_t> pixels{};
+  uint64_t nFrames{};
+
+  bool acceptResolution(const Frame& frame);
+  void convert(const Frame& frame, const std::vector<uint8_t>& dirty);
+  bool writeY4M(uint64_t cycle);
+  bool writePPM(uint64_t cycle);
+};
+
+#endif /* __FRAME_CAPTURE_H__ */
@@ -20,14 +20,23 @@
  * - Mode/resolution changes only work when screen is off to simplify design.
  * - Palette changes are always possible.
  * - The framebuffer is just a large chunk of memory uploaded to a texture
- *   and rendered to the screen. This isn't the most efficient method
- *   but it is very simple in its design. For the indexed/Y8 modes
- *   we translate it to RGBA8888 first.
+ *   and rendered to the screen. Writes mark the rows they touch as dirty,
+ *   and only the dirty rows are uploaded, so a single pixel write does not
+ *   cost a full-screen upload. For the indexed/Y8 modes we translate
+ *   the rows to RGBA first, with SIMD kernels (see pixel-kernels.h).
  * - Two base memory addresses, one for control/palette which only accepts
  *   aligned word size writes.
  *   The other writes directly to the framebuffer memory we allocate.
  * - Refreshes happen every X bus cycles if any of the memory changed.
  *   Refresh frequency can be adjusted with up/down arrow keys.
+ * - The window is drawn by a separate render thread, which receives a
+ *   copy of the framebuffer memory at every refresh. The simulation never
+ *   waits for the window.
+ * - The window needs SDL (ENABLE_FRAMEBUFFER), the device itself does not.
+ *   Frames can also be captured to a file (see FrameCapture) at a fixed
+ *   cycle interval, which is independent of the refresh frequency of the
+ *   window. Only frames that changed since the last capture are written,
+ *   and only their dirty rows are converted again.
  *
  * Relevant addresses:
  *  0x0000800 - Control interface/palette (word-size writes only)
@@ -42,34 +51,25 @@
  *              to support larger window sizes.
  */
 
-#ifdef ENABLE_FRAMEBUFFER
 #include "framebuffer.h"
+#include "frame-capture.h"
+#include "pixel-kernels.h"
+
+#include <algorithm>
+#include <cstring>
 
+#ifdef ENABLE_FRAMEBUFFER
 #include <SDL.h>
 #include <SDL_events.h>
 #include <SDL_video.h>
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 /* PRIu64 on MSVC */
 #include <cinttypes>
-
-enum FBmode {
-  FBMODE_Y8 = 0,
-  FBMODE_INDEXED,
-  FBMODE_RGB332,
-  FBMODE_RGB555,
-  FBMODE_RGB24,
-  FBMODE_RGBA32
-};
-
-/* We map most of our modes directly to SDL modes */
-static int sdl_mode_map[] = {
-    SDL_PIXELFORMAT_RGBA8888, // Y8
-    SDL_PIXELFORMAT_RGBA8888, // INDEXED
-    SDL_PIXELFORMAT_RGB332,   // RGB332
-    SDL_PIXELFORMAT_RGB555,   // RGB555
-    SDL_PIXELFORMAT_RGB24,    // RGB24
-    SDL_PIXELFORMAT_RGBA8888  // RGBA32
-};
+#endif
 
 /* bytes per pixel */
 static const int mem_mult[] = {
@@ -81,9 +81,100 @@ static const int mem_mult[] = {
     4  // RGBA32
 };
 
+/*
+ * Frame: conversion to RGBA, in the pixel formats used by the window.
+ */
+
+static inline void
+storeRGBA(uint8_t* p, uint32_t rgba8888)
+{
+  p[0] = rgba8888 >> 24;
+  p[1] = rgba8888 >> 16;
+  p[2] = rgba8888 >> 8;
+  p[3] = rgba8888;
+}
+
+/* Scale a component of bits wide to 8 bits. */
+static inline uint8_t
+expand(uint32_t value, unsigned bits)
+{
+  return value * 255 / ((1u << bits) - 1);
+}
+
+/* The 8-bit modes are converted by the SIMD kernels. */
+void
+Frame::toRGBA(uint8_t* rgba, uint32_t firstRow, uint32_t rows) const
+{
+  const size_t first = size_t{firstRow} * resx;
+  const size_t count = size_t{rows} * resx;
+
+  if (mode == FBMODE_Y8) {
+    getPixelKernels().grey(rgba, &mem[first], count);
+    return;
+  }
+
+  if (mode == FBMODE_INDEXED) {
+    std::array<uint32_t, 256> colours;
+    for (size_t i = 0; i < colours.size(); ++i)
+      storeRGBA(reinterpret_cast<uint8_t*>(&colours[i]), palette[i]);
+    getPixelKernels().palette(rgba, &mem[first], colours.data(), count);
+    return;
+  }
+
+  for (size_t i = first; i < first + count; ++i, rgba += 4) {
+    switch (mode) {
+    case FBMODE_RGB332:
+      rgba[0] = expand(mem[i] >> 5, 3);
+      rgba[1] = expand((mem[i] >> 2) & 0x7, 3);
+      rgba[2] = expand(mem[i] & 0x3, 2);
+      rgba[3] = 0xff;
+      break;
+
+    case FBMODE_RGB555: {
+      uint16_t pixel;
+      std::memcpy(&pixel, &mem[i * 2], sizeof(pixel));
+      rgba[0] = expand((pixel >> 10) & 0x1f, 5);
+      rgba[1] = expand((pixel >> 5) & 0x1f, 5);
+      rgba[2] = expand(pixel & 0x1f, 5);
+      rgba[3] = 0xff;
+      break;
+    }
+
+    case FBMODE_RGB24:
+      /* The bytes are in R, G, B order in memory. */
+      rgba[0] = mem[i * 3];
+      rgba[1] = mem[i * 3 + 1];
+      rgba[2] = mem[i * 3 + 2];
+      rgba[3] = 0xff;
+      break;
+
+    case FBMODE_RGBA32: {
+      uint32_t pixel;
+      std::memcpy(&pixel, &mem[i * 4], sizeof(pixel));
+      storeRGBA(rgba, pixel);
+      break;
+    }
+    }
+  }
+}
+
+#ifdef ENABLE_FRAMEBUFFER
+
+/* We map most of our modes directly to SDL modes; RGBA32 is the byte order
+ * of Frame::toRGBA.
+ */
+static int sdl_mode_map[] = {
+    SDL_PIXELFORMAT_RGBA32,   // Y8
+    SDL_PIXELFORMAT_RGBA32,   // INDEXED
+    SDL_PIXELFORMAT_RGB332,   // RGB332
+    SDL_PIXELFORMAT_RGB555,   // RGB555
+    SDL_PIXELFORMAT_RGB24,    // RGB24
+    SDL_PIXELFORMAT_RGBA8888  // RGBA32
+};
+
 /*
  * RenderContext: Useful context for the current window and its contents.
- * Internal class.
+ * Internal class, only used by the render thread.
  */
 
 class RenderContext {
@@ -91,26 +182,31 @@ public:
   RenderContext(const uint32_t resx, const uint32_t resy, const uint32_t mode);
   ~RenderContext();
 
-  void redrawScreen();
+  void redrawScreen(const Frame& frame, bool all);
+  void present();
+
+  bool matches(const Frame& frame) const
+  {
+    return frame.mode == mode && frame.resx == resx && frame.resy == resy;
+  }
 
   RenderContext(const RenderContext&) = delete;
   RenderContext& operator=(const RenderContext&) = delete;
 
-  /* public members, will be accessed directly by class FrameBuffer. */
   SDL_Window* window{};
   SDL_Renderer* renderer{};
   SDL_Texture* texture{};
-  uint8_t* mem{};
-  size_t memsize{};
 
-  bool active = false;
-  bool changed = true;
   uint32_t mode;
   uint32_t resx;
   uint32_t resy;
-};
 
-static uint32_t palette[256];
+private:
+  void updateRows(const Frame& frame, uint32_t first, uint32_t rows);
+
+  /* Rows of the 8-bit modes, converted to RGBA. */
+  std::vector<uint8_t> pixels{};
+};
 
 RenderContext::RenderContext(const uint32_t resx, const uint32_t resy,
                              const uint32_t mode)
@@ -131,10 +227,6 @@ RenderContext::RenderContext(const uint32_t resx, const uint32_t resy,
                  SDL_GetError());
     throw std::runtime_error("Error creating texture");
   }
-
-  memsize = resx * resy * mem_mult[mode];
-  mem = (uint8_t*)calloc(memsize, sizeof(uint8_t));
-  active = true;
 }
 
 RenderContext::~RenderContext()
@@ -146,132 +238,399 @@ RenderContext::~RenderContext()
     SDL_DestroyRenderer(renderer);
   if (window)
     SDL_DestroyWindow(window);
-  if (mem)
-    free(mem);
 }
 
-/* Update the texture and render it to the window */
+/* Update the texture with the rows of frame that are dirty, or with all
+ * rows. Consecutive dirty rows are uploaded together.
+ */
 void
-RenderContext::redrawScreen()
+RenderContext::redrawScreen(const Frame& frame, bool all)
 {
+  uint32_t y = 0;
+  while (y < resy) {
+    if (!all && !frame.dirty[y]) {
+      ++y;
+      continue;
+    }
+
+    uint32_t end = y + 1;
+    while (end < resy && (all || frame.dirty[end]))
+      ++end;
+    updateRows(frame, y, end - y);
+    y = end;
+  }
+
+  present();
+}
+
+void
+RenderContext::updateRows(const Frame& frame, uint32_t first, uint32_t rows)
+{
+  const SDL_Rect rect = {0, static_cast<int>(first), static_cast<int>(resx),
+                         static_cast<int>(rows)};
+
   switch (mode) {
   case FBMODE_RGB332:
   case FBMODE_RGB555:
   case FBMODE_RGB24:
-  case FBMODE_RGBA32:
-    SDL_UpdateTexture(texture, NULL, mem, resx * mem_mult[mode]);
+  case FBMODE_RGBA32: {
+    const size_t pitch = size_t{resx} * mem_mult[mode];
+    SDL_UpdateTexture(texture, &rect, &frame.mem[first * pitch], pitch);
     break;
+  }
 
   case FBMODE_Y8:
   case FBMODE_INDEXED:
-    uint8_t* pixels;
-    int pitch;
-    SDL_LockTexture(texture, NULL, (void**)&pixels, &pitch);
-    for (uint32_t y = 0; y < resy; y++)
-      for (uint32_t x = 0; x < resx; x++) {
-        uint32_t* p = (uint32_t*)&pixels[pitch * y + x * sizeof(uint32_t)];
-        uint8_t mval = mem[y * resx + x];
-        uint32_t pval = 0;
-        if (mode == FBMODE_Y8)
-          pval = mval << 24 | mval << 16 | mval << 8 | 0xff;
-        else if (mode == FBMODE_INDEXED)
-          pval = palette[mval];
-        *p = pval;
-      }
-    SDL_UnlockTexture(texture);
+    pixels.resize(size_t{resx} * rows * sizeof(uint32_t));
+    frame.toRGBA(pixels.data(), first, rows);
+    SDL_UpdateTexture(texture, &rect, pixels.data(),
+                      resx * sizeof(uint32_t));
     break;
   }
+}
 
+/* Render the texture to the window */
+void
+RenderContext::present()
+{
   SDL_RenderCopy(renderer, texture, 0, 0);
   SDL_RenderPresent(renderer);
-  changed = false;
 }
 
 /*
- * FrameBuffer implementation
+ * RenderThread: owns SDL and the window. Internal class.
+ *
+ * The simulation hands frames to the render thread through three Frame
+ * buffers: the simulation fills the back frame and exchanges it with the
+ * ready frame, the render thread exchanges the ready frame with the one
+ * it draws from. Neither thread waits for the other, so the simulation
+ * is not slowed down by window events, texture uploads or vsync. When
+ * the render thread falls behind, it only draws the latest frame.
  */
 
-Framebuffer::Framebuffer(const MemAddress control_base,
-                         const MemAddress framebuffer_base)
-    : control_base{control_base}, framebuffer_base{framebuffer_base}, context{}
+class RenderThread {
+public:
+  RenderThread();
+  ~RenderThread();
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  /* Simulation side */
+  Frame& getBackFrame() { return frames[back]; }
+  void publishFrame();
+
+  /* Whether the user closed the window since the last call. */
+  bool takeWindowClosed() { return window_closed.exchange(false); }
+
+  uint64_t getUpdateFreq() const { return update_freq.load(); }
+
+private:
+  static constexpr unsigned Fresh = 4; /* flag in ready, a new frame */
+
+  std::array<Frame, 3> frames{};
+  unsigned back = 0;               /* simulation */
+  std::atomic<unsigned> ready{1};  /* shared */
+  unsigned front = 2;              /* render thread */
+
+  std::atomic<bool> finished{false};
+  std::atomic<bool> window_closed{false};
+  std::atomic<uint64_t> update_freq{1000000};
+
+  /* Render thread state */
+  std::unique_ptr<RenderContext> context{};
+  uint64_t shown_generation = 0;
+  uint64_t shown_sequence = 0;
+  uint64_t closed_generation = 0;
+  uint64_t title_freq = 0;
+
+  std::thread thread{};
+
+  void run(std::promise<void>& initialized);
+  bool takeFrame();
+  void showFrame(const Frame& frame);
+  void closeWindow(uint64_t generation);
+  void processEvents(int timeout);
+};
+
+RenderThread::RenderThread()
+{
+  std::promise<void> initialized;
+  std::future<void> result = initialized.get_future();
+  thread = std::thread([this, &initialized]() { run(initialized); });
+
+  try {
+    result.get();
+  } catch (...) {
+    thread.join();
+    throw;
+  }
+}
+
+/* Once the simulation is over, the window stays open until the user
+ * closes it.
+ */
+RenderThread::~RenderThread()
+{
+  finished.store(true, std::memory_order_release);
+  thread.join();
+}
+
+void
+RenderThread::publishFrame()
+{
+  back = ready.exchange(back | Fresh, std::memory_order_acq_rel) & ~Fresh;
+}
+
+bool
+RenderThread::takeFrame()
+{
+  if (!(ready.load(std::memory_order_relaxed) & Fresh))
+    return false;
+
+  front = ready.exchange(front, std::memory_order_acq_rel) & ~Fresh;
+  return true;
+}
+
+void
+RenderThread::run(std::promise<void>& initialized)
 {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't init SDL: %s",
                  SDL_GetError());
     SDL_Quit();
-    throw std::runtime_error("Error initialising SDL");
+    initialized.set_exception(std::make_exception_ptr(
+        std::runtime_error("Error initialising SDL")));
+    return;
   }
+  initialized.set_value();
+
+  bool title_set = false;
+  while (true) {
+    /* A frame published before finished is set is still shown. */
+    const bool done = finished.load(std::memory_order_acquire);
+    if (takeFrame())
+      showFrame(frames[front]);
+
+    if (done && !context)
+      break;
+    if (done && !title_set) {
+      SDL_SetWindowTitle(context->window,
+                         "Simulation over, press q/ESC to quit");
+      title_set = true;
+    }
+
+    processEvents(done ? 200 : 10);
+  }
+
+  SDL_Quit();
 }
 
-Framebuffer::~Framebuffer()
+void
+RenderThread::showFrame(const Frame& frame)
 {
-  finished = true;
-  processEvents(true);
-  if (active_window) {
-    SDL_SetWindowTitle(context->window, "Simulation over, press q/ESC to quit");
-    while (active_window) {
-      processEvents(true);
-      SDL_Delay(200);
-    }
+  /* Frames that were published before the simulation noticed that the
+   * user closed the window, are not shown.
+   */
+  if (!frame.enable || frame.generation == closed_generation) {
+    context.reset(nullptr);
+    return;
   }
 
-  if (context)
+  if (context && !context->matches(frame))
     context.reset(nullptr);
 
-  SDL_Quit();
+  /* The dirty rows are relative to the previous frame, which may have
+   * been skipped.
+   */
+  bool all = frame.sequence != shown_sequence + 1;
+  if (!context) {
+    try {
+      context.reset(new RenderContext(frame.resx, frame.resy, frame.mode));
+    } catch (std::runtime_error&) {
+      closeWindow(frame.generation);
+      return;
+    }
+    title_freq = 0;
+    all = true;
+  }
+
+  context->redrawScreen(frame, all);
+  shown_generation = frame.generation;
+  shown_sequence = frame.sequence;
 }
 
 void
-Framebuffer::processEvents(const bool redraw)
+RenderThread::closeWindow(uint64_t generation)
 {
-  if (not active_window)
-    return;
+  context.reset(nullptr);
+  closed_generation = generation;
+  window_closed.store(true);
+}
 
+/* Wait up to timeout milliseconds for an event. */
+void
+RenderThread::processEvents(int timeout)
+{
   SDL_Event event;
-  while (SDL_PollEvent(&event)) {
+  bool pending = SDL_WaitEventTimeout(&event, timeout);
+  while (pending) {
     switch (event.type) {
     case SDL_KEYUP:
       switch (event.key.keysym.sym) {
       case SDLK_ESCAPE:
       case SDLK_q:
-        if (active_window) {
-          context.reset(nullptr);
-
-          control.enable = 0;
-          active_window = false;
-        }
+        if (context)
+          closeWindow(shown_generation);
         break;
 
       case SDLK_UP:
         if (update_freq > 10)
-          update_freq /= 10;
+          update_freq = update_freq / 10;
         break;
 
       case SDLK_DOWN:
         if (update_freq < 10000000)
-          update_freq *= 10;
+          update_freq = update_freq * 10;
         break;
       }
       break;
 
+    case SDL_WINDOWEVENT:
+      if (context && event.window.event == SDL_WINDOWEVENT_EXPOSED)
+        context->present();
+      break;
+
     default:
       break;
     }
-  }
 
-  /* Bail out if the window was just destroyed (due to quit command) */
-  if (not active_window)
-    return;
+    pending = SDL_PollEvent(&event);
+  }
 
-  /* Check if we need to update */
-  if (!finished) {
+  if (context && !finished && title_freq != update_freq) {
+    title_freq = update_freq;
     char tmp[256];
-    snprintf(tmp, 256, "rv64-emu - %" PRIu64 " bus cycles/update", update_freq);
+    snprintf(tmp, 256, "rv64-emu - %" PRIu64 " bus cycles/update", title_freq);
     SDL_SetWindowTitle(context->window, tmp);
   }
+}
+
+#else
+
+/* Without SDL there is no window, and no render thread is created. */
+class RenderThread {};
+
+#endif /* ENABLE_FRAMEBUFFER */
+
+/*
+ * FrameBuffer implementation
+ */
+
+Framebuffer::Framebuffer(const MemAddress control_base,
+                         const MemAddress framebuffer_base,
+                         const MachineConfig& config, const uint64_t& nCycles)
+    : control_base{control_base}, framebuffer_base{framebuffer_base},
+      nCycles{nCycles}, render{}, capture{}
+{
+#ifdef ENABLE_FRAMEBUFFER
+  if (config.framebuffer.window)
+    render.reset(new RenderThread());
+#endif
+
+  if (!config.framebuffer.capture.empty()) {
+    capture_interval = config.framebuffer.interval;
+    capture.reset(new FrameCapture(config.framebuffer.capture,
+                                   capture_interval,
+                                   config.pipeline.clockFrequency));
+  }
+}
+
+Framebuffer::~Framebuffer()
+{
+  /* Show the final contents of the framebuffer. */
+  if (frame.enable)
+    publishFrame();
+}
+
+/* Capture the final contents of the framebuffer, if they changed since
+ * the last capture.
+ */
+void
+Framebuffer::flush()
+{
+  if (capture && frame.enable && capture_changed) {
+    capture->write(frame, capture_dirty, nCycles);
+    std::fill(capture_dirty.begin(), capture_dirty.end(), 0);
+    capture_changed = false;
+  }
+}
+
+void
+Framebuffer::enable()
+{
+  if (control.mode > FBMODE_RGBA32)
+    throw IllegalAccess("Invalid framebuffer mode");
+
+  frame.mode = control.mode;
+  frame.resx = control.resx;
+  frame.resy = control.resy;
+  row_bytes = control.resx * mem_mult[control.mode];
+  frame.mem.assign(size_t{row_bytes} * control.resy, 0);
+  frame.dirty.assign(control.resy, 1);
+  capture_dirty.assign(control.resy, 1);
+  ++frame.generation;
+  frame.enable = true;
+  control.enable = 1;
+  capture_changed = true;
+  publishFrame();
+}
+
+void
+Framebuffer::disable()
+{
+  frame.mem.clear();
+  frame.mem.shrink_to_fit();
+  frame.dirty.clear();
+  capture_dirty.clear();
+  frame.enable = false;
+  control.enable = 0;
+  capture_changed = false;
+  publishFrame();
+}
+
+/* Hand a copy of the framebuffer to the render thread. */
+void
+Framebuffer::publishFrame()
+{
+#ifdef ENABLE_FRAMEBUFFER
+  if (render) {
+    Frame& back = render->getBackFrame();
+    back.enable = frame.enable;
+    back.generation = frame.generation;
+    back.mode = frame.mode;
+    back.resx = frame.resx;
+    back.resy = frame.resy;
+    back.mem.assign(frame.mem.begin(), frame.mem.end());
+    back.palette = frame.palette;
+    back.dirty.assign(frame.dirty.begin(), frame.dirty.end());
+    back.sequence = ++frame.sequence;
+
+    render->publishFrame();
+    std::fill(frame.dirty.begin(), frame.dirty.end(), 0);
+  }
+#endif
+  changed = false;
+}
 
-  if (context->changed || redraw)
-    context->redrawScreen();
+/* Mark the rows that contain the written bytes. */
+void
+Framebuffer::markDirty(uint32_t offset, uint32_t size)
+{
+  const uint32_t last = (offset + size - 1) / row_bytes;
+  for (uint32_t row = offset / row_bytes; row <= last; ++row)
+    frame.dirty[row] = capture_dirty[row] = 1;
+  setChanged();
 }
 
 /* Because the control/palette/framebuffer sections are stored differently
@@ -287,7 +646,7 @@ Framebuffer::getZone(const MemAddress addr, const uint8_t size,
 
   if (addr >= control_base && addr + size <= control_base +
                                                  sizeof(ControlInterface) +
-                                                 sizeof(palette)) {
+                                                 sizeof(frame.palette)) {
     if ((size > 0 && size != 4) || (size == 4 && addr % size != 0))
       throw IllegalAccess("Control/palette only support aligned 4 byte access");
 
@@ -301,14 +660,14 @@ Framebuffer::getZone(const MemAddress addr, const uint8_t size,
       if (offset)
         *offset = pos - sizeof(ControlInterface);
     }
-  } else if (not active_window && size == 0)
+  } else if (not frame.enable && size == 0)
     return FBzone::INVALID;
-  else if (not active_window && size > 0)
+  else if (not frame.enable && size > 0)
     throw IllegalAccess(
         "Framebuffer device only accessible with an active window");
   /* From here onwards, an active window is guaranteed. */
   else if (addr >= framebuffer_base &&
-           addr + size <= framebuffer_base + context->memsize) {
+           addr + size <= framebuffer_base + frame.mem.size()) {
     if (offset)
       *offset = addr - framebuffer_base;
     r = FBzone::BUFFER;
@@ -331,7 +690,7 @@ Framebuffer::readByte(MemAddress addr)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal access on framebuffer");
 
-  return context->mem[offset];
+  return frame.mem[offset];
 }
 
 uint16_t
@@ -342,7 +701,7 @@ Framebuffer::readHalfWord(MemAddress addr)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal halfword access on framebuffer");
 
-  return *(uint16_t*)&context->mem[offset];
+  return *(uint16_t*)&frame.mem[offset];
 }
 
 uint32_t
@@ -356,10 +715,10 @@ Framebuffer::readWord(MemAddress addr)
     return ((uint32_t*)&control)[offset / sizeof(uint32_t)];
 
   case FBzone::PALETTE:
-    return palette[offset / sizeof(uint32_t)];
+    return frame.palette[offset / sizeof(uint32_t)];
 
   case FBzone::BUFFER:
-    return *(uint32_t*)&context->mem[offset];
+    return *(uint32_t*)&frame.mem[offset];
 
   default:
     throw IllegalAccess("Invalid word access on framebuffer");
@@ -374,7 +733,7 @@ Framebuffer::readDoubleWord(MemAddress addr)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal doubleword access on framebuffer");
 
-  return *(uint64_t*)&context->mem[offset];
+  return *(uint64_t*)&frame.mem[offset];
 }
 
 void
@@ -385,8 +744,8 @@ Framebuffer::writeByte(MemAddress addr, uint8_t value)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal access on framebuffer");
 
-  context->mem[offset] = value;
-  context->changed = true;
+  frame.mem[offset] = value;
+  markDirty(offset, sizeof(value));
 }
 
 void
@@ -397,8 +756,8 @@ Framebuffer::writeHalfWord(MemAddress addr, uint16_t value)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal access on framebuffer");
 
-  *(uint16_t*)&context->mem[offset] = value;
-  context->changed = true;
+  *(uint16_t*)&frame.mem[offset] = value;
+  markDirty(offset, sizeof(value));
 }
 
 void
@@ -411,17 +770,10 @@ Framebuffer::writeWord(MemAddress addr, uint32_t value)
   case FBzone::CONTROL:
     if (offset == 0) {
       /* Turn the device on or off at address 0 */
-      if (active_window && value == 0) {
-        context.reset(nullptr);
-
-        active_window = false;
-        control.enable = 0;
-      } else if (not active_window && value > 0) {
-        context.reset(
-            new RenderContext(control.resx, control.resy, control.mode));
-        active_window = true;
-        control.enable = 1;
-      }
+      if (frame.enable && value == 0)
+        disable();
+      else if (not frame.enable && value > 0)
+        enable();
     } else {
       /* Writing directly to the struct */
       ((uint32_t*)&control)[offset / sizeof(uint32_t)] = value;
@@ -429,14 +781,18 @@ Framebuffer::writeWord(MemAddress addr, uint32_t value)
     break;
 
   case FBzone::PALETTE:
-    palette[offset / sizeof(uint32_t)] = value;
-    if (active_window)
-      context->changed = true;
+    frame.palette[offset / sizeof(uint32_t)] = value;
+    if (frame.enable && frame.mode == FBMODE_INDEXED) {
+      /* Every row may use the colour. */
+      std::fill(frame.dirty.begin(), frame.dirty.end(), 1);
+      std::fill(capture_dirty.begin(), capture_dirty.end(), 1);
+      setChanged();
+    }
     break;
 
   case FBzone::BUFFER:
-    *(uint32_t*)&context->mem[offset] = value;
-    context->changed = true;
+    *(uint32_t*)&frame.mem[offset] = value;
+    markDirty(offset, sizeof(value));
     break;
 
   default:
@@ -452,18 +808,49 @@ Framebuffer::writeDoubleWord(MemAddress addr, uint64_t value)
   if (zone == FBzone::INVALID)
     throw IllegalAccess("Illegal access on framebuffer");
 
-  *(uint64_t*)&context->mem[offset] = value;
-  context->changed = true;
+  *(uint64_t*)&frame.mem[offset] = value;
+  markDirty(offset, sizeof(value));
 }
 
+/* At every refresh interval, the render thread gets a copy of the
+ * framebuffer when it has changed. Captures are taken at multiples of the
+ * capture interval.
+ */
 void
 Framebuffer::clockPulse()
 {
-  if (cycles_since_update > update_freq) {
-    processEvents(true);
-    cycles_since_update = 0;
+#ifdef ENABLE_FRAMEBUFFER
+  if (render) {
+    if (render->takeWindowClosed() && frame.enable)
+      disable();
+
+    if (cycles_since_update > render->getUpdateFreq()) {
+      if (frame.enable && changed)
+        publishFrame();
+      cycles_since_update = 0;
+    }
+    ++cycles_since_update;
+  }
+#endif
+
+  if (capture && nCycles >= next_capture) {
+    flush();
+    next_capture = (nCycles / capture_interval + 1) * capture_interval;
   }
-  ++cycles_since_update;
 }
 
-#endif
+/* A pending capture must not be skipped over by the idle fast-forward. */
+uint64_t
+Framebuffer::getNextEvent() const
+{
+  if (capture && frame.enable && capture_changed)
+    return next_capture;
+  return NoEvent;
+}
+
+uint64_t
+Framebuffer::getFramesCaptured() const
+{
+  return capture ? capture->getFramesWritten() : 0;
+}
+
@@ -11,11 +11,15 @@
 #ifndef __FRAMEBUFFER_H__
 #define __FRAMEBUFFER_H__
 
+#include "machine-config.h"
 #include "memory-interface.h"
 
+#include <array>
 #include <memory>
+#include <vector>
 
-class RenderContext;
+class FrameCapture;
+class RenderThread;
 
 struct ControlInterface {
   uint32_t enable;
@@ -26,11 +30,47 @@ struct ControlInterface {
 
 enum class FBzone { INVALID = 0, CONTROL, PALETTE, BUFFER };
 
+enum FBmode {
+  FBMODE_Y8 = 0,
+  FBMODE_INDEXED,
+  FBMODE_RGB332,
+  FBMODE_RGB555,
+  FBMODE_RGB24,
+  FBMODE_RGBA32
+};
+
+/* The framebuffer memory and its configuration. The framebuffer hands
+ * copies to the render thread.
+ */
+struct Frame {
+  bool enable = false;
+  uint64_t generation{}; /* incremented every time the device is enabled */
+  uint64_t sequence{};   /* incremented for every copy that is handed over */
+  uint32_t mode{};
+  uint32_t resx{};
+  uint32_t resy{};
+  std::vector<uint8_t> mem{};
+  std::array<uint32_t, 256> palette{};
+
+  /* A flag for every row that was written since the previous copy was
+   * handed over.
+   */
+  std::vector<uint8_t> dirty{};
+
+  /* Convert the pixels to 4 bytes each: red, green, blue and alpha. */
+  void toRGBA(uint8_t* rgba) const { toRGBA(rgba, 0, resy); }
+  void toRGBA(uint8_t* rgba, uint32_t firstRow, uint32_t rows) const;
+};
+
 class Framebuffer : public MemoryInterface {
 public:
-  Framebuffer(const MemAddress control_base, const MemAddress framebuffer_base);
+  Framebuffer(const MemAddress control_base, const MemAddress framebuffer_base,
+              const MachineConfig& config, const uint64_t& nCycles);
   ~Framebuffer() override;
 
+  Framebuffer(const Framebuffer&) = delete;
+  Framebuffer& operator=(const Framebuffer&) = delete;
+
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
   uint16_t readHalfWord(MemAddress addr) override;
@@ -43,26 +83,49 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  bool isReadStable(MemAddress addr) const override { return true; }
 
   void clockPulse() override;
+  uint64_t getNextEvent() const override;
 
-  void processEvents(const bool redraw);
+  void flush();
+  bool isCapturing() const { return capture != nullptr; }
+  uint64_t getFramesCaptured() const;
 
 private:
   FBzone getZone(const MemAddress addr, const uint8_t size,
                  uint32_t* offset) const;
 
+  void enable();
+  void disable();
+  void publishFrame();
+  void setChanged() { changed = capture_changed = true; }
+  void markDirty(uint32_t offset, uint32_t size);
+
   const MemAddress control_base;
   const MemAddress framebuffer_base;
+  const uint64_t& nCycles;
 
-  bool active_window = false;
-  bool finished = false;
+  /* Whether the frame changed since the last refresh or capture. */
+  bool changed = false;
+  bool capture_changed = false;
 
-  uint64_t update_freq = 1000000;
   uint64_t cycles_since_update{};
+  uint32_t row_bytes{};
 
   ControlInterface control{};
-  std::unique_ptr<RenderContext> context;
+
+  /* The framebuffer memory written by the program, and the configuration
+   * it was enabled with. It is only accessed by the simulation; the render
+   * thread draws from copies of it.
+   */
+  Frame frame{};
+
+  std::unique_ptr<RenderThread> render;  /* nullptr without a window */
+  std::unique_ptr<FrameCapture> capture; /* nullptr without capture */
+  uint64_t capture_interval{};
+  uint64_t next_capture{};
+  std::vector<uint8_t> capture_dirty{}; /* rows written since the capture */
 };
 
 #endif /* __FRAMEBUFFER_H__ */
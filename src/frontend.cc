@@ -0,0 +1,227 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    frontend.cc - Branch predictor and decoupled instruction fetch.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "frontend.h"
+
+#include <iostream>
+
+/*
+ * Branch predictor
+ */
+
+BranchPredictor::BranchPredictor(unsigned btbEntries, unsigned counterEntries)
+    : btb(btbEntries, BTBEntry{false, false, 0, 0}),
+      counters(counterEntries, 1) /* weakly not taken */
+{
+  if (btbEntries == 0 || counterEntries == 0)
+    throw std::runtime_error("branch predictor tables must have entries");
+}
+
+MemAddress
+BranchPredictor::predict(MemAddress PC) const
+{
+  const BTBEntry& entry = btb[btbIndex(PC)];
+
+  if (!entry.valid || entry.PC != PC)
+    return PC + 4;
+
+  if (entry.conditional && counters[counterIndex(PC)] < 2)
+    return PC + 4;
+
+  return entry.target;
+}
+
+void
+BranchPredictor::update(MemAddress PC, bool conditional, bool taken,
+                        MemAddress target)
+{
+  if (conditional) {
+    uint8_t& counter = counters[counterIndex(PC)];
+    if (taken && counter < 3)
+      ++counter;
+    else if (!taken && counter > 0)
+      --counter;
+  }
+
+  /* Only taken control transfers allocate an entry. */
+  if (taken)
+    btb[btbIndex(PC)] = {true, conditional, PC, target};
+}
+
+/*
+ * Decoupled instruction fetch
+ */
+
+DecoupledFetchStage::DecoupledFetchStage(IF_IDRegisters& if_id,
+                                         InstructionMemory instructionMemory,
+                                         MemAddress& PC,
+                                         PipelineControl& control,
+                                         BranchPredictor& predictor,
+                                         const FrontendConfig& config,
+                                         int drainCycles)
+    : FetchStage(true), if_id(if_id), instructionMemory(instructionMemory),
+      PC(PC), control(control), predictor(predictor), config(config),
+      drainCycles(drainCycles)
+{
+  if (config.ftqSize == 0 || config.fetchLatency == 0)
+    throw std::runtime_error("fetch target queue size and fetch latency "
+                             "must be at least 1");
+}
+
+/* The queues are internal to the stage and decode only observes IF_ID,
+ * so all work is done at the clock edge.
+ */
+void
+DecoupledFetchStage::propagate()
+{
+}
+
+void
+DecoupledFetchStage::clockPulse()
+{
+  if (control.flushFetch) {
+    /* Everything in the front-end is on the wrong path, including an end
+     * marker that may have been reached.
+     */
+    ftq.clear();
+    iq.clear();
+    fetchStopped = false;
+    endMarkerSeen = false;
+    ++fetchSeq; /* the instruction being fetched is squashed */
+
+    if_id = {};
+    ++cycle;
+    return;
+  }
+
+  predict();
+  fetch();
+
+  if (endMarkerSeen) {
+    if (endMarkerCountdown > 0)
+      --endMarkerCountdown;
+    else
+      throw TestEndMarkerEncountered(endMarkerPC);
+  } else if (!control.stallFetch) {
+    if (iq.empty() || iq.front().readyCycle > cycle) {
+      if_id = {};
+      ++nQueueEmpty;
+    } else {
+      QueueEntry entry = iq.front();
+      iq.pop_front();
+
+      /* Fetches may run ahead on the wrong path, so errors are only
+       * raised once decode issues the instruction.
+       */
+      if (entry.endMarker) {
+        endMarkerSeen = true;
+        endMarkerCountdown = drainCycles;
+        endMarkerPC = entry.PC;
+        if_id = {};
+      } else {
+        if_id.seq = entry.seq;
+        if_id.PC = entry.PC;
+        if_id.predictedPC = entry.predictedPC;
+        if_id.instructionWord = entry.instructionWord;
+        if_id.fetchFailed = entry.fetchFailed;
+      }
+    }
+  }
+
+  ++cycle;
+}
+
+void
+DecoupledFetchStage::predict()
+{
+  if (fetchStopped || ftq.size() >= config.ftqSize)
+    return;
+
+  const MemAddress next = predictor.predict(PC);
+  ftq.push_back({PC, next});
+  PC = next;
+}
+
+void
+DecoupledFetchStage::fetch()
+{
+  if (ftq.empty())
+    return;
+
+  if (iq.size() >= config.iqSize) {
+    ++nQueueFull;
+    return;
+  }
+
+  const FetchTarget target = ftq.front();
+  ftq.pop_front();
+
+  QueueEntry entry{};
+  entry.seq = fetchSeq++;
+  entry.PC = target.PC;
+  entry.predictedPC = target.predictedPC;
+  entry.instructionWord = NopInstruction;
+  entry.readyCycle = cycle + config.fetchLatency - 1;
+
+  try {
+    entry.instructionWord = readInstruction(instructionMemory, target.PC);
+    countFetch(entry.instructionWord);
+  } catch (std::exception&) {
+    entry.fetchFailed = true;
+  }
+
+  /* The predictor does not know the instruction lengths, a compressed
+   * instruction that was predicted to fall through is only discovered
+   * here. The predictor is restarted at the actual fall through address.
+   */
+  if (!entry.fetchFailed && isCompressedInstruction(entry.instructionWord) &&
+      target.predictedPC == target.PC + 4) {
+    entry.predictedPC = target.PC + 2;
+    ftq.clear();
+    PC = entry.predictedPC;
+  }
+
+  /* Nothing is fetched beyond the end marker, unless it turns out to be
+   * on the wrong path.
+   */
+  if (!entry.fetchFailed && entry.instructionWord == TestEndMarker) {
+    entry.endMarker = true;
+    fetchStopped = true;
+    ftq.clear();
+  }
+
+  iq.push_back(entry);
+}
+
+void
+DecoupledFetchStage::getInFlight(std::vector<FrontendSlot>& slots) const
+{
+  for (const auto& entry : iq)
+    slots.push_back({entry.seq, entry.PC, entry.readyCycle <= cycle});
+
+  /* The instruction that will be fetched in this cycle. */
+  if (!fetchStopped && !endMarkerSeen && iq.size() < config.iqSize)
+    slots.push_back({fetchSeq, ftq.empty() ? PC : ftq.front().PC, false});
+}
+
+/* The queues have filled up while decode was stalled, only the clock
+ * advances.
+ */
+void
+DecoupledFetchStage::addIdleCycles(uint64_t idleCycles)
+{
+  if (!ftq.empty() && iq.size() >= config.iqSize)
+    nQueueFull += idleCycles;
+  cycle += idleCycles;
+}
+
+void
+DecoupledFetchStage::dumpStatistics(std::ostream& os) const
+{
+  os << "Instruction queue empty " << nQueueEmpty << " cycles, full "
+     << nQueueFull << " cycles." << std::endl;
+}
@@ -0,0 +1,115 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    frontend.h - Branch predictor and decoupled instruction fetch.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __FRONTEND_H__
+#define __FRONTEND_H__
+
+#include "machine-config.h"
+#include "stages.h"
+
+#include <deque>
+#include <vector>
+
+/* Direct-mapped branch target buffer combined with a table of bimodal
+ * 2-bit counters for the direction of conditional branches. Jumps that
+ * hit in the BTB are always predicted taken.
+ */
+class BranchPredictor {
+public:
+  BranchPredictor(unsigned btbEntries, unsigned counterEntries);
+
+  /* Predicted address of the instruction following the one at PC. */
+  MemAddress predict(MemAddress PC) const;
+
+  /* Train with the outcome of a branch or jump, as resolved in EX. */
+  void update(MemAddress PC, bool conditional, bool taken, MemAddress target);
+
+private:
+  struct BTBEntry {
+    bool valid;
+    bool conditional;
+    MemAddress PC;
+    MemAddress target;
+  };
+
+  std::vector<BTBEntry> btb;
+  std::vector<uint8_t> counters;
+
+  size_t btbIndex(MemAddress PC) const { return (PC >> 2) % btb.size(); }
+  size_t counterIndex(MemAddress PC) const
+  {
+    return (PC >> 2) % counters.size();
+  }
+};
+
+/* Instruction fetch decoupled from decode. The branch predictor runs
+ * ahead of fetch and fills the fetch target queue (FTQ) with the
+ * addresses to fetch, one per cycle. Fetch reads the instructions in
+ * FTQ order and places them in the instruction queue, where they become
+ * available to decode after the fetch latency. Fetch continues while
+ * decode stalls until the instruction queue is full. A misprediction,
+ * detected in EX, flushes all queues and restarts the predictor at the
+ * correct address.
+ */
+class DecoupledFetchStage : public FetchStage {
+public:
+  DecoupledFetchStage(IF_IDRegisters& if_id,
+                      InstructionMemory instructionMemory, MemAddress& PC,
+                      PipelineControl& control, BranchPredictor& predictor,
+                      const FrontendConfig& config, int drainCycles);
+
+  void propagate() override;
+  void clockPulse() override;
+
+  void getInFlight(std::vector<FrontendSlot>& slots) const override;
+  void dumpStatistics(std::ostream& os) const override;
+  void addIdleCycles(uint64_t idleCycles) override;
+
+private:
+  struct FetchTarget {
+    MemAddress PC;
+    MemAddress predictedPC;
+  };
+
+  struct QueueEntry {
+    uint64_t seq{};
+    MemAddress PC{};
+    MemAddress predictedPC{};
+    uint32_t instructionWord{};
+    uint64_t readyCycle{}; /* cycle from which decode may take it */
+    bool fetchFailed{};    /* raised when decode takes the entry */
+    bool endMarker{};
+  };
+
+  IF_IDRegisters& if_id;
+
+  InstructionMemory instructionMemory;
+  MemAddress& PC; /* address the predictor continues at */
+  PipelineControl& control;
+  BranchPredictor& predictor;
+  const FrontendConfig config;
+  int drainCycles;
+
+  std::deque<FetchTarget> ftq{};
+  std::deque<QueueEntry> iq{};
+
+  uint64_t cycle{};
+  uint64_t fetchSeq{1};
+  bool fetchStopped{}; /* end marker fetched, wait for redirect */
+  bool endMarkerSeen{};
+  int endMarkerCountdown{};
+  MemAddress endMarkerPC{};
+
+  /* Statistics */
+  uint64_t nQueueEmpty{};
+  uint64_t nQueueFull{};
+
+  void predict();
+  void fetch();
+};
+
+#endif /* __FRONTEND_H__ */
@@ -0,0 +1,131 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    idle-monitor.cc - Detection of a program that waits for a device.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "idle-monitor.h"
+
+#include <algorithm>
+
+static PipelineCounters
+subtract(const PipelineCounters& a, const PipelineCounters& b)
+{
+  PipelineCounters result{a.instrIssued - b.instrIssued,
+                          a.instrCompleted - b.instrCompleted,
+                          a.stalls - b.stalls,
+                          {}};
+  for (size_t i = 0; i < result.cycles.size(); ++i)
+    result.cycles[i] = a.cycles[i] - b.cycles[i];
+  return result;
+}
+
+IdleMonitor::IdleMonitor(const RegisterFile& regfile,
+                         const FloatRegisterFile& floatRegfile,
+                         const FloatStatus& fcsr, const MemoryBus& bus,
+                         const VectorUnit& vectorUnit,
+                         const Pipeline& pipeline, const uint64_t& nCycles,
+                         const MachineConfig& config)
+    : regfile{regfile}, floatRegfile{floatRegfile}, fcsr{fcsr}, bus{bus},
+      vectorUnit{vectorUnit}, pipeline{pipeline}, nCycles{nCycles}
+{
+  /* Every instruction in the instruction queue may wait for the slowest
+   * functional unit.
+   */
+  const FunctionalUnitConfig& units = config.units;
+  const uint64_t latency =
+      std::max({units.aluLatency, units.loadLatency, units.mulLatency,
+                units.divLatency, units.fpLatency, units.fdivLatency});
+  settleCycles = config.pipeline.fetchStages + config.pipeline.memoryStages +
+                 config.frontend.fetchLatency + 3 +
+                 (config.frontend.iqSize + 1) * latency;
+}
+
+void
+IdleMonitor::loopBack(MemAddress loopTarget)
+{
+  const uint64_t effects = countSideEffects();
+  const PipelineCounters now = pipeline.getCounters();
+
+  /* The registers are compared last, they are only captured once the
+   * loop ran an iteration without side effects.
+   */
+  const bool sameTarget = loopTarget == target && effects == sideEffects;
+  if (sameTarget && hasRegisters && hasSameRegisters()) {
+    const uint64_t period = nCycles - cycle;
+    const PipelineCounters delta = subtract(now, counters);
+
+    if (identicalIterations > 0 && period == iterationCycles &&
+        delta == iterationCounters)
+      ++identicalIterations;
+    else {
+      identicalIterations = 1;
+      iterationCycles = period;
+      iterationCounters = delta;
+    }
+  } else {
+    identicalIterations = 0;
+    hasRegisters = sameTarget;
+    if (hasRegisters) {
+      registers = regfile;
+      floatRegisters = floatRegfile;
+      floatStatus = fcsr;
+    }
+  }
+
+  target = loopTarget;
+  cycle = nCycles;
+  sideEffects = effects;
+  counters = now;
+}
+
+bool
+IdleMonitor::isWaitSettled() const
+{
+  const CSRFile& csrFile = pipeline.getCSRFile();
+  return csrFile.isWaiting() &&
+         nCycles - csrFile.getWaitStart() >= settleCycles;
+}
+
+/* The iterations must also agree on their length and counters, as the
+ * instructions from before the loop may still be in the pipeline and its
+ * timing state (such as the branch predictor) needs to settle. Iterations
+ * are skipped up to a full iteration before the event, the remaining
+ * iterations are simulated such that the event is observed in the same
+ * cycle.
+ */
+uint64_t
+IdleMonitor::getSkippableIterations(uint64_t event) const
+{
+  if (identicalIterations < 2 ||
+      identicalIterations * iterationCycles < settleCycles ||
+      event == MemoryInterface::NoEvent || event <= nCycles)
+    return 0;
+
+  const uint64_t iterations = (event - nCycles) / iterationCycles;
+  return iterations >= 2 ? iterations - 1 : 0;
+}
+
+void
+IdleMonitor::reset()
+{
+  identicalIterations = 0;
+  hasRegisters = false;
+  target = 0;
+}
+
+uint64_t
+IdleMonitor::countSideEffects() const
+{
+  return bus.getVolatileAccesses() + pipeline.getCSRFile().getWriteCount() +
+         vectorUnit.getElementOperations();
+}
+
+bool
+IdleMonitor::hasSameRegisters() const
+{
+  return regfile.hasSameContents(registers) &&
+         floatRegfile.hasSameContents(floatRegisters) &&
+         fcsr.flags == floatStatus.flags && fcsr.frm == floatStatus.frm;
+}
@@ -0,0 +1,97 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    idle-monitor.h - Detection of a program that waits for a device.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __IDLE_MONITOR_H__
+#define __IDLE_MONITOR_H__
+
+#include "memory-bus.h"
+#include "pipeline.h"
+#include "reg-file.h"
+
+/* A program is idle when it waits for an interrupt after wfi, or when it
+ * spins in a loop that cannot end before the next device event. The
+ * processor then advances the cycle count to that event, instead of
+ * simulating every cycle. A wait is skipped once the instructions before
+ * wfi have completed and the front-end has filled up.
+ *
+ * A loop is detected at its taken backward branch or jump. An iteration
+ * spins when it leaves the registers unchanged, does not write memory or
+ * CSRs, does not use the vector unit and only reads memory and device
+ * registers that are stable until the next event. Once the iterations
+ * took the same number of cycles and changed the pipeline's counters by
+ * the same amount for longer than an instruction can stay in the
+ * pipeline, every following iteration does the same, so skipped
+ * iterations are accounted exactly.
+ */
+class IdleMonitor {
+public:
+  IdleMonitor(const RegisterFile& regfile,
+              const FloatRegisterFile& floatRegfile, const FloatStatus& fcsr,
+              const MemoryBus& bus, const VectorUnit& vectorUnit,
+              const Pipeline& pipeline, const uint64_t& nCycles,
+              const MachineConfig& config);
+
+  IdleMonitor(const IdleMonitor&) = delete;
+  IdleMonitor& operator=(const IdleMonitor&) = delete;
+
+  /* Reported by EX for the instruction it completes. */
+  void loopBack(MemAddress target);
+
+  /* Whether the processor waits for an interrupt since long enough that
+   * nothing changes in the pipeline anymore, other than the idle cycles.
+   */
+  bool isWaitSettled() const;
+
+  /* The number of iterations of the current loop that can be skipped, such
+   * that the loop is still spinning when the event of cycle event occurs.
+   * 0 when the program is not in a spinning loop.
+   */
+  uint64_t getSkippableIterations(uint64_t event) const;
+
+  uint64_t getIterationCycles() const { return iterationCycles; }
+  const PipelineCounters& getIterationCounters() const
+  {
+    return iterationCounters;
+  }
+
+  /* Start over, after the processor skipped iterations. */
+  void reset();
+
+private:
+  const RegisterFile& regfile;
+  const FloatRegisterFile& floatRegfile;
+  const FloatStatus& fcsr;
+  const MemoryBus& bus;
+  const VectorUnit& vectorUnit;
+  const Pipeline& pipeline;
+  const uint64_t& nCycles;
+
+  /* Upper bound of the cycles from fetch until completion. */
+  uint64_t settleCycles{};
+
+  /* State at the previous loop back. The registers are only captured once
+   * an iteration without side effects was seen.
+   */
+  MemAddress target{};
+  uint64_t cycle{};
+  uint64_t sideEffects{};
+  PipelineCounters counters{};
+  bool hasRegisters{};
+  RegisterFile registers{};
+  FloatRegisterFile floatRegisters{};
+  FloatStatus floatStatus{};
+
+  /* Number of consecutive identical iterations, and their length. */
+  unsigned identicalIterations{};
+  uint64_t iterationCycles{};
+  PipelineCounters iterationCounters{};
+
+  uint64_t countSideEffects() const;
+  bool hasSameRegisters() const;
+};
+
+#endif /* __IDLE_MONITOR_H__ */
@@ -7,6 +7,7 @@
  */
 
 #include "inst-decoder.h"
+#include "instruction-table.h"
 
 #include <map>
 
@@ -24,12 +25,306 @@ signExtend(uint64_t value, unsigned bits)
   return static_cast<int64_t>((value ^ mask) - mask);
 }
 
+/* Encoders for the 32-bit instruction formats. Immediates are given as
+ * their value, the encoders scatter the bits.
+ */
+constexpr uint32_t
+encodeR(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3,
+        uint32_t rd, uint32_t opcode)
+{
+  return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 |
+         opcode;
+}
+
+constexpr uint32_t
+encodeI(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd,
+        uint32_t opcode)
+{
+  return (static_cast<uint32_t>(imm) & 0xFFF) << 20 | rs1 << 15 |
+         funct3 << 12 | rd << 7 | opcode;
+}
+
+constexpr uint32_t
+encodeS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3,
+        uint32_t opcode)
+{
+  const uint32_t u = static_cast<uint32_t>(imm);
+  return ((u >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 |
+         (u & 0x1F) << 7 | opcode;
+}
+
+constexpr uint32_t
+encodeB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3)
+{
+  const uint32_t u = static_cast<uint32_t>(imm);
+  return ((u >> 12) & 0x1) << 31 | ((u >> 5) & 0x3F) << 25 | rs2 << 20 |
+         rs1 << 15 | funct3 << 12 | ((u >> 1) & 0xF) << 8 |
+         ((u >> 11) & 0x1) << 7 | static_cast<uint32_t>(Opcode::BRANCH);
+}
+
+constexpr uint32_t
+encodeJ(int32_t imm, uint32_t rd)
+{
+  const uint32_t u = static_cast<uint32_t>(imm);
+  return ((u >> 20) & 0x1) << 31 | ((u >> 1) & 0x3FF) << 21 |
+         ((u >> 11) & 0x1) << 20 | ((u >> 12) & 0xFF) << 12 | rd << 7 |
+         static_cast<uint32_t>(Opcode::JAL);
+}
+
+constexpr uint32_t
+op(Opcode opcode)
+{
+  return static_cast<uint32_t>(opcode);
+}
+
+/* Bits [hi:lo] of a parcel, shifted to position pos. */
+constexpr uint32_t
+bits(uint16_t parcel, unsigned hi, unsigned lo, unsigned pos)
+{
+  return ((parcel >> lo) & ((1U << (hi - lo + 1)) - 1)) << pos;
+}
+
+constexpr int32_t
+signExtend32(uint32_t value, unsigned bits)
+{
+  const uint32_t mask = 1U << (bits - 1);
+  return static_cast<int32_t>((value ^ mask) - mask);
+}
+
+/* Register numbers x8-x15 in the 3-bit fields of CIW, CL, CS, CA, CB. */
+constexpr uint32_t
+regPrime(uint16_t parcel, unsigned lo)
+{
+  return 8 + ((parcel >> lo) & 0x7);
+}
+
+/* Immediates of the CI and CB-format ALU instructions: imm[5] in bit 12,
+ * imm[4:0] in bits [6:2].
+ */
+constexpr int32_t
+immCI(uint16_t parcel)
+{
+  return signExtend32(bits(parcel, 12, 12, 5) | bits(parcel, 6, 2, 0), 6);
+}
+
+/* Word and double-word offsets of the CL/CS-format loads and stores. */
+constexpr int32_t
+offsetW(uint16_t parcel)
+{
+  return bits(parcel, 12, 10, 3) | bits(parcel, 6, 6, 2) |
+         bits(parcel, 5, 5, 6);
+}
+
+constexpr int32_t
+offsetD(uint16_t parcel)
+{
+  return bits(parcel, 12, 10, 3) | bits(parcel, 6, 5, 6);
+}
+
+uint32_t
+expandQuadrant0(uint16_t parcel)
+{
+  const uint32_t rdPrime = regPrime(parcel, 2);
+  const uint32_t rs1Prime = regPrime(parcel, 7);
+
+  switch ((parcel >> 13) & 0x7) {
+  case 0x0: { /* C.ADDI4SPN */
+    const int32_t imm = bits(parcel, 12, 11, 4) | bits(parcel, 10, 7, 6) |
+                        bits(parcel, 6, 6, 2) | bits(parcel, 5, 5, 3);
+    if (imm == 0)
+      return 0;
+    return encodeI(imm, 2, 0x0, rdPrime, op(Opcode::OP_IMM));
+  }
+  case 0x1: /* C.FLD */
+    return encodeI(offsetD(parcel), rs1Prime, 0x3, rdPrime,
+                   op(Opcode::LOAD_FP));
+  case 0x2: /* C.LW */
+    return encodeI(offsetW(parcel), rs1Prime, 0x2, rdPrime, op(Opcode::LOAD));
+  case 0x3: /* C.LD */
+    return encodeI(offsetD(parcel), rs1Prime, 0x3, rdPrime, op(Opcode::LOAD));
+  case 0x5: /* C.FSD */
+    return encodeS(offsetD(parcel), rdPrime, rs1Prime, 0x3,
+                   op(Opcode::STORE_FP));
+  case 0x6: /* C.SW */
+    return encodeS(offsetW(parcel), rdPrime, rs1Prime, 0x2,
+                   op(Opcode::STORE));
+  case 0x7: /* C.SD */
+    return encodeS(offsetD(parcel), rdPrime, rs1Prime, 0x3,
+                   op(Opcode::STORE));
+  default:
+    return 0;
+  }
+}
+
+uint32_t
+expandQuadrant1(uint16_t parcel)
+{
+  const uint32_t rd = bits(parcel, 11, 7, 0);
+  const uint32_t rdPrime = regPrime(parcel, 7);
+  const uint32_t rs2Prime = regPrime(parcel, 2);
+
+  switch ((parcel >> 13) & 0x7) {
+  case 0x0: /* C.ADDI, C.NOP */
+    return encodeI(immCI(parcel), rd, 0x0, rd, op(Opcode::OP_IMM));
+
+  case 0x1: /* C.ADDIW */
+    if (rd == 0)
+      return 0;
+    return encodeI(immCI(parcel), rd, 0x0, rd, op(Opcode::OP_IMM_32));
+
+  case 0x2: /* C.LI */
+    return encodeI(immCI(parcel), 0, 0x0, rd, op(Opcode::OP_IMM));
+
+  case 0x3:
+    if (rd == 2) { /* C.ADDI16SP */
+      const int32_t imm = signExtend32(
+          bits(parcel, 12, 12, 9) | bits(parcel, 6, 6, 4) |
+              bits(parcel, 5, 5, 6) | bits(parcel, 4, 3, 7) |
+              bits(parcel, 2, 2, 5),
+          10);
+      if (imm == 0)
+        return 0;
+      return encodeI(imm, 2, 0x0, 2, op(Opcode::OP_IMM));
+    } else { /* C.LUI */
+      const int32_t imm = immCI(parcel);
+      if (imm == 0)
+        return 0;
+      return (static_cast<uint32_t>(imm) & 0xFFFFF) << 12 | rd << 7 |
+             op(Opcode::LUI);
+    }
+
+  case 0x4: {
+    const uint32_t shamt = bits(parcel, 12, 12, 5) | bits(parcel, 6, 2, 0);
+
+    switch ((parcel >> 10) & 0x3) {
+    case 0x0: /* C.SRLI */
+      return encodeI(shamt, rdPrime, 0x5, rdPrime, op(Opcode::OP_IMM));
+    case 0x1: /* C.SRAI */
+      return encodeI(0x400 | shamt, rdPrime, 0x5, rdPrime,
+                     op(Opcode::OP_IMM));
+    case 0x2: /* C.ANDI */
+      return encodeI(immCI(parcel), rdPrime, 0x7, rdPrime,
+                     op(Opcode::OP_IMM));
+    default:
+      break;
+    }
+
+    /* C.SUB, C.XOR, C.OR, C.AND and C.SUBW, C.ADDW */
+    const uint32_t funct2 = (parcel >> 5) & 0x3;
+    if (!(parcel & 0x1000)) {
+      static constexpr uint32_t funct3[] = {0x0, 0x4, 0x6, 0x7};
+      return encodeR(funct2 == 0x0 ? 0x20 : 0x00, rs2Prime, rdPrime,
+                     funct3[funct2], rdPrime, op(Opcode::OP));
+    }
+    if (funct2 <= 0x1)
+      return encodeR(funct2 == 0x0 ? 0x20 : 0x00, rs2Prime, rdPrime, 0x0,
+                     rdPrime, op(Opcode::OP_32));
+    return 0;
+  }
+
+  case 0x5: { /* C.J */
+    const int32_t offset = signExtend32(
+        bits(parcel, 12, 12, 11) | bits(parcel, 11, 11, 4) |
+            bits(parcel, 10, 9, 8) | bits(parcel, 8, 8, 10) |
+            bits(parcel, 7, 7, 6) | bits(parcel, 6, 6, 7) |
+            bits(parcel, 5, 3, 1) | bits(parcel, 2, 2, 5),
+        12);
+    return encodeJ(offset, 0);
+  }
+
+  default: { /* C.BEQZ, C.BNEZ */
+    const int32_t offset = signExtend32(
+        bits(parcel, 12, 12, 8) | bits(parcel, 11, 10, 3) |
+            bits(parcel, 6, 5, 6) | bits(parcel, 4, 3, 1) |
+            bits(parcel, 2, 2, 5),
+        9);
+    return encodeB(offset, 0, rdPrime, (parcel & 0x2000) ? 0x1 : 0x0);
+  }
+  }
+}
+
+uint32_t
+expandQuadrant2(uint16_t parcel)
+{
+  const uint32_t rd = bits(parcel, 11, 7, 0);
+  const uint32_t rs2 = bits(parcel, 6, 2, 0);
+
+  /* Stack pointer relative offsets */
+  const int32_t offsetLWSP =
+      bits(parcel, 12, 12, 5) | bits(parcel, 6, 4, 2) | bits(parcel, 3, 2, 6);
+  const int32_t offsetLDSP =
+      bits(parcel, 12, 12, 5) | bits(parcel, 6, 5, 3) | bits(parcel, 4, 2, 6);
+  const int32_t offsetSWSP = bits(parcel, 12, 9, 2) | bits(parcel, 8, 7, 6);
+  const int32_t offsetSDSP = bits(parcel, 12, 10, 3) | bits(parcel, 9, 7, 6);
+
+  switch ((parcel >> 13) & 0x7) {
+  case 0x0: { /* C.SLLI */
+    const uint32_t shamt = bits(parcel, 12, 12, 5) | bits(parcel, 6, 2, 0);
+    return encodeI(shamt, rd, 0x1, rd, op(Opcode::OP_IMM));
+  }
+  case 0x1: /* C.FLDSP */
+    return encodeI(offsetLDSP, 2, 0x3, rd, op(Opcode::LOAD_FP));
+  case 0x2: /* C.LWSP */
+    if (rd == 0)
+      return 0;
+    return encodeI(offsetLWSP, 2, 0x2, rd, op(Opcode::LOAD));
+  case 0x3: /* C.LDSP */
+    if (rd == 0)
+      return 0;
+    return encodeI(offsetLDSP, 2, 0x3, rd, op(Opcode::LOAD));
+
+  case 0x4:
+    if (!(parcel & 0x1000)) {
+      if (rs2 != 0) /* C.MV */
+        return encodeR(0x00, rs2, 0, 0x0, rd, op(Opcode::OP));
+      if (rd == 0)
+        return 0;
+      /* C.JR */
+      return encodeI(0, rd, 0x0, 0, op(Opcode::JALR));
+    }
+    if (rs2 != 0) /* C.ADD */
+      return encodeR(0x00, rs2, rd, 0x0, rd, op(Opcode::OP));
+    if (rd == 0) /* C.EBREAK */
+      return encodeI(1, 0, 0x0, 0, op(Opcode::SYSTEM));
+    /* C.JALR */
+    return encodeI(0, rd, 0x0, 1, op(Opcode::JALR));
+
+  case 0x5: /* C.FSDSP */
+    return encodeS(offsetSDSP, rs2, 2, 0x3, op(Opcode::STORE_FP));
+  case 0x6: /* C.SWSP */
+    return encodeS(offsetSWSP, rs2, 2, 0x2, op(Opcode::STORE));
+  default: /* C.SDSP */
+    return encodeS(offsetSDSP, rs2, 2, 0x3, op(Opcode::STORE));
+  }
+}
+
 } // namespace
 
+uint32_t
+expandCompressedInstruction(uint16_t parcel)
+{
+  switch (parcel & 0x3) {
+  case 0x0:
+    return expandQuadrant0(parcel);
+  case 0x1:
+    return expandQuadrant1(parcel);
+  case 0x2:
+    return expandQuadrant2(parcel);
+  default:
+    return 0; /* not a compressed instruction */
+  }
+}
+
 void
 InstructionDecoder::setInstructionWord(const uint32_t instructionWord)
 {
   this->instructionWord = instructionWord;
+
+  if (isCompressedInstruction(instructionWord))
+    expandedWord =
+        expandCompressedInstruction(static_cast<uint16_t>(instructionWord));
+  else
+    expandedWord = instructionWord;
 }
 
 uint32_t
@@ -41,79 +336,57 @@ InstructionDecoder::getInstructionWord() const
 Opcode
 InstructionDecoder::getOpcode() const
 {
-  uint8_t opcode = instructionWord & 0x7F;
+  uint8_t opcode = expandedWord & 0x7F;
   return static_cast<Opcode>(opcode);
 }
 
 RegNumber
 InstructionDecoder::getRS1() const
 {
-  return (instructionWord >> 15) & 0x1F;
+  return (expandedWord >> 15) & 0x1F;
 }
 
 RegNumber
 InstructionDecoder::getRS2() const
 {
-  return (instructionWord >> 20) & 0x1F;
+  return (expandedWord >> 20) & 0x1F;
+}
+
+RegNumber
+InstructionDecoder::getRS3() const
+{
+  return (expandedWord >> 27) & 0x1F;
 }
 
 RegNumber
 InstructionDecoder::getRD() const
 {
-  return (instructionWord >> 7) & 0x1F;
+  return (expandedWord >> 7) & 0x1F;
 }
 
 uint8_t
 InstructionDecoder::getFunct3() const
 {
-  return (instructionWord >> 12) & 0x07;
+  return (expandedWord >> 12) & 0x07;
 }
 
 uint8_t
 InstructionDecoder::getFunct7() const
 {
-  return (instructionWord >> 25) & 0x7F;
+  return (expandedWord >> 25) & 0x7F;
 }
 
 InstructionType
 InstructionDecoder::getInstructionType() const
 {
-  Opcode opcode = getOpcode();
-
-  switch (opcode) {
-  case Opcode::OP:
-  case Opcode::OP_32:
-    return InstructionType::R_TYPE;
-
-  case Opcode::OP_IMM:
-  case Opcode::OP_IMM_32:
-  case Opcode::LOAD:
-  case Opcode::JALR:
-    return InstructionType::I_TYPE;
-
-  case Opcode::STORE:
-    return InstructionType::S_TYPE;
-
-  case Opcode::BRANCH:
-    return InstructionType::B_TYPE;
-
-  case Opcode::LUI:
-  case Opcode::AUIPC:
-    return InstructionType::U_TYPE;
-
-  case Opcode::JAL:
-    return InstructionType::J_TYPE;
-
-  default:
-    throw IllegalInstruction("Unknown opcode");
-  }
+  return getOpcodeType(getOpcode());
 }
 
 int64_t
 InstructionDecoder::getImmediateI() const
 {
   /* I-type: imm[11:0] in bits [31:20] */
-  const uint64_t imm = (instructionWord >> 20) & 0xFFF;
+  const uint64_t imm = (expandedWord >> 20) & 0xFFF;
   return signExtend(imm, 12);
 }
 
@@ -122,7 +395,7 @@ InstructionDecoder::getImmediateS() const
 {
   /* S-type: imm[11:5] in bits [31:25], imm[4:0] in bits [11:7] */
   const uint64_t imm =
-      ((instructionWord >> 25) & 0x7F) << 5 | ((instructionWord >> 7) & 0x1F);
+      ((expandedWord >> 25) & 0x7F) << 5 | ((expandedWord >> 7) & 0x1F);
   return signExtend(imm, 12);
 }
 
@@ -130,10 +403,10 @@ int64_t
 InstructionDecoder::getImmediateB() const
 {
   /* B-type: imm[12|10:5|4:1|11|0] */
-  const uint64_t imm = ((instructionWord >> 31) & 0x1) << 12 |
-                       ((instructionWord >> 7) & 0x1) << 11 |
-                       ((instructionWord >> 25) & 0x3F) << 5 |
-                       ((instructionWord >> 8) & 0xF) << 1;
+  const uint64_t imm = ((expandedWord >> 31) & 0x1) << 12 |
+                       ((expandedWord >> 7) & 0x1) << 11 |
+                       ((expandedWord >> 25) & 0x3F) << 5 |
+                       ((expandedWord >> 8) & 0xF) << 1;
   return signExtend(imm, 13);
 }
 
@@ -141,17 +414,17 @@ int64_t
 InstructionDecoder::getImmediateU() const
 {
   /* U-type: imm[31:12] in bits [31:12], left-shifted by 12 */
-  return static_cast<int64_t>(instructionWord & 0xFFFFF000);
+  return static_cast<int64_t>(expandedWord & 0xFFFFF000);
 }
 
 int64_t
 InstructionDecoder::getImmediateJ() const
 {
   /* J-type: imm[20|10:1|11|19:12|0] */
-  const uint64_t imm = ((instructionWord >> 31) & 0x1) << 20 |
-                       ((instructionWord >> 21) & 0x3FF) << 1 |
-                       ((instructionWord >> 20) & 0x1) << 11 |
-                       ((instructionWord >> 12) & 0xFF) << 12;
+  const uint64_t imm = ((expandedWord >> 31) & 0x1) << 20 |
+                       ((expandedWord >> 21) & 0x3FF) << 1 |
+                       ((expandedWord >> 20) & 0x1) << 11 |
+                       ((expandedWord >> 12) & 0xFF) << 12;
   return signExtend(imm, 21);
 }
 
@@ -14,7 +14,15 @@
 #include <stdexcept>
 
 /* Instruction types based on encoding format */
-enum class InstructionType { R_TYPE, I_TYPE, S_TYPE, B_TYPE, U_TYPE, J_TYPE };
+enum class InstructionType {
+  R_TYPE,
+  R4_TYPE, /* fused multiply-add, with rs3 */
+  I_TYPE,
+  S_TYPE,
+  B_TYPE,
+  U_TYPE,
+  J_TYPE
+};
 
 /* Opcodes for RV64I */
 enum class Opcode : uint8_t {
@@ -29,7 +37,17 @@ enum class Opcode : uint8_t {
   JALR = 0x67,      /* I-type: jalr */
   JAL = 0x6F,       /* J-type: jal */
   LUI = 0x37,       /* U-type: lui */
-  AUIPC = 0x17      /* U-type: auipc */
+  AUIPC = 0x17,     /* U-type: auipc */
+  AMO = 0x2F,       /* R-type: lr, sc, amoswap, amoadd, ... (A extension) */
+  LOAD_FP = 0x07,   /* I-type: flw, fld */
+  STORE_FP = 0x27,  /* S-type: fsw, fsd */
+  OP_FP = 0x53,     /* R-type: fadd, fsub, fmul, fdiv, fsqrt, fcvt, ... */
+  MADD = 0x43,      /* R4-type: fmadd */
+  MSUB = 0x47,      /* R4-type: fmsub */
+  NMSUB = 0x4B,     /* R4-type: fnmsub */
+  NMADD = 0x4F,     /* R4-type: fnmadd */
+  OP_V = 0x57,      /* vsetvli, vadd, vmul, vredsum, ... (V extension) */
+  SYSTEM = 0x73     /* I-type: csrrw, csrrs, csrrc, csrrwi, ... (Zicsr) */
 };
 
 /* Exception that should be thrown when an illegal instruction
@@ -45,14 +63,34 @@ public:
   explicit IllegalInstruction(const char* what) : std::runtime_error(what) {}
 };
 
+/* Expand a 16-bit compressed instruction (RVC) to the equivalent 32-bit
+ * instruction. Reserved and illegal encodings expand to 0, which is not
+ * a valid instruction.
+ */
+uint32_t expandCompressedInstruction(uint16_t parcel);
+
+/* Instructions with the two lowest bits not both set are compressed. */
+inline bool
+isCompressedInstruction(uint32_t instructionWord)
+{
+  return (instructionWord & 0x3) != 0x3;
+}
+
 /* InstructionDecoder component to be used by class Processor */
 class InstructionDecoder {
 public:
+  /* A compressed instruction is expanded, all fields are then decoded
+   * from the 32-bit equivalent.
+   */
   void setInstructionWord(const uint32_t instructionWord);
   uint32_t getInstructionWord() const;
 
+  bool isCompressed() const { return isCompressedInstruction(instructionWord); }
+  uint8_t getLength() const { return isCompressed() ? 2 : 4; }
+
   RegNumber getRS1() const;
   RegNumber getRS2() const;
+  RegNumber getRS3() const;
   RegNumber getRD() const;
 
   Opcode getOpcode() const;
@@ -70,6 +108,7 @@ public:
 
 private:
   uint32_t instructionWord;
+  uint32_t expandedWord; /* 32-bit equivalent of instructionWord */
 };
 
 std::ostream& operator<<(std::ostream& os, const InstructionDecoder& decoder);
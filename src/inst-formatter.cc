@@ -5,9 +5,12 @@
  * Copyright (C) 2016,2018  Leiden University, The Netherlands.
  */
 
+#include "csr.h"
 #include "inst-decoder.h"
+#include "instruction-table.h"
 
 #include <iostream>
+#include <sstream>
 #include <string>
 
 namespace {
@@ -19,454 +22,243 @@ formatRegister(RegNumber reg)
 }
 
 std::string
-formatImmediate(int64_t value)
+formatFloatRegister(RegNumber reg)
 {
-  return "$" + std::to_string(value);
+  return "f" + std::to_string(static_cast<unsigned>(reg));
 }
 
-inline uint16_t
-low16(uint32_t word)
+std::string
+formatVectorRegister(RegNumber reg)
 {
-  return static_cast<uint16_t>(word & 0xFFFF);
+  return "v" + std::to_string(static_cast<unsigned>(reg));
 }
 
-inline int64_t
-signExtend(uint32_t value, unsigned bits)
+std::string
+formatImmediate(int64_t value)
 {
-  const uint32_t mask = 1U << (bits - 1);
-  return static_cast<int64_t>((value ^ mask) - mask);
+  return "$" + std::to_string(value);
 }
 
-void
-emitBinaryOp(std::ostream& os, const char* mnemonic, RegNumber rd,
-             RegNumber rs1, RegNumber rs2)
+/* Register operands are integer or floating-point registers according to
+ * the flags of the instruction.
+ */
+std::string
+formatOperand(const InstructionInfo& info, InstructionFlags isFloat,
+              RegNumber reg)
 {
-  os << mnemonic << " " << formatRegister(rd) << ", " << formatRegister(rs1)
-     << ", " << formatRegister(rs2);
+  return info.has(isFloat) ? formatFloatRegister(reg) : formatRegister(reg);
 }
 
-void
-emitUnaryOp(std::ostream& os, const char* mnemonic, RegNumber rd, RegNumber rs1,
-            int64_t imm)
+/* vtype in assembler syntax, for example "e32, m2, ta, mu". Reserved
+ * values are shown as a number.
+ */
+std::string
+formatVectorType(uint32_t vtype)
 {
-  os << mnemonic << " " << formatRegister(rd) << ", " << formatRegister(rs1)
-     << ", " << formatImmediate(imm);
+  static constexpr const char* lmuls[] = {"m1",    "m2",  "m4",  "m8",
+                                          nullptr, "mf8", "mf4", "mf2"};
+
+  const unsigned vsew = (vtype >> 3) & 0x7;
+  const char* lmul = lmuls[vtype & 0x7];
+  if ((vtype >> 8) != 0 || vsew > 3 || !lmul)
+    return formatImmediate(vtype);
+
+  return "e" + std::to_string(8 << vsew) + ", " + lmul +
+         ((vtype & 0x40) ? ", ta" : ", tu") +
+         ((vtype & 0x80) ? ", ma" : ", mu");
 }
 
-void
-emitLoad(std::ostream& os, const char* mnemonic, RegNumber rd, RegNumber rs1,
-         int64_t imm)
+/* The second source operand of vector arithmetic and moves. The
+ * immediate is a sign-extended 5-bit value.
+ */
+std::string
+formatVectorSource(const InstructionInfo& info, RegNumber rs1)
 {
-  os << mnemonic << " " << formatRegister(rd) << ", " << formatImmediate(imm)
-     << "(" << formatRegister(rs1) << ")";
+  if (info.has(InstUsesRS1))
+    return formatRegister(rs1);
+  if (info.has(InstALUSrc))
+    return formatImmediate((static_cast<int64_t>(rs1) ^ 0x10) - 0x10);
+  return formatVectorRegister(rs1);
 }
 
+/* The static rounding mode is shown as an additional operand. */
 void
-emitStore(std::ostream& os, const char* mnemonic, RegNumber rs2, RegNumber rs1,
-          int64_t imm)
+emitRoundingMode(std::ostream& os, uint8_t rm)
 {
-  os << mnemonic << " " << formatRegister(rs2) << ", " << formatImmediate(imm)
-     << "(" << formatRegister(rs1) << ")";
+  static constexpr const char* modes[] = {"rne", "rtz", "rdn", "rup", "rmm"};
+
+  if (rm == 0x7) /* dynamic */
+    return;
+  if (rm > 0x4)
+    throw IllegalInstruction("Invalid rounding mode");
+  os << ", " << modes[rm];
 }
 
+/* Zicsr; unsupported CSRs are shown by number. */
 void
-formatCompressedInstruction(std::ostream& os, uint16_t inst)
+formatCSR(std::ostream& os, const InstructionInfo& info,
+          const InstructionDecoder& decoder)
 {
-  const uint8_t quadrant = inst & 0x3;
-  const uint8_t funct3 = (inst >> 13) & 0x7;
-
-  switch (quadrant) {
-  case 0x0:            /* Quadrant 0 */
-    if (funct3 == 0x0) /* C.ADDI4SPN */
-    {
-      const uint8_t rdPrime = (inst >> 2) & 0x7;
-      const RegNumber rd = static_cast<RegNumber>(rdPrime + 8);
-      uint32_t imm = 0;
-      imm |= ((inst >> 11) & 0x3) << 4; /* nzuimm[5:4] */
-      imm |= ((inst >> 7) & 0xF) << 6;  /* nzuimm[9:6] */
-      imm |= ((inst >> 6) & 0x1) << 2;  /* nzuimm[2] */
-      imm |= ((inst >> 5) & 0x1) << 3;  /* nzuimm[3] */
-
-      os << "addi " << formatRegister(rd) << ", " << formatRegister(2) << ", "
-         << formatImmediate(static_cast<int64_t>(imm));
-    } else
-      throw IllegalInstruction("Unsupported compressed instruction");
-    break;
-
-  case 0x1:            /* Quadrant 1 */
-    if (funct3 == 0x1) /* C.ADDIW */
-    {
-      const RegNumber rd = static_cast<RegNumber>((inst >> 7) & 0x1F);
-      uint32_t imm = ((inst >> 12) & 0x1) << 5 | ((inst >> 2) & 0x1F);
-      os << "addiw " << formatRegister(rd) << ", " << formatRegister(rd) << ", "
-         << formatImmediate(signExtend(imm, 6));
-    } else
-      throw IllegalInstruction("Unsupported compressed instruction");
-    break;
-
-  case 0x2:            /* Quadrant 2 */
-    if (funct3 == 0x0) /* C.SLLI */
-    {
-      const RegNumber rd = static_cast<RegNumber>((inst >> 7) & 0x1F);
-      uint32_t shamt = ((inst >> 12) & 0x1) << 5 | ((inst >> 2) & 0x1F);
-      os << "slli " << formatRegister(rd) << ", " << formatRegister(rd) << ", "
-         << formatImmediate(static_cast<int64_t>(shamt));
-    } else
-      throw IllegalInstruction("Unsupported compressed instruction");
-    break;
-
-  default:
-    throw IllegalInstruction("Unsupported compressed instruction");
-  }
-
-  os << "  \t(compressed)";
+  const uint16_t csr = decoder.getImmediateI() & 0xFFF;
+  const char* name = getCSRName(csr);
+
+  os << info.mnemonic << " " << formatRegister(decoder.getRD()) << ", ";
+  if (name)
+    os << name;
+  else
+    os << "0x" << std::hex << csr << std::dec;
+  os << ", ";
+  if (info.format == InstructionFormat::CSRImmediate)
+    os << formatImmediate(decoder.getRS1());
+  else
+    os << formatRegister(decoder.getRS1());
 }
 
 void
-formatOpType(std::ostream& os, const InstructionDecoder& decoder)
+formatInstruction(std::ostream& os, const InstructionDecoder& decoder)
 {
-  const uint8_t funct3 = decoder.getFunct3();
-  const uint8_t funct7 = decoder.getFunct7();
-  const RegNumber rd = decoder.getRD();
-  const RegNumber rs1 = decoder.getRS1();
-  const RegNumber rs2 = decoder.getRS2();
-
-  switch (funct3) {
-  case 0x0:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "add", rd, rs1, rs2);
-    else if (funct7 == 0x20)
-      emitBinaryOp(os, "sub", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  const InstructionInfo* info = lookupInstruction(decoder);
+  if (!info)
+    throw IllegalInstruction("Unknown instruction");
+
+  const std::string rd = formatOperand(*info, InstFloatRD, decoder.getRD());
+  const std::string rs1 =
+      formatOperand(*info, InstFloatRS1, decoder.getRS1());
+  const std::string rs2 =
+      formatOperand(*info, InstFloatRS2, decoder.getRS2());
+  const char* mnemonic = info->mnemonic;
+
+  switch (info->format) {
+  case InstructionFormat::Binary:
+    os << mnemonic << " " << rd << ", " << rs1 << ", " << rs2;
     break;
 
-  case 0x1:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "sll", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::Unary:
+    os << mnemonic << " " << rd << ", " << rs1;
     break;
 
-  case 0x2:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "slt", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::Immediate:
+    os << mnemonic << " " << rd << ", " << rs1 << ", "
+       << formatImmediate(decoder.getImmediateI());
     break;
 
-  case 0x3:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "sltu", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  /* In RV64, bit 25 is part of the shift amount. */
+  case InstructionFormat::Shift:
+    os << mnemonic << " " << rd << ", " << rs1 << ", "
+       << formatImmediate(decoder.getImmediateI() & 0x3F);
     break;
 
-  case 0x4:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "xor", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::ShiftWord:
+    os << mnemonic << " " << rd << ", " << rs1 << ", "
+       << formatImmediate(decoder.getImmediateI() & 0x1F);
     break;
 
-  case 0x5:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "srl", rd, rs1, rs2);
-    else if (funct7 == 0x20)
-      emitBinaryOp(os, "sra", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::Load:
+    os << mnemonic << " " << rd << ", "
+       << formatImmediate(decoder.getImmediateI()) << "(" << rs1 << ")";
     break;
 
-  case 0x6:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "or", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::Store:
+    os << mnemonic << " " << rs2 << ", "
+       << formatImmediate(decoder.getImmediateS()) << "(" << rs1 << ")";
     break;
 
-  case 0x7:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "and", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown R-type instruction");
+  case InstructionFormat::Branch:
+    os << mnemonic << " " << rs1 << ", " << rs2 << ", "
+       << formatImmediate(decoder.getImmediateB());
     break;
 
-  default:
-    throw IllegalInstruction("Unknown R-type instruction");
-  }
-}
-
-void
-formatOp32Type(std::ostream& os, const InstructionDecoder& decoder)
-{
-  const uint8_t funct3 = decoder.getFunct3();
-  const uint8_t funct7 = decoder.getFunct7();
-  const RegNumber rd = decoder.getRD();
-  const RegNumber rs1 = decoder.getRS1();
-  const RegNumber rs2 = decoder.getRS2();
-
-  switch (funct3) {
-  case 0x0:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "addw", rd, rs1, rs2);
-    else if (funct7 == 0x20)
-      emitBinaryOp(os, "subw", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown RV64 R-type instruction");
-    break;
-
-  case 0x1:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "sllw", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown RV64 R-type instruction");
+  case InstructionFormat::Jump:
+    os << mnemonic << " " << rd << ", "
+       << formatImmediate(decoder.getImmediateJ());
     break;
 
-  case 0x5:
-    if (funct7 == 0x00)
-      emitBinaryOp(os, "srlw", rd, rs1, rs2);
-    else if (funct7 == 0x20)
-      emitBinaryOp(os, "sraw", rd, rs1, rs2);
-    else
-      throw IllegalInstruction("Unknown RV64 R-type instruction");
-    break;
-
-  default:
-    throw IllegalInstruction("Unknown RV64 R-type instruction");
-  }
-}
-
-void
-formatOpImm(std::ostream& os, const InstructionDecoder& decoder)
-{
-  const uint8_t funct3 = decoder.getFunct3();
-  const uint8_t funct7 = decoder.getFunct7();
-  const RegNumber rd = decoder.getRD();
-  const RegNumber rs1 = decoder.getRS1();
-  const int64_t imm = decoder.getImmediateI();
-
-  switch (funct3) {
-  case 0x0:
-    emitUnaryOp(os, "addi", rd, rs1, imm);
+  case InstructionFormat::Upper:
+    os << mnemonic << " " << rd << ", "
+       << formatImmediate(decoder.getImmediateU() >> 12);
     break;
 
-  case 0x2:
-    emitUnaryOp(os, "slti", rd, rs1, imm);
+  /* A extension; the acquire and release bits are shown as a suffix. */
+  case InstructionFormat::Atomic:
+  case InstructionFormat::LoadReserved: {
+    static constexpr const char* orderings[] = {"", ".rl", ".aq", ".aqrl"};
+
+    os << mnemonic << orderings[decoder.getFunct7() & 0x3] << " " << rd
+       << ", ";
+    if (info->format == InstructionFormat::Atomic)
+      os << rs2 << ", ";
+    os << "(" << rs1 << ")";
+  } break;
+
+  case InstructionFormat::FusedMultiplyAdd:
+    os << mnemonic << " " << rd << ", " << rs1 << ", " << rs2 << ", "
+       << formatFloatRegister(decoder.getRS3());
     break;
 
-  case 0x3:
-    emitUnaryOp(os, "sltiu", rd, rs1, imm);
+  case InstructionFormat::CSR:
+  case InstructionFormat::CSRImmediate:
+    formatCSR(os, *info, decoder);
     break;
 
-  case 0x4:
-    emitUnaryOp(os, "xori", rd, rs1, imm);
+  case InstructionFormat::System:
+    os << mnemonic;
     break;
 
-  case 0x6:
-    emitUnaryOp(os, "ori", rd, rs1, imm);
+  /* V extension; operands are listed as in the assembler syntax. */
+  case InstructionFormat::VectorArith:
+    os << mnemonic << " " << formatVectorRegister(decoder.getRD()) << ", "
+       << formatVectorRegister(decoder.getRS2()) << ", "
+       << formatVectorSource(*info, decoder.getRS1());
     break;
 
-  case 0x7:
-    emitUnaryOp(os, "andi", rd, rs1, imm);
+  case InstructionFormat::VectorMove:
+    os << mnemonic << " " << formatVectorRegister(decoder.getRD()) << ", "
+       << formatVectorSource(*info, decoder.getRS1());
     break;
 
-  case 0x1:
-    if (funct7 == 0x00)
-      emitUnaryOp(os, "slli", rd, rs1, imm & 0x3F);
-    else
-      throw IllegalInstruction("Unknown shift immediate");
+  case InstructionFormat::VectorToScalar:
+    os << mnemonic << " " << rd << ", "
+       << formatVectorRegister(decoder.getRS2());
     break;
 
-  case 0x5:
-    if (funct7 == 0x00)
-      emitUnaryOp(os, "srli", rd, rs1, imm & 0x3F);
-    else if (funct7 == 0x20)
-      emitUnaryOp(os, "srai", rd, rs1, imm & 0x3F);
-    else
-      throw IllegalInstruction("Unknown shift immediate");
+  case InstructionFormat::VectorConfig: {
+    const uint32_t vtype = (decoder.getInstructionWord() >> 20) &
+                           (info->has(InstALUSrc) ? 0x3FF : 0x7FF);
+    os << mnemonic << " " << rd << ", "
+       << (info->has(InstALUSrc) ? formatImmediate(decoder.getRS1()) : rs1)
+       << ", " << formatVectorType(vtype);
+  } break;
+
+  case InstructionFormat::VectorAccess:
+    os << mnemonic << " " << formatVectorRegister(decoder.getRD()) << ", ("
+       << rs1 << ")";
+    if (info->has(InstUsesRS2))
+      os << ", " << rs2;
     break;
-
-  default:
-    throw IllegalInstruction("Unknown immediate instruction");
   }
-}
 
-void
-formatOpImm32(std::ostream& os, const InstructionDecoder& decoder)
-{
-  const uint8_t funct3 = decoder.getFunct3();
-  const uint8_t funct7 = decoder.getFunct7();
-  const RegNumber rd = decoder.getRD();
-  const RegNumber rs1 = decoder.getRS1();
-  const int64_t imm = decoder.getImmediateI();
-
-  switch (funct3) {
-  case 0x0:
-    emitUnaryOp(os, "addiw", rd, rs1, imm);
-    break;
+  if (info->has(InstVectorMask) && !(decoder.getFunct7() & 0x1))
+    os << ", v0.t";
 
-  case 0x1:
-    if (funct7 == 0x00)
-      emitUnaryOp(os, "slliw", rd, rs1, imm & 0x1F);
-    else
-      throw IllegalInstruction("Unknown RV64 shift immediate");
-    break;
-
-  case 0x5:
-    if (funct7 == 0x00)
-      emitUnaryOp(os, "srliw", rd, rs1, imm & 0x1F);
-    else if (funct7 == 0x20)
-      emitUnaryOp(os, "sraiw", rd, rs1, imm & 0x1F);
-    else
-      throw IllegalInstruction("Unknown RV64 shift immediate");
-    break;
-
-  default:
-    throw IllegalInstruction("Unknown RV64 immediate instruction");
-  }
+  if (info->has(InstRounding))
+    emitRoundingMode(os, decoder.getFunct3());
 }
 
 } // namespace
 
+/* Compressed instructions are printed as their 32-bit equivalent. An
+ * instruction is only printed once it is known to be valid.
+ */
 std::ostream&
 operator<<(std::ostream& os, const InstructionDecoder& decoder)
 {
+  std::ostringstream out;
+
   try {
-    const uint32_t word = decoder.getInstructionWord();
-
-    if ((word & 0x3) != 0x3) {
-      formatCompressedInstruction(os, low16(word));
-      return os;
-    }
-
-    const Opcode opcode = decoder.getOpcode();
-    const uint8_t funct3 = decoder.getFunct3();
-    const RegNumber rd = decoder.getRD();
-    const RegNumber rs1 = decoder.getRS1();
-    const RegNumber rs2 = decoder.getRS2();
-
-    switch (opcode) {
-    case Opcode::OP:
-      formatOpType(os, decoder);
-      break;
-
-    case Opcode::OP_IMM:
-      formatOpImm(os, decoder);
-      break;
-
-    case Opcode::OP_32:
-      formatOp32Type(os, decoder);
-      break;
-
-    case Opcode::OP_IMM_32:
-      formatOpImm32(os, decoder);
-      break;
-
-    case Opcode::LOAD:
-      switch (funct3) {
-      case 0x0:
-        emitLoad(os, "lb", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x1:
-        emitLoad(os, "lh", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x2:
-        emitLoad(os, "lw", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x3:
-        emitLoad(os, "ld", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x4:
-        emitLoad(os, "lbu", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x5:
-        emitLoad(os, "lhu", rd, rs1, decoder.getImmediateI());
-        break;
-      case 0x6:
-        emitLoad(os, "lwu", rd, rs1, decoder.getImmediateI());
-        break;
-      default:
-        throw IllegalInstruction("Unknown load");
-      }
-      break;
-
-    case Opcode::STORE:
-      switch (funct3) {
-      case 0x0:
-        emitStore(os, "sb", rs2, rs1, decoder.getImmediateS());
-        break;
-      case 0x1:
-        emitStore(os, "sh", rs2, rs1, decoder.getImmediateS());
-        break;
-      case 0x2:
-        emitStore(os, "sw", rs2, rs1, decoder.getImmediateS());
-        break;
-      case 0x3:
-        emitStore(os, "sd", rs2, rs1, decoder.getImmediateS());
-        break;
-      default:
-        throw IllegalInstruction("Unknown store");
-      }
-      break;
-
-    case Opcode::BRANCH: {
-      const int64_t imm = decoder.getImmediateB();
-
-      switch (funct3) {
-      case 0x0:
-        os << "beq " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      case 0x1:
-        os << "bne " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      case 0x4:
-        os << "blt " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      case 0x5:
-        os << "bge " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      case 0x6:
-        os << "bltu " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      case 0x7:
-        os << "bgeu " << formatRegister(rs1) << ", " << formatRegister(rs2)
-           << ", " << formatImmediate(imm);
-        break;
-      default:
-        throw IllegalInstruction("Unknown branch");
-      }
-    } break;
-
-    case Opcode::JALR:
-      os << "jalr " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateI()) << "("
-         << formatRegister(rs1) << ")";
-      break;
-
-    case Opcode::JAL:
-      os << "jal " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateJ());
-      break;
-
-    case Opcode::LUI:
-      os << "lui " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateU() >> 12);
-      break;
-
-    case Opcode::AUIPC:
-      os << "auipc " << formatRegister(rd) << ", "
-         << formatImmediate(decoder.getImmediateU() >> 12);
-      break;
-
-    default:
-      throw IllegalInstruction("Unknown opcode");
-    }
+    formatInstruction(out, decoder);
+    if (decoder.isCompressed())
+      out << "  \t(compressed)";
+    os << out.str();
   } catch (const IllegalInstruction&) {
     os << "illegal instruction";
   }
@@ -0,0 +1,785 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    instruction-table.cc - Description of the supported instructions.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "instruction-table.h"
+
+#include <array>
+#include <iterator>
+
+namespace {
+
+constexpr uint8_t Funct3 = 0x7;
+constexpr uint8_t Funct7 = 0x7F;
+
+/* The operands of floating-point instructions. */
+constexpr uint32_t FloatBinary =
+    InstUsesRS1 | InstUsesRS2 | InstFloatRS1 | InstFloatRS2 | InstFloatRD;
+constexpr uint32_t FloatUnary = InstUsesRS1 | InstFloatRS1 | InstFloatRD;
+constexpr uint32_t FloatCompare =
+    InstUsesRS1 | InstUsesRS2 | InstFloatRS1 | InstFloatRS2;
+constexpr uint32_t FloatToInteger = InstUsesRS1 | InstFloatRS1;
+constexpr uint32_t IntegerToFloat = InstUsesRS1 | InstFloatRD;
+
+constexpr InstructionInfo
+describe(const char* mnemonic, Opcode opcode, InstructionType type,
+         uint8_t funct3, uint8_t funct3Mask, uint8_t funct7,
+         uint8_t funct7Mask, InstructionFormat format, uint32_t flags)
+{
+  return {mnemonic,       opcode,         type,
+          funct3,         funct3Mask,     funct7,
+          funct7Mask,     AnyRS2,         format,
+          flags,          FunctionalUnit::ALU, ALUOp::NOP,
+          FPUOp::NOP,     AtomicOp::None, CSROp::None,
+          SystemOp::None, VectorOp::None, 0};
+}
+
+/* Integer instructions with two register operands. */
+constexpr InstructionInfo
+regOp(const char* mnemonic, Opcode opcode, uint8_t funct3, uint8_t funct7,
+      ALUOp op, FunctionalUnit unit = FunctionalUnit::ALU)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::R_TYPE, funct3, Funct3, funct7,
+      Funct7, InstructionFormat::Binary,
+      InstRegWrite | InstUsesRS1 | InstUsesRS2);
+  info.aluOp = op;
+  info.unit = unit;
+  return info;
+}
+
+/* Integer instructions with a register and a 12-bit immediate. */
+constexpr InstructionInfo
+immOp(const char* mnemonic, Opcode opcode, uint8_t funct3, ALUOp op)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::I_TYPE, funct3, Funct3, 0, 0,
+      InstructionFormat::Immediate, InstRegWrite | InstALUSrc | InstUsesRS1);
+  info.aluOp = op;
+  return info;
+}
+
+/* Shifts by an immediate, which extends into funct7 unless the whole of
+ * funct7 selects the instruction.
+ */
+constexpr InstructionInfo
+shiftOp(const char* mnemonic, Opcode opcode, uint8_t funct3, uint8_t funct7,
+        uint8_t funct7Mask, InstructionFormat format, ALUOp op)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::I_TYPE, funct3, Funct3, funct7,
+      funct7Mask, format, InstRegWrite | InstALUSrc | InstUsesRS1);
+  info.aluOp = op;
+  return info;
+}
+
+/* Integer instructions with a single operand, selected by rs2. */
+constexpr InstructionInfo
+unaryOp(const char* mnemonic, Opcode opcode, uint8_t funct3, uint8_t funct7,
+        uint8_t rs2, ALUOp op)
+{
+  const bool immediate = opcode == Opcode::OP_IMM ||
+                         opcode == Opcode::OP_IMM_32;
+  InstructionInfo info = describe(
+      mnemonic, opcode,
+      immediate ? InstructionType::I_TYPE : InstructionType::R_TYPE, funct3,
+      Funct3, funct7, Funct7, InstructionFormat::Unary,
+      InstRegWrite | InstUsesRS1 | (immediate ? InstALUSrc : 0));
+  info.rs2 = rs2;
+  info.aluOp = op;
+  return info;
+}
+
+constexpr InstructionInfo
+load(const char* mnemonic, Opcode opcode, uint8_t funct3, uint8_t size,
+     uint32_t flags)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::I_TYPE, funct3, Funct3, 0, 0,
+      InstructionFormat::Load,
+      InstRegWrite | InstALUSrc | InstMemRead | InstMemToReg | InstUsesRS1 |
+          flags);
+  info.unit = FunctionalUnit::Load;
+  info.aluOp = ALUOp::ADD;
+  info.memSize = size;
+  return info;
+}
+
+constexpr InstructionInfo
+store(const char* mnemonic, Opcode opcode, uint8_t funct3, uint8_t size,
+      uint32_t flags)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::S_TYPE, funct3, Funct3, 0, 0,
+      InstructionFormat::Store,
+      InstALUSrc | InstMemWrite | InstUsesRS1 | InstUsesRS2 | flags);
+  info.aluOp = ALUOp::ADD;
+  info.memSize = size;
+  return info;
+}
+
+constexpr InstructionInfo
+branch(const char* mnemonic, uint8_t funct3)
+{
+  InstructionInfo info = describe(
+      mnemonic, Opcode::BRANCH, InstructionType::B_TYPE, funct3, Funct3, 0,
+      0, InstructionFormat::Branch, InstBranch | InstUsesRS1 | InstUsesRS2);
+  info.aluOp = ALUOp::SUB;
+  return info;
+}
+
+/* lui, auipc, jal and jalr all add their immediate to an operand. */
+constexpr InstructionInfo
+addImmediate(InstructionInfo info)
+{
+  info.aluOp = ALUOp::ADD;
+  return info;
+}
+
+/* A extension, funct5 in the high bits of funct7, followed by the aq and
+ * rl bits. The address is rs1, the immediate of an R-type instruction
+ * is 0.
+ */
+constexpr InstructionInfo
+atomic(const char* mnemonic, uint8_t funct3, uint8_t funct5, AtomicOp op)
+{
+  const bool isLoad = op == AtomicOp::LoadReserved;
+  InstructionInfo info = describe(
+      mnemonic, Opcode::AMO, InstructionType::R_TYPE, funct3, Funct3,
+      funct5 << 2, 0x7C,
+      isLoad ? InstructionFormat::LoadReserved : InstructionFormat::Atomic,
+      InstRegWrite | InstALUSrc | InstMemRead | InstMemToReg | InstUsesRS1 |
+          (isLoad ? 0 : InstMemWrite | InstUsesRS2) |
+          (funct3 == 0x2 ? InstSignExtend : 0));
+  if (isLoad)
+    info.rs2 = 0;
+  info.unit = FunctionalUnit::Load;
+  info.aluOp = ALUOp::ADD;
+  info.atomicOp = op;
+  info.memSize = funct3 == 0x2 ? 4 : 8;
+  return info;
+}
+
+/* F and D extensions under OP_FP: funct5 and the format in funct7. The
+ * operation is selected by funct3 when given with a mask, otherwise
+ * funct3 holds the rounding mode. Instructions without rs2 operand may
+ * be selected by rs2.
+ */
+constexpr InstructionInfo
+floatOp(const char* mnemonic, uint8_t funct5, uint8_t fmt, uint8_t funct3,
+        uint8_t funct3Mask, uint8_t rs2, FPUOp op, uint32_t operands)
+{
+  InstructionInfo info = describe(
+      mnemonic, Opcode::OP_FP, InstructionType::R_TYPE, funct3, funct3Mask,
+      funct5 << 2 | fmt, Funct7,
+      (operands & InstUsesRS2) ? InstructionFormat::Binary
+                               : InstructionFormat::Unary,
+      InstRegWrite | operands | (fmt == 0x1 ? InstDouble : 0));
+  info.rs2 = rs2;
+  info.unit = op == FPUOp::FDIV || op == FPUOp::FSQRT
+                  ? FunctionalUnit::FloatDivide
+                  : FunctionalUnit::FloatingPoint;
+  info.fpuOp = op;
+  return info;
+}
+
+/* Rounding operations. */
+constexpr InstructionInfo
+roundingOp(const char* mnemonic, uint8_t funct5, uint8_t fmt, uint8_t rs2,
+           FPUOp op, uint32_t operands)
+{
+  return floatOp(mnemonic, funct5, fmt, 0, 0, rs2, op,
+                 operands | InstRounding);
+}
+
+/* The format is in the low bits of funct7, rs3 in the high bits. */
+constexpr InstructionInfo
+fusedMultiplyAdd(const char* mnemonic, Opcode opcode, uint8_t fmt, FPUOp op)
+{
+  InstructionInfo info = describe(
+      mnemonic, opcode, InstructionType::R4_TYPE, 0, 0, fmt, 0x3,
+      InstructionFormat::FusedMultiplyAdd,
+      InstRegWrite | InstUsesRS3 | InstFloatRS1 | FloatBinary | InstRounding |
+          (fmt == 0x1 ? InstDouble : 0));
+  info.unit = FunctionalUnit::FloatingPoint;
+  info.fpuOp = op;
+  return info;
+}
+
+/* Zicsr, the immediate forms take the rs1 field as operand. */
+constexpr InstructionInfo
+csrOp(const char* mnemonic, uint8_t funct3, CSROp op)
+{
+  const bool immediate = funct3 & 0x4;
+  InstructionInfo info = describe(
+      mnemonic, Opcode::SYSTEM, InstructionType::I_TYPE, funct3, Funct3, 0,
+      0,
+      immediate ? InstructionFormat::CSRImmediate : InstructionFormat::CSR,
+      InstRegWrite | (immediate ? 0 : InstUsesRS1));
+  info.csrOp = op;
+  return info;
+}
+
+/* The other SYSTEM instructions are selected by funct7 and rs2. */
+constexpr InstructionInfo
+systemOp(const char* mnemonic, uint8_t funct7, uint8_t rs2, SystemOp op)
+{
+  InstructionInfo info =
+      describe(mnemonic, Opcode::SYSTEM, InstructionType::I_TYPE, 0x0,
+               Funct3, funct7, Funct7, InstructionFormat::System, 0);
+  info.rs2 = rs2;
+  info.systemOp = op;
+  return info;
+}
+
+/* V extension. The operand category of OP_V, in funct3, determines the
+ * second source operand: vs1 (OPIVV, OPMVV), rs1 (OPIVX, OPMVX) or a
+ * 5-bit immediate (OPIVI). funct6 selects the operation.
+ */
+constexpr uint8_t OPIVV = 0x0;
+constexpr uint8_t OPMVV = 0x2;
+constexpr uint8_t OPIVI = 0x3;
+constexpr uint8_t OPIVX = 0x4;
+constexpr uint8_t OPMVX = 0x6;
+constexpr uint8_t OPCFG = 0x7;
+
+constexpr uint32_t
+vectorSource(uint8_t funct3)
+{
+  if (funct3 == OPIVX || funct3 == OPMVX)
+    return InstUsesRS1;
+  return funct3 == OPIVI ? InstALUSrc : 0;
+}
+
+constexpr InstructionInfo
+vectorOp(const char* mnemonic, uint8_t funct3, uint8_t funct6, VectorOp op)
+{
+  InstructionInfo info =
+      describe(mnemonic, Opcode::OP_V, InstructionType::R_TYPE, funct3,
+               Funct3, funct6 << 1, 0x7E, InstructionFormat::VectorArith,
+               InstVectorMask | vectorSource(funct3));
+  info.vectorOp = op;
+  return info;
+}
+
+/* Moves are unmasked, vm is set, and are selected by the source register
+ * that they do not use.
+ */
+constexpr InstructionInfo
+vectorMove(const char* mnemonic, uint8_t funct3, uint8_t funct6, uint8_t rs,
+           InstructionFormat format, uint32_t flags, VectorOp op)
+{
+  InstructionInfo info = describe(
+      mnemonic, Opcode::OP_V, InstructionType::R_TYPE, funct3, Funct3,
+      funct6 << 1 | 0x1, Funct7, format, flags | vectorSource(funct3));
+  info.rs2 = rs;
+  info.vectorOp = op;
+  return info;
+}
+
+/* vsetvli and vsetivli are selected by the top bits, the rest of funct7
+ * is part of the vtype immediate.
+ */
+constexpr InstructionInfo
+vectorConfig(const char* mnemonic, uint8_t funct7, uint8_t funct7Mask,
+             InstructionFormat format, uint32_t flags, VectorOp op)
+{
+  InstructionInfo info =
+      describe(mnemonic, Opcode::OP_V, InstructionType::R_TYPE, OPCFG,
+               Funct3, funct7, funct7Mask, format, InstRegWrite | flags);
+  info.vectorOp = op;
+  return info;
+}
+
+/* Unit-stride and strided loads and stores of a single field: nf, mew
+ * and mop in funct7 are 0 except for the strided mop. Unit-stride
+ * accesses have lumop or sumop, in rs2, 0. They share their opcodes with
+ * the floating-point loads and stores.
+ */
+constexpr InstructionInfo
+vectorAccess(const char* mnemonic, Opcode opcode, uint8_t funct3,
+             uint8_t width, bool strided)
+{
+  const bool isStore = opcode == Opcode::STORE_FP;
+  InstructionInfo info = describe(
+      mnemonic, opcode,
+      isStore ? InstructionType::S_TYPE : InstructionType::I_TYPE, funct3,
+      Funct3, strided ? 0x04 : 0x00, 0x7E, InstructionFormat::VectorAccess,
+      InstUsesRS1 | InstVectorMask | (strided ? InstUsesRS2 : 0));
+  if (!strided)
+    info.rs2 = 0;
+  info.vectorOp = isStore ? VectorOp::Store : VectorOp::Load;
+  info.memSize = width;
+  return info;
+}
+
+/* Instructions that are selected by rs2 have to follow each other. */
+constexpr InstructionInfo instructions[] = {
+    /* RV64I */
+    addImmediate(describe("lui", Opcode::LUI, InstructionType::U_TYPE, 0, 0,
+                          0, 0, InstructionFormat::Upper,
+                          InstRegWrite | InstALUSrc)),
+    addImmediate(describe("auipc", Opcode::AUIPC, InstructionType::U_TYPE, 0,
+                          0, 0, 0, InstructionFormat::Upper,
+                          InstRegWrite | InstALUSrc)),
+    addImmediate(describe("jal", Opcode::JAL, InstructionType::J_TYPE, 0, 0,
+                          0, 0, InstructionFormat::Jump,
+                          InstRegWrite | InstALUSrc | InstJump)),
+    addImmediate(describe("jalr", Opcode::JALR, InstructionType::I_TYPE, 0x0,
+                          Funct3, 0, 0, InstructionFormat::Load,
+                          InstRegWrite | InstALUSrc | InstJump |
+                              InstUsesRS1)),
+
+    branch("beq", 0x0),
+    branch("bne", 0x1),
+    branch("blt", 0x4),
+    branch("bge", 0x5),
+    branch("bltu", 0x6),
+    branch("bgeu", 0x7),
+
+    load("lb", Opcode::LOAD, 0x0, 1, InstSignExtend),
+    load("lh", Opcode::LOAD, 0x1, 2, InstSignExtend),
+    load("lw", Opcode::LOAD, 0x2, 4, InstSignExtend),
+    load("ld", Opcode::LOAD, 0x3, 8, 0),
+    load("lbu", Opcode::LOAD, 0x4, 1, 0),
+    load("lhu", Opcode::LOAD, 0x5, 2, 0),
+    load("lwu", Opcode::LOAD, 0x6, 4, 0),
+
+    store("sb", Opcode::STORE, 0x0, 1, 0),
+    store("sh", Opcode::STORE, 0x1, 2, 0),
+    store("sw", Opcode::STORE, 0x2, 4, 0),
+    store("sd", Opcode::STORE, 0x3, 8, 0),
+
+    immOp("addi", Opcode::OP_IMM, 0x0, ALUOp::ADD),
+    immOp("slti", Opcode::OP_IMM, 0x2, ALUOp::SLT),
+    immOp("sltiu", Opcode::OP_IMM, 0x3, ALUOp::SLTU),
+    immOp("xori", Opcode::OP_IMM, 0x4, ALUOp::XOR),
+    immOp("ori", Opcode::OP_IMM, 0x6, ALUOp::OR),
+    immOp("andi", Opcode::OP_IMM, 0x7, ALUOp::AND),
+    /* In RV64, bit 25 is part of the shift amount. */
+    shiftOp("slli", Opcode::OP_IMM, 0x1, 0x00, 0x7E, InstructionFormat::Shift,
+            ALUOp::SLL),
+    shiftOp("srli", Opcode::OP_IMM, 0x5, 0x00, 0x7E, InstructionFormat::Shift,
+            ALUOp::SRL),
+    shiftOp("srai", Opcode::OP_IMM, 0x5, 0x20, 0x7E, InstructionFormat::Shift,
+            ALUOp::SRA),
+
+    regOp("add", Opcode::OP, 0x0, 0x00, ALUOp::ADD),
+    regOp("sub", Opcode::OP, 0x0, 0x20, ALUOp::SUB),
+    regOp("sll", Opcode::OP, 0x1, 0x00, ALUOp::SLL),
+    regOp("slt", Opcode::OP, 0x2, 0x00, ALUOp::SLT),
+    regOp("sltu", Opcode::OP, 0x3, 0x00, ALUOp::SLTU),
+    regOp("xor", Opcode::OP, 0x4, 0x00, ALUOp::XOR),
+    regOp("srl", Opcode::OP, 0x5, 0x00, ALUOp::SRL),
+    regOp("sra", Opcode::OP, 0x5, 0x20, ALUOp::SRA),
+    regOp("or", Opcode::OP, 0x6, 0x00, ALUOp::OR),
+    regOp("and", Opcode::OP, 0x7, 0x00, ALUOp::AND),
+
+    immOp("addiw", Opcode::OP_IMM_32, 0x0, ALUOp::ADDW),
+    shiftOp("slliw", Opcode::OP_IMM_32, 0x1, 0x00, Funct7,
+            InstructionFormat::ShiftWord, ALUOp::SLLW),
+    shiftOp("srliw", Opcode::OP_IMM_32, 0x5, 0x00, Funct7,
+            InstructionFormat::ShiftWord, ALUOp::SRLW),
+    shiftOp("sraiw", Opcode::OP_IMM_32, 0x5, 0x20, Funct7,
+            InstructionFormat::ShiftWord, ALUOp::SRAW),
+
+    regOp("addw", Opcode::OP_32, 0x0, 0x00, ALUOp::ADDW),
+    regOp("subw", Opcode::OP_32, 0x0, 0x20, ALUOp::SUBW),
+    regOp("sllw", Opcode::OP_32, 0x1, 0x00, ALUOp::SLLW),
+    regOp("srlw", Opcode::OP_32, 0x5, 0x00, ALUOp::SRLW),
+    regOp("sraw", Opcode::OP_32, 0x5, 0x20, ALUOp::SRAW),
+
+    /* M extension */
+    regOp("mul", Opcode::OP, 0x0, 0x01, ALUOp::MUL, FunctionalUnit::Multiply),
+    regOp("mulh", Opcode::OP, 0x1, 0x01, ALUOp::MULH,
+          FunctionalUnit::Multiply),
+    regOp("mulhsu", Opcode::OP, 0x2, 0x01, ALUOp::MULHSU,
+          FunctionalUnit::Multiply),
+    regOp("mulhu", Opcode::OP, 0x3, 0x01, ALUOp::MULHU,
+          FunctionalUnit::Multiply),
+    regOp("div", Opcode::OP, 0x4, 0x01, ALUOp::DIV, FunctionalUnit::Divide),
+    regOp("divu", Opcode::OP, 0x5, 0x01, ALUOp::DIVU, FunctionalUnit::Divide),
+    regOp("rem", Opcode::OP, 0x6, 0x01, ALUOp::REM, FunctionalUnit::Divide),
+    regOp("remu", Opcode::OP, 0x7, 0x01, ALUOp::REMU, FunctionalUnit::Divide),
+    regOp("mulw", Opcode::OP_32, 0x0, 0x01, ALUOp::MULW,
+          FunctionalUnit::Multiply),
+    regOp("divw", Opcode::OP_32, 0x4, 0x01, ALUOp::DIVW,
+          FunctionalUnit::Divide),
+    regOp("divuw", Opcode::OP_32, 0x5, 0x01, ALUOp::DIVUW,
+          FunctionalUnit::Divide),
+    regOp("remw", Opcode::OP_32, 0x6, 0x01, ALUOp::REMW,
+          FunctionalUnit::Divide),
+    regOp("remuw", Opcode::OP_32, 0x7, 0x01, ALUOp::REMUW,
+          FunctionalUnit::Divide),
+
+    /* A extension */
+    atomic("lr.w", 0x2, 0x02, AtomicOp::LoadReserved),
+    atomic("sc.w", 0x2, 0x03, AtomicOp::StoreConditional),
+    atomic("amoswap.w", 0x2, 0x01, AtomicOp::Swap),
+    atomic("amoadd.w", 0x2, 0x00, AtomicOp::Add),
+    atomic("amoxor.w", 0x2, 0x04, AtomicOp::Xor),
+    atomic("amoand.w", 0x2, 0x0C, AtomicOp::And),
+    atomic("amoor.w", 0x2, 0x08, AtomicOp::Or),
+    atomic("amomin.w", 0x2, 0x10, AtomicOp::Min),
+    atomic("amomax.w", 0x2, 0x14, AtomicOp::Max),
+    atomic("amominu.w", 0x2, 0x18, AtomicOp::MinU),
+    atomic("amomaxu.w", 0x2, 0x1C, AtomicOp::MaxU),
+    atomic("lr.d", 0x3, 0x02, AtomicOp::LoadReserved),
+    atomic("sc.d", 0x3, 0x03, AtomicOp::StoreConditional),
+    atomic("amoswap.d", 0x3, 0x01, AtomicOp::Swap),
+    atomic("amoadd.d", 0x3, 0x00, AtomicOp::Add),
+    atomic("amoxor.d", 0x3, 0x04, AtomicOp::Xor),
+    atomic("amoand.d", 0x3, 0x0C, AtomicOp::And),
+    atomic("amoor.d", 0x3, 0x08, AtomicOp::Or),
+    atomic("amomin.d", 0x3, 0x10, AtomicOp::Min),
+    atomic("amomax.d", 0x3, 0x14, AtomicOp::Max),
+    atomic("amominu.d", 0x3, 0x18, AtomicOp::MinU),
+    atomic("amomaxu.d", 0x3, 0x1C, AtomicOp::MaxU),
+
+    /* F and D extensions */
+    load("flw", Opcode::LOAD_FP, 0x2, 4, InstFloatRD),
+    load("fld", Opcode::LOAD_FP, 0x3, 8, InstFloatRD),
+    store("fsw", Opcode::STORE_FP, 0x2, 4, InstFloatRS2),
+    store("fsd", Opcode::STORE_FP, 0x3, 8, InstFloatRS2),
+
+    fusedMultiplyAdd("fmadd.s", Opcode::MADD, 0x0, FPUOp::FMADD),
+    fusedMultiplyAdd("fmsub.s", Opcode::MSUB, 0x0, FPUOp::FMSUB),
+    fusedMultiplyAdd("fnmsub.s", Opcode::NMSUB, 0x0, FPUOp::FNMSUB),
+    fusedMultiplyAdd("fnmadd.s", Opcode::NMADD, 0x0, FPUOp::FNMADD),
+    fusedMultiplyAdd("fmadd.d", Opcode::MADD, 0x1, FPUOp::FMADD),
+    fusedMultiplyAdd("fmsub.d", Opcode::MSUB, 0x1, FPUOp::FMSUB),
+    fusedMultiplyAdd("fnmsub.d", Opcode::NMSUB, 0x1, FPUOp::FNMSUB),
+    fusedMultiplyAdd("fnmadd.d", Opcode::NMADD, 0x1, FPUOp::FNMADD),
+
+    roundingOp("fadd.s", 0x00, 0x0, AnyRS2, FPUOp::FADD, FloatBinary),
+    roundingOp("fsub.s", 0x01, 0x0, AnyRS2, FPUOp::FSUB, FloatBinary),
+    roundingOp("fmul.s", 0x02, 0x0, AnyRS2, FPUOp::FMUL, FloatBinary),
+    roundingOp("fdiv.s", 0x03, 0x0, AnyRS2, FPUOp::FDIV, FloatBinary),
+    roundingOp("fsqrt.s", 0x0B, 0x0, 0, FPUOp::FSQRT, FloatUnary),
+    floatOp("fsgnj.s", 0x04, 0x0, 0x0, Funct3, AnyRS2, FPUOp::FSGNJ,
+            FloatBinary),
+    floatOp("fsgnjn.s", 0x04, 0x0, 0x1, Funct3, AnyRS2, FPUOp::FSGNJN,
+            FloatBinary),
+    floatOp("fsgnjx.s", 0x04, 0x0, 0x2, Funct3, AnyRS2, FPUOp::FSGNJX,
+            FloatBinary),
+    floatOp("fmin.s", 0x05, 0x0, 0x0, Funct3, AnyRS2, FPUOp::FMIN,
+            FloatBinary),
+    floatOp("fmax.s", 0x05, 0x0, 0x1, Funct3, AnyRS2, FPUOp::FMAX,
+            FloatBinary),
+    roundingOp("fcvt.s.d", 0x08, 0x0, 1, FPUOp::FCVT_F_F, FloatUnary),
+    floatOp("fle.s", 0x14, 0x0, 0x0, Funct3, AnyRS2, FPUOp::FLE,
+            FloatCompare),
+    floatOp("flt.s", 0x14, 0x0, 0x1, Funct3, AnyRS2, FPUOp::FLT,
+            FloatCompare),
+    floatOp("feq.s", 0x14, 0x0, 0x2, Funct3, AnyRS2, FPUOp::FEQ,
+            FloatCompare),
+    roundingOp("fcvt.w.s", 0x18, 0x0, 0, FPUOp::FCVT_W_F, FloatToInteger),
+    roundingOp("fcvt.wu.s", 0x18, 0x0, 1, FPUOp::FCVT_WU_F, FloatToInteger),
+    roundingOp("fcvt.l.s", 0x18, 0x0, 2, FPUOp::FCVT_L_F, FloatToInteger),
+    roundingOp("fcvt.lu.s", 0x18, 0x0, 3, FPUOp::FCVT_LU_F, FloatToInteger),
+    roundingOp("fcvt.s.w", 0x1A, 0x0, 0, FPUOp::FCVT_F_W, IntegerToFloat),
+    roundingOp("fcvt.s.wu", 0x1A, 0x0, 1, FPUOp::FCVT_F_WU, IntegerToFloat),
+    roundingOp("fcvt.s.l", 0x1A, 0x0, 2, FPUOp::FCVT_F_L, IntegerToFloat),
+    roundingOp("fcvt.s.lu", 0x1A, 0x0, 3, FPUOp::FCVT_F_LU, IntegerToFloat),
+    floatOp("fmv.x.w", 0x1C, 0x0, 0x0, Funct3, 0, FPUOp::FMV_X_F,
+            FloatToInteger),
+    floatOp("fclass.s", 0x1C, 0x0, 0x1, Funct3, 0, FPUOp::FCLASS,
+            FloatToInteger),
+    floatOp("fmv.w.x", 0x1E, 0x0, 0x0, Funct3, 0, FPUOp::FMV_F_X,
+            IntegerToFloat),
+
+    roundingOp("fadd.d", 0x00, 0x1, AnyRS2, FPUOp::FADD, FloatBinary),
+    roundingOp("fsub.d", 0x01, 0x1, AnyRS2, FPUOp::FSUB, FloatBinary),
+    roundingOp("fmul.d", 0x02, 0x1, AnyRS2, FPUOp::FMUL, FloatBinary),
+    roundingOp("fdiv.d", 0x03, 0x1, AnyRS2, FPUOp::FDIV, FloatBinary),
+    roundingOp("fsqrt.d", 0x0B, 0x1, 0, FPUOp::FSQRT, FloatUnary),
+    floatOp("fsgnj.d", 0x04, 0x1, 0x0, Funct3, AnyRS2, FPUOp::FSGNJ,
+            FloatBinary),
+    floatOp("fsgnjn.d", 0x04, 0x1, 0x1, Funct3, AnyRS2, FPUOp::FSGNJN,
+            FloatBinary),
+    floatOp("fsgnjx.d", 0x04, 0x1, 0x2, Funct3, AnyRS2, FPUOp::FSGNJX,
+            FloatBinary),
+    floatOp("fmin.d", 0x05, 0x1, 0x0, Funct3, AnyRS2, FPUOp::FMIN,
+            FloatBinary),
+    floatOp("fmax.d", 0x05, 0x1, 0x1, Funct3, AnyRS2, FPUOp::FMAX,
+            FloatBinary),
+    /* Conversions to double precision are exact, except from double
+     * words; the rounding mode is not shown.
+     */
+    floatOp("fcvt.d.s", 0x08, 0x1, 0, 0, 0, FPUOp::FCVT_F_F, FloatUnary),
+    floatOp("fle.d", 0x14, 0x1, 0x0, Funct3, AnyRS2, FPUOp::FLE,
+            FloatCompare),
+    floatOp("flt.d", 0x14, 0x1, 0x1, Funct3, AnyRS2, FPUOp::FLT,
+            FloatCompare),
+    floatOp("feq.d", 0x14, 0x1, 0x2, Funct3, AnyRS2, FPUOp::FEQ,
+            FloatCompare),
+    roundingOp("fcvt.w.d", 0x18, 0x1, 0, FPUOp::FCVT_W_F, FloatToInteger),
+    roundingOp("fcvt.wu.d", 0x18, 0x1, 1, FPUOp::FCVT_WU_F, FloatToInteger),
+    roundingOp("fcvt.l.d", 0x18, 0x1, 2, FPUOp::FCVT_L_F, FloatToInteger),
+    roundingOp("fcvt.lu.d", 0x18, 0x1, 3, FPUOp::FCVT_LU_F, FloatToInteger),
+    floatOp("fcvt.d.w", 0x1A, 0x1, 0, 0, 0, FPUOp::FCVT_F_W, IntegerToFloat),
+    floatOp("fcvt.d.wu", 0x1A, 0x1, 0, 0, 1, FPUOp::FCVT_F_WU,
+            IntegerToFloat),
+    roundingOp("fcvt.d.l", 0x1A, 0x1, 2, FPUOp::FCVT_F_L, IntegerToFloat),
+    roundingOp("fcvt.d.lu", 0x1A, 0x1, 3, FPUOp::FCVT_F_LU, IntegerToFloat),
+    floatOp("fmv.x.d", 0x1C, 0x1, 0x0, Funct3, 0, FPUOp::FMV_X_F,
+            FloatToInteger),
+    floatOp("fclass.d", 0x1C, 0x1, 0x1, Funct3, 0, FPUOp::FCLASS,
+            FloatToInteger),
+    floatOp("fmv.d.x", 0x1E, 0x1, 0x0, Funct3, 0, FPUOp::FMV_F_X,
+            IntegerToFloat),
+
+    /* Zba extension */
+    regOp("sh1add", Opcode::OP, 0x2, 0x10, ALUOp::SH1ADD),
+    regOp("sh2add", Opcode::OP, 0x4, 0x10, ALUOp::SH2ADD),
+    regOp("sh3add", Opcode::OP, 0x6, 0x10, ALUOp::SH3ADD),
+    regOp("add.uw", Opcode::OP_32, 0x0, 0x04, ALUOp::ADDUW),
+    regOp("sh1add.uw", Opcode::OP_32, 0x2, 0x10, ALUOp::SH1ADDUW),
+    regOp("sh2add.uw", Opcode::OP_32, 0x4, 0x10, ALUOp::SH2ADDUW),
+    regOp("sh3add.uw", Opcode::OP_32, 0x6, 0x10, ALUOp::SH3ADDUW),
+    shiftOp("slli.uw", Opcode::OP_IMM_32, 0x1, 0x04, 0x7E,
+            InstructionFormat::Shift, ALUOp::SLLIUW),
+
+    /* Zbb extension */
+    regOp("andn", Opcode::OP, 0x7, 0x20, ALUOp::ANDN),
+    regOp("orn", Opcode::OP, 0x6, 0x20, ALUOp::ORN),
+    regOp("xnor", Opcode::OP, 0x4, 0x20, ALUOp::XNOR),
+    regOp("min", Opcode::OP, 0x4, 0x05, ALUOp::MIN),
+    regOp("minu", Opcode::OP, 0x5, 0x05, ALUOp::MINU),
+    regOp("max", Opcode::OP, 0x6, 0x05, ALUOp::MAX),
+    regOp("maxu", Opcode::OP, 0x7, 0x05, ALUOp::MAXU),
+    regOp("rol", Opcode::OP, 0x1, 0x30, ALUOp::ROL),
+    regOp("ror", Opcode::OP, 0x5, 0x30, ALUOp::ROR),
+    regOp("rolw", Opcode::OP_32, 0x1, 0x30, ALUOp::ROLW),
+    regOp("rorw", Opcode::OP_32, 0x5, 0x30, ALUOp::RORW),
+    shiftOp("rori", Opcode::OP_IMM, 0x5, 0x30, 0x7E, InstructionFormat::Shift,
+            ALUOp::ROR),
+    shiftOp("roriw", Opcode::OP_IMM_32, 0x5, 0x30, Funct7,
+            InstructionFormat::ShiftWord, ALUOp::RORW),
+    unaryOp("zext.h", Opcode::OP_32, 0x4, 0x04, 0, ALUOp::ZEXTH),
+    unaryOp("clz", Opcode::OP_IMM, 0x1, 0x30, 0, ALUOp::CLZ),
+    unaryOp("ctz", Opcode::OP_IMM, 0x1, 0x30, 1, ALUOp::CTZ),
+    unaryOp("cpop", Opcode::OP_IMM, 0x1, 0x30, 2, ALUOp::CPOP),
+    unaryOp("sext.b", Opcode::OP_IMM, 0x1, 0x30, 4, ALUOp::SEXTB),
+    unaryOp("sext.h", Opcode::OP_IMM, 0x1, 0x30, 5, ALUOp::SEXTH),
+    unaryOp("clzw", Opcode::OP_IMM_32, 0x1, 0x30, 0, ALUOp::CLZW),
+    unaryOp("ctzw", Opcode::OP_IMM_32, 0x1, 0x30, 1, ALUOp::CTZW),
+    unaryOp("cpopw", Opcode::OP_IMM_32, 0x1, 0x30, 2, ALUOp::CPOPW),
+    unaryOp("orc.b", Opcode::OP_IMM, 0x5, 0x14, 7, ALUOp::ORCB),
+    unaryOp("rev8", Opcode::OP_IMM, 0x5, 0x35, 24, ALUOp::REV8),
+
+    /* Zbs extension */
+    regOp("bclr", Opcode::OP, 0x1, 0x24, ALUOp::BCLR),
+    regOp("bext", Opcode::OP, 0x5, 0x24, ALUOp::BEXT),
+    regOp("binv", Opcode::OP, 0x1, 0x34, ALUOp::BINV),
+    regOp("bset", Opcode::OP, 0x1, 0x14, ALUOp::BSET),
+    shiftOp("bclri", Opcode::OP_IMM, 0x1, 0x24, 0x7E,
+            InstructionFormat::Shift, ALUOp::BCLR),
+    shiftOp("bexti", Opcode::OP_IMM, 0x5, 0x24, 0x7E,
+            InstructionFormat::Shift, ALUOp::BEXT),
+    shiftOp("binvi", Opcode::OP_IMM, 0x1, 0x34, 0x7E,
+            InstructionFormat::Shift, ALUOp::BINV),
+    shiftOp("bseti", Opcode::OP_IMM, 0x1, 0x14, 0x7E,
+            InstructionFormat::Shift, ALUOp::BSET),
+
+    /* Zicsr extension */
+    csrOp("csrrw", 0x1, CSROp::ReadWrite),
+    csrOp("csrrs", 0x2, CSROp::ReadSet),
+    csrOp("csrrc", 0x3, CSROp::ReadClear),
+    csrOp("csrrwi", 0x5, CSROp::ReadWrite),
+    csrOp("csrrsi", 0x6, CSROp::ReadSet),
+    csrOp("csrrci", 0x7, CSROp::ReadClear),
+
+    /* Machine-mode traps */
+    systemOp("ecall", 0x00, 0, SystemOp::ECall),
+    systemOp("ebreak", 0x00, 1, SystemOp::EBreak),
+    systemOp("mret", 0x18, 2, SystemOp::MRet),
+    systemOp("wfi", 0x08, 5, SystemOp::WFI),
+
+    /* V extension */
+    vectorConfig("vsetvli", 0x00, 0x40, InstructionFormat::VectorConfig,
+                 InstUsesRS1, VectorOp::SetVL),
+    vectorConfig("vsetivli", 0x60, 0x60, InstructionFormat::VectorConfig,
+                 InstALUSrc, VectorOp::SetVL),
+    vectorConfig("vsetvl", 0x40, Funct7, InstructionFormat::Binary,
+                 InstUsesRS1 | InstUsesRS2, VectorOp::SetVLFromRegister),
+    vectorOp("vadd.vv", OPIVV, 0x00, VectorOp::Add),
+    vectorOp("vadd.vx", OPIVX, 0x00, VectorOp::Add),
+    vectorOp("vadd.vi", OPIVI, 0x00, VectorOp::Add),
+    vectorOp("vsub.vv", OPIVV, 0x02, VectorOp::Sub),
+    vectorOp("vsub.vx", OPIVX, 0x02, VectorOp::Sub),
+    vectorOp("vrsub.vx", OPIVX, 0x03, VectorOp::ReverseSub),
+    vectorOp("vrsub.vi", OPIVI, 0x03, VectorOp::ReverseSub),
+    vectorOp("vand.vv", OPIVV, 0x09, VectorOp::And),
+    vectorOp("vand.vx", OPIVX, 0x09, VectorOp::And),
+    vectorOp("vand.vi", OPIVI, 0x09, VectorOp::And),
+    vectorOp("vor.vv", OPIVV, 0x0A, VectorOp::Or),
+    vectorOp("vor.vx", OPIVX, 0x0A, VectorOp::Or),
+    vectorOp("vor.vi", OPIVI, 0x0A, VectorOp::Or),
+    vectorOp("vxor.vv", OPIVV, 0x0B, VectorOp::Xor),
+    vectorOp("vxor.vx", OPIVX, 0x0B, VectorOp::Xor),
+    vectorOp("vxor.vi", OPIVI, 0x0B, VectorOp::Xor),
+    vectorOp("vmul.vv", OPMVV, 0x25, VectorOp::Mul),
+    vectorOp("vmul.vx", OPMVX, 0x25, VectorOp::Mul),
+    vectorOp("vredsum.vs", OPMVV, 0x00, VectorOp::ReduceSum),
+    vectorOp("vredand.vs", OPMVV, 0x01, VectorOp::ReduceAnd),
+    vectorOp("vredor.vs", OPMVV, 0x02, VectorOp::ReduceOr),
+    vectorOp("vredxor.vs", OPMVV, 0x03, VectorOp::ReduceXor),
+    vectorMove("vmv.v.v", OPIVV, 0x17, 0, InstructionFormat::VectorMove, 0,
+               VectorOp::Move),
+    vectorMove("vmv.v.x", OPIVX, 0x17, 0, InstructionFormat::VectorMove, 0,
+               VectorOp::Move),
+    vectorMove("vmv.v.i", OPIVI, 0x17, 0, InstructionFormat::VectorMove, 0,
+               VectorOp::Move),
+    vectorMove("vmv.x.s", OPMVV, 0x10, 0, InstructionFormat::VectorToScalar,
+               InstRegWrite | InstSelectRS1, VectorOp::MoveToScalar),
+    vectorMove("vmv.s.x", OPMVX, 0x10, 0, InstructionFormat::VectorMove, 0,
+               VectorOp::MoveFromScalar),
+    vectorAccess("vle8.v", Opcode::LOAD_FP, 0x0, 1, false),
+    vectorAccess("vlse8.v", Opcode::LOAD_FP, 0x0, 1, true),
+    vectorAccess("vle16.v", Opcode::LOAD_FP, 0x5, 2, false),
+    vectorAccess("vlse16.v", Opcode::LOAD_FP, 0x5, 2, true),
+    vectorAccess("vle32.v", Opcode::LOAD_FP, 0x6, 4, false),
+    vectorAccess("vlse32.v", Opcode::LOAD_FP, 0x6, 4, true),
+    vectorAccess("vle64.v", Opcode::LOAD_FP, 0x7, 8, false),
+    vectorAccess("vlse64.v", Opcode::LOAD_FP, 0x7, 8, true),
+    vectorAccess("vse8.v", Opcode::STORE_FP, 0x0, 1, false),
+    vectorAccess("vsse8.v", Opcode::STORE_FP, 0x0, 1, true),
+    vectorAccess("vse16.v", Opcode::STORE_FP, 0x5, 2, false),
+    vectorAccess("vsse16.v", Opcode::STORE_FP, 0x5, 2, true),
+    vectorAccess("vse32.v", Opcode::STORE_FP, 0x6, 4, false),
+    vectorAccess("vsse32.v", Opcode::STORE_FP, 0x6, 4, true),
+    vectorAccess("vse64.v", Opcode::STORE_FP, 0x7, 8, false),
+    vectorAccess("vsse64.v", Opcode::STORE_FP, 0x7, 8, true)};
+
+constexpr size_t NumInstructions = std::size(instructions);
+
+/* The lookup holds the index of the first instruction with the opcode,
+ * funct3 and funct7 of the key, plus one; 0 if there is none. The low
+ * bits of the opcode are always set and not part of the key.
+ */
+using LookupTable = std::array<uint16_t, 1 << 15>;
+
+static_assert(NumInstructions < 0xFFFF, "instruction index overflow");
+
+constexpr size_t
+lookupKey(uint8_t opcode, uint8_t funct3, uint8_t funct7)
+{
+  return static_cast<size_t>(opcode >> 2) << 10 | funct3 << 7 | funct7;
+}
+
+constexpr bool
+matches(const InstructionInfo& info, uint8_t funct3, uint8_t funct7)
+{
+  return (funct3 & info.funct3Mask) == info.funct3 &&
+         (funct7 & info.funct7Mask) == info.funct7;
+}
+
+constexpr LookupTable
+makeLookupTable()
+{
+  LookupTable table{};
+
+  for (size_t i = 0; i < NumInstructions; ++i) {
+    const InstructionInfo& info = instructions[i];
+    const uint8_t opcode = static_cast<uint8_t>(info.opcode);
+
+    for (uint8_t funct3 = 0; funct3 <= Funct3; ++funct3)
+      for (uint8_t funct7 = 0; funct7 <= Funct7; ++funct7) {
+        uint16_t& entry = table[lookupKey(opcode, funct3, funct7)];
+        if (entry == 0 && matches(info, funct3, funct7))
+          entry = static_cast<uint16_t>(i + 1);
+      }
+  }
+
+  return table;
+}
+
+constexpr LookupTable lookupTable = makeLookupTable();
+
+/* The instruction type of every opcode plus one, 0 for unknown opcodes. */
+constexpr std::array<uint8_t, 128>
+makeOpcodeTypes()
+{
+  std::array<uint8_t, 128> types{};
+  for (const InstructionInfo& info : instructions)
+    types[static_cast<uint8_t>(info.opcode)] =
+        static_cast<uint8_t>(info.type) + 1;
+  return types;
+}
+
+constexpr std::array<uint8_t, 128> opcodeTypes = makeOpcodeTypes();
+
+/* Sanity checks of the table: the immediate format is a property of the
+ * opcode, and instructions with the same opcode, funct3 and funct7 are
+ * adjacent and told apart by rs2.
+ */
+constexpr bool
+overlaps(const InstructionInfo& a, const InstructionInfo& b)
+{
+  return a.opcode == b.opcode &&
+         ((a.funct3 ^ b.funct3) & a.funct3Mask & b.funct3Mask) == 0 &&
+         ((a.funct7 ^ b.funct7) & a.funct7Mask & b.funct7Mask) == 0;
+}
+
+constexpr bool
+isConsistent()
+{
+  for (size_t i = 0; i < NumInstructions; ++i) {
+    const InstructionInfo& info = instructions[i];
+    if (opcodeTypes[static_cast<uint8_t>(info.opcode)] !=
+        static_cast<uint8_t>(info.type) + 1)
+      return false;
+
+    for (size_t j = i + 1; j < NumInstructions; ++j) {
+      if (!overlaps(info, instructions[j]))
+        continue;
+      if (info.rs2 == AnyRS2 || !overlaps(info, instructions[j - 1]))
+        return false;
+    }
+  }
+  return true;
+}
+
+static_assert(isConsistent(), "inconsistent instruction table");
+
+} // namespace
+
+const InstructionInfo*
+lookupInstruction(const InstructionDecoder& decoder)
+{
+  const uint8_t opcode = static_cast<uint8_t>(decoder.getOpcode());
+  const uint8_t funct3 = decoder.getFunct3();
+  const uint8_t funct7 = decoder.getFunct7();
+
+  if ((opcode & 0x3) != 0x3)
+    return nullptr;
+
+  const size_t first = lookupTable[lookupKey(opcode, funct3, funct7)];
+  if (first == 0)
+    return nullptr;
+
+  for (size_t i = first - 1; i < NumInstructions; ++i) {
+    const InstructionInfo& info = instructions[i];
+    if (info.opcode != decoder.getOpcode() || !matches(info, funct3, funct7))
+      break;
+    const RegNumber rs = info.has(InstSelectRS1) ? decoder.getRS1()
+                                                 : decoder.getRS2();
+    if (info.rs2 == AnyRS2 || info.rs2 == rs)
+      return &info;
+  }
+
+  return nullptr;
+}
+
+InstructionType
+getOpcodeType(Opcode opcode)
+{
+  const uint8_t type = opcodeTypes[static_cast<uint8_t>(opcode) & 0x7F];
+  if (type == 0)
+    throw IllegalInstruction("Unknown opcode");
+  return static_cast<InstructionType>(type - 1);
+}
@@ -0,0 +1,111 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    instruction-table.h - Description of the supported instructions.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __INSTRUCTION_TABLE_H__
+#define __INSTRUCTION_TABLE_H__
+
+#include "alu.h"
+#include "csr.h"
+#include "fpu.h"
+#include "inst-decoder.h"
+#include "memory-bus.h"
+#include "scoreboard.h"
+#include "vector-unit.h"
+
+/* Operands of an instruction in the assembler syntax. Registers are
+ * integer or floating-point registers according to the flags of the
+ * instruction.
+ */
+enum class InstructionFormat : uint8_t {
+  Binary,           /* rd, rs1, rs2 */
+  Unary,            /* rd, rs1 */
+  Immediate,        /* rd, rs1, imm */
+  Shift,            /* rd, rs1, 6-bit shift amount */
+  ShiftWord,        /* rd, rs1, 5-bit shift amount */
+  Load,             /* rd, imm(rs1); also jalr */
+  Store,            /* rs2, imm(rs1) */
+  Branch,           /* rs1, rs2, imm */
+  Jump,             /* rd, imm */
+  Upper,            /* rd, imm[31:12] */
+  Atomic,           /* rd, rs2, (rs1) with the ordering as a suffix */
+  LoadReserved,     /* rd, (rs1) with the ordering as a suffix */
+  FusedMultiplyAdd, /* rd, rs1, rs2, rs3 */
+  CSR,              /* rd, csr, rs1 */
+  CSRImmediate,     /* rd, csr, uimm */
+  System,           /* no operands */
+  VectorArith,      /* vd, vs2, vs1 or rs1 or simm5 */
+  VectorMove,       /* vd, vs1 or rs1 or simm5 */
+  VectorToScalar,   /* rd, vs2 */
+  VectorConfig,     /* rd, rs1 or uimm, vtype */
+  VectorAccess      /* vd or vs3, (rs1) and rs2 if strided */
+};
+
+/* Control bits of an instruction. */
+enum InstructionFlags : uint32_t {
+  InstRegWrite = 1 << 0,
+  InstALUSrc = 1 << 1, /* second ALU operand is the immediate */
+  InstMemRead = 1 << 2,
+  InstMemWrite = 1 << 3,
+  InstMemToReg = 1 << 4,
+  InstBranch = 1 << 5,
+  InstJump = 1 << 6,
+  InstSignExtend = 1 << 7, /* of loaded values */
+  InstUsesRS1 = 1 << 8,
+  InstUsesRS2 = 1 << 9,
+  InstUsesRS3 = 1 << 10,
+  InstFloatRS1 = 1 << 11,
+  InstFloatRS2 = 1 << 12,
+  InstFloatRD = 1 << 13,
+  InstDouble = 1 << 14,     /* FPU operates on double precision */
+  InstRounding = 1 << 15,   /* funct3 is a rounding mode */
+  InstVectorMask = 1 << 16, /* vm is an operand, masked if clear */
+  InstSelectRS1 = 1 << 17   /* selected by rs1 instead of rs2 */
+};
+
+/* rs2 of an instruction that is not selected by its rs2 field. */
+static constexpr uint8_t AnyRS2 = 0xFF;
+
+/* An instruction is selected by its opcode, the bits of funct3 and
+ * funct7 that are set in the masks and, for some, by the rs2 (or rs1)
+ * field. The other bits are operands, such as the rounding mode in funct3,
+ * the shift amount or vm in funct7.
+ */
+struct InstructionInfo {
+  const char* mnemonic;
+  Opcode opcode;
+  InstructionType type;
+  uint8_t funct3;
+  uint8_t funct3Mask;
+  uint8_t funct7;
+  uint8_t funct7Mask;
+  uint8_t rs2;
+  InstructionFormat format;
+  uint32_t flags;
+  FunctionalUnit unit; /* latency class */
+  ALUOp aluOp;
+  FPUOp fpuOp;
+  AtomicOp atomicOp;
+  CSROp csrOp;
+  SystemOp systemOp;
+  VectorOp vectorOp;
+  uint8_t memSize; /* also the element width of vector loads and stores */
+
+  bool has(InstructionFlags flag) const { return flags & flag; }
+};
+
+/* The description of the decoded instruction, found with a single table
+ * lookup on its opcode, funct3 and funct7. Returns nullptr for encodings
+ * that are not supported.
+ */
+const InstructionInfo* lookupInstruction(const InstructionDecoder& decoder);
+
+/* The format of the immediate, which follows from the opcode. Throws
+ * IllegalInstruction for unknown opcodes.
+ */
+InstructionType getOpcodeType(Opcode opcode);
+
+#endif /* __INSTRUCTION_TABLE_H__ */
@@ -0,0 +1,197 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    machine-config.cc - Configurable parameters of the timing models.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "machine-config.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+MachineConfig::Setter
+bind(unsigned& field)
+{
+  return [&field](const std::string& value) {
+    field = static_cast<unsigned>(std::stoul(value, nullptr, 0));
+  };
+}
+
+MachineConfig::Setter
+bind(uint64_t& field)
+{
+  return [&field](const std::string& value) {
+    field = std::stoull(value, nullptr, 0);
+  };
+}
+
+MachineConfig::Setter
+bind(double& field)
+{
+  return [&field](const std::string& value) { field = std::stod(value); };
+}
+
+MachineConfig::Setter
+bind(bool& field)
+{
+  return [&field](const std::string& value) {
+    if (value == "true" || value == "yes")
+      field = true;
+    else if (value == "false" || value == "no")
+      field = false;
+    else
+      field = std::stoul(value, nullptr, 0) != 0;
+  };
+}
+
+MachineConfig::Setter
+bind(std::string& field)
+{
+  return [&field](const std::string& value) { field = value; };
+}
+
+} // namespace
+
+MachineConfig::Setter
+MachineConfig::findSetter(const std::string& section, const std::string& key)
+{
+  if (section == "pipeline") {
+    if (key == "fetchStages")
+      return bind(pipeline.fetchStages);
+    if (key == "memoryStages")
+      return bind(pipeline.memoryStages);
+    if (key == "clockFrequency")
+      return bind(pipeline.clockFrequency);
+    if (key == "fastForward")
+      return bind(pipeline.fastForward);
+  } else if (section == "units") {
+    if (key == "aluLatency")
+      return bind(units.aluLatency);
+    if (key == "loadLatency")
+      return bind(units.loadLatency);
+    if (key == "mulLatency")
+      return bind(units.mulLatency);
+    if (key == "mulPipelined")
+      return bind(units.mulPipelined);
+    if (key == "divLatency")
+      return bind(units.divLatency);
+    if (key == "divPipelined")
+      return bind(units.divPipelined);
+    if (key == "fpLatency")
+      return bind(units.fpLatency);
+    if (key == "fdivLatency")
+      return bind(units.fdivLatency);
+    if (key == "fdivPipelined")
+      return bind(units.fdivPipelined);
+  } else if (section == "frontend") {
+    if (key == "iqSize")
+      return bind(frontend.iqSize);
+    if (key == "ftqSize")
+      return bind(frontend.ftqSize);
+    if (key == "fetchLatency")
+      return bind(frontend.fetchLatency);
+    if (key == "btbEntries")
+      return bind(frontend.btbEntries);
+    if (key == "predictorEntries")
+      return bind(frontend.predictorEntries);
+  } else if (section == "ooo") {
+    if (key == "enable")
+      return bind(ooo.enable);
+    if (key == "fetchWidth")
+      return bind(ooo.fetchWidth);
+    if (key == "dispatchWidth")
+      return bind(ooo.dispatchWidth);
+    if (key == "issueWidth")
+      return bind(ooo.issueWidth);
+    if (key == "commitWidth")
+      return bind(ooo.commitWidth);
+    if (key == "fetchQueueSize")
+      return bind(ooo.fetchQueueSize);
+    if (key == "robSize")
+      return bind(ooo.robSize);
+    if (key == "issueQueueSize")
+      return bind(ooo.issueQueueSize);
+    if (key == "lsqSize")
+      return bind(ooo.lsqSize);
+    if (key == "physRegs")
+      return bind(ooo.physRegs);
+    if (key == "frontendLatency")
+      return bind(ooo.frontendLatency);
+    if (key == "mispredictPenalty")
+      return bind(ooo.mispredictPenalty);
+    if (key == "predictorEntries")
+      return bind(ooo.predictorEntries);
+  } else if (section == "vector") {
+    if (key == "vlen")
+      return bind(vector.vlen);
+  } else if (section == "serial") {
+    if (key == "output")
+      return bind(serial.output);
+    if (key == "input")
+      return bind(serial.input);
+    if (key == "flushInterval")
+      return bind(serial.flushInterval);
+  } else if (section == "clint") {
+    if (key == "enable")
+      return bind(clint.enable);
+    if (key == "base")
+      return bind(clint.base);
+    if (key == "cyclesPerTick")
+      return bind(clint.cyclesPerTick);
+  } else if (section == "block") {
+    if (key == "image")
+      return bind(block.image);
+    if (key == "readOnly")
+      return bind(block.readOnly);
+    if (key == "base")
+      return bind(block.base);
+    if (key == "latency")
+      return bind(block.latency);
+    if (key == "cyclesPerSector")
+      return bind(block.cyclesPerSector);
+  } else if (section == "dma") {
+    if (key == "enable")
+      return bind(dma.enable);
+    if (key == "base")
+      return bind(dma.base);
+    if (key == "latency")
+      return bind(dma.latency);
+    if (key == "bytesPerCycle")
+      return bind(dma.bytesPerCycle);
+  } else if (section == "framebuffer") {
+    if (key == "window")
+      return bind(framebuffer.window);
+    if (key == "capture")
+      return bind(framebuffer.capture);
+    if (key == "interval")
+      return bind(framebuffer.interval);
+  }
+
+  return nullptr;
+}
+
+void
+MachineConfig::load(std::string_view filename)
+{
+  ConfigFile file{filename};
+
+  for (const auto& section : file.getSections()) {
+    for (const auto& [key, value] : file.getProperties(section)) {
+      Setter setter = findSetter(section, key);
+      if (!setter)
+        throw std::runtime_error(std::string{filename} + ": unknown key '" +
+                                 key + "' in section '" + section + "'");
+
+      try {
+        setter(value);
+      } catch (std::logic_error&) {
+        throw std::runtime_error(std::string{filename} +
+                                 ": invalid value '" + value + "' for '" +
+                                 key + "'");
+      }
+    }
+  }
+}
@@ -0,0 +1,185 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    machine-config.h - Configurable parameters of the timing models.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __MACHINE_CONFIG_H__
+#define __MACHINE_CONFIG_H__
+
+#include "config-file.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/* Depth of the pipeline: IF and MEM can be split over multiple stages.
+ * The clock frequency (in MHz) is used to report the execution time, when
+ * it is set. With fastForward, the cycles in which the program waits for
+ * the next device event are skipped, see IdleMonitor.
+ */
+struct PipelineConfig {
+  unsigned fetchStages = 1;
+  unsigned memoryStages = 1;
+  double clockFrequency = 0;
+  bool fastForward = true;
+};
+
+/* Latencies of the functional units, in cycles from the start of
+ * execution until a dependent instruction can start execution. A unit
+ * that is not pipelined accepts a new instruction only once the previous
+ * one has finished. There is no cache model, so the load latency is the
+ * same for every access.
+ */
+struct FunctionalUnitConfig {
+  unsigned aluLatency = 1;
+  unsigned loadLatency = 2;
+  unsigned mulLatency = 3;
+  bool mulPipelined = true;
+  unsigned divLatency = 20;
+  bool divPipelined = false;
+  unsigned fpLatency = 4;
+  unsigned fdivLatency = 20; /* also square root */
+  bool fdivPipelined = false;
+};
+
+/* Parameters of the front-end of the pipeline. With an instruction queue
+ * size of 0, fetch and decode operate in lockstep and branches are
+ * predicted not taken. Otherwise fetch is decoupled from decode by an
+ * instruction queue and is steered by a branch predictor.
+ */
+struct FrontendConfig {
+  unsigned iqSize = 0;
+  unsigned ftqSize = 8;      /* fetch target queue */
+  unsigned fetchLatency = 1; /* cycles from fetch until decode */
+  unsigned btbEntries = 256;
+  unsigned predictorEntries = 1024;
+};
+
+/* Parameters of the out-of-order timing model. Widths are in instructions
+ * per cycle, sizes in entries and latencies in cycles.
+ */
+struct OoOConfig {
+  bool enable = false;
+
+  unsigned fetchWidth = 4;
+  unsigned dispatchWidth = 4;
+  unsigned issueWidth = 4;
+  unsigned commitWidth = 4;
+
+  unsigned fetchQueueSize = 16;
+  unsigned robSize = 64;
+  unsigned issueQueueSize = 32;
+  unsigned lsqSize = 32;
+  unsigned physRegs = 128;
+
+  unsigned frontendLatency = 2; /* fetch to dispatch */
+  unsigned mispredictPenalty = 3;
+  unsigned predictorEntries = 1024;
+};
+
+/* Parameters of the vector unit. Unlike the other parameters, the length
+ * of the vector registers (VLEN, in bits) is visible to programs: it
+ * determines the vector length that vsetvli returns.
+ */
+struct VectorConfig {
+  unsigned vlen = 128;
+};
+
+/* Parameters of the serial interface. The output of programs is written
+ * to std::cerr, or to the output file when it is set. Output that does not
+ * end with a newline is written after flushInterval bus cycles; 0 delays
+ * it until the buffer is full or the program halts. Programs receive the
+ * contents of the input file, if it is set ("-" is stdin).
+ */
+struct SerialConfig {
+  std::string output{};
+  std::string input{};
+  unsigned flushInterval = 100000;
+};
+
+/* The core-local interruptor (CLINT) provides the machine timer. mtime
+ * advances once every cyclesPerTick clock cycles. It is not available in
+ * Linux user mode.
+ */
+struct CLINTConfig {
+  bool enable = true;
+  uint64_t base = 0x2000000;
+  unsigned cyclesPerTick = 1;
+};
+
+/* The block device is backed by the host image file, it is only present
+ * when an image is configured. A command completes latency cycles plus
+ * cyclesPerSector cycles for every sector after it is issued.
+ */
+struct BlockDeviceConfig {
+  std::string image{};
+  bool readOnly = false;
+  uint64_t base = 0x3000000;
+  unsigned latency = 1000;
+  unsigned cyclesPerSector = 8;
+};
+
+/* The DMA engine completes a transfer latency cycles plus one cycle for
+ * every bytesPerCycle bytes after it is started. It is not available in
+ * Linux user mode.
+ */
+struct DMAConfig {
+  bool enable = true;
+  uint64_t base = 0x3001000;
+  unsigned latency = 100;
+  unsigned bytesPerCycle = 8;
+};
+
+/* The framebuffer opens a window when the emulator is built with SDL and
+ * window is set. Without a window, the frames can be captured to a file
+ * instead: every interval cycles, the framebuffer contents are written if
+ * they changed. The format follows from the file name: a .y4m video,
+ * a .rgba stream of raw pixels, or otherwise numbered PPM images whose
+ * names start with capture. "-" writes a Y4M video to stdout.
+ */
+struct FramebufferConfig {
+  bool window = true;
+  std::string capture{};
+  unsigned interval = 1000000;
+};
+
+/* The machine configuration collects the parameters that do not affect
+ * the architecture (the results computed by a program), but only the
+ * timing of the simulated machine and the host side of its devices; VLEN
+ * is the exception. Defaults are chosen such that the emulator behaves as
+ * the classic 5-stage pipeline.
+ */
+struct MachineConfig {
+  using Setter = std::function<void(const std::string&)>;
+
+  PipelineConfig pipeline{};
+  FunctionalUnitConfig units{};
+  FrontendConfig frontend{};
+  OoOConfig ooo{};
+  VectorConfig vector{};
+  SerialConfig serial{};
+  CLINTConfig clint{};
+  BlockDeviceConfig block{};
+  DMAConfig dma{};
+  FramebufferConfig framebuffer{};
+
+  /* Read a machine description file. Keys are set within a section,
+   * for example:
+   *
+   *     [ooo]
+   *     enable = 1
+   *     robSize = 128
+   *
+   * Keys that are not present keep their current value. Boolean keys
+   * take true, yes, false, no or a number.
+   */
+  void load(std::string_view filename);
+
+private:
+  Setter findSetter(const std::string& section, const std::string& key);
+};
+
+#endif /* __MACHINE_CONFIG_H__ */
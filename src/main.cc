@@ -7,6 +7,7 @@
 
 #include "testing.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <regex>
@@ -58,7 +59,10 @@ validateRegisters(const Processor& p,
  */
 static int
 launcher(const char* testFilename, const char* execFilename, bool pipelining,
-         bool debugMode, std::vector<RegisterInit> initializers)
+         bool debugMode, const MachineConfig& config,
+         const char* traceFilename, const TraceWindow& traceWindow,
+         std::vector<RegisterInit> initializers, bool userMode,
+         std::vector<std::string> programArgs)
 {
   try {
     std::string programFilename;
@@ -87,11 +91,19 @@ launcher(const char* testFilename, const char* execFilename, bool pipelining,
 
     /* Read the ELF file and start the emulator */
     ELFFile program(programFilename);
-    Processor p(program, pipelining, debugMode);
+    Processor p(program, pipelining, debugMode, config);
+
+    if (userMode) {
+      programArgs.insert(programArgs.begin(), programFilename);
+      p.enableSyscalls(program, programArgs);
+    }
 
     for (auto& initializer : initializers)
       p.initRegister(initializer.number, initializer.value);
 
+    if (traceFilename)
+      p.enableTrace(traceFilename, traceWindow);
+
     p.run(testFilename != nullptr);
 
     /* Dump registers and statistics when not running a unit test. */
@@ -102,6 +114,10 @@ launcher(const char* testFilename, const char* execFilename, bool pipelining,
 
     if (!validateRegisters(p, postRegisters))
       return ExitCodes::UnitTestFailed;
+
+    /* In user mode, the exit status is that of the program. */
+    if (p.hasExited())
+      return p.getExitStatus();
   } catch (std::runtime_error& e) {
     std::cerr << "Couldn't load program: " << e.what() << std::endl;
     return ExitCodes::InitializationError;
@@ -143,11 +159,17 @@ disasmELFFile(const ELFFile& program)
 
   InstructionDecoder decoder;
   size_t i = 0;
-  while (i < segmentSize) {
-    const RegValue* instr = reinterpret_cast<const RegValue*>(&segment[i]);
-    decoder.setInstructionWord(*instr);
+  while (i + 2 <= segmentSize) {
+    /* Instructions are stored in 16-bit parcels. */
+    uint16_t parcels[2]{};
+    std::memcpy(&parcels[0], &segment[i], 2);
+    if (!isCompressedInstruction(parcels[0]) && i + 4 <= segmentSize)
+      std::memcpy(&parcels[1], &segment[i + 2], 2);
+
+    decoder.setInstructionWord(static_cast<uint32_t>(parcels[1]) << 16 |
+                               parcels[0]);
     formatDisassembly(decoder, segmentBase + i);
-    i += 4;
+    i += decoder.getLength();
   }
 
   return ExitCodes::Success;
@@ -225,14 +247,66 @@ disasmSingle(const char* disasmArg)
   return ExitCodes::InitializationError;
 }
 
+/* Parse a cycle window in the form BEGIN:END, BEGIN: or :END. */
+static bool
+parseTraceWindow(const std::string& arg, TraceWindow& window)
+{
+  size_t colon = arg.find(':');
+  if (colon == std::string::npos)
+    return false;
+
+  try {
+    if (colon > 0)
+      window.begin = std::stoull(arg.substr(0, colon), nullptr, 0);
+    if (colon + 1 < arg.size())
+      window.end = std::stoull(arg.substr(colon + 1), nullptr, 0);
+  } catch (std::exception&) {
+    return false;
+  }
+
+  return window.begin < window.end;
+}
+
+/* Options without a short form are only available with getopt_long.
+ * Parsing stops at the first argument that is not an option (the leading
+ * '+' requests this from GNU getopt, which otherwise permutes argv), the
+ * caller decides whether the options that follow are its own.
+ */
+static int
+getOption(int argc, char** argv, const char* options)
+{
+#ifdef _MSC_VER
+  return getopt(argc, argv, options + 1);
+#else
+  static const struct option longOptions[] = {
+      {"serial-in", required_argument, nullptr, 'i'},
+      {"serial-out", required_argument, nullptr, 's'},
+      {"block", required_argument, nullptr, 'b'},
+      {"fb-capture", required_argument, nullptr, 'F'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+
+  return getopt_long(argc, argv, options, longOptions, nullptr);
+#endif
+}
+
 static void
 showHelp(const char* progName)
 {
   std::cerr << "Usage:" << std::endl;
-  std::cerr << progName << " [-d] [-p] [-r REGINIT] <programFilename>"
+  std::cerr << progName
+            << " [-d] [-p] [-o] [-c CONFIG] [-k TRACE [-w WINDOW]]"
+            << " [-i FILE] [-s FILE] [-b FILE] [-F FILE] [-r REGINIT]"
+            << " <programFilename>"
             << std::endl;
   std::cerr << "    or" << std::endl;
-  std::cerr << progName << " [-d] [-p] -t <testFilename>" << std::endl;
+  std::cerr << progName
+            << " [-d] [-p] [-o] [-c CONFIG] [-k TRACE [-w WINDOW]]"
+            << " -u <programFilename> [ARG]..." << std::endl;
+  std::cerr << "    or" << std::endl;
+  std::cerr << progName
+            << " [-d] [-p] [-o] [-c CONFIG] [-k TRACE [-w WINDOW]]"
+            << " -t <testFilename>" << std::endl;
   std::cerr << "    or" << std::endl;
   std::cerr << progName << " -x <instruction>" << std::endl;
   std::cerr << "    or" << std::endl;
@@ -243,10 +317,36 @@ showHelp(const char* progName)
         to the terminal.
     -p, enables pipelining. When omitted, the emulator runs in non-pipelined
         mode.
+    -o, enables the out-of-order core timing model instead of the 5-stage
+        pipeline.
+    -c, reads the machine description CONFIG, which configures the timing
+        models (e.g. the sizes of the out-of-order structures).
+    -k, writes a pipeline trace to the file TRACE ('-' is stdout), in the
+        Kanata format that can be viewed with Konata. Requires pipelined
+        mode.
+    -w, limits the trace to the instructions fetched in the cycle WINDOW,
+        given as BEGIN:END (either may be omitted).
     -r, specifies a register initializer REGINIT, in the form
         rX=Y with X a register number and Y the initializer value.
     -t, enables unit test mode, with testFilename a unit test
         configuration file.
+    -i, --serial-in, makes the contents of FILE available to the program
+        as input of the serial interface; '-' is stdin.
+    -s, --serial-out, writes the output of the serial interface to FILE
+        instead of stderr; '-' is stdout and /dev/fd/N a file descriptor.
+        The output is buffered and written on a newline.
+    -b, --block, attaches the block device with the image file FILE, which
+        is modified by the program's writes.
+    -F, --fb-capture, writes the framebuffer contents to FILE instead of
+        showing a window: a .y4m video ('-' is stdout), a .rgba stream of
+        raw pixels, or otherwise PPM images named FILENNNNNN.ppm. Frames
+        that changed are written every 1000000 cycles (see [framebuffer]
+        in the machine description). Only one of -F, -k and -s can write
+        to stdout, and -F not together with -d.
+    -u, runs a statically linked Linux program in user mode: ecall performs
+        a Linux system call and the program is started with the arguments
+        that follow programFilename. Options of the emulator must precede
+        programFilename in this mode.
     -x, disassembles (decodes) a single instruction specified as
         hexadecimal argument.
     -X, disassembles 'filename' which is either an ELF file (in which case
@@ -261,15 +361,32 @@ main(int argc, char** argv)
   char c;
   bool pipelining = false;
   bool debugMode = false;
+  bool userMode = false;
+  MachineConfig config;
   std::vector<RegisterInit> initializers;
   const char* testFilename = nullptr;
+  const char* traceFilename = nullptr;
+  TraceWindow traceWindow;
   const char* disasmArg = nullptr;
   bool disasmAsFile = false;
 
   /* Command line option processing */
   const char* progName = argv[0];
 
-  while ((c = getopt(argc, argv, "dpr:t:x:X:h")) != -1) {
+  /* Options may follow the program filename, except in user mode: there
+   * the arguments after the program filename are passed to the program.
+   */
+  std::vector<char*> operands;
+  while (true) {
+    c = getOption(argc, argv, "+dpouc:k:w:i:s:b:F:r:t:x:X:h");
+    if (c == -1) {
+      if (userMode || optind >= argc ||
+          std::strcmp(argv[optind - 1], "--") == 0)
+        break;
+      operands.push_back(argv[optind++]);
+      continue;
+    }
+
     switch (c) {
     case 'd':
       debugMode = true;
@@ -279,6 +396,55 @@ main(int argc, char** argv)
       pipelining = true;
       break;
 
+    case 'o':
+      config.ooo.enable = true;
+      break;
+
+    case 'u':
+      /* The heap of a program could overlap the CLINT and DMA engine. */
+      userMode = true;
+      config.clint.enable = false;
+      config.dma.enable = false;
+      break;
+
+    case 'c':
+      try {
+        config.load(optarg);
+      } catch (std::exception& e) {
+        std::cerr << "Error loading machine config: " << e.what()
+                  << std::endl;
+        return ExitCodes::InitializationError;
+      }
+      break;
+
+    case 'k':
+      traceFilename = optarg;
+      break;
+
+    case 'w':
+      if (!parseTraceWindow(optarg, traceWindow)) {
+        std::cerr << "Error: Malformed trace window " << optarg << std::endl;
+        return ExitCodes::InvalidArgument;
+      }
+      break;
+
+    case 'i':
+      config.serial.input = optarg;
+      break;
+
+    case 's':
+      config.serial.output = optarg;
+      break;
+
+    case 'b':
+      config.block.image = optarg;
+      break;
+
+    case 'F':
+      config.framebuffer.capture = optarg;
+      config.framebuffer.window = false;
+      break;
+
     case 'r':
       if (testFilename != nullptr) {
         std::cerr << "Error: Cannot set unit test and individual "
@@ -336,8 +502,7 @@ main(int argc, char** argv)
     }
   }
 
-  argc -= optind;
-  argv += optind;
+  operands.insert(operands.end(), argv + optind, argv + argc);
 
   if (disasmArg != nullptr) {
     if (disasmAsFile)
@@ -346,11 +511,40 @@ main(int argc, char** argv)
     return disasmSingle(disasmArg);
   }
 
-  if (!testFilename and argc < 1) {
+  /* The binary video cannot share stdout with text, nor can the pipeline
+   * trace and the serial output share it with each other.
+   */
+  const bool captureToStdout = config.framebuffer.capture == "-";
+  const int nStdoutOutputs =
+      captureToStdout +
+      (traceFilename && std::strcmp(traceFilename, "-") == 0) +
+      (config.serial.output == "-");
+  if (nStdoutOutputs > 1) {
+    std::cerr << "Error: Only one of the framebuffer capture, the pipeline "
+              << "trace and the serial output can be written to stdout."
+              << std::endl;
+    return ExitCodes::InvalidArgument;
+  }
+  if (captureToStdout && debugMode) {
+    std::cerr << "Error: Cannot write the framebuffer capture to stdout "
+              << "in debug mode." << std::endl;
+    return ExitCodes::InvalidArgument;
+  }
+
+  if (!testFilename and operands.empty()) {
     std::cerr << "Error: No executable specified." << std::endl << std::endl;
     showHelp(progName);
     return ExitCodes::InvalidArgument;
   }
 
-  return launcher(testFilename, argv[0], pipelining, debugMode, initializers);
+  /* The arguments of the program, without the program filename. */
+  std::vector<std::string> programArgs;
+  if (!operands.empty())
+    programArgs.assign(operands.begin() + (testFilename ? 0 : 1),
+                       operands.end());
+
+  const char* execFilename = operands.empty() ? nullptr : operands[0];
+  return launcher(testFilename, execFilename, pipelining, debugMode, config,
+                  traceFilename, traceWindow, initializers, userMode,
+                  programArgs);
 }
@@ -7,6 +7,8 @@
 
 #include "memory-bus.h"
 
+#include <algorithm>
+
 MemoryBus::MemoryBus(std::vector<std::unique_ptr<MemoryInterface>>&& clients)
     : clients{std::move(clients)}
 {
@@ -36,33 +38,34 @@ uint8_t
 MemoryBus::readByte(MemAddress addr)
 {
   bytesRead += 1;
-  return getClient(addr)->readByte(addr);
+  return getReadClient(addr)->readByte(addr);
 }
 
 uint16_t
 MemoryBus::readHalfWord(MemAddress addr)
 {
   bytesRead += 2;
-  return getClient(addr)->readHalfWord(addr);
+  return getReadClient(addr)->readHalfWord(addr);
 }
 
 uint32_t
 MemoryBus::readWord(MemAddress addr)
 {
   bytesRead += 4;
-  return getClient(addr)->readWord(addr);
+  return getReadClient(addr)->readWord(addr);
 }
 
 uint64_t
 MemoryBus::readDoubleWord(MemAddress addr)
 {
   bytesRead += 8;
-  return getClient(addr)->readDoubleWord(addr);
+  return getReadClient(addr)->readDoubleWord(addr);
 }
 
 void
 MemoryBus::writeByte(MemAddress addr, uint8_t value)
 {
+  checkReservation(addr, 1);
   bytesWritten += 1;
   return getClient(addr)->writeByte(addr, value);
 }
@@ -70,6 +73,7 @@ MemoryBus::writeByte(MemAddress addr, uint8_t value)
 void
 MemoryBus::writeHalfWord(MemAddress addr, uint16_t value)
 {
+  checkReservation(addr, 2);
   bytesWritten += 2;
   return getClient(addr)->writeHalfWord(addr, value);
 }
@@ -77,6 +81,7 @@ MemoryBus::writeHalfWord(MemAddress addr, uint16_t value)
 void
 MemoryBus::writeWord(MemAddress addr, uint32_t value)
 {
+  checkReservation(addr, 4);
   bytesWritten += 4;
   return getClient(addr)->writeWord(addr, value);
 }
@@ -84,6 +89,7 @@ MemoryBus::writeWord(MemAddress addr, uint32_t value)
 void
 MemoryBus::writeDoubleWord(MemAddress addr, uint64_t value)
 {
+  checkReservation(addr, 8);
   bytesWritten += 8;
   return getClient(addr)->writeDoubleWord(addr, value);
 }
@@ -102,9 +108,140 @@ MemoryBus::clockPulse()
     client->clockPulse();
 }
 
+uint64_t
+MemoryBus::getInterruptLines() const
+{
+  uint64_t lines = 0;
+  for (const auto& client : clients)
+    lines |= client->getInterruptLines();
+  return lines;
+}
+
+uint64_t
+MemoryBus::getNextEvent() const
+{
+  uint64_t event = NoEvent;
+  for (const auto& client : clients)
+    event = std::min(event, client->getNextEvent());
+  return event;
+}
+
+std::byte*
+MemoryBus::getHostPointer(MemAddress addr, size_t size, bool write)
+{
+  auto* client = findClient(addr);
+  if (!client)
+    return nullptr;
+
+  if (write)
+    checkReservation(addr, size);
+  return client->getHostPointer(addr, size, write);
+}
+
+uint64_t
+MemoryBus::atomic(AtomicOp op, MemAddress addr, uint8_t size,
+                  uint64_t operand)
+{
+  if (size != 4 && size != 8)
+    throw IllegalAccess("Invalid size " + std::to_string(size));
+  if (addr % size != 0)
+    throw IllegalAccess(addr, size);
+
+  auto* client = getClient(addr);
+  ++volatileReads;
+  const MemAddress granule = addr & ~static_cast<MemAddress>(7);
+
+  if (op == AtomicOp::StoreConditional) {
+    const bool success = reservationValid && reservation == granule;
+    reservationValid = false;
+    if (!success)
+      return 1;
+
+    bytesWritten += size;
+    if (size == 4)
+      client->writeWord(addr, static_cast<uint32_t>(operand));
+    else
+      client->writeDoubleWord(addr, operand);
+    return 0;
+  }
+
+  bytesRead += size;
+  const uint64_t old =
+      size == 4 ? client->readWord(addr) : client->readDoubleWord(addr);
+
+  if (op == AtomicOp::LoadReserved) {
+    reservationValid = true;
+    reservation = granule;
+    return old;
+  }
+
+  /* Words are compared as signed or unsigned 32-bit values. */
+  const int shift = size == 4 ? 32 : 0;
+  const int64_t signedOld = static_cast<int64_t>(old << shift) >> shift;
+  const int64_t signedOperand = static_cast<int64_t>(operand << shift) >> shift;
+  const uint64_t mask = size == 4 ? 0xFFFFFFFFULL : ~0ULL;
+  const uint64_t unsignedOperand = operand & mask;
+
+  uint64_t result{};
+  switch (op) {
+  case AtomicOp::Swap:
+    result = operand;
+    break;
+  case AtomicOp::Add:
+    result = old + operand;
+    break;
+  case AtomicOp::Xor:
+    result = old ^ operand;
+    break;
+  case AtomicOp::And:
+    result = old & operand;
+    break;
+  case AtomicOp::Or:
+    result = old | operand;
+    break;
+  case AtomicOp::Min:
+    result = signedOld < signedOperand ? old : operand;
+    break;
+  case AtomicOp::Max:
+    result = signedOld > signedOperand ? old : operand;
+    break;
+  case AtomicOp::MinU:
+    result = old < unsignedOperand ? old : operand;
+    break;
+  case AtomicOp::MaxU:
+    result = old > unsignedOperand ? old : operand;
+    break;
+  default:
+    throw IllegalAccess("Invalid atomic operation");
+  }
+
+  checkReservation(addr, size);
+  bytesWritten += size;
+  if (size == 4)
+    client->writeWord(addr, static_cast<uint32_t>(result));
+  else
+    client->writeDoubleWord(addr, result);
+
+  return old;
+}
+
 /*
  * Private methods
  */
+
+/* A write that overlaps the reserved double word invalidates the
+ * reservation.
+ */
+void
+MemoryBus::checkReservation(MemAddress addr, size_t size)
+{
+  if (!reservationValid)
+    return;
+
+  if (reservation < addr + size && addr < reservation + 8)
+    reservationValid = false;
+}
+
 MemoryInterface*
 MemoryBus::findClient(MemAddress addr) noexcept
 {
@@ -124,3 +261,13 @@ MemoryBus::getClient(MemAddress addr)
 
   return client;
 }
+
+MemoryInterface*
+MemoryBus::getReadClient(MemAddress addr)
+{
+  auto* client = getClient(addr);
+  if (!client->isReadStable(addr))
+    ++volatileReads;
+
+  return client;
+}
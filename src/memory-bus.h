@@ -13,6 +13,22 @@
 #include <memory>
 #include <vector>
 
+/* Atomic memory operations of the A extension. */
+enum class AtomicOp {
+  None,
+  LoadReserved,
+  StoreConditional,
+  Swap,
+  Add,
+  Xor,
+  And,
+  Or,
+  Min,
+  Max,
+  MinU,
+  MaxU
+};
+
 class MemoryBus : public MemoryInterface {
 public:
   MemoryBus(std::vector<std::unique_ptr<MemoryInterface>>&& clients);
@@ -38,14 +54,51 @@ public:
 
   void clockPulse() override;
 
+  /* The interrupt lines raised by any of the clients. */
+  uint64_t getInterruptLines() const override;
+
+  /* The earliest next event of the clients. */
+  uint64_t getNextEvent() const override;
+
+  /* The number of accesses that may have changed the state of memory or
+   * a device, or that read a value that may change by itself: writes,
+   * atomic memory operations and reads that are not stable.
+   */
+  uint64_t getVolatileAccesses() const { return bytesWritten + volatileReads; }
+
+  /* Direct accesses are not included in the bytes read and written. A
+   * write access invalidates a reservation of the range.
+   */
+  std::byte* getHostPointer(MemAddress addr, size_t size,
+                            bool write) override;
+
+  /* Perform an atomic memory operation on a naturally aligned word or
+   * double word, as a single bus transaction. Returns the original value
+   * in memory, or for a store conditional 0 on success and 1 on failure.
+   * A load reserved registers a reservation on the enclosing double word,
+   * which is lost when that double word is written.
+   */
+  uint64_t atomic(AtomicOp op, MemAddress addr, uint8_t size,
+                  uint64_t operand);
+
 private:
   std::vector<std::unique_ptr<MemoryInterface>> clients;
 
   MemoryInterface* findClient(MemAddress addr) noexcept;
   MemoryInterface* getClient(MemAddress addr);
+  MemoryInterface* getReadClient(MemAddress addr);
 
   uint64_t bytesRead = 0;    /* Bytes read from bus */
   uint64_t bytesWritten = 0; /* Bytes written to bus */
+  uint64_t volatileReads = 0;
+
+  /* Reservation set of the last load reserved, a single hart only has
+   * one.
+   */
+  bool reservationValid = false;
+  MemAddress reservation = 0;
+
+  void checkReservation(MemAddress addr, size_t size);
 };
 
 #endif /* __MEMORY_BUS_H__ */
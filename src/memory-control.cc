@@ -78,6 +78,12 @@ DataMemory::setWriteEnable(bool setting)
   writeEnable = setting;
 }
 
+void
+DataMemory::setAtomicOp(AtomicOp op)
+{
+  atomicOp = op;
+}
+
 RegValue
 DataMemory::getDataOut(bool signExtend) const
 {
@@ -125,9 +131,23 @@ DataMemory::getDataOut(bool signExtend) const
   return data;
 }
 
+RegValue
+DataMemory::getAtomicResult(bool signExtend) const
+{
+  if (signExtend && size == 4)
+    return static_cast<int64_t>(static_cast<int32_t>(atomicResult));
+
+  return atomicResult;
+}
+
 void
-DataMemory::clockPulse() const
+DataMemory::clockPulse()
 {
+  if (atomicOp != AtomicOp::None) {
+    atomicResult = bus.atomic(atomicOp, addr, size, dataIn);
+    return;
+  }
+
   if (!writeEnable)
     return;
 
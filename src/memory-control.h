@@ -34,10 +34,16 @@ public:
   void setDataIn(RegValue value);
   void setReadEnable(bool setting);
   void setWriteEnable(bool setting);
+  void setAtomicOp(AtomicOp op);
 
   RegValue getDataOut(bool signExtend) const;
 
-  void clockPulse() const;
+  /* Original memory value of the atomic operation performed during the
+   * last clock pulse.
+   */
+  RegValue getAtomicResult(bool signExtend) const;
+
+  void clockPulse();
 
 private:
   MemoryBus& bus;
@@ -47,6 +53,8 @@ private:
   RegValue dataIn{};
   bool readEnable{};
   bool writeEnable{};
+  AtomicOp atomicOp{AtomicOp::None};
+  RegValue atomicResult{};
 };
 
 #endif /* __MEMORY_CONTROL_H__ */
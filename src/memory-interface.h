@@ -15,6 +15,7 @@
 #include <stdexcept>
 #include <string>
 
+#include <cstddef>
 #include <cstdint>
 
 class MemoryInterface {
@@ -33,6 +34,32 @@ public:
 
   virtual void clockPulse() {}
 
+  /* Interrupt lines raised by the device, see InterruptLine. */
+  virtual uint64_t getInterruptLines() const { return 0; }
+
+  static constexpr uint64_t NoEvent = ~uint64_t{0};
+
+  /* The cycle of the next change of the device's state that is not caused
+   * by an access, such as a timer that expires; NoEvent if none has been
+   * scheduled.
+   */
+  virtual uint64_t getNextEvent() const { return NoEvent; }
+
+  /* Whether a read of addr has no side effects and returns the same value
+   * until the device is accessed or its next event. Device registers that
+   * the host may change at any time are not stable.
+   */
+  virtual bool isReadStable(MemAddress addr) const { return false; }
+
+  /* Host address of the size bytes at addr, for host system calls that
+   * access guest memory directly. Returns nullptr when the range is not
+   * backed by host memory of a single client or may not be accessed.
+   */
+  virtual std::byte* getHostPointer(MemAddress addr, size_t size, bool write)
+  {
+    return nullptr;
+  }
+
   virtual ~MemoryInterface() = default;
 };
 
@@ -116,13 +116,24 @@ Memory::contains(MemAddress addr) const
   return base <= addr && addr < base + size;
 }
 
+std::byte*
+Memory::getHostPointer(MemAddress addr, size_t size, bool write)
+{
+  if (!canAccess(addr, size, write))
+    return nullptr;
+
+  return data + (addr - base);
+}
+
 /*
  * Private methods
  */
 bool
 Memory::canAccess(MemAddress addr, size_t accessSize, bool write) const
 {
-  if (addr < base || addr + accessSize > base + this->size)
+  /* Sizes come from the program, addr + accessSize may overflow. */
+  if (addr < base || accessSize > this->size ||
+      addr - base > this->size - accessSize)
     return false;
 
   if (write && !mayWrite)
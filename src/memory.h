@@ -34,6 +34,10 @@ public:
   void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
   bool contains(MemAddress addr) const override;
+  bool isReadStable(MemAddress addr) const override { return true; }
+
+  std::byte* getHostPointer(MemAddress addr, size_t size,
+                            bool write) override;
 
   Memory(const Memory&) = delete;
   Memory& operator=(const Memory&) = delete;
@@ -0,0 +1,430 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    ooo-core.cc - Out-of-order core timing model
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "ooo-core.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+bool
+writesRegister(const ExecutedInstruction& inst)
+{
+  return inst.control.getRegWrite() && inst.rd != 0;
+}
+
+bool
+accessesOverlap(const ExecutedInstruction& a, const ExecutedInstruction& b)
+{
+  return a.memAddress < b.memAddress + b.control.getMemSize() &&
+         b.memAddress < a.memAddress + a.control.getMemSize();
+}
+
+} // namespace
+
+OutOfOrderCore::OutOfOrderCore(const MachineConfig& machineConfig,
+                               Pipeline& pipeline, const SysStatus& sysStatus)
+    : config{machineConfig.ooo}, units{machineConfig.units},
+      pipeline{pipeline}, sysStatus{sysStatus}
+{
+  if (config.fetchWidth == 0 || config.dispatchWidth == 0 ||
+      config.issueWidth == 0 || config.commitWidth == 0)
+    throw std::runtime_error("out-of-order widths must be at least 1");
+
+  if (config.fetchQueueSize == 0 || config.robSize == 0 ||
+      config.issueQueueSize == 0 || config.lsqSize == 0 ||
+      config.predictorEntries == 0)
+    throw std::runtime_error("out-of-order structures must have entries");
+
+  if (config.physRegs <= NumRegs)
+    throw std::runtime_error("out-of-order core needs more than " +
+                             std::to_string(NumRegs) + " physical registers");
+
+  freePhysRegs = config.physRegs - NumRegs;
+  counters.resize(config.predictorEntries, 1); /* weakly not taken */
+}
+
+void
+OutOfOrderCore::clockPulse()
+{
+  /* The structures are processed back to front, such that every step
+   * observes the state left behind by the previous clock cycle.
+   */
+  commit();
+  issue();
+  dispatch();
+  fetch();
+
+  sampleStatistics();
+  ++cycle;
+
+  if (endMarkerSeen && isDrained())
+    throw TestEndMarkerEncountered(endMarkerPC);
+}
+
+void
+OutOfOrderCore::commit()
+{
+  for (unsigned n = 0; n < config.commitWidth && !rob.empty(); ++n) {
+    Entry& entry = rob.front();
+    if (!entry.issued || entry.doneCycle > cycle)
+      break;
+
+    if (entry.cls == InstClass::Load || entry.cls == InstClass::Store)
+      --lsqOccupancy;
+
+    /* The physical register holding the previous value of rd is no
+     * longer referenced and can be released.
+     */
+    if (writesRegister(entry.inst)) {
+      ++freePhysRegs;
+      if (rat[entry.inst.rd] == entry.seq)
+        rat[entry.inst.rd] = 0;
+    }
+
+    rob.pop_front();
+    ++nCommitted;
+  }
+}
+
+void
+OutOfOrderCore::issue()
+{
+  unsigned n = 0;
+
+  /* Oldest-first selection among the ready instructions. */
+  for (auto it = issueQueue.begin();
+       it != issueQueue.end() && n < config.issueWidth;) {
+    Entry* entry = findInROB(*it);
+    const FunctionalUnit unit = entry->inst.control.getUnit();
+    uint64_t& busyUntil = unitBusyUntil[static_cast<size_t>(unit)];
+
+    if (!isReady(entry->producers[0]) || !isReady(entry->producers[1]) ||
+        !isReady(entry->producers[2]) ||
+        (entry->cls == InstClass::Load && !memoryDependencyResolved(*entry)) ||
+        busyUntil > cycle) {
+      ++it;
+      continue;
+    }
+
+    entry->issued = true;
+    entry->doneCycle = cycle + getLatency(unit);
+    if (!isPipelined(unit))
+      busyUntil = entry->doneCycle;
+
+    /* Fetch is redirected once the mispredicted branch has executed. */
+    if (entry->mispredicted) {
+      fetchResumeCycle = entry->doneCycle + config.mispredictPenalty;
+      blockingBranch = 0;
+    }
+
+    it = issueQueue.erase(it);
+    ++n;
+  }
+}
+
+void
+OutOfOrderCore::dispatch()
+{
+  StallCause cause = StallCause::None;
+  unsigned n = 0;
+
+  for (; n < config.dispatchWidth; ++n) {
+    if (fetchQueue.empty() || fetchQueue.front().readyCycle > cycle) {
+      if (blockingBranch != 0 || cycle < fetchResumeCycle)
+        cause = StallCause::Mispredict;
+      else if (!endMarkerSeen && !sysStatus.shouldHalt())
+        cause = StallCause::Frontend;
+      break;
+    }
+
+    Entry& entry = fetchQueue.front();
+    const bool isMemory =
+        entry.cls == InstClass::Load || entry.cls == InstClass::Store;
+    const bool writes = writesRegister(entry.inst);
+
+    if (rob.size() >= config.robSize)
+      cause = StallCause::ROBFull;
+    else if (issueQueue.size() >= config.issueQueueSize)
+      cause = StallCause::IQFull;
+    else if (isMemory && lsqOccupancy >= config.lsqSize)
+      cause = StallCause::LSQFull;
+    else if (writes && freePhysRegs == 0)
+      cause = StallCause::NoFreeRegs;
+
+    if (cause != StallCause::None)
+      break;
+
+    /* Rename: look up the producers of the source operands and make
+     * this instruction the producer of its destination.
+     */
+    if (entry.inst.usesRS1 && entry.inst.rs1 != 0)
+      entry.producers[0] = rat[entry.inst.rs1];
+    if (entry.inst.usesRS2 && entry.inst.rs2 != 0)
+      entry.producers[1] = rat[entry.inst.rs2];
+    if (entry.inst.usesRS3)
+      entry.producers[2] = rat[entry.inst.rs3];
+
+    if (writes) {
+      rat[entry.inst.rd] = entry.seq;
+      --freePhysRegs;
+    }
+
+    if (isMemory)
+      ++lsqOccupancy;
+
+    issueQueue.push_back(entry.seq);
+    rob.push_back(std::move(entry));
+    fetchQueue.pop_front();
+  }
+
+  if (cause != StallCause::None)
+    ++stallCycles[static_cast<size_t>(cause)];
+  nDispatched += n;
+}
+
+void
+OutOfOrderCore::fetch()
+{
+  if (endMarkerSeen || sysStatus.shouldHalt())
+    return;
+  if (blockingBranch != 0 || cycle < fetchResumeCycle)
+    return;
+
+  for (unsigned n = 0; n < config.fetchWidth &&
+                       fetchQueue.size() < config.fetchQueueSize;
+       ++n) {
+    /* Nothing is fetched after wfi until an interrupt wakes it up. */
+    if (pipeline.getCSRFile().isWaiting())
+      break;
+
+    Entry entry{};
+
+    try {
+      entry.inst = pipeline.executeInstruction();
+    } catch (TestEndMarkerEncountered& e) {
+      /* Let the instructions in flight drain before ending the test. */
+      endMarkerSeen = true;
+      endMarkerPC = e.getAddress();
+      return;
+    }
+
+    const ExecutedInstruction& inst = entry.inst;
+
+    entry.seq = nextSeq++;
+    entry.readyCycle = cycle + config.frontendLatency;
+    if (inst.control.getMemRead())
+      entry.cls = InstClass::Load;
+    else if (inst.control.getMemWrite())
+      entry.cls = InstClass::Store;
+    else if (inst.control.getBranch() || inst.control.getJump())
+      entry.cls = InstClass::Branch;
+
+    entry.mispredicted = !predict(inst);
+
+    fetchQueue.push_back(std::move(entry));
+    ++nFetched;
+
+    if (fetchQueue.back().mispredicted) {
+      blockingBranch = fetchQueue.back().seq;
+      ++nMispredicts;
+      break;
+    }
+
+    /* A fetch block ends at a taken control transfer and the program
+     * stops once a halt was requested. It also ends at a CSR instruction,
+     * which may enable interrupts: the interrupt lines are sampled once
+     * per cycle, and may be stale after the stores in this block.
+     */
+    if (inst.nextPC != inst.PC + inst.length ||
+        inst.control.getCSROp() != CSROp::None || sysStatus.shouldHalt())
+      break;
+  }
+}
+
+OutOfOrderCore::Entry*
+OutOfOrderCore::findInROB(uint64_t seq)
+{
+  if (rob.empty() || seq < rob.front().seq || seq > rob.back().seq)
+    return nullptr;
+
+  return &rob[seq - rob.front().seq];
+}
+
+const OutOfOrderCore::Entry*
+OutOfOrderCore::findInROB(uint64_t seq) const
+{
+  if (rob.empty() || seq < rob.front().seq || seq > rob.back().seq)
+    return nullptr;
+
+  return &rob[seq - rob.front().seq];
+}
+
+bool
+OutOfOrderCore::isReady(uint64_t producer) const
+{
+  if (producer == 0)
+    return true;
+
+  /* Producers that already left the ROB have committed. */
+  const Entry* entry = findInROB(producer);
+  return !entry || (entry->issued && entry->doneCycle <= cycle);
+}
+
+/* Addresses are known from functional execution, so memory dependencies
+ * are disambiguated perfectly: a load only waits for older stores that
+ * write (part of) the bytes it reads.
+ */
+bool
+OutOfOrderCore::memoryDependencyResolved(const Entry& load) const
+{
+  for (const auto& entry : rob) {
+    if (entry.seq >= load.seq)
+      break;
+
+    if (entry.cls == InstClass::Store &&
+        accessesOverlap(entry.inst, load.inst) &&
+        !(entry.issued && entry.doneCycle <= cycle))
+      return false;
+  }
+
+  return true;
+}
+
+unsigned
+OutOfOrderCore::getLatency(FunctionalUnit unit) const
+{
+  switch (unit) {
+  case FunctionalUnit::Multiply:
+    return units.mulLatency;
+  case FunctionalUnit::Divide:
+    return units.divLatency;
+  case FunctionalUnit::Load:
+    return units.loadLatency;
+  case FunctionalUnit::FloatingPoint:
+    return units.fpLatency;
+  case FunctionalUnit::FloatDivide:
+    return units.fdivLatency;
+  default:
+    return units.aluLatency;
+  }
+}
+
+bool
+OutOfOrderCore::isPipelined(FunctionalUnit unit) const
+{
+  switch (unit) {
+  case FunctionalUnit::Multiply:
+    return units.mulPipelined;
+  case FunctionalUnit::Divide:
+    return units.divPipelined;
+  case FunctionalUnit::FloatDivide:
+    return units.fdivPipelined;
+  default:
+    return true;
+  }
+}
+
+/* Returns whether the front-end would have predicted the next fetch
+ * address correctly, and trains the predictor.
+ */
+bool
+OutOfOrderCore::predict(const ExecutedInstruction& inst)
+{
+  if (inst.control.getBranch()) {
+    uint8_t& counter = counters[(inst.PC >> 2) % counters.size()];
+    const bool predictTaken = counter >= 2;
+    const bool taken = inst.nextPC != inst.PC + inst.length;
+
+    if (taken && counter < 3)
+      ++counter;
+    else if (!taken && counter > 0)
+      --counter;
+
+    return predictTaken == taken;
+  }
+
+  if (inst.opcode == Opcode::JALR) {
+    auto it = indirectTargets.find(inst.PC);
+    const bool correct = it != indirectTargets.end() && it->second == inst.nextPC;
+
+    indirectTargets[inst.PC] = inst.nextPC;
+    return correct;
+  }
+
+  /* JAL targets are known at decode. Traps and mret are not predicted. */
+  return inst.opcode == Opcode::JAL || inst.nextPC == inst.PC + inst.length;
+}
+
+void
+OutOfOrderCore::sampleStatistics()
+{
+  robOccupancySum += rob.size();
+  robOccupancyMax = std::max(robOccupancyMax, rob.size());
+
+  uint64_t loadsInFlight = std::count_if(
+      rob.begin(), rob.end(), [this](const Entry& entry) {
+        return entry.cls == InstClass::Load && entry.issued &&
+               entry.doneCycle > cycle;
+      });
+  if (loadsInFlight > 0) {
+    loadsInFlightSum += loadsInFlight;
+    ++cyclesWithLoadsInFlight;
+  }
+}
+
+const char*
+OutOfOrderCore::stallCauseName(StallCause cause)
+{
+  switch (cause) {
+  case StallCause::Frontend:
+    return "front-end empty";
+  case StallCause::Mispredict:
+    return "branch misprediction";
+  case StallCause::ROBFull:
+    return "reorder buffer full";
+  case StallCause::IQFull:
+    return "issue queue full";
+  case StallCause::LSQFull:
+    return "load/store queue full";
+  case StallCause::NoFreeRegs:
+    return "no free physical registers";
+  default:
+    return "none";
+  }
+}
+
+void
+OutOfOrderCore::dumpStatistics(std::ostream& os) const
+{
+  auto storeFlags(os.flags());
+  auto storePrecision(os.precision());
+  os << std::fixed << std::setprecision(3);
+
+  const double cycles = cycle > 0 ? static_cast<double>(cycle) : 1.0;
+  os << "IPC " << nCommitted / cycles << ", " << nMispredicts
+     << " branch mispredictions." << std::endl;
+  os << "ROB occupancy " << robOccupancySum / cycles << " average, "
+     << robOccupancyMax << " maximum." << std::endl;
+  if (cyclesWithLoadsInFlight > 0)
+    os << "Memory-level parallelism "
+       << static_cast<double>(loadsInFlightSum) / cyclesWithLoadsInFlight
+       << " loads in flight." << std::endl;
+
+  os.flags(storeFlags);
+  os.precision(storePrecision);
+
+  auto storeFill(os.fill(' '));
+  os << "Dispatch stall cycles:" << std::endl;
+  for (size_t i = 1; i < stallCycles.size(); ++i)
+    os << "  " << std::setw(28) << std::left
+       << stallCauseName(static_cast<StallCause>(i)) << std::right
+       << stallCycles[i] << std::endl;
+  os.flags(storeFlags);
+  os.fill(storeFill);
+}
@@ -0,0 +1,139 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    ooo-core.h - Out-of-order core timing model
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __OOO_CORE_H__
+#define __OOO_CORE_H__
+
+#include "machine-config.h"
+#include "pipeline.h"
+#include "sys-status.h"
+
+#include <array>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+/* The out-of-order core is a timing model: instructions are executed in
+ * program order at fetch time by a Pipeline running in non-pipelined mode
+ * (so InstructionDecoder, ALU and DataMemory provide the semantics). The
+ * resulting instruction stream is then scheduled through register rename,
+ * a reorder buffer, an issue queue and a load/store queue to determine
+ * when every instruction would complete and commit on an out-of-order
+ * machine. Because fetch follows the architecturally correct path, branch
+ * mispredictions are modeled by stopping fetch until the mispredicted
+ * branch has executed.
+ */
+class OutOfOrderCore {
+public:
+  OutOfOrderCore(const MachineConfig& machineConfig, Pipeline& pipeline,
+                 const SysStatus& sysStatus);
+
+  OutOfOrderCore(const OutOfOrderCore&) = delete;
+  OutOfOrderCore& operator=(const OutOfOrderCore&) = delete;
+
+  void clockPulse();
+
+  /* True when no instructions are in flight anymore. */
+  bool isDrained() const { return fetchQueue.empty() && rob.empty(); }
+
+  uint64_t getInstrFetched() const { return nFetched; }
+  uint64_t getInstrDispatched() const { return nDispatched; }
+  uint64_t getInstrCommitted() const { return nCommitted; }
+
+  void dumpStatistics(std::ostream& os) const;
+
+private:
+  enum class InstClass { ALU, Branch, Load, Store };
+
+  enum class StallCause {
+    None,
+    Frontend,
+    Mispredict,
+    ROBFull,
+    IQFull,
+    LSQFull,
+    NoFreeRegs,
+    LAST
+  };
+
+  struct Entry {
+    uint64_t seq{};
+    ExecutedInstruction inst{};
+    InstClass cls{InstClass::ALU};
+
+    uint64_t readyCycle{}; /* earliest cycle to dispatch (fetch queue) */
+    std::array<uint64_t, 3> producers{}; /* 0: operand ready */
+    bool mispredicted{};
+
+    bool issued{};
+    uint64_t doneCycle{};
+  };
+
+  const OoOConfig& config;
+  const FunctionalUnitConfig& units;
+  Pipeline& pipeline;
+  const SysStatus& sysStatus;
+
+  uint64_t cycle{};
+  uint64_t nextSeq{1};
+
+  std::deque<Entry> fetchQueue{};
+  std::deque<Entry> rob{};
+  std::vector<uint64_t> issueQueue{};
+  size_t lsqOccupancy{};
+  size_t freePhysRegs{};
+
+  /* Cycle from which the unpipelined units accept a new instruction */
+  std::array<uint64_t, static_cast<size_t>(FunctionalUnit::LAST)>
+      unitBusyUntil{};
+
+  /* Register alias table: sequence number of the in-flight producer of
+   * every architectural register, 0 if the value is committed. Indexed
+   * by pipeline register number, which includes the floating-point
+   * registers.
+   */
+  std::array<uint64_t, NumPipelineRegs> rat{};
+
+  /* Branch prediction: bimodal 2-bit counters and last indirect targets */
+  std::vector<uint8_t> counters{};
+  std::unordered_map<MemAddress, MemAddress> indirectTargets{};
+
+  uint64_t blockingBranch{}; /* mispredicted branch fetch waits for */
+  uint64_t fetchResumeCycle{};
+  bool endMarkerSeen{};
+  MemAddress endMarkerPC{};
+
+  /* Statistics */
+  uint64_t nFetched{};
+  uint64_t nDispatched{};
+  uint64_t nCommitted{};
+  uint64_t nMispredicts{};
+  uint64_t robOccupancySum{};
+  size_t robOccupancyMax{};
+  uint64_t loadsInFlightSum{};
+  uint64_t cyclesWithLoadsInFlight{};
+  std::array<uint64_t, static_cast<size_t>(StallCause::LAST)> stallCycles{};
+
+  void commit();
+  void issue();
+  void dispatch();
+  void fetch();
+
+  Entry* findInROB(uint64_t seq);
+  const Entry* findInROB(uint64_t seq) const;
+  bool isReady(uint64_t producer) const;
+  bool memoryDependencyResolved(const Entry& load) const;
+  unsigned getLatency(FunctionalUnit unit) const;
+  bool isPipelined(FunctionalUnit unit) const;
+  bool predict(const ExecutedInstruction& inst);
+  void sampleStatistics();
+
+  static const char* stallCauseName(StallCause cause);
+};
+
+#endif /* __OOO_CORE_H__ */
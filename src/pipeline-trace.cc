@@ -0,0 +1,308 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pipeline-trace.cc - Pipeline visualisation trace (Kanata format).
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "pipeline-trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+constexpr std::array<std::string_view, PipelineTracer::NumStages> stageNames =
+    {"IF", "IQ", "ID", "EX", "MEM", "WB"};
+
+bool
+isStall(CycleCategory category)
+{
+  return category == CycleCategory::LoadUse ||
+         category == CycleCategory::Memory ||
+         category == CycleCategory::Dependency ||
+         category == CycleCategory::Structural;
+}
+
+} // namespace
+
+/*
+ * TraceWriter
+ */
+
+/* "-" is stdout. */
+TraceWriter::TraceWriter(const std::string& filename)
+    : filename{filename}, stream{nullptr}, buffer(BufferSize)
+{
+  if (filename == "-") {
+    stream.rdbuf(std::cout.rdbuf());
+    return;
+  }
+
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("cannot open trace file " + filename);
+  stream.rdbuf(file.rdbuf());
+}
+
+TraceWriter::~TraceWriter()
+{
+  flush();
+}
+
+void
+TraceWriter::put(std::string_view str)
+{
+  while (!str.empty()) {
+    if (used == buffer.size())
+      flush();
+
+    size_t n = std::min(str.size(), buffer.size() - used);
+    std::memcpy(&buffer[used], str.data(), n);
+    used += n;
+    str.remove_prefix(n);
+  }
+}
+
+void
+TraceWriter::putDecimal(uint64_t value)
+{
+  char digits[20];
+  size_t n = 0;
+
+  do {
+    digits[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (n > 0)
+    put(digits[--n]);
+}
+
+void
+TraceWriter::putHex(uint64_t value)
+{
+  static constexpr char hexDigits[] = "0123456789abcdef";
+  char digits[16];
+  size_t n = 0;
+
+  do {
+    digits[n++] = hexDigits[value & 0xf];
+    value >>= 4;
+  } while (value != 0);
+
+  while (n > 0)
+    put(digits[--n]);
+}
+
+/* A failed write does not stop the simulation, the rest of the trace is
+ * lost.
+ */
+void
+TraceWriter::flush()
+{
+  stream.write(buffer.data(), used);
+  stream.flush();
+  used = 0;
+
+  if (!stream && !failed) {
+    std::cerr << "warning: cannot write trace file " << filename
+              << std::endl;
+    failed = true;
+  }
+}
+
+/*
+ * PipelineTracer
+ */
+
+PipelineTracer::PipelineTracer(const std::string& filename,
+                               const TraceWindow& window)
+    : writer{filename}, window{window}
+{
+  writer.put("Kanata\t0004\n");
+}
+
+void
+PipelineTracer::sample(const std::vector<FrontendSlot>& frontend,
+                       const Backend& backend,
+                       const std::vector<uint64_t>& memory,
+                       const IF_IDRegisters& if_id,
+                       const CycleAccounting& cycles)
+{
+  /* Nothing is left to record once the window has passed. */
+  if (cycle >= window.end && inFlight.empty())
+    return;
+
+  labelStall(cycles);
+
+  /* Instructions move forward through the stages, and leave the
+   * pipeline when they retire from WB or are flushed.
+   */
+  for (auto it = inFlight.begin(); it != inFlight.end();) {
+    size_t stage = findStage(it->seq, frontend, backend, memory);
+
+    if (stage == it->stage) {
+      ++it;
+      continue;
+    }
+
+    endStage(*it);
+
+    if (stage < NumStages) {
+      startStage(*it, stage);
+      ++it;
+      continue;
+    }
+
+    const bool retired = it->stage == NumStages - 1;
+    beginRecord('R', it->id);
+    writer.put('\t');
+    writer.putDecimal(retired ? nextRetireId++ : 0);
+    writer.put(retired ? "\t0\n" : "\t1\n");
+    it = inFlight.erase(it);
+  }
+
+  for (const auto& slot : frontend) {
+    if (slot.seq <= lastSeq)
+      continue;
+
+    lastSeq = slot.seq;
+    if (cycle < window.begin || cycle >= window.end)
+      continue;
+
+    Instruction inst{slot.seq, nextId++, 0};
+
+    beginRecord('I', inst.id);
+    writer.put('\t');
+    writer.putDecimal(inst.seq);
+    writer.put("\t0\n");
+
+    beginRecord('L', inst.id);
+    writer.put("\t0\t0x");
+    writer.putHex(slot.PC);
+    writer.put(": \n");
+
+    startStage(inst, slot.queued ? 1 : 0);
+    inFlight.push_back(inst);
+  }
+
+  /* Label instructions with their disassembly once they are decoded. */
+  for (const auto& inst : inFlight) {
+    if (inst.stage != DecodeStage || previousBackend[0] == inst.seq)
+      continue;
+
+    std::ostringstream text;
+    try {
+      decoder.setInstructionWord(if_id.instructionWord);
+      text << decoder;
+    } catch (std::exception&) {
+      text << "illegal instruction";
+    }
+    label(inst.id, false, text.str());
+  }
+
+  previousBackend = backend;
+  previousCycles = cycles;
+  ++cycle;
+}
+
+size_t
+PipelineTracer::findStage(uint64_t seq,
+                          const std::vector<FrontendSlot>& frontend,
+                          const Backend& backend,
+                          const std::vector<uint64_t>& memory) const
+{
+  for (const auto& slot : frontend)
+    if (slot.seq == seq)
+      return slot.queued ? 1 : 0;
+
+  for (size_t i = 0; i < backend.size(); ++i)
+    if (backend[i] == seq)
+      return DecodeStage + i;
+
+  for (auto memorySeq : memory)
+    if (memorySeq == seq)
+      return MemoryStage;
+
+  return NumStages;
+}
+
+/* Records are grouped by cycle, the first group sets the absolute cycle
+ * and every following group advances it.
+ */
+void
+PipelineTracer::beginRecord(char type, uint64_t id)
+{
+  if (!cycleWritten) {
+    writer.put("C=\t");
+    writer.putDecimal(cycle);
+    writer.put('\n');
+    cycleWritten = true;
+    lastRecordCycle = cycle;
+  } else if (cycle != lastRecordCycle) {
+    writer.put("C\t");
+    writer.putDecimal(cycle - lastRecordCycle);
+    writer.put('\n');
+    lastRecordCycle = cycle;
+  }
+
+  writer.put(type);
+  writer.put('\t');
+  writer.putDecimal(id);
+}
+
+void
+PipelineTracer::startStage(Instruction& inst, size_t stage)
+{
+  inst.stage = stage;
+
+  beginRecord('S', inst.id);
+  writer.put("\t0\t");
+  writer.put(stageNames[stage]);
+  writer.put('\n');
+}
+
+void
+PipelineTracer::endStage(const Instruction& inst)
+{
+  beginRecord('E', inst.id);
+  writer.put("\t0\t");
+  writer.put(stageNames[inst.stage]);
+  writer.put('\n');
+}
+
+void
+PipelineTracer::label(uint64_t id, bool hover, std::string_view text)
+{
+  beginRecord('L', id);
+  writer.put(hover ? "\t1\t" : "\t0\t");
+  writer.put(text);
+  writer.put('\n');
+}
+
+/* The cycle accounting tells why the instruction in ID was held in the
+ * previous cycle.
+ */
+void
+PipelineTracer::labelStall(const CycleAccounting& cycles)
+{
+  for (size_t i = 0; i < cycles.size(); ++i) {
+    const auto category = static_cast<CycleCategory>(i);
+    if (cycles[i] == previousCycles[i] || !isStall(category))
+      continue;
+
+    auto it = std::find_if(inFlight.begin(), inFlight.end(),
+                           [this](const Instruction& inst) {
+                             return inst.seq == previousBackend[0];
+                           });
+    if (it == inFlight.end())
+      return;
+
+    std::string text{cycleCategoryName(category)};
+    text += " stall at cycle " + std::to_string(cycle - 1) + "; ";
+    label(it->id, true, text);
+  }
+}
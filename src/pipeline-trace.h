@@ -0,0 +1,126 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pipeline-trace.h - Pipeline visualisation trace (Kanata format).
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PIPELINE_TRACE_H__
+#define __PIPELINE_TRACE_H__
+
+#include "inst-decoder.h"
+#include "stages.h"
+
+#include <array>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* Range of clock cycles [begin, end) in which instructions are recorded. */
+struct TraceWindow {
+  uint64_t begin = 0;
+  uint64_t end = std::numeric_limits<uint64_t>::max();
+};
+
+/* Writes text to a file through a large buffer. Numbers are converted
+ * by hand to avoid the overhead of stream formatting for every field.
+ */
+class TraceWriter {
+public:
+  explicit TraceWriter(const std::string& filename);
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter&) = delete;
+  TraceWriter& operator=(const TraceWriter&) = delete;
+
+  void put(char c)
+  {
+    if (used == buffer.size())
+      flush();
+    buffer[used++] = c;
+  }
+
+  void put(std::string_view str);
+  void putDecimal(uint64_t value);
+  void putHex(uint64_t value);
+
+  void flush();
+
+private:
+  static constexpr size_t BufferSize = 64 * 1024;
+
+  std::string filename;
+  std::ofstream file{};
+  std::ostream stream;
+  std::vector<char> buffer;
+  size_t used{};
+  bool failed{}; /* warned about a write error */
+};
+
+/* Records when every instruction enters and leaves each of the pipeline
+ * stages, in the Kanata log format that is read by the Konata pipeline
+ * viewer. Instructions are identified by the sequence number that is
+ * assigned at fetch and carried along in the pipeline registers.
+ */
+class PipelineTracer {
+public:
+  /* IF, IQ (instruction queue), ID, EX, MEM and WB */
+  static constexpr size_t NumStages = 6;
+  static constexpr size_t DecodeStage = 2;
+  static constexpr size_t MemoryStage = 4;
+
+  /* Sequence numbers of the instructions in ID, EX, MEM and WB. */
+  using Backend = std::array<uint64_t, NumStages - DecodeStage>;
+
+  PipelineTracer(const std::string& filename, const TraceWindow& window);
+
+  PipelineTracer(const PipelineTracer&) = delete;
+  PipelineTracer& operator=(const PipelineTracer&) = delete;
+
+  /* Called at the start of every clock cycle with the instructions in
+   * the front-end and the sequence numbers of the instructions in the
+   * other stages (0 for a bubble). When MEM is split over multiple
+   * stages, the instructions in the additional stages are passed
+   * separately.
+   */
+  void sample(const std::vector<FrontendSlot>& frontend,
+              const Backend& backend, const std::vector<uint64_t>& memory,
+              const IF_IDRegisters& if_id, const CycleAccounting& cycles);
+
+private:
+  struct Instruction {
+    uint64_t seq;
+    uint64_t id; /* Kanata instruction id */
+    size_t stage;
+  };
+
+  TraceWriter writer;
+  TraceWindow window;
+  InstructionDecoder decoder{};
+
+  uint64_t cycle{};
+  uint64_t lastRecordCycle{};
+  bool cycleWritten{};
+
+  uint64_t nextId{};
+  uint64_t nextRetireId{};
+  uint64_t lastSeq{}; /* youngest instruction seen */
+  std::vector<Instruction> inFlight{};
+
+  Backend previousBackend{};
+  CycleAccounting previousCycles{};
+
+  size_t findStage(uint64_t seq, const std::vector<FrontendSlot>& frontend,
+                   const Backend& backend,
+                   const std::vector<uint64_t>& memory) const;
+  void beginRecord(char type, uint64_t id);
+  void startStage(Instruction& inst, size_t stage);
+  void endStage(const Instruction& inst);
+  void label(uint64_t id, bool hover, std::string_view text);
+  void labelStall(const CycleAccounting& cycles);
+};
+
+#endif /* __PIPELINE_TRACE_H__ */
@@ -1,29 +1,94 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    pipeline.cc - Classic 5-stage RISC pipeline
+ *    pipeline.cc - Classic RISC pipeline, 5 stages by default
  *
  * Copyright (C) 2016-2021  Leiden University, The Netherlands.
  */
 
 #include "pipeline.h"
+#include "pipeline-trace.h"
+
+#include <iomanip>
 
 Pipeline::Pipeline(bool pipelining, bool debugMode, MemAddress& PC,
                    InstructionMemory& instructionMemory,
                    InstructionDecoder& decoder, RegisterFile& regfile,
-                   DataMemory& dataMemory)
-    : pipelining{pipelining}
-{
-  stages.emplace_back(std::make_unique<InstructionFetchStage>(
-      pipelining, if_id, instructionMemory, PC, controlSignals));
-  stages.emplace_back(std::make_unique<InstructionDecodeStage>(
-      pipelining, if_id, id_ex, m_wb, regfile, decoder, nInstrIssued, nStalls,
-      controlSignals, debugMode));
-  stages.emplace_back(std::make_unique<ExecuteStage>(pipelining, id_ex, ex_m,
-                                                     m_wb, PC, controlSignals));
+                   FloatRegisterFile& floatRegfile, FloatStatus& fcsr,
+                   DataMemory& dataMemory, VectorUnit& vectorUnit,
+                   const uint64_t& nCycles, const MachineConfig& config)
+    : pipelining{pipelining}, PC{PC},
+      csrFile{nCycles, nInstrCompleted, fcsr, vectorUnit},
+      scoreboard{config.units, config.pipeline.memoryStages},
+      predictor{config.frontend.btbEntries, config.frontend.predictorEntries}
+{
+  const PipelineConfig& depth = config.pipeline;
+  if (depth.fetchStages == 0 || depth.memoryStages == 0)
+    throw std::runtime_error("pipeline needs at least one fetch and one "
+                             "memory stage");
+
+  /* The stages keep references to the registers, so these have to be
+   * allocated up front. The additional stages do not exist in
+   * non-pipelined mode, which executes a single stage per step.
+   */
+  if (pipelining) {
+    fetchRegisters.resize(depth.fetchStages - 1);
+    memRegisters.resize(depth.memoryStages - 1);
+  }
+
+  IF_IDRegisters& fetchOut =
+      fetchRegisters.empty() ? if_id : fetchRegisters.front();
+  M_WBRegisters& memOut = memRegisters.empty() ? m_wb : memRegisters.front();
+
+  /* Number of cycles from fetching the end marker until the preceding
+   * instruction has been written back.
+   */
+  const int drainCycles = depth.fetchStages + depth.memoryStages + 3;
+
+  std::unique_ptr<FetchStage> fetch;
+  if (pipelining && config.frontend.iqSize > 0)
+    fetch = std::make_unique<DecoupledFetchStage>(
+        fetchOut, instructionMemory, PC, controlSignals, predictor,
+        config.frontend, drainCycles - 1);
+  else
+    fetch = std::make_unique<InstructionFetchStage>(
+        pipelining, fetchOut, instructionMemory, PC, controlSignals,
+        drainCycles);
+  fetchStage = fetch.get();
+  stages.emplace_back(std::move(fetch));
+  for (size_t i = 0; i < fetchRegisters.size(); ++i)
+    stages.emplace_back(std::make_unique<LatchStage<IF_IDRegisters>>(
+        fetchRegisters[i],
+        i + 1 < fetchRegisters.size() ? fetchRegisters[i + 1] : if_id,
+        controlSignals, true));
+
+  auto decode = std::make_unique<InstructionDecodeStage>(
+      pipelining, if_id, id_ex, m_wb, regfile, floatRegfile, decoder,
+      scoreboard, csrFile, nInstrIssued, nStalls, cycles, controlSignals,
+      depth.fetchStages, debugMode);
+  decodeStage = decode.get();
+  stages.emplace_back(std::move(decode));
+
+  std::vector<const M_WBRegisters*> memLatches;
+  for (const auto& registers : memRegisters)
+    memLatches.push_back(&registers);
+  memLatches.push_back(&m_wb);
+  auto execute = std::make_unique<ExecuteStage>(
+      pipelining, id_ex, ex_m, std::move(memLatches), PC, regfile, fcsr,
+      csrFile, controlSignals, predictor);
+  executeStage = execute.get();
+  stages.emplace_back(std::move(execute));
+
   stages.emplace_back(
-      std::make_unique<MemoryStage>(pipelining, ex_m, m_wb, dataMemory));
+      std::make_unique<MemoryStage>(pipelining, ex_m, memOut, dataMemory,
+                                    vectorUnit));
+  for (size_t i = 0; i < memRegisters.size(); ++i)
+    stages.emplace_back(std::make_unique<LatchStage<M_WBRegisters>>(
+        memRegisters[i],
+        i + 1 < memRegisters.size() ? memRegisters[i + 1] : m_wb,
+        controlSignals, false));
+
   stages.emplace_back(std::make_unique<WriteBackStage>(
-      pipelining, m_wb, regfile, nInstrCompleted));
+      pipelining, m_wb, regfile, floatRegfile, nInstrCompleted));
 }
 
 void
@@ -32,9 +97,31 @@ Pipeline::propagate()
   controlSignals.reset();
 
   if (!pipelining) {
-    /* Execute a single instruction execution step. */
-    stages[currentStage]->propagate();
+    /* Execute a single instruction execution step. After wfi, the next
+     * instruction is not fetched until an interrupt wakes the processor.
+     */
+    waitCycle = currentStage == 0 && csrFile.isWaiting();
+    if (!waitCycle)
+      stages[currentStage]->propagate();
   } else {
+    if (tracer) {
+      /* Instructions in the additional fetch stages are shown as IF. */
+      std::vector<FrontendSlot> frontend;
+      for (auto it = fetchRegisters.rbegin(); it != fetchRegisters.rend();
+           ++it)
+        if (it->seq != 0)
+          frontend.push_back({it->seq, it->PC, false});
+      fetchStage->getInFlight(frontend);
+
+      std::vector<uint64_t> memory;
+      for (const auto& registers : memRegisters)
+        if (registers.seq != 0)
+          memory.push_back(registers.seq);
+
+      tracer->sample(frontend, {if_id.seq, id_ex.seq, ex_m.seq, m_wb.seq},
+                     memory, if_id, cycles);
+    }
+
     /* Run propagate for all stages within a single clock cycle. */
     for (auto& s : stages)
       s->propagate();
@@ -45,10 +132,143 @@ void
 Pipeline::clockPulse()
 {
   if (!pipelining) {
+    if (waitCycle) {
+      addIdleCycles(1);
+      return;
+    }
     stages[currentStage]->clockPulse();
     currentStage = (currentStage + 1) % stages.size();
   } else {
     for (auto& s : stages)
       s->clockPulse();
+
+    scoreboard.clockPulse();
+  }
+}
+
+void
+Pipeline::setTracer(PipelineTracer* newTracer)
+{
+  if (newTracer && !pipelining)
+    throw std::logic_error("pipeline tracing requires pipelined mode");
+
+  tracer = newTracer;
+}
+
+void
+Pipeline::setSyscallProxy(SyscallProxy* proxy)
+{
+  decodeStage->setSyscallProxy(proxy);
+  executeStage->setSyscallProxy(proxy);
+}
+
+void
+Pipeline::setIdleMonitor(IdleMonitor* monitor)
+{
+  executeStage->setIdleMonitor(monitor);
+}
+
+PipelineCounters
+Pipeline::getCounters() const
+{
+  return {nInstrIssued, nInstrCompleted, nStalls, cycles};
+}
+
+void
+Pipeline::addCounters(const PipelineCounters& iteration, uint64_t times)
+{
+  nInstrIssued += iteration.instrIssued * times;
+  nInstrCompleted += iteration.instrCompleted * times;
+  nStalls += iteration.stalls * times;
+  for (size_t i = 0; i < cycles.size(); ++i)
+    cycles[i] += iteration.cycles[i] * times;
+}
+
+void
+Pipeline::addIdleCycles(uint64_t idleCycles)
+{
+  cycles[static_cast<size_t>(CycleCategory::Idle)] += idleCycles;
+
+  /* Decode inserts a bubble in every cycle of the wait. */
+  if (pipelining)
+    nStalls += idleCycles;
+  fetchStage->addIdleCycles(idleCycles);
+}
+
+ExecutedInstruction
+Pipeline::executeInstruction()
+{
+  if (pipelining)
+    throw std::logic_error("executeInstruction requires non-pipelined mode");
+
+  ExecutedInstruction info{};
+  info.PC = PC;
+
+  do {
+    propagate();
+    clockPulse();
+
+    /* Capture the decoded instruction after ID, the effective address
+     * after EX. An instruction squashed by a trap does nothing past EX.
+     */
+    if (currentStage == 2) {
+      info.instructionWord = if_id.instructionWord;
+      info.length = id_ex.length;
+      info.opcode = id_ex.opcode;
+      info.rd = id_ex.rd;
+      info.rs1 = id_ex.rs1;
+      info.rs2 = id_ex.rs2;
+      info.rs3 = id_ex.rs3;
+      info.usesRS1 = id_ex.control.getUsesRS1();
+      info.usesRS2 = id_ex.control.getUsesRS2();
+      info.usesRS3 = id_ex.control.getUsesRS3();
+      info.control = id_ex.control;
+    } else if (currentStage == 3) {
+      info.memAddress = ex_m.aluResult;
+      info.control = ex_m.control;
+    }
+  } while (currentStage != 0);
+
+  info.nextPC = PC;
+  return info;
+}
+
+/* Print the CPI stack: the contribution of every cycle category to the
+ * number of cycles per issued instruction.
+ */
+void
+Pipeline::dumpCycleAccounting(std::ostream& os) const
+{
+  uint64_t total = 0;
+  for (auto n : cycles)
+    total += n;
+
+  const uint64_t instructions =
+      cycles[static_cast<size_t>(CycleCategory::Retiring)];
+  if (total == 0 || instructions == 0)
+    return;
+
+  auto storeFlags(os.flags());
+  auto storePrecision(os.precision());
+  auto storeFill(os.fill(' '));
+  os << std::fixed << std::setprecision(3);
+
+  os << "CPI stack, " << static_cast<double>(total) / instructions
+     << " cycles per instruction:" << std::endl;
+  for (size_t i = 0; i < cycles.size(); ++i) {
+    /* Only shown for programs that wait for interrupts. */
+    if (static_cast<CycleCategory>(i) == CycleCategory::Idle && cycles[i] == 0)
+      continue;
+
+    os << "  " << std::setw(16) << std::left
+       << cycleCategoryName(static_cast<CycleCategory>(i)) << std::right
+       << std::setw(10) << cycles[i] << std::setw(8)
+       << static_cast<double>(cycles[i]) / instructions << std::setw(7)
+       << std::setprecision(1) << 100.0 * cycles[i] / total << "%"
+       << std::setprecision(3) << std::endl;
   }
+
+  os.flags(storeFlags);
+  os.precision(storePrecision);
+  os.fill(storeFill);
 }
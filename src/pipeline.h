@@ -1,6 +1,6 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    pipeline.h - Classic 5-stage RISC pipeline
+ *    pipeline.h - Classic RISC pipeline, 5 stages by default
  *
  * Copyright (C) 2016-2021  Leiden University, The Netherlands.
  */
@@ -8,15 +8,61 @@
 #ifndef __PIPELINE_H__
 #define __PIPELINE_H__
 
+#include "frontend.h"
 #include "stages.h"
 
 #include "memory-control.h"
 
+class PipelineTracer;
+
+/* Summary of a single instruction that was executed to completion. This
+ * is used by timing models that rely on the pipeline stages only for
+ * the functional semantics of the instructions.
+ */
+struct ExecutedInstruction {
+  MemAddress PC{};
+  MemAddress nextPC{};
+  uint32_t instructionWord{};
+  uint8_t length{}; /* 2 for compressed instructions */
+  Opcode opcode{Opcode::OP};
+
+  RegNumber rd{}; /* register numbers of the pipeline, see FloatRegBase */
+  RegNumber rs1{};
+  RegNumber rs2{};
+  RegNumber rs3{};
+  bool usesRS1{};
+  bool usesRS2{};
+  bool usesRS3{};
+
+  MemAddress memAddress{}; /* only valid for loads and stores */
+  ControlSignals control{};
+};
+
+/* The statistics of the pipeline, which are extrapolated when the
+ * iterations of an idle loop are skipped.
+ */
+struct PipelineCounters {
+  uint64_t instrIssued{};
+  uint64_t instrCompleted{};
+  uint64_t stalls{};
+  CycleAccounting cycles{};
+
+  bool operator==(const PipelineCounters& other) const
+  {
+    return instrIssued == other.instrIssued &&
+           instrCompleted == other.instrCompleted &&
+           stalls == other.stalls && cycles == other.cycles;
+  }
+};
+
 class Pipeline {
 public:
   Pipeline(bool pipelining, bool debugMode, MemAddress& PC,
            InstructionMemory& instructionMemory, InstructionDecoder& decoder,
-           RegisterFile& regfile, DataMemory& dataMemory);
+           RegisterFile& regfile, FloatRegisterFile& floatRegfile,
+           FloatStatus& fcsr, DataMemory& dataMemory,
+           VectorUnit& vectorUnit, const uint64_t& nCycles,
+           const MachineConfig& config);
 
   Pipeline(const Pipeline&) = delete;
   Pipeline& operator=(const Pipeline&) = delete;
@@ -24,25 +70,84 @@ public:
   void propagate();
   void clockPulse();
 
+  /* Run all stages for a single instruction, only in non-pipelined mode. */
+  ExecutedInstruction executeInstruction();
+
   bool getPipelining() const { return pipelining; }
 
+  /* The interrupt lines are sampled once per cycle, see InterruptLine. */
+  void setInterruptLines(uint64_t lines) { csrFile.setInterruptLines(lines); }
+
+  /* The time CSR reads mtime of the timer, rather than the cycle count.
+   * The pipeline does not take ownership of the timer.
+   */
+  void setTimer(const CLINT* timer) { csrFile.setTimer(timer); }
+
+  /* Execute ecall as a Linux system call. The pipeline does not take
+   * ownership of the proxy.
+   */
+  void setSyscallProxy(SyscallProxy* proxy);
+
+  /* Report wfi and loops to the monitor, which is not owned. */
+  void setIdleMonitor(IdleMonitor* monitor);
+
+  const CSRFile& getCSRFile() const { return csrFile; }
+
+  /* Record the stage timing of every instruction, only in pipelined mode.
+   * The pipeline does not take ownership of the tracer.
+   */
+  void setTracer(PipelineTracer* newTracer);
+
   uint64_t getInstrIssued() const { return nInstrIssued; }
 
   uint64_t getInstrCompleted() const { return nInstrCompleted; }
 
   uint64_t getStalls() const { return nStalls; }
 
+  uint64_t getInstrFetched() const { return fetchStage->getInstrFetched(); }
+  uint64_t getBytesFetched() const { return fetchStage->getBytesFetched(); }
+
+  const CycleAccounting& getCycleAccounting() const { return cycles; }
+
+  PipelineCounters getCounters() const;
+  /* Add the counters of times skipped iterations. */
+  void addCounters(const PipelineCounters& iteration, uint64_t times);
+  /* Account cycles that were skipped while waiting for an interrupt, once
+   * the pipeline is settled.
+   */
+  void addIdleCycles(uint64_t idleCycles);
+
+  void dumpCycleAccounting(std::ostream& os) const;
+  void dumpFrontendStatistics(std::ostream& os) const
+  {
+    fetchStage->dumpStatistics(os);
+  }
+
 private:
   bool pipelining;
   size_t currentStage{};
+  bool waitCycle{}; /* non-pipelined: no step while waiting (wfi) */
+  MemAddress& PC;
 
   /* Statistics */
   uint64_t nInstrIssued{};
   uint64_t nInstrCompleted{};
   uint64_t nStalls{};
+  CycleAccounting cycles{};
+
+  /* Reads the cycle count of the processor and the statistics above. */
+  CSRFile csrFile;
+
+  Scoreboard scoreboard;
+  BranchPredictor predictor;
 
   /* Stages */
   std::vector<std::unique_ptr<Stage>> stages{};
+  FetchStage* fetchStage{}; /* no ownership */
+  InstructionDecodeStage* decodeStage{};
+  ExecuteStage* executeStage{};
+
+  PipelineTracer* tracer{}; /* no ownership */
 
   /* Pipeline registers */
   IF_IDRegisters if_id{};
@@ -50,6 +155,12 @@ private:
   EX_MRegisters ex_m{};
   M_WBRegisters m_wb{};
 
+  /* Registers between the additional stages when IF and MEM are split,
+   * in pipeline order. These are empty in non-pipelined mode.
+   */
+  std::vector<IF_IDRegisters> fetchRegisters{};
+  std::vector<M_WBRegisters> memRegisters{};
+
   PipelineControl controlSignals{};
 };
 
@@ -0,0 +1,150 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pixel-kernels.cc - Host SIMD kernels of the framebuffer.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "pixel-kernels.h"
+#include "vector-kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/* See vector-kernels.cc: the emulator is compiled for the baseline
+ * instruction set, only these functions use the extensions.
+ */
+#ifdef _MSC_VER
+#define TARGET_SSE42
+#define TARGET_AVX2
+#else
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+/* One pixel at a time; also handles the remaining pixels of the SIMD
+ * kernels.
+ */
+void
+scalarGrey(uint8_t* rgba, const uint8_t* src, size_t n)
+{
+  for (size_t i = 0; i < n; ++i, rgba += 4) {
+    rgba[0] = rgba[1] = rgba[2] = src[i];
+    rgba[3] = 0xff;
+  }
+}
+
+void
+scalarPalette(uint8_t* rgba, const uint8_t* src, const uint32_t* palette,
+              size_t n)
+{
+  for (size_t i = 0; i < n; ++i, rgba += 4)
+    std::memcpy(rgba, &palette[src[i]], sizeof(uint32_t));
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* A byte shuffle spreads 4 grey pixels over the red, green and blue bytes
+ * of 4 output pixels; index -1 clears the alpha byte, which is then set.
+ */
+TARGET_SSE42 void
+sseGrey(uint8_t* rgba, const uint8_t* src, size_t n)
+{
+  const __m128i alpha = _mm_set1_epi32(0xff000000);
+  const __m128i spread[4] = {
+      _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1),
+      _mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+      _mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1),
+      _mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15,
+                    15, -1)};
+
+  size_t i = 0;
+  for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+    const __m128i pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    for (int k = 0; k < 4; ++k)
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(rgba + (i + k * 4) * 4),
+          _mm_or_si128(_mm_shuffle_epi8(pixels, spread[k]), alpha));
+  }
+  scalarGrey(rgba + i * 4, src + i, n - i);
+}
+
+/* SSE has no gather, a palette lookup is as fast in scalar code. */
+void
+ssePalette(uint8_t* rgba, const uint8_t* src, const uint32_t* palette,
+           size_t n)
+{
+  scalarPalette(rgba, src, palette, n);
+}
+
+/* The shuffle works within the 128-bit halves, so both halves get the
+ * same 16 pixels and each half spreads a different 4 of them.
+ */
+TARGET_AVX2 void
+avx2Grey(uint8_t* rgba, const uint8_t* src, size_t n)
+{
+  const __m256i alpha = _mm256_set1_epi32(0xff000000);
+  const __m256i spread[2] = {
+      _mm256_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1, 4,
+                       4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+      _mm256_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11,
+                       -1, 12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15,
+                       15, 15, -1)};
+
+  size_t i = 0;
+  for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+    const __m256i pixels = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+    for (int k = 0; k < 2; ++k)
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(rgba + (i + k * 8) * 4),
+          _mm256_or_si256(_mm256_shuffle_epi8(pixels, spread[k]), alpha));
+  }
+  scalarGrey(rgba + i * 4, src + i, n - i);
+}
+
+TARGET_AVX2 void
+avx2Palette(uint8_t* rgba, const uint8_t* src, const uint32_t* palette,
+            size_t n)
+{
+  const int* colours = reinterpret_cast<const int*>(palette);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i index = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4),
+                        _mm256_i32gather_epi32(colours, index, 4));
+  }
+  scalarPalette(rgba + i * 4, src + i, palette, n - i);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+PixelKernels
+selectKernels()
+{
+#ifdef HAVE_X86_KERNELS
+  if (hostSupportsAVX2())
+    return {"AVX2", avx2Grey, avx2Palette};
+  if (hostSupportsSSE42())
+    return {"SSE4.2", sseGrey, ssePalette};
+#endif
+  return {"scalar", scalarGrey, scalarPalette};
+}
+
+} // namespace
+
+const PixelKernels&
+getPixelKernels()
+{
+  static const PixelKernels kernels = selectKernels();
+  return kernels;
+}
@@ -0,0 +1,34 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    pixel-kernels.h - Host SIMD kernels of the framebuffer.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PIXEL_KERNELS_H__
+#define __PIXEL_KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+/* Expand n 8-bit pixels to 4 bytes each, in the order red, green, blue and
+ * alpha. The grey kernel replicates the value in the colour channels, the
+ * palette kernel looks the pixels up in 256 colours that are stored in
+ * that byte order. src and rgba may not overlap.
+ */
+using GreyKernel = void (*)(uint8_t* rgba, const uint8_t* src, size_t n);
+using PaletteKernel = void (*)(uint8_t* rgba, const uint8_t* src,
+                               const uint32_t* palette, size_t n);
+
+struct PixelKernels {
+  const char* isa;
+  GreyKernel grey;
+  PaletteKernel palette;
+};
+
+/* The kernels for the best instruction set that the host supports: AVX2,
+ * SSE4.2 or plain C++. This is determined once, at the first call.
+ */
+const PixelKernels& getPixelKernels();
+
+#endif /* __PIXEL_KERNELS_H__ */
@@ -6,27 +6,73 @@
  */
 
 #include "processor.h"
-#include "framebuffer.h"
 #include "inst-decoder.h"
-#include "serial.h"
 
 #include <iomanip>
 #include <iostream>
 
-Processor::Processor(ELFFile& program, bool pipelining, bool debugMode)
-    : bus{program.createMemories()}, instructionMemory{bus}, dataMemory{bus},
-      pipeline{pipelining, debugMode, PC,        instructionMemory,
-               decoder,    regfile,   dataMemory}
+Processor::Processor(ELFFile& program, bool pipelining, bool debugMode,
+                     const MachineConfig& config)
+    : config{config}, bus{program.createMemories()}, instructionMemory{bus},
+      dataMemory{bus}, vectorUnit{bus, config.vector.vlen},
+      /* The out-of-order model uses the pipeline only for its semantics. */
+      pipeline{pipelining && !config.ooo.enable, debugMode, PC,
+               instructionMemory, decoder, regfile, floatRegfile, fcsr,
+               dataMemory, vectorUnit, nCycles, config}
 {
-  bus.addClient(std::make_unique<Serial>(0x200));
+  auto serialPort = std::make_unique<Serial>(0x200, config.serial);
+  serial = serialPort.get();
+  bus.addClient(std::move(serialPort));
 
   auto status = std::make_unique<SysStatus>(0x270);
   sysStatus = status.get();
   bus.addClient(std::move(status));
 
+  if (config.clint.enable) {
+    auto timer = std::make_unique<CLINT>(config.clint, nCycles);
+    clint = timer.get();
+    bus.addClient(std::move(timer));
+    pipeline.setTimer(clint);
+  }
+
+  if (!config.block.image.empty()) {
+    auto device = std::make_unique<BlockDevice>(config.block, bus, nCycles);
+    block = device.get();
+    bus.addClient(std::move(device));
+  }
+
+  if (config.dma.enable) {
+    auto engine = std::make_unique<DMAEngine>(config.dma, bus, nCycles);
+    dma = engine.get();
+    bus.addClient(std::move(engine));
+  }
+
+  /* Without SDL, the framebuffer is only present to be captured. */
 #ifdef ENABLE_FRAMEBUFFER
-  bus.addClient(std::make_unique<Framebuffer>(0x800, 0x1000000));
+  const bool window = config.framebuffer.window;
+#else
+  const bool window = false;
 #endif
+  if (window || !config.framebuffer.capture.empty()) {
+    auto device =
+        std::make_unique<Framebuffer>(0x800, 0x1000000, config, nCycles);
+    framebuffer = device.get();
+    bus.addClient(std::move(device));
+  }
+
+  if (config.ooo.enable)
+    oooCore = std::make_unique<OutOfOrderCore>(this->config, pipeline,
+                                               *sysStatus);
+
+  /* The out-of-order core keeps its own timing state, which cannot be
+   * advanced by the idle monitor.
+   */
+  if (config.pipeline.fastForward && !config.ooo.enable) {
+    idleMonitor = std::make_unique<IdleMonitor>(
+        regfile, floatRegfile, fcsr, bus, vectorUnit, pipeline, nCycles,
+        config);
+    pipeline.setIdleMonitor(idleMonitor.get());
+  }
 
   /* Initialize PC */
   PC = program.getEntrypoint();
@@ -47,6 +93,30 @@ Processor::getRegister(RegNumber regnum) const
   return regfile.readRegister(regnum);
 }
 
+void
+Processor::enableTrace(const std::string& filename, const TraceWindow& window)
+{
+  if (!pipeline.getPipelining())
+    throw std::runtime_error("tracing is only supported in pipelined mode");
+
+  tracer = std::make_unique<PipelineTracer>(filename, window);
+  pipeline.setTracer(tracer.get());
+
+  /* Every cycle is traced. */
+  pipeline.setIdleMonitor(nullptr);
+  idleMonitor.reset();
+}
+
+void
+Processor::enableSyscalls(const ELFFile& program,
+                          const std::vector<std::string>& args)
+{
+  syscalls = std::make_unique<SyscallProxy>(bus, *sysStatus,
+                                            program.getProgramEnd());
+  regfile.writeRegister(2 /* sp */, syscalls->setupStack(args, {}));
+  pipeline.setSyscallProxy(syscalls.get());
+}
+
 /* Processor main loop. Each iteration should execute an instruction.
  * One step in executing and instruction takes 1 clock cycle.
  *
@@ -63,15 +133,26 @@ Processor::getRegister(RegNumber regnum) const
 bool
 Processor::run(bool testMode)
 {
-  while (!sysStatus->shouldHalt()) {
+  /* The out-of-order core stops fetching once a halt is requested, but
+   * the instructions in flight are allowed to commit.
+   */
+  while (!sysStatus->shouldHalt() || (oooCore && !oooCore->isDrained())) {
     try {
       /* The "bus clock" runs at 1/5 the frequency of the Processor. */
       if (nCycles % 5 == 0)
         bus.clockPulse();
+      pipeline.setInterruptLines(bus.getInterruptLines());
 
-      pipeline.propagate();
-      pipeline.clockPulse();
+      if (oooCore)
+        oooCore->clockPulse();
+      else {
+        pipeline.propagate();
+        pipeline.clockPulse();
+      }
       ++nCycles;
+
+      if (idleMonitor)
+        fastForward();
     } catch (TestEndMarkerEncountered& e) {
       if (testMode)
         return true;
@@ -97,9 +178,41 @@ Processor::run(bool testMode)
     }
   }
 
+  serial->flush();
+  if (framebuffer)
+    framebuffer->flush();
   return true;
 }
 
+/* Skip the cycles until the next device event, when the program waits for
+ * an interrupt after wfi, or spins in a loop that cannot end before that
+ * event.
+ */
+void
+Processor::fastForward()
+{
+  const uint64_t event = bus.getNextEvent();
+  const uint64_t start = nCycles;
+
+  if (idleMonitor->isWaitSettled()) {
+    if (event == MemoryInterface::NoEvent || event <= nCycles)
+      return;
+
+    pipeline.addIdleCycles(event - nCycles);
+    nCycles = event;
+  } else if (uint64_t iterations =
+                 idleMonitor->getSkippableIterations(event)) {
+    nCycles += iterations * idleMonitor->getIterationCycles();
+    pipeline.addCounters(idleMonitor->getIterationCounters(), iterations);
+    idleMonitor->reset();
+  } else
+    return;
+
+  nCyclesSkipped += nCycles - start;
+  /* Pending output is not held back during the idle period. */
+  serial->flush();
+}
+
 void
 Processor::dumpRegisters() const
 {
@@ -122,11 +235,145 @@ Processor::dumpRegisters() const
 void
 Processor::dumpStatistics() const
 {
+  if (oooCore) {
+    std::cerr << nCycles << " clock cycles, "
+              << oooCore->getInstrDispatched() << " instructions issued, "
+              << oooCore->getInstrCommitted() << " instructions completed."
+              << std::endl;
+    oooCore->dumpStatistics(std::cerr);
+    dumpFetchStatistics();
+    dumpVectorStatistics();
+    dumpSyscallStatistics();
+    dumpBlockStatistics();
+    dumpDMAStatistics();
+    dumpFramebufferStatistics();
+    std::cerr << bus.getBytesRead() << " bytes read, "
+              << bus.getBytesWritten() << " bytes written." << std::endl;
+    dumpExecutionTime();
+    return;
+  }
+
   std::cerr << nCycles << " clock cycles, " << pipeline.getInstrIssued()
             << " instructions issued, " << pipeline.getInstrCompleted()
             << " instructions completed." << std::endl;
-  if (pipeline.getPipelining())
+  if (pipeline.getPipelining()) {
     std::cerr << pipeline.getStalls() << " stall cycles inserted." << std::endl;
+    pipeline.dumpCycleAccounting(std::cerr);
+    pipeline.dumpFrontendStatistics(std::cerr);
+  }
+  dumpFetchStatistics();
+  dumpVectorStatistics();
+  dumpSyscallStatistics();
+  dumpIdleStatistics();
+  dumpBlockStatistics();
+  dumpDMAStatistics();
+  dumpFramebufferStatistics();
   std::cerr << bus.getBytesRead() << " bytes read, " << bus.getBytesWritten()
             << " bytes written." << std::endl;
+  dumpExecutionTime();
+}
+
+/* The savings of compressed instructions, only shown for programs that
+ * contain them.
+ */
+void
+Processor::dumpFetchStatistics() const
+{
+  const uint64_t bytes = pipeline.getBytesFetched();
+  const uint64_t uncompressedBytes = 4 * pipeline.getInstrFetched();
+  if (bytes == uncompressedBytes)
+    return;
+
+  auto storeFlags(std::cerr.flags());
+  std::cerr << bytes << " instruction bytes fetched, " << uncompressedBytes
+            << " without compression (" << std::fixed << std::setprecision(1)
+            << 100.0 * (uncompressedBytes - bytes) / uncompressedBytes
+            << "% saved)." << std::endl;
+  std::cerr.flags(storeFlags);
+}
+
+/* Only shown for programs that use the vector unit. */
+void
+Processor::dumpVectorStatistics() const
+{
+  const uint64_t elements = vectorUnit.getElementOperations();
+  if (elements == 0)
+    return;
+
+  std::cerr << elements << " vector element operations, "
+            << vectorUnit.getKernelISA() << " kernels." << std::endl;
+}
+
+/* Only shown in Linux user mode. Buffers accessed by system calls are not
+ * included in the bytes read and written.
+ */
+void
+Processor::dumpSyscallStatistics() const
+{
+  if (!syscalls)
+    return;
+
+  std::cerr << syscalls->getCallCount() << " system calls." << std::endl;
+}
+
+/* Only shown when cycles were skipped. The statistics other than the
+ * cycles, instructions and stalls do not include skipped iterations.
+ */
+void
+Processor::dumpIdleStatistics() const
+{
+  if (nCyclesSkipped == 0)
+    return;
+
+  std::cerr << nCyclesSkipped << " cycles fast-forwarded while idle."
+            << std::endl;
+}
+
+/* Only shown when a block device is present. Its transfers are not
+ * included in the bytes read and written.
+ */
+void
+Processor::dumpBlockStatistics() const
+{
+  if (!block)
+    return;
+
+  std::cerr << block->getSectorsRead() << " sectors read, "
+            << block->getSectorsWritten() << " sectors written." << std::endl;
+}
+
+/* Only shown for programs that use the DMA engine. Its copies are not
+ * included in the bytes read and written.
+ */
+void
+Processor::dumpDMAStatistics() const
+{
+  if (!dma || dma->getTransfers() == 0)
+    return;
+
+  std::cerr << dma->getTransfers() << " DMA transfers, "
+            << dma->getBytesCopied() << " bytes copied." << std::endl;
+}
+
+/* Only shown when frames are captured. */
+void
+Processor::dumpFramebufferStatistics() const
+{
+  if (!framebuffer || !framebuffer->isCapturing())
+    return;
+
+  std::cerr << framebuffer->getFramesCaptured() << " frames captured."
+            << std::endl;
+}
+
+/* The execution time is only known when a clock frequency is configured. */
+void
+Processor::dumpExecutionTime() const
+{
+  const double frequency = config.pipeline.clockFrequency;
+  if (frequency <= 0)
+    return;
+
+  std::cerr << "Execution time " << nCycles / frequency << " us at "
+            << frequency << " MHz." << std::endl;
 }
@@ -10,13 +10,24 @@
 
 #include "arch.h"
 
+#include "block-device.h"
+#include "clint.h"
+#include "dma-engine.h"
 #include "elf-file.h"
+#include "framebuffer.h"
+#include "idle-monitor.h"
+#include "machine-config.h"
+#include "ooo-core.h"
 #include "pipeline.h"
+#include "pipeline-trace.h"
+#include "serial.h"
 #include "sys-status.h"
+#include "syscall-proxy.h"
 
 class Processor {
 public:
-  Processor(ELFFile& program, bool pipelining, bool debugMode = false);
+  Processor(ELFFile& program, bool pipelining, bool debugMode = false,
+            const MachineConfig& config = MachineConfig{});
 
   Processor(const Processor&) = delete;
   Processor& operator=(const Processor&) = delete;
@@ -25,6 +36,20 @@ public:
   void initRegister(RegNumber regnum, RegValue value);
   RegValue getRegister(RegNumber regnum) const;
 
+  /* Write a pipeline trace in Kanata format to filename. */
+  void enableTrace(const std::string& filename, const TraceWindow& window);
+
+  /* Run program in Linux user mode: ecall is a system call and the
+   * program starts with args (the first being the program name) on the
+   * stack.
+   */
+  void enableSyscalls(const ELFFile& program,
+                      const std::vector<std::string>& args);
+
+  /* The exit status of a program in user mode, once it has exited. */
+  bool hasExited() const { return syscalls && syscalls->hasExited(); }
+  int getExitStatus() const { return syscalls->getExitStatus(); }
+
   /* Instruction execution steps */
   bool run(bool testMode = false);
 
@@ -33,23 +58,49 @@ public:
   void dumpStatistics() const;
 
 private:
+  MachineConfig config;
+
+  void dumpFetchStatistics() const;
+  void dumpVectorStatistics() const;
+  void dumpSyscallStatistics() const;
+  void dumpIdleStatistics() const;
+  void dumpBlockStatistics() const;
+  void dumpDMAStatistics() const;
+  void dumpFramebufferStatistics() const;
+  void dumpExecutionTime() const;
+
+  void fastForward();
+
   /* Statistics */
   uint64_t nCycles{};
+  uint64_t nCyclesSkipped{};
 
   /* Components shared by multiple stages or components. */
   RegisterFile regfile{};
+  FloatRegisterFile floatRegfile{};
+  FloatStatus fcsr{};
   InstructionDecoder decoder{};
 
   MemoryBus bus;
   InstructionMemory instructionMemory;
   DataMemory dataMemory;
+  VectorUnit vectorUnit;
 
   MemAddress PC{};
 
   Pipeline pipeline;
+  std::unique_ptr<OutOfOrderCore> oooCore{};
+  std::unique_ptr<PipelineTracer> tracer{};
+  std::unique_ptr<SyscallProxy> syscalls{};
+  std::unique_ptr<IdleMonitor> idleMonitor{};
 
   /* Memory bus clients */
   SysStatus* sysStatus{}; /* no ownership */
+  Serial* serial{};       /* no ownership */
+  CLINT* clint{};         /* no ownership, nullptr when disabled */
+  BlockDevice* block{};   /* no ownership, nullptr without an image */
+  DMAEngine* dma{};       /* no ownership, nullptr when disabled */
+  Framebuffer* framebuffer{}; /* no ownership, nullptr when absent */
 };
 
 #endif /* __PROCESSOR_H__ */
@@ -15,6 +15,7 @@
 #include <string>
 
 class Processor;
+class ExecuteStage;
 
 /* For now hard-coded for a single zero-register and
  * (NumRegs - 1) general-purpose registers.
@@ -52,6 +53,12 @@ public:
       writeRegister(RD, writeData);
   }
 
+  /* Compares the contents of the registers. */
+  bool hasSameContents(const RegisterFile& other) const
+  {
+    return registers == other.registers;
+  }
+
 private:
   std::array<RegValue, NumRegs - 1> registers{};
 
@@ -88,8 +95,89 @@ private:
     registers[regnum - 1] = value;
   }
 
-  /* to allow access to read/writeRegister */
+  /* to allow access to read/writeRegister, system calls read their
+   * arguments directly
+   */
   friend Processor;
+  friend ExecuteStage;
+};
+
+/* Floating-point registers of the F and D extensions, with a third read
+ * port for the fused multiply-add instructions. There is no zero
+ * register. Single-precision values are stored NaN-boxed.
+ */
+class FloatRegisterFile {
+public:
+  FloatRegisterFile() = default;
+
+  /*
+   * Input signals
+   */
+
+  void setRS1(const RegNumber newRS1) { RS1 = newRS1; };
+  void setRS2(const RegNumber newRS2) { RS2 = newRS2; };
+  void setRS3(const RegNumber newRS3) { RS3 = newRS3; };
+
+  void setRD(const RegNumber newRD) { RD = newRD; };
+  void setWriteData(const RegValue newData) { writeData = newData; }
+  void setWriteEnable(bool newEnable) { writeEnable = newEnable; }
+
+  /*
+   * Output signals
+   */
+
+  RegValue getReadData1() const { return readRegister(RS1); }
+
+  RegValue getReadData2() const { return readRegister(RS2); }
+
+  RegValue getReadData3() const { return readRegister(RS3); }
+
+  /*
+   * Clock signal
+   */
+
+  void clockPulse()
+  {
+    if (writeEnable)
+      writeRegister(RD, writeData);
+  }
+
+  /* Compares the contents of the registers. */
+  bool hasSameContents(const FloatRegisterFile& other) const
+  {
+    return registers == other.registers;
+  }
+
+private:
+  std::array<RegValue, NumFloatRegs> registers{};
+
+  RegNumber RS1{};
+  RegNumber RS2{};
+  RegNumber RS3{};
+
+  RegNumber RD{};
+  RegValue writeData{};
+  bool writeEnable = false;
+
+  void checkRegNumber(const RegNumber regnum) const
+  {
+    if (regnum >= NumFloatRegs) {
+      throw std::out_of_range("floating-point register number " +
+                              std::to_string(regnum) + " out of range.");
+    }
+  }
+
+  RegValue readRegister(const RegNumber regnum) const
+  {
+    checkRegNumber(regnum);
+    return registers[regnum];
+  }
+
+  void writeRegister(const RegNumber regnum, RegValue value)
+  {
+    checkRegNumber(regnum);
+    registers[regnum] = value;
+  }
 };
 
 #endif /* __REG_FILE_H__ */
@@ -0,0 +1,90 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    scoreboard.cc - Register scoreboard and functional unit latencies.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "scoreboard.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Scoreboard::Scoreboard(const FunctionalUnitConfig& config,
+                       unsigned memoryStages)
+    : loadForwardingLatency{1 + memoryStages}
+{
+  if (config.aluLatency < 1 || config.mulLatency < 1 ||
+      config.divLatency < 1 || config.fpLatency < 1 ||
+      config.fdivLatency < 1)
+    throw std::runtime_error("functional unit latencies must be at least 1");
+
+  /* The loaded value is available at the end of MEM at the earliest. */
+  if (config.loadLatency < 2)
+    throw std::runtime_error("load latency must be at least 2");
+
+  units[static_cast<size_t>(FunctionalUnit::ALU)] = {config.aluLatency,
+                                                     true, 0};
+  units[static_cast<size_t>(FunctionalUnit::Multiply)] = {
+      config.mulLatency, config.mulPipelined, 0};
+  units[static_cast<size_t>(FunctionalUnit::Divide)] = {
+      config.divLatency, config.divPipelined, 0};
+  units[static_cast<size_t>(FunctionalUnit::Load)] = {
+      config.loadLatency + memoryStages - 1, true, 0};
+  units[static_cast<size_t>(FunctionalUnit::FloatingPoint)] = {
+      config.fpLatency, true, 0};
+  units[static_cast<size_t>(FunctionalUnit::FloatDivide)] = {
+      config.fdivLatency, config.fdivPipelined, 0};
+}
+
+Hazard
+Scoreboard::check(FunctionalUnit unit, RegNumber rs1, bool usesRS1,
+                  RegNumber rs2, bool usesRS2, RegNumber rs3, bool usesRS3,
+                  RegNumber rd, bool regWrite) const
+{
+  if (usesRS1 && !isReady(rs1))
+    return classifyRAW(rs1);
+  if (usesRS2 && !isReady(rs2))
+    return classifyRAW(rs2);
+  if (usesRS3 && !isReady(rs3))
+    return classifyRAW(rs3);
+
+  /* Results have to be produced in program order, otherwise a consumer
+   * may observe the older value.
+   */
+  if (regWrite && rd != 0 &&
+      results[rd].readyCycle > cycle + getLatency(unit))
+    return Hazard::WAW;
+
+  if (units[static_cast<size_t>(unit)].busyUntil > cycle)
+    return Hazard::Structural;
+
+  return Hazard::None;
+}
+
+void
+Scoreboard::issue(FunctionalUnit unit, RegNumber rd, bool regWrite)
+{
+  Unit& u = units[static_cast<size_t>(unit)];
+
+  if (!u.pipelined)
+    u.busyUntil = cycle + u.latency;
+
+  if (regWrite && rd != 0)
+    results[rd] = {cycle + u.latency, cycle + forwardingLatency(unit), unit};
+
+  /* Write back follows the last memory stage; the unit may take longer. */
+  const unsigned completion = std::max(u.latency, loadForwardingLatency + 1);
+  drainedCycle = std::max(drainedCycle, cycle + completion);
+}
+
+Hazard
+Scoreboard::classifyRAW(RegNumber reg) const
+{
+  const Result& result = results[reg];
+
+  if (result.unit != FunctionalUnit::Load)
+    return Hazard::RAW;
+
+  return cycle < result.forwardCycle ? Hazard::LoadUse : Hazard::LoadLatency;
+}
@@ -0,0 +1,119 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    scoreboard.h - Register scoreboard and functional unit latencies.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SCOREBOARD_H__
+#define __SCOREBOARD_H__
+
+#include "arch.h"
+#include "machine-config.h"
+
+#include <array>
+
+enum class FunctionalUnit {
+  ALU,      /* also branches, jumps and stores */
+  Multiply,
+  Divide,
+  Load,
+  FloatingPoint, /* all floating-point operations but division and sqrt */
+  FloatDivide,
+  LAST
+};
+
+enum class Hazard {
+  None,
+  LoadUse,     /* waiting for a load result that is still in MEM */
+  LoadLatency, /* waiting for a load beyond the pipeline's load-use delay */
+  RAW,         /* waiting for the result of a multi-cycle unit */
+  WAW,         /* older write to rd would complete later */
+  Structural,  /* functional unit busy */
+  Serialize,   /* waiting for all older instructions to complete */
+  Wait         /* waiting for an interrupt after wfi */
+};
+
+/* The scoreboard tracks, per register, the cycle from which its result
+ * can be forwarded to an instruction that starts execution, and per
+ * functional unit the cycle from which it accepts a new instruction.
+ * Instructions are checked and issued from the decode stage: an
+ * instruction issued at cycle t by a unit with latency L makes its result
+ * available to an instruction that issues at cycle t + L.
+ *
+ * The scoreboard only determines timing, results are still computed
+ * in EX and forwarded by the pipeline. Latencies can therefore not be
+ * shorter than the pipeline itself provides (1 for the ALU, 1 plus the
+ * number of memory stages for loads).
+ */
+class Scoreboard {
+public:
+  /* With multiple memory stages, the load latency is extended by the
+   * additional stages.
+   */
+  Scoreboard(const FunctionalUnitConfig& config, unsigned memoryStages);
+
+  unsigned getLatency(FunctionalUnit unit) const
+  {
+    return units[static_cast<size_t>(unit)].latency;
+  }
+
+  /* Check whether an instruction can issue in the current cycle.
+   * Register numbers are those of the pipeline, which includes the
+   * floating-point registers.
+   */
+  Hazard check(FunctionalUnit unit, RegNumber rs1, bool usesRS1,
+               RegNumber rs2, bool usesRS2, RegNumber rs3, bool usesRS3,
+               RegNumber rd, bool regWrite) const;
+
+  /* Issue an instruction in the current cycle. */
+  void issue(FunctionalUnit unit, RegNumber rd, bool regWrite);
+
+  /* Whether all instructions issued before the current cycle have been
+   * written back, such that an instruction issued now observes their
+   * effects when it reaches EX.
+   */
+  bool isDrained() const { return drainedCycle <= cycle; }
+
+  /* Advance to the next cycle. */
+  void clockPulse() { ++cycle; }
+
+private:
+  struct Unit {
+    unsigned latency;
+    bool pipelined;
+    uint64_t busyUntil;
+  };
+
+  /* The pending result of a register. The cycle at which the pipeline
+   * itself could forward the result is kept to tell the load-use delay
+   * apart from additional (memory) latency.
+   */
+  struct Result {
+    uint64_t readyCycle;
+    uint64_t forwardCycle;
+    FunctionalUnit unit;
+  };
+
+  unsigned loadForwardingLatency;
+
+  uint64_t cycle{};
+  uint64_t drainedCycle{};
+  std::array<Result, NumPipelineRegs> results{};
+  std::array<Unit, static_cast<size_t>(FunctionalUnit::LAST)> units{};
+
+  bool isReady(RegNumber reg) const
+  {
+    return reg == 0 || results[reg].readyCycle <= cycle;
+  }
+
+  /* Latency at which the pipeline can forward a result. */
+  unsigned forwardingLatency(FunctionalUnit unit) const
+  {
+    return unit == FunctionalUnit::Load ? loadForwardingLatency : 1;
+  }
+
+  Hazard classifyRAW(RegNumber reg) const;
+};
+
+#endif /* __SCOREBOARD_H__ */
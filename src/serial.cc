@@ -1,15 +1,197 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    serial.cc - Dumb write-only serial interface.
+ *    serial.cc - Dumb serial interface.
  *
  * Copyright (C) 2016  Leiden University, The Netherlands.
  */
 
 #include "serial.h"
 
+#include <cerrno>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 
-Serial::Serial(const MemAddress base) : base{base} {}
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SerialBuffer::SerialBuffer(std::streambuf* sink) : sink{sink}
+{
+  setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+/* Called when the buffer is full. */
+SerialBuffer::int_type
+SerialBuffer::overflow(int_type ch)
+{
+  if (sync() != 0)
+    return traits_type::eof();
+
+  if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    sputc(traits_type::to_char_type(ch));
+  return traits_type::not_eof(ch);
+}
+
+/* The bytes are written to the stream buffer of the sink, rather than to
+ * its stream, as that stream may be tied to this buffer.
+ */
+int
+SerialBuffer::sync()
+{
+  const std::streamsize count = pptr() - pbase();
+  if (count == 0)
+    return 0;
+
+  const bool written = sink->sputn(pbase(), count) == count;
+  setp(buffer.data(), buffer.data() + buffer.size());
+  return written && sink->pubsync() == 0 ? 0 : -1;
+}
+
+/* The output goes to std::cerr, unless a file is configured; "-" is
+ * standard output.
+ */
+Serial::Serial(const MemAddress base, const SerialConfig& config)
+    : base{base}, flushInterval{config.flushInterval},
+      buffer{std::cerr.rdbuf()}, stream{&buffer}
+{
+  if (config.output == "-")
+    buffer.setSink(std::cout.rdbuf());
+  else if (!config.output.empty()) {
+    file.open(config.output, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw std::runtime_error("cannot open serial output file " +
+                               config.output);
+    buffer.setSink(file.rdbuf());
+  }
+
+  previousTie = std::cerr.tie(&stream);
+
+  if (config.input.empty())
+    inputEnded = true;
+  else
+    openInput(config.input);
+}
+
+Serial::~Serial()
+{
+  if (reader.joinable()) {
+    stopReader = true;
+    reader.join();
+  }
+#ifndef _MSC_VER
+  if (inputFile > STDIN_FILENO)
+    close(inputFile);
+#endif
+
+  std::cerr.tie(previousTie);
+  flush();
+}
+
+#ifndef _MSC_VER
+
+/* "-" is standard input. */
+void
+Serial::openInput(const std::string& filename)
+{
+  inputFile = filename == "-" ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+  if (inputFile < 0)
+    throw std::runtime_error("cannot open serial input file " + filename);
+
+  struct stat status;
+  awaitReader = fstat(inputFile, &status) == 0 && S_ISREG(status.st_mode);
+  reader = std::thread{&Serial::readInput, this};
+}
+
+/* Reader thread. The file is polled with a timeout, rather than read
+ * with a blocking read, so that the thread notices when the serial
+ * interface is destroyed. When the queue is full, the thread waits for
+ * the program to catch up.
+ */
+void
+Serial::readInput()
+{
+  using namespace std::chrono_literals;
+  constexpr int PollTimeout = 50; /* ms */
+
+  std::array<uint8_t, 4096> chunk{};
+
+  while (!stopReader) {
+    pollfd request{inputFile, POLLIN, 0};
+    if (poll(&request, 1, PollTimeout) <= 0)
+      continue;
+
+    const ssize_t count = read(inputFile, chunk.data(), chunk.size());
+    if (count < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (count <= 0)
+      break;
+
+    for (ssize_t i = 0; i < count;) {
+      if (input.push(chunk[i]))
+        ++i;
+      else if (stopReader)
+        return;
+      else
+        std::this_thread::sleep_for(1ms);
+    }
+  }
+
+  inputEnded = true;
+}
+
+#else
+
+void
+Serial::openInput(const std::string& filename)
+{
+  throw std::runtime_error("serial input is not supported on Windows");
+}
+
+void
+Serial::readInput()
+{
+}
+
+#endif /* _MSC_VER */
+
+/* The reader does not block on a regular file, so the next byte or the
+ * end of the input follows shortly.
+ */
+void
+Serial::awaitInput() const
+{
+  while (awaitReader && input.isEmpty() && !inputEnded)
+    std::this_thread::yield();
+}
+
+/* The input has ended once the reader has finished and its bytes have
+ * been read, so inputEnded is checked before the queue.
+ */
+uint8_t
+Serial::getStatus() const
+{
+  awaitInput();
+  const bool ended = inputEnded;
+  if (!input.isEmpty())
+    return RxReady;
+  return ended ? RxEnded : 0;
+}
+
+void
+Serial::clockPulse()
+{
+  if (flushInterval == 0 || buffer.isEmpty())
+    return;
+
+  if (++pendingCycles >= flushInterval) {
+    flush();
+    pendingCycles = 0;
+  }
+}
 
 /*
  * MemoryInterface
@@ -18,7 +200,15 @@ Serial::Serial(const MemAddress base) : base{base} {}
 uint8_t
 Serial::readByte(MemAddress addr)
 {
-  throw IllegalAccess("Not supported on serial interface");
+  if (addr == base + 1)
+    return getStatus();
+  if (addr != base)
+    throw IllegalAccess("Invalid address");
+
+  uint8_t value = 0;
+  awaitInput();
+  input.pop(value);
+  return value;
 }
 
 uint16_t
@@ -45,7 +235,11 @@ Serial::writeByte(MemAddress addr, uint8_t value)
   if (addr != base)
     throw IllegalAccess("Invalid address");
 
-  std::cerr << static_cast<char>(value);
+  stream.put(static_cast<char>(value));
+  if (value == '\n') {
+    flush();
+    pendingCycles = 0;
+  }
 }
 
 void
@@ -69,5 +263,5 @@ Serial::writeDoubleWord(MemAddress addr, uint64_t value)
 bool
 Serial::contains(MemAddress addr) const
 {
-  return base <= addr && addr < base + 1;
+  return base <= addr && addr < base + 2;
 }
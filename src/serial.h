@@ -1,6 +1,6 @@
 /* rv64-emu -- Simple 64-bit RISC-V simulator
  *
- *    serial.h - Dumb write-only serial interface.
+ *    serial.h - Dumb serial interface.
  *
  * Copyright (C) 2016  Leiden University, The Netherlands.
  */
@@ -8,14 +8,81 @@
 #ifndef __SERIAL_H__
 #define __SERIAL_H__
 
+#include "machine-config.h"
 #include "memory-interface.h"
+#include "spsc-queue.h"
 
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
+/* Buffer of the bytes written to the serial interface, that are written
+ * to the host in blocks. It is a stream buffer, such that the stream of
+ * the emulator's diagnostics can be tied to it.
+ */
+class SerialBuffer : public std::streambuf {
+public:
+  static constexpr size_t Size = 4096;
+
+  explicit SerialBuffer(std::streambuf* sink);
+
+  SerialBuffer(const SerialBuffer&) = delete;
+  SerialBuffer& operator=(const SerialBuffer&) = delete;
+
+  void setSink(std::streambuf* newSink) { sink = newSink; }
+  bool isEmpty() const { return pptr() == pbase(); }
+
+protected:
+  int_type overflow(int_type ch) override;
+  int sync() override;
+
+private:
+  std::streambuf* sink;
+  std::array<char, Size> buffer{};
+};
+
+/* The serial interface has two byte registers:
+ *
+ *   base + 0: data; a write transmits a byte, a read returns the next
+ *             received byte, or 0 when there is none.
+ *   base + 1: status (read-only), see the Status bits.
+ *
+ * Output is buffered and written to the host on a newline, when the
+ * buffer is full, when the output has been pending for the configured
+ * number of bus cycles and on halt. The emulator's diagnostics on
+ * std::cerr flush the buffer first, so these appear in order with the
+ * output of the program.
+ *
+ * Input is read from the configured host file by a reader thread, which
+ * passes the bytes to the simulation through a lock-free queue. The
+ * simulation therefore never waits for a terminal or pipe: a program polls
+ * the status register until a byte has been received. The reader is only
+ * awaited for a regular file, such that a run does not depend on the
+ * timing of the host.
+ */
 class Serial : public MemoryInterface {
 public:
-  Serial(const MemAddress base);
-  ~Serial() override = default;
+  enum Status : uint8_t {
+    RxReady = 1 << 0, /* a byte can be read from the data register */
+    RxEnded = 1 << 1  /* all input has been read */
+  };
+
+  static constexpr size_t InputQueueSize = 64 << 10;
+
+  Serial(const MemAddress base, const SerialConfig& config = SerialConfig{});
+  ~Serial() override;
+
+  Serial(const Serial&) = delete;
+  Serial& operator=(const Serial&) = delete;
+
+  void flush() { stream.flush(); }
 
   /* MemoryInterface */
+  void clockPulse() override;
+
   uint8_t readByte(MemAddress addr) override;
   uint16_t readHalfWord(MemAddress addr) override;
   uint32_t readWord(MemAddress addr) override;
@@ -30,6 +97,25 @@ public:
 
 private:
   const MemAddress base;
+  const unsigned flushInterval;
+  unsigned pendingCycles{};
+
+  std::ofstream file{};
+  SerialBuffer buffer;
+  std::ostream stream;
+  std::ostream* previousTie{};
+
+  SPSCQueue<uint8_t, InputQueueSize> input{};
+  int inputFile{-1};
+  std::atomic<bool> inputEnded{false};
+  std::atomic<bool> stopReader{false};
+  std::thread reader{};
+  bool awaitReader{}; /* the input is a regular file */
+
+  void openInput(const std::string& filename);
+  void readInput();
+  void awaitInput() const;
+  uint8_t getStatus() const;
 };
 
 #endif /* __SERIAL_H__ */
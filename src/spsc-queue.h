@@ -0,0 +1,65 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    spsc-queue.h - Lock-free queue between two threads.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* A bounded queue with a single producer thread and a single consumer
+ * thread. Each index is only written by one of the threads: the producer
+ * publishes an element by advancing tail, the consumer releases its slot
+ * by advancing head. The indices increase monotonically and are reduced
+ * modulo the capacity, which must be a power of two.
+ */
+template <typename T, size_t Capacity> class SPSCQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+
+public:
+  /* Producer; returns false when the queue is full. */
+  bool push(const T& value)
+  {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity)
+      return false;
+
+    slots[t % Capacity] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer; returns false when the queue is empty. */
+  bool pop(T& value)
+  {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+
+    value = slots[h % Capacity];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer */
+  bool isEmpty() const
+  {
+    return head.load(std::memory_order_relaxed) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<T, Capacity> slots{};
+
+  /* On separate cache lines, as each is written by a different thread. */
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif /* __SPSC_QUEUE_H__ */
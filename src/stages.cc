@@ -6,27 +6,50 @@
  */
 
 #include "stages.h"
+#include "frontend.h"
+#include "idle-monitor.h"
+#include "instruction-table.h"
+#include "syscall-proxy.h"
 
 #include <iostream>
+#include <iterator>
 
 namespace {
 
-bool
-instructionUsesRS2(Opcode opcode)
+/* Number of a register within the pipeline, see FloatRegBase. */
+RegNumber
+pipelineRegister(RegNumber reg, bool isFloat)
 {
-  switch (opcode) {
-  case Opcode::OP:
-  case Opcode::OP_32:
-  case Opcode::STORE:
-  case Opcode::BRANCH:
-    return true;
-  default:
-    return false;
-  }
+  return isFloat ? FloatRegBase + reg : reg;
 }
 
 } // namespace
 
+const char*
+cycleCategoryName(CycleCategory category)
+{
+  switch (category) {
+  case CycleCategory::Retiring:
+    return "retiring";
+  case CycleCategory::Frontend:
+    return "frontend";
+  case CycleCategory::BadSpeculation:
+    return "bad speculation";
+  case CycleCategory::LoadUse:
+    return "load-use";
+  case CycleCategory::Memory:
+    return "memory";
+  case CycleCategory::Dependency:
+    return "dependency";
+  case CycleCategory::Structural:
+    return "structural";
+  case CycleCategory::Idle:
+    return "idle";
+  default:
+    return "unknown";
+  }
+}
+
 /*
  * Control Signals
  */
@@ -34,10 +57,6 @@ instructionUsesRS2(Opcode opcode)
 void
 ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
 {
-  Opcode opcode = decoder.getOpcode();
-  uint8_t funct3 = decoder.getFunct3();
-  uint8_t funct7 = decoder.getFunct7();
-
   /* Default values */
   regWrite = false;
   aluSrc = false;
@@ -49,169 +68,92 @@ ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
   aluOp = ALUOp::NOP;
   memSize = 0;
   memSignExtend = false;
+  unit = FunctionalUnit::ALU;
+  atomicOp = AtomicOp::None;
+  fpuOp = FPUOp::NOP;
+  floatDouble = false;
+  usesRS1 = false;
+  usesRS2 = false;
+  usesRS3 = false;
+  floatRS1 = false;
+  floatRS2 = false;
+  floatRD = false;
+  csrOp = CSROp::None;
+  systemOp = SystemOp::None;
+  illegal = false;
+  vector = VectorInstruction{};
+
+  /* Unknown encodings otherwise leave all as defaults (no-op) */
+  const InstructionInfo* info = lookupInstruction(decoder);
+  if (!info) {
+    illegal = true;
+    return;
+  }
 
-  switch (opcode) {
-  case Opcode::OP: /* R-type ALU */
-    regWrite = true;
-    aluSrc = false;
-    if (funct3 == 0x0 && funct7 == 0x00)
-      aluOp = ALUOp::ADD;
-    else if (funct3 == 0x0 && funct7 == 0x20)
-      aluOp = ALUOp::SUB;
-    else if (funct3 == 0x1 && funct7 == 0x00)
-      aluOp = ALUOp::SLL;
-    else if (funct3 == 0x2 && funct7 == 0x00)
-      aluOp = ALUOp::SLT;
-    else if (funct3 == 0x3 && funct7 == 0x00)
-      aluOp = ALUOp::SLTU;
-    else if (funct3 == 0x4 && funct7 == 0x00)
-      aluOp = ALUOp::XOR;
-    else if (funct3 == 0x5 && funct7 == 0x00)
-      aluOp = ALUOp::SRL;
-    else if (funct3 == 0x5 && funct7 == 0x20)
-      aluOp = ALUOp::SRA;
-    else if (funct3 == 0x6 && funct7 == 0x00)
-      aluOp = ALUOp::OR;
-    else if (funct3 == 0x7 && funct7 == 0x00)
-      aluOp = ALUOp::AND;
-    break;
-
-  case Opcode::OP_IMM: /* I-type ALU */
-    regWrite = true;
-    aluSrc = true;
-    if (funct3 == 0x0)
-      aluOp = ALUOp::ADD;
-    else if (funct3 == 0x2)
-      aluOp = ALUOp::SLT;
-    else if (funct3 == 0x3)
-      aluOp = ALUOp::SLTU;
-    else if (funct3 == 0x4)
-      aluOp = ALUOp::XOR;
-    else if (funct3 == 0x6)
-      aluOp = ALUOp::OR;
-    else if (funct3 == 0x7)
-      aluOp = ALUOp::AND;
-    else if (funct3 == 0x1 && funct7 == 0x00)
-      aluOp = ALUOp::SLL;
-    else if (funct3 == 0x5 && funct7 == 0x00)
-      aluOp = ALUOp::SRL;
-    else if (funct3 == 0x5 && funct7 == 0x20)
-      aluOp = ALUOp::SRA;
-    break;
-
-  case Opcode::OP_32: /* R-type 32-bit */
-    regWrite = true;
-    aluSrc = false;
-    if (funct3 == 0x0 && funct7 == 0x00)
-      aluOp = ALUOp::ADDW;
-    else if (funct3 == 0x0 && funct7 == 0x20)
-      aluOp = ALUOp::SUBW;
-    else if (funct3 == 0x1 && funct7 == 0x00)
-      aluOp = ALUOp::SLLW;
-    else if (funct3 == 0x5 && funct7 == 0x00)
-      aluOp = ALUOp::SRLW;
-    else if (funct3 == 0x5 && funct7 == 0x20)
-      aluOp = ALUOp::SRAW;
-    break;
-
-  case Opcode::OP_IMM_32: /* I-type 32-bit */
-    regWrite = true;
-    aluSrc = true;
-    if (funct3 == 0x0)
-      aluOp = ALUOp::ADDW;
-    else if (funct3 == 0x1 && funct7 == 0x00)
-      aluOp = ALUOp::SLLW;
-    else if (funct3 == 0x5 && funct7 == 0x00)
-      aluOp = ALUOp::SRLW;
-    else if (funct3 == 0x5 && funct7 == 0x20)
-      aluOp = ALUOp::SRAW;
-    break;
-
-  case Opcode::LOAD:
-    regWrite = true;
-    aluSrc = true;
-    memRead = true;
-    memToReg = true;
-    aluOp = ALUOp::ADD;
-    if (funct3 == 0x0) {
-      memSize = 1;
-      memSignExtend = true;
-    } /* lb */
-    else if (funct3 == 0x1) {
-      memSize = 2;
-      memSignExtend = true;
-    } /* lh */
-    else if (funct3 == 0x2) {
-      memSize = 4;
-      memSignExtend = true;
-    } /* lw */
-    else if (funct3 == 0x3) {
-      memSize = 8;
-      memSignExtend = false;
-    } /* ld */
-    else if (funct3 == 0x4) {
-      memSize = 1;
-      memSignExtend = false;
-    } /* lbu */
-    else if (funct3 == 0x5) {
-      memSize = 2;
-      memSignExtend = false;
-    } /* lhu */
-    else if (funct3 == 0x6) {
-      memSize = 4;
-      memSignExtend = false;
-    } /* lwu */
-    break;
-
-  case Opcode::STORE:
-    aluSrc = true;
-    memWrite = true;
-    aluOp = ALUOp::ADD;
-    if (funct3 == 0x0)
-      memSize = 1; /* sb */
-    else if (funct3 == 0x1)
-      memSize = 2; /* sh */
-    else if (funct3 == 0x2)
-      memSize = 4; /* sw */
-    else if (funct3 == 0x3)
-      memSize = 8; /* sd */
-    break;
-
-  case Opcode::BRANCH:
-    branch = true;
-    aluSrc = false;
-    aluOp = ALUOp::SUB;
-    break;
-
-  case Opcode::JAL:
-    regWrite = true;
-    jump = true;
-    aluOp = ALUOp::ADD;
-    aluSrc = true;
-    break;
-
-  case Opcode::JALR:
-    regWrite = true;
-    jump = true;
-    aluOp = ALUOp::ADD;
-    aluSrc = true;
-    break;
-
-  case Opcode::LUI:
-    regWrite = true;
-    aluSrc = true;
-    aluOp = ALUOp::ADD; /* Will load immediate into rd */
-    break;
-
-  case Opcode::AUIPC:
-    regWrite = true;
-    aluSrc = true;
-    aluOp = ALUOp::ADD; /* Add immediate to PC */
-    break;
+  if (info->vectorOp != VectorOp::None) {
+    setVectorFromInstruction(decoder, *info);
+    return;
+  }
 
-  default:
-    /* Leave all as defaults (no-op) */
-    break;
+  regWrite = info->has(InstRegWrite);
+  aluSrc = info->has(InstALUSrc);
+  memRead = info->has(InstMemRead);
+  memWrite = info->has(InstMemWrite);
+  memToReg = info->has(InstMemToReg);
+  branch = info->has(InstBranch);
+  jump = info->has(InstJump);
+  aluOp = info->aluOp;
+  memSize = info->memSize;
+  memSignExtend = info->has(InstSignExtend);
+  unit = info->unit;
+  atomicOp = info->atomicOp;
+  fpuOp = info->fpuOp;
+  floatDouble = info->has(InstDouble);
+  usesRS1 = info->has(InstUsesRS1);
+  usesRS2 = info->has(InstUsesRS2);
+  usesRS3 = info->has(InstUsesRS3);
+  floatRS1 = info->has(InstFloatRS1);
+  floatRS2 = info->has(InstFloatRS2);
+  floatRD = info->has(InstFloatRD);
+  csrOp = info->csrOp;
+  systemOp = info->systemOp;
+}
+
+/* V extension. Vector instructions are executed by the vector unit in
+ * MEM, only their scalar operands and results pass through the pipeline.
+ * A scalar result is written back like loaded data.
+ */
+void
+ControlSignals::setVectorFromInstruction(const InstructionDecoder& decoder,
+                                         const InstructionInfo& info)
+{
+  const RegNumber rs1 = decoder.getRS1();
+
+  vector.op = info.vectorOp;
+  vector.source = info.has(InstUsesRS1)  ? VectorSource::Scalar
+                  : info.has(InstALUSrc) ? VectorSource::Immediate
+                                         : VectorSource::Vector;
+  vector.vd = decoder.getRD();
+  vector.vs1 = rs1;
+  vector.vs2 = decoder.getRS2();
+  vector.eew = info.memSize;
+  vector.strided =
+      info.format == InstructionFormat::VectorAccess && info.has(InstUsesRS2);
+  vector.masked = info.has(InstVectorMask) && !(decoder.getFunct7() & 0x1);
+
+  /* The vtype of vsetvli and vsetivli, otherwise simm5 in rs1. */
+  if (info.format == InstructionFormat::VectorConfig)
+    vector.immediate = (decoder.getInstructionWord() >> 20) &
+                       (info.has(InstALUSrc) ? 0x3FF : 0x7FF);
+  else if (info.has(InstALUSrc))
+    vector.immediate = (static_cast<int64_t>(rs1) ^ 0x10) - 0x10;
+
+  regWrite = info.has(InstRegWrite);
+  usesRS1 = info.has(InstUsesRS1);
+  usesRS2 = info.has(InstUsesRS2);
+  if (regWrite) {
+    memToReg = true;
+    unit = FunctionalUnit::Load;
   }
 }
 
@@ -219,9 +161,26 @@ ControlSignals::setFromInstruction(const InstructionDecoder& decoder)
  * Instruction fetch
  */
 
+uint32_t
+readInstruction(InstructionMemory& instructionMemory, MemAddress addr)
+{
+  instructionMemory.setSize(2);
+  instructionMemory.setAddress(addr);
+  uint32_t instructionWord = instructionMemory.getValue();
+
+  if (!isCompressedInstruction(instructionWord)) {
+    instructionMemory.setAddress(addr + 2);
+    instructionWord |= static_cast<uint32_t>(instructionMemory.getValue())
+                       << 16;
+  }
+
+  return instructionWord;
+}
+
 void
 InstructionFetchStage::propagate()
 {
+  fetchFailed = false;
   if (endMarkerSeen) {
     fetchPC = PC;
     fetchedInstruction = NopInstruction;
@@ -230,20 +189,16 @@ InstructionFetchStage::propagate()
 
   try {
     /* Fetch instruction from memory at current PC */
-    instructionMemory.setAddress(PC);
-    instructionMemory.setSize(4); /* Instructions are 32 bits (4 bytes) */
-
-    uint32_t instructionWord = instructionMemory.getValue();
+    uint32_t instructionWord = readInstruction(instructionMemory, PC);
 
     /* Check for test end marker */
     if (instructionWord == TestEndMarker) {
       if (pipelining) {
         endMarkerSeen = true;
-        endMarkerCountdown = 5; /* drain remaining pipeline stages */
+        endMarkerCountdown = drainCycles;
         endMarkerPC = PC;
         fetchPC = PC;
         fetchedInstruction = NopInstruction;
-        control.flushFetch = true;
         return;
       }
       throw TestEndMarkerEncountered(PC);
@@ -254,17 +209,26 @@ InstructionFetchStage::propagate()
   } catch (TestEndMarkerEncountered& e) {
     throw;
   } catch (std::exception& e) {
-    throw InstructionFetchFailure(PC);
+    /* In pipelined mode, fetch may run ahead on the wrong path. */
+    if (!pipelining)
+      throw InstructionFetchFailure(PC);
+
+    fetchPC = PC;
+    fetchedInstruction = NopInstruction;
+    fetchFailed = true;
   }
 }
 
 void
 InstructionFetchStage::clockPulse()
 {
+  const unsigned length = isCompressedInstruction(fetchedInstruction) ? 2 : 4;
+
   if (!pipelining) {
     if_id.PC = PC;
     if_id.instructionWord = fetchedInstruction;
-    PC += 4;
+    countFetch(fetchedInstruction);
+    PC += length;
 
     if (endMarkerSeen && endMarkerCountdown <= 0)
       throw TestEndMarkerEncountered(endMarkerPC);
@@ -276,12 +240,24 @@ InstructionFetchStage::clockPulse()
   bool stall = control.stallFetch;
 
   if (flush) {
+    if_id.seq = 0;
     if_id.PC = 0;
     if_id.instructionWord = NopInstruction;
-  } else if (!stall && !endMarkerSeen) {
+    if_id.fetchFailed = false;
+    ++fetchSeq; /* the instruction in IF is squashed */
+  } else if (stall) {
+    /* Keep the instruction in IF. */
+  } else if (endMarkerSeen) {
+    /* Nothing is fetched beyond the end marker. */
+    if_id = {};
+  } else {
+    if_id.seq = fetchSeq++;
     if_id.PC = fetchPC;
+    if_id.predictedPC = fetchPC + length;
     if_id.instructionWord = fetchedInstruction;
-    PC += 4;
+    if_id.fetchFailed = fetchFailed;
+    countFetch(fetchedInstruction);
+    PC += length;
   }
 
   if (endMarkerSeen) {
@@ -293,6 +269,13 @@ InstructionFetchStage::clockPulse()
   }
 }
 
+void
+InstructionFetchStage::getInFlight(std::vector<FrontendSlot>& slots) const
+{
+  if (!endMarkerSeen)
+    slots.push_back({fetchSeq, PC, false});
+}
+
 /*
  * Instruction decode
  */
@@ -303,8 +286,11 @@ void dump_instruction(std::ostream& os, const uint32_t instructionWord,
 void
 InstructionDecodeStage::propagate()
 {
+  seq = if_id.seq;
   PC = if_id.PC;
+  predictedPC = if_id.predictedPC;
   instructionWord = if_id.instructionWord;
+  fetchFailed = if_id.fetchFailed;
 
   /* Decode the instruction */
   decoder.setInstructionWord(instructionWord);
@@ -332,10 +318,33 @@ InstructionDecodeStage::propagate()
   /* Register fetch: read from register file */
   regfile.setRS1(decoder.getRS1());
   regfile.setRS2(decoder.getRS2());
+  floatRegfile.setRS1(decoder.getRS1());
+  floatRegfile.setRS2(decoder.getRS2());
+  floatRegfile.setRS3(decoder.getRS3());
 
   /* Get register values (combinational, so can read immediately) */
-  readData1 = regfile.getReadData1();
-  readData2 = regfile.getReadData2();
+  readData1 = decodedControl.getFloatRS1() ? floatRegfile.getReadData1()
+                                           : regfile.getReadData1();
+  readData2 = decodedControl.getFloatRS2() ? floatRegfile.getReadData2()
+                                           : regfile.getReadData2();
+  readData3 = floatRegfile.getReadData3();
+
+  rd = pipelineRegister(decoder.getRD(), decodedControl.getFloatRD());
+  rs1 = pipelineRegister(decoder.getRS1(), decodedControl.getFloatRS1());
+  rs2 = pipelineRegister(decoder.getRS2(), decodedControl.getFloatRS2());
+  rs3 = pipelineRegister(decoder.getRS3(), true);
+
+  /* In Linux user mode, ecall returns the result of the system call in
+   * a0.
+   */
+  const bool systemCall =
+      syscalls && decodedControl.getSystemOp() == SystemOp::ECall;
+  if (systemCall) {
+    decodedControl.setSystemCall();
+    rd = SyscallProxy::FirstArgument;
+  }
+
+  hazard = Hazard::None;
 
   if (pipelining) {
     /* Forward results that are about to be written back so decode sees
@@ -345,25 +354,39 @@ InstructionDecodeStage::propagate()
       RegValue wbValue =
           m_wb.control.getMemToReg() ? m_wb.memData : m_wb.aluResult;
 
-      if (m_wb.rd == decoder.getRS1())
+      if (m_wb.rd == rs1)
         readData1 = wbValue;
 
-      if (instructionUsesRS2(decoder.getOpcode()) &&
-          m_wb.rd == decoder.getRS2())
+      if (decodedControl.getUsesRS2() && m_wb.rd == rs2)
         readData2 = wbValue;
-    }
-
-    bool hazard = false;
 
-    if (id_ex.control.getMemRead() && id_ex.rd != 0) {
-      if (id_ex.rd == decoder.getRS1())
-        hazard = true;
-      else if (instructionUsesRS2(decoder.getOpcode()) &&
-               id_ex.rd == decoder.getRS2())
-        hazard = true;
+      if (decodedControl.getUsesRS3() && m_wb.rd == rs3)
+        readData3 = wbValue;
     }
 
-    if (hazard) {
+    /* Hold the instruction in ID until its operands can be forwarded
+     * and its functional unit is available. After wfi, nothing issues
+     * until an interrupt wakes the processor.
+     */
+    if (csrFile.isWaiting())
+      hazard = Hazard::Wait;
+    else
+      hazard = scoreboard.check(
+          decodedControl.getUnit(), rs1, decodedControl.getUsesRS1(), rs2,
+          decodedControl.getUsesRS2(), rs3, decodedControl.getUsesRS3(), rd,
+          decodedControl.getRegWrite());
+
+    /* CSR instructions access state that is updated by instructions in
+     * any stage, such as the counters, fflags and vl. They issue once all
+     * older instructions have completed. So do system calls, which read
+     * their arguments in EX and may access any memory.
+     */
+    if (hazard == Hazard::None &&
+        (decodedControl.getCSROp() != CSROp::None || systemCall) &&
+        !scoreboard.isDrained())
+      hazard = Hazard::Serialize;
+
+    if (hazard != Hazard::None) {
       control.stallFetch = true;
       control.insertDecodeBubble = true;
     }
@@ -374,6 +397,8 @@ void
 InstructionDecodeStage::clockPulse()
 {
   if (pipelining) {
+    accountCycle();
+
     if (control.flushDecode) {
       id_ex = {};
       id_ex.control = ControlSignals();
@@ -392,23 +417,84 @@ InstructionDecodeStage::clockPulse()
     }
   }
 
+  /* A failed fetch is only an error on the correct path. Older
+   * instructions that redirect fetch are in EX or have completed, and
+   * would have flushed decode.
+   */
+  if (fetchFailed)
+    throw InstructionFetchFailure(PC);
+
   /* ignore the "instruction" in the first cycle. */
   if (!pipelining || (pipelining && PC != 0x0))
     ++nInstrIssued;
 
+  if (pipelining)
+    scoreboard.issue(decodedControl.getUnit(), rd,
+                     decodedControl.getRegWrite());
+
+  /* The wait starts when wfi issues, so that no younger instruction
+   * follows it into EX. An interrupt taken on the wfi wakes it up as well.
+   */
+  if (decodedControl.getSystemOp() == SystemOp::WFI)
+    csrFile.waitForInterrupt();
+
   /* Write to pipeline register */
+  id_ex.seq = seq;
   id_ex.PC = PC;
+  id_ex.predictedPC = predictedPC;
   id_ex.readData1 = readData1;
   id_ex.readData2 = readData2;
-  id_ex.immediate = decoder.getImmediate();
-  id_ex.rd = decoder.getRD();
-  id_ex.rs1 = decoder.getRS1();
-  id_ex.rs2 = decoder.getRS2();
+  id_ex.readData3 = readData3;
+  /* The immediate format of unknown opcodes is not known. */
+  id_ex.immediate = decodedControl.getIllegal() ? 0 : decoder.getImmediate();
+  id_ex.rd = rd;
+  id_ex.rs1 = rs1;
+  id_ex.rs2 = rs2;
+  id_ex.rs3 = rs3;
   id_ex.opcode = decoder.getOpcode();
   id_ex.funct3 = decoder.getFunct3();
+  id_ex.length = decoder.getLength();
   id_ex.control = decodedControl;
 }
 
+void
+InstructionDecodeStage::accountCycle()
+{
+  CycleCategory category = CycleCategory::Retiring;
+
+  /* A flush of the fetch stages shows up as empty slots in ID in the
+   * following cycles.
+   */
+  if (control.flushDecode || (PC == 0x0 && squashCycles > 0))
+    category = CycleCategory::BadSpeculation;
+  else if (control.insertDecodeBubble) {
+    switch (hazard) {
+    case Hazard::LoadUse:
+      category = CycleCategory::LoadUse;
+      break;
+    case Hazard::LoadLatency:
+      category = CycleCategory::Memory;
+      break;
+    case Hazard::RAW:
+      category = CycleCategory::Dependency;
+      break;
+    case Hazard::Wait:
+      category = CycleCategory::Idle;
+      break;
+    default:
+      category = CycleCategory::Structural;
+      break;
+    }
+  } else if (PC == 0x0)
+    category = CycleCategory::Frontend;
+
+  if (control.flushDecode)
+    squashCycles = fetchStages;
+  else if (squashCycles > 0)
+    --squashCycles;
+  ++cycles[static_cast<size_t>(category)];
+}
+
 /*
  * Execute
  */
@@ -416,36 +502,28 @@ InstructionDecodeStage::clockPulse()
 void
 ExecuteStage::propagate()
 {
+  seq = id_ex.seq;
   PC = id_ex.PC;
 
   pcWriteEnable = false;
   nextPC = 0;
 
+  /* Interrupts are taken on the instruction in EX, which is not executed.
+   * Bubbles are not interrupted.
+   */
+  trapCause = 0;
+  trapReason = {};
+  if ((!pipelining || id_ex.seq != 0) && csrFile.hasTrapHandler())
+    trapCause = csrFile.getPendingInterrupt();
+
   RegValue rs1Value = id_ex.readData1;
   RegValue rs2Value = id_ex.readData2;
+  RegValue rs3Value = id_ex.readData3;
 
   if (pipelining) {
-    bool exStageCanForward = ex_m.control.getRegWrite() &&
-                             !ex_m.control.getMemToReg() && ex_m.rd != 0;
-
-    if (exStageCanForward && ex_m.rd == id_ex.rs1)
-      rs1Value = ex_m.aluResult;
-
-    if (exStageCanForward && ex_m.rd == id_ex.rs2)
-      rs2Value = ex_m.aluResult;
-
-    if (prev_m_wb.control.getRegWrite() && prev_m_wb.rd != 0) {
-      RegValue wbValue = prev_m_wb.control.getMemToReg() ? prev_m_wb.memData
-                                                         : prev_m_wb.aluResult;
-
-      if (prev_m_wb.rd == id_ex.rs1 &&
-          (!exStageCanForward || ex_m.rd != id_ex.rs1))
-        rs1Value = wbValue;
-
-      if (prev_m_wb.rd == id_ex.rs2 &&
-          (!exStageCanForward || ex_m.rd != id_ex.rs2))
-        rs2Value = wbValue;
-    }
+    rs1Value = forward(id_ex.rs1, rs1Value);
+    rs2Value = forward(id_ex.rs2, rs2Value);
+    rs3Value = forward(id_ex.rs3, rs3Value);
   }
 
   /* Select ALU operands */
@@ -470,6 +548,59 @@ ExecuteStage::propagate()
     aluResult = static_cast<RegValue>(
         computePCRelativeTarget(id_ex.PC, id_ex.immediate));
 
+  /* Floating-point operations take the place of the ALU result. */
+  floatFlags = 0;
+  const RoundingMode roundingMode = getRoundingMode(id_ex.funct3);
+  if (id_ex.control.getFPUOp() != FPUOp::NOP &&
+      roundingMode > RoundingMode::RMM)
+    raiseException(TrapIllegalInstruction, "Invalid rounding mode");
+  else if (id_ex.control.getFPUOp() != FPUOp::NOP) {
+    fpu.setA(rs1Value);
+    fpu.setB(rs2Value);
+    fpu.setC(rs3Value);
+    fpu.setOp(id_ex.control.getFPUOp());
+    fpu.setDouble(id_ex.control.getFloatDouble());
+    fpu.setRoundingMode(roundingMode);
+
+    aluResult = fpu.getResult();
+    floatFlags = fpu.getFlags();
+  }
+
+  /* The result of a CSR instruction is the old value of the CSR. This is
+   * not read by csrrw with rd x0; csrrs and csrrc do not write when the
+   * rs1 field is 0.
+   */
+  csrWrite = false;
+  const CSROp csrOp = id_ex.control.getCSROp();
+  if (csrOp != CSROp::None) {
+    csr = id_ex.immediate & 0xFFF;
+    const RegValue operand = (id_ex.funct3 & 0x4) ? id_ex.rs1 : rs1Value;
+    csrWrite = csrOp == CSROp::ReadWrite || id_ex.rs1 != 0;
+    if (!csrFile.isSupported(csr))
+      raiseException(TrapIllegalInstruction, "Unsupported CSR");
+    else if (csrWrite && !csrFile.isWritable(csr))
+      raiseException(TrapIllegalInstruction, "Write to read-only CSR");
+    else {
+      if (csrOp != CSROp::ReadWrite || id_ex.rd != 0)
+        aluResult = csrFile.read(csr);
+      csrValue = CSRFile::apply(csrOp, aluResult, operand);
+    }
+  }
+
+  if (id_ex.control.getIllegal())
+    raiseException(TrapIllegalInstruction, "Illegal instruction");
+  else if (id_ex.control.getSystemOp() == SystemOp::ECall && syscalls) {
+    if (trapCause == 0)
+      aluResult = systemCall();
+  } else if (id_ex.control.getSystemOp() == SystemOp::ECall)
+    raiseException(TrapMachineECall, "Environment call");
+  else if (id_ex.control.getSystemOp() == SystemOp::EBreak)
+    raiseException(TrapBreakpoint, "Breakpoint");
+
+  /* Vector instructions take their scalar operands along to MEM. */
+  if (id_ex.control.getVector().op != VectorOp::None)
+    aluResult = rs1Value;
+
   if (id_ex.control.getBranch()) {
     if (evaluateBranch(id_ex.funct3, rs1Value, rs2Value)) {
       nextPC = computePCRelativeTarget(id_ex.PC, id_ex.immediate);
@@ -477,8 +608,10 @@ ExecuteStage::propagate()
     }
   }
 
+  const MemAddress fallThroughPC = id_ex.PC + id_ex.length;
+
   if (id_ex.control.getJump()) {
-    RegValue returnAddress = id_ex.PC + 4;
+    RegValue returnAddress = fallThroughPC;
     aluResult = returnAddress;
 
     if (id_ex.opcode == Opcode::JAL)
@@ -489,7 +622,7 @@ ExecuteStage::propagate()
       nextPC = static_cast<MemAddress>(static_cast<uint64_t>(rawTarget) &
                                        ~static_cast<uint64_t>(1));
     } else
-      nextPC = id_ex.PC + 4;
+      nextPC = fallThroughPC;
 
     pcWriteEnable = true;
   }
@@ -499,7 +632,47 @@ ExecuteStage::propagate()
   nextRD = id_ex.rd;
   nextControl = id_ex.control;
 
-  if (pcWriteEnable) {
+  isControlTransfer = id_ex.control.getBranch() || id_ex.control.getJump();
+  isConditional = id_ex.control.getBranch();
+  actualNextPC = pcWriteEnable ? nextPC : fallThroughPC;
+  taken = actualNextPC != fallThroughPC;
+
+  trapReturn =
+      trapCause == 0 && id_ex.control.getSystemOp() == SystemOp::MRet;
+  if (trapReturn)
+    actualNextPC = csrFile.getReturnAddress();
+
+  /* A trap squashes the instruction and continues at the trap handler.
+   * Without a handler, the simulation ends.
+   */
+  if (trapCause != 0) {
+    if (!csrFile.hasTrapHandler())
+      throw IllegalInstruction(std::string{trapReason});
+
+    actualNextPC = csrFile.getTrapVector(trapCause);
+    nextRD = 0;
+    nextControl = ControlSignals();
+    floatFlags = 0;
+    csrWrite = false;
+    isControlTransfer = false;
+  }
+
+  /* Loops are recognized by their taken backward branch or jump; returns
+   * (jalr) are not loop backs.
+   */
+  isLoopBack = trapCause == 0 && isControlTransfer && taken &&
+               actualNextPC <= id_ex.PC && id_ex.opcode != Opcode::JALR;
+
+  /* Younger instructions are flushed when fetch did not continue at the
+   * address the instruction resolved to, and on traps.
+   */
+  if (pipelining)
+    redirect = id_ex.seq != 0 &&
+               (trapCause != 0 || actualNextPC != id_ex.predictedPC);
+  else
+    redirect = pcWriteEnable || trapCause != 0 || trapReturn;
+
+  if (redirect) {
     control.flushFetch = true;
     control.flushDecode = true;
   }
@@ -508,17 +681,99 @@ ExecuteStage::propagate()
 void
 ExecuteStage::clockPulse()
 {
-  /* Write to pipeline register */
-  ex_m.PC = PC;
+  fcsr.flags |= floatFlags;
+  if (csrWrite)
+    csrFile.write(csr, csrValue);
+  if (trapCause != 0)
+    csrFile.enterTrap(trapCause, PC, 0);
+  else if (trapReturn)
+    csrFile.returnFromTrap();
+
+  /* Write to pipeline register, a squashed instruction leaves a bubble */
+  ex_m.seq = trapCause != 0 ? 0 : seq;
+  ex_m.PC = trapCause != 0 ? 0 : PC;
   ex_m.aluResult = aluResult;
   ex_m.writeData = writeData;
   ex_m.rd = nextRD;
   ex_m.control = nextControl;
 
-  if (pcWriteEnable) {
-    PCRef = nextPC;
-    pcWriteEnable = false;
+  if (pipelining && isControlTransfer)
+    predictor.update(PC, isConditional, taken, actualNextPC);
+
+  if (idleMonitor && isLoopBack)
+    idleMonitor->loopBack(actualNextPC);
+
+  if (redirect) {
+    PCRef = actualNextPC;
+    redirect = false;
   }
+  pcWriteEnable = false;
+}
+
+/* Take the value of reg from the youngest instruction past EX that
+ * writes it. A load in EX_M has not accessed memory yet, the scoreboard
+ * ensures that no instruction depends on it.
+ */
+RegValue
+ExecuteStage::forward(RegNumber reg, RegValue value) const
+{
+  if (reg == 0)
+    return value;
+
+  if (ex_m.control.getRegWrite() && !ex_m.control.getMemToReg() &&
+      ex_m.rd == reg)
+    return ex_m.aluResult;
+
+  for (const M_WBRegisters* latch : memLatches)
+    if (latch->control.getRegWrite() && latch->rd == reg)
+      return latch->control.getMemToReg() ? latch->memData
+                                          : latch->aluResult;
+
+  return value;
+}
+
+/* The system call number in a7 and the arguments in a0 to a5. These are
+ * read in EX rather than ID, as the register file only has two read
+ * ports.
+ */
+RegValue
+ExecuteStage::systemCall()
+{
+  auto readRegister = [this](RegNumber reg) {
+    const RegValue value = regfile.readRegister(reg);
+    return pipelining ? forward(reg, value) : value;
+  };
+
+  SyscallArguments args;
+  for (size_t i = 0; i < args.size(); ++i)
+    args[i] = readRegister(SyscallProxy::FirstArgument + i);
+
+  return syscalls->call(readRegister(SyscallProxy::NumberRegister), args);
+}
+
+/* The rounding mode of a floating-point instruction, from its rm field
+ * or from frm. For operations that do not round, the field selects a
+ * variant of the operation and any valid mode is returned. Invalid modes
+ * are above RMM.
+ */
+RoundingMode
+ExecuteStage::getRoundingMode(uint8_t rm) const
+{
+  RoundingMode mode = static_cast<RoundingMode>(rm);
+  if (mode == RoundingMode::DYN)
+    mode = fcsr.frm;
+  return mode;
+}
+
+/* Only the first exception raised by an instruction is taken. */
+void
+ExecuteStage::raiseException(uint64_t cause, const char* reason)
+{
+  if (trapCause != 0)
+    return;
+
+  trapCause = cause;
+  trapReason = reason;
 }
 
 bool
@@ -555,10 +810,12 @@ ExecuteStage::computePCRelativeTarget(MemAddress base, int64_t offset) const
 void
 MemoryStage::propagate()
 {
+  seq = ex_m.seq;
   PC = ex_m.PC;
 
   /* Pass through ALU result */
   aluResult = ex_m.aluResult;
+  writeData = ex_m.writeData;
   memData = 0;
   nextRD = ex_m.rd;
   nextControl = ex_m.control;
@@ -566,9 +823,19 @@ MemoryStage::propagate()
   /* Reset control lines to avoid reusing previous instruction state */
   dataMemory.setReadEnable(false);
   dataMemory.setWriteEnable(false);
+  dataMemory.setAtomicOp(AtomicOp::None);
 
+  /* Atomic memory operations read and write memory in a single bus
+   * transaction at the clock edge.
+   */
+  if (ex_m.control.getAtomicOp() != AtomicOp::None) {
+    dataMemory.setAddress(ex_m.aluResult);
+    dataMemory.setSize(ex_m.control.getMemSize());
+    dataMemory.setDataIn(ex_m.writeData);
+    dataMemory.setAtomicOp(ex_m.control.getAtomicOp());
+  }
   /* Only configure memory if there's a memory operation */
-  if (ex_m.control.getMemRead() || ex_m.control.getMemWrite()) {
+  else if (ex_m.control.getMemRead() || ex_m.control.getMemWrite()) {
     dataMemory.setAddress(ex_m.aluResult);
     dataMemory.setSize(ex_m.control.getMemSize());
     dataMemory.setDataIn(ex_m.writeData);
@@ -578,6 +845,10 @@ MemoryStage::propagate()
     /* Read from memory if needed */
     if (ex_m.control.getMemRead())
       memData = dataMemory.getDataOut(ex_m.control.getMemSignExtend());
+
+    /* Single-precision values are NaN-boxed in the registers. */
+    if (ex_m.control.getFloatRD() && ex_m.control.getMemSize() == 4)
+      memData |= 0xFFFFFFFF00000000ULL;
   }
 }
 
@@ -586,8 +857,16 @@ MemoryStage::clockPulse()
 {
   /* Pulse data memory to perform write if needed */
   dataMemory.clockPulse();
+  if (nextControl.getAtomicOp() != AtomicOp::None)
+    memData = dataMemory.getAtomicResult(nextControl.getMemSignExtend());
+
+  /* Vector instructions, with rs1 in aluResult and rs2 in writeData. */
+  if (nextControl.getVector().op != VectorOp::None)
+    memData = vectorUnit.execute(nextControl.getVector(), aluResult,
+                                 writeData);
 
   /* Write to pipeline register */
+  m_wb.seq = seq;
   m_wb.PC = PC;
   m_wb.aluResult = aluResult;
   m_wb.memData = memData;
@@ -602,22 +881,29 @@ MemoryStage::clockPulse()
 void
 WriteBackStage::propagate()
 {
-  if (!pipelining || (pipelining && m_wb.PC != 0x0))
+  /* Bubbles, including instructions squashed by a trap, have PC 0. */
+  if (m_wb.PC != 0x0)
     ++nInstrCompleted;
 
-  /* Configure register file for writeback */
+  /* Configure register files for writeback, rd is numbered within the
+   * pipeline.
+   */
+  const bool isFloat = m_wb.control.getFloatRD();
   regfile.setRD(m_wb.rd);
-  regfile.setWriteEnable(m_wb.control.getRegWrite());
+  regfile.setWriteEnable(m_wb.control.getRegWrite() && !isFloat);
+  floatRegfile.setRD(m_wb.rd - (isFloat ? FloatRegBase : 0));
+  floatRegfile.setWriteEnable(m_wb.control.getRegWrite() && isFloat);
 
   /* Select data to write: from memory or from ALU */
-  if (m_wb.control.getMemToReg())
-    regfile.setWriteData(m_wb.memData);
-  else
-    regfile.setWriteData(m_wb.aluResult);
+  const RegValue data =
+      m_wb.control.getMemToReg() ? m_wb.memData : m_wb.aluResult;
+  regfile.setWriteData(data);
+  floatRegfile.setWriteData(data);
 }
 
 void
 WriteBackStage::clockPulse()
 {
   regfile.clockPulse();
+  floatRegfile.clockPulse();
 }
@@ -9,9 +9,21 @@
 #define __STAGES_H__
 
 #include "alu.h"
+#include "csr.h"
+#include "fpu.h"
 #include "inst-decoder.h"
 #include "memory-control.h"
 #include "mux.h"
+#include "scoreboard.h"
+#include "vector-unit.h"
+
+#include <string_view>
+#include <vector>
+
+class BranchPredictor;
+class IdleMonitor;
+class SyscallProxy;
+struct InstructionInfo;
 
 static constexpr uint32_t NopInstruction = 0x00000013;
 
@@ -20,12 +32,19 @@ public:
   ControlSignals()
       : regWrite(false), aluSrc(false), memRead(false), memWrite(false),
         memToReg(false), branch(false), jump(false), aluOp(ALUOp::NOP),
-        memSize(0), memSignExtend(false)
+        memSize(0), memSignExtend(false), unit(FunctionalUnit::ALU),
+        atomicOp(AtomicOp::None), fpuOp(FPUOp::NOP), floatDouble(false),
+        usesRS1(false), usesRS2(false), usesRS3(false), floatRS1(false),
+        floatRS2(false), floatRD(false), csrOp(CSROp::None),
+        systemOp(SystemOp::None), illegal(false), vector()
   {
   }
 
   void setFromInstruction(const InstructionDecoder& decoder);
 
+  /* In Linux user mode, ecall is a system call that returns a value. */
+  void setSystemCall() { regWrite = true; }
+
   bool getRegWrite() const { return regWrite; }
   bool getALUSrc() const { return aluSrc; }
   bool getMemRead() const { return memRead; }
@@ -36,8 +55,32 @@ public:
   ALUOp getALUOp() const { return aluOp; }
   uint8_t getMemSize() const { return memSize; }
   bool getMemSignExtend() const { return memSignExtend; }
+  FunctionalUnit getUnit() const { return unit; }
+  AtomicOp getAtomicOp() const { return atomicOp; }
+  FPUOp getFPUOp() const { return fpuOp; }
+  bool getFloatDouble() const { return floatDouble; }
+
+  /* Operands that are read and the register files of the operands;
+   * rs3 is only used by floating-point instructions.
+   */
+  bool getUsesRS1() const { return usesRS1; }
+  bool getUsesRS2() const { return usesRS2; }
+  bool getUsesRS3() const { return usesRS3; }
+  bool getFloatRS1() const { return floatRS1; }
+  bool getFloatRS2() const { return floatRS2; }
+  bool getFloatRD() const { return floatRD; }
+
+  CSROp getCSROp() const { return csrOp; }
+  SystemOp getSystemOp() const { return systemOp; }
+
+  /* Unknown encodings raise an illegal instruction exception in EX. */
+  bool getIllegal() const { return illegal; }
+  const VectorInstruction& getVector() const { return vector; }
 
 private:
+  void setVectorFromInstruction(const InstructionDecoder& decoder,
+                                const InstructionInfo& info);
+
   bool regWrite;      /* Write to register file */
   bool aluSrc;        /* ALU source: 0=reg, 1=imm */
   bool memRead;       /* Memory read enable */
@@ -48,6 +91,20 @@ private:
   ALUOp aluOp;        /* ALU operation */
   uint8_t memSize;    /* Memory access size (1,2,4,8) */
   bool memSignExtend; /* Sign extend memory read */
+  FunctionalUnit unit; /* Functional unit that executes the instruction */
+  AtomicOp atomicOp;   /* Atomic memory operation, A extension */
+  FPUOp fpuOp;         /* Floating-point operation, F and D extensions */
+  bool floatDouble;    /* FPU operates on double precision */
+  bool usesRS1;
+  bool usesRS2;
+  bool usesRS3;
+  bool floatRS1;
+  bool floatRS2;
+  bool floatRD;
+  CSROp csrOp;              /* Zicsr, executed in EX */
+  SystemOp systemOp;        /* ecall, ebreak and mret, executed in EX */
+  bool illegal;
+  VectorInstruction vector; /* V extension, executed in MEM */
 };
 
 struct PipelineControl {
@@ -65,6 +122,27 @@ struct PipelineControl {
   bool flushDecode{};
 };
 
+/* Every pipeline cycle is accounted to a single category, depending on
+ * what the decode stage issues to EX in that cycle.
+ */
+enum class CycleCategory {
+  Retiring,       /* an instruction was issued */
+  Frontend,       /* no instruction was fetched (pipeline fill and drain) */
+  BadSpeculation, /* instruction squashed by a taken branch or jump */
+  LoadUse,        /* load-use delay of the pipeline */
+  Memory,         /* load latency beyond the load-use delay */
+  Dependency,     /* waiting for the result of a multi-cycle unit */
+  Structural,     /* functional unit busy, in-order write back or a CSR
+                   * instruction waiting for older instructions */
+  Idle,           /* waiting for an interrupt after wfi */
+  LAST
+};
+
+using CycleAccounting =
+    std::array<uint64_t, static_cast<size_t>(CycleCategory::LAST)>;
+
+const char* cycleCategoryName(CycleCategory category);
+
 /* Pipeline registers may be read during propagate and may only be
  * written during clockPulse. Note that you cannot read the incoming
  * pipeline registers in clockPulse (e.g. in clockPulse of EX, you cannot
@@ -73,24 +151,33 @@ struct PipelineControl {
  * the next, these need to be buffered explicitly within the stage.
  */
 struct IF_IDRegisters {
+  uint64_t seq = 0; /* sequence number assigned at fetch, 0 for bubbles */
   MemAddress PC = 0;
+  MemAddress predictedPC = 0; /* address fetch continued at */
   uint32_t instructionWord = NopInstruction;
+  bool fetchFailed = false; /* raised when decode issues the instruction */
 };
 
 struct ID_EXRegisters {
+  uint64_t seq{};
   MemAddress PC{};
+  MemAddress predictedPC{};
   RegValue readData1{};
   RegValue readData2{};
+  RegValue readData3{};
   int64_t immediate{};
-  RegNumber rd{};
+  RegNumber rd{}; /* register numbers of the pipeline, see FloatRegBase */
   RegNumber rs1{};
   RegNumber rs2{};
+  RegNumber rs3{};
   Opcode opcode{Opcode::OP};
   uint8_t funct3{};
+  uint8_t length{4}; /* 2 for compressed instructions */
   ControlSignals control{};
 };
 
 struct EX_MRegisters {
+  uint64_t seq{};
   MemAddress PC{};
   RegValue aluResult{};
   RegValue writeData{}; /* Data to write to memory (rs2 value) */
@@ -99,6 +186,7 @@ struct EX_MRegisters {
 };
 
 struct M_WBRegisters {
+  uint64_t seq{};
   MemAddress PC{};
   RegValue aluResult{};
   RegValue memData{};
@@ -123,6 +211,39 @@ protected:
   bool pipelining;
 };
 
+/* Additional stage that only delays the contents of a pipeline register
+ * by one cycle, used to split IF and MEM over multiple stages. Latches
+ * in the front-end are held when fetch stalls and cleared when fetch is
+ * flushed, like IF itself. Only used in pipelined mode.
+ */
+template <typename Registers>
+class LatchStage : public Stage {
+public:
+  LatchStage(const Registers& in, Registers& out,
+             const PipelineControl& control, bool frontend)
+      : Stage(true), in(in), out(out), control(control), frontend(frontend)
+  {
+  }
+
+  void propagate() override { buffer = in; }
+
+  void clockPulse() override
+  {
+    if (frontend && control.flushFetch)
+      out = Registers{};
+    else if (!frontend || !control.stallFetch)
+      out = buffer;
+  }
+
+private:
+  const Registers& in;
+  Registers& out;
+  const PipelineControl& control;
+  bool frontend;
+
+  Registers buffer{};
+};
+
 /*
  * Instruction fetch
  */
@@ -142,9 +263,51 @@ private:
   std::string message{};
 };
 
+/* An instruction that has been fetched, but has not yet entered ID. */
+struct FrontendSlot {
+  uint64_t seq;
+  MemAddress PC;
+  bool queued; /* waiting in the instruction queue */
+};
+
+/* Read the instruction at addr in 16-bit parcels, such that a 32-bit
+ * instruction only needs to be aligned to 2 bytes.
+ */
+uint32_t readInstruction(InstructionMemory& instructionMemory,
+                         MemAddress addr);
+
+class FetchStage : public Stage {
+public:
+  FetchStage(bool pipelining) : Stage(pipelining) {}
+
+  /* Append the instructions in the front-end, oldest first. */
+  virtual void getInFlight(std::vector<FrontendSlot>& slots) const = 0;
+
+  virtual void dumpStatistics(std::ostream&) const {}
+
+  /* Account cycles that were skipped while the pipeline waited for an
+   * interrupt, and was stalled.
+   */
+  virtual void addIdleCycles(uint64_t) {}
+
+  uint64_t getInstrFetched() const { return nInstrFetched; }
+  uint64_t getBytesFetched() const { return nBytesFetched; }
+
+protected:
+  void countFetch(uint32_t instructionWord)
+  {
+    ++nInstrFetched;
+    nBytesFetched += isCompressedInstruction(instructionWord) ? 2 : 4;
+  }
+
+private:
+  uint64_t nInstrFetched{};
+  uint64_t nBytesFetched{};
+};
+
 class TestEndMarkerEncountered : public std::exception {
 public:
-  explicit TestEndMarkerEncountered(const MemAddress addr)
+  explicit TestEndMarkerEncountered(const MemAddress addr) : addr{addr}
   {
     std::stringstream ss;
     ss << "Test end marker encountered at address " << std::hex << addr;
@@ -153,32 +316,45 @@ public:
 
   const char* what() const noexcept override { return message.c_str(); }
 
+  MemAddress getAddress() const { return addr; }
+
 private:
+  MemAddress addr{};
   std::string message{};
 };
 
-class InstructionFetchStage : public Stage {
+/* Fetch in lockstep with decode, predicting every branch not taken. */
+class InstructionFetchStage : public FetchStage {
 public:
+  /* After the end marker is fetched, the pipeline runs for drainCycles
+   * more cycles to complete the instructions in flight.
+   */
   InstructionFetchStage(bool pipelining, IF_IDRegisters& if_id,
                         InstructionMemory instructionMemory, MemAddress& PC,
-                        PipelineControl& control)
-      : Stage(pipelining), if_id(if_id), instructionMemory(instructionMemory),
-        PC(PC), control(control)
+                        PipelineControl& control, int drainCycles)
+      : FetchStage(pipelining), if_id(if_id),
+        instructionMemory(instructionMemory), PC(PC), control(control),
+        drainCycles(drainCycles)
   {
   }
 
   void propagate() override;
   void clockPulse() override;
 
+  void getInFlight(std::vector<FrontendSlot>& slots) const override;
+
 private:
   IF_IDRegisters& if_id;
 
   InstructionMemory instructionMemory;
   MemAddress& PC;
   PipelineControl& control;
+  int drainCycles;
 
   MemAddress fetchPC{};
   uint32_t fetchedInstruction{};
+  bool fetchFailed{};
+  uint64_t fetchSeq{1};
   bool endMarkerSeen{};
   int endMarkerCountdown{};
   MemAddress endMarkerPC{};
@@ -192,37 +368,66 @@ class InstructionDecodeStage : public Stage {
 public:
   InstructionDecodeStage(bool pipelining, const IF_IDRegisters& if_id,
                          ID_EXRegisters& id_ex, const M_WBRegisters& m_wb,
-                         RegisterFile& regfile, InstructionDecoder& decoder,
-                         uint64_t& nInstrIssued, uint64_t& nStalls,
-                         PipelineControl& control, bool debugMode = false)
+                         RegisterFile& regfile,
+                         FloatRegisterFile& floatRegfile,
+                         InstructionDecoder& decoder, Scoreboard& scoreboard,
+                         CSRFile& csrFile, uint64_t& nInstrIssued,
+                         uint64_t& nStalls, CycleAccounting& cycles,
+                         PipelineControl& control, unsigned fetchStages,
+                         bool debugMode = false)
       : Stage(pipelining), if_id(if_id), id_ex(id_ex), m_wb(m_wb),
-        regfile(regfile), decoder(decoder), nInstrIssued(nInstrIssued),
-        nStalls(nStalls), control(control), debugMode(debugMode)
+        regfile(regfile), floatRegfile(floatRegfile), decoder(decoder),
+        scoreboard(scoreboard), csrFile(csrFile), nInstrIssued(nInstrIssued),
+        nStalls(nStalls), cycles(cycles), control(control),
+        fetchStages(fetchStages), debugMode(debugMode)
   {
   }
 
+  InstructionDecodeStage(const InstructionDecodeStage&) = delete;
+  InstructionDecodeStage& operator=(const InstructionDecodeStage&) = delete;
+
   void propagate() override;
   void clockPulse() override;
 
+  void setSyscallProxy(SyscallProxy* proxy) { syscalls = proxy; }
+
 private:
   const IF_IDRegisters& if_id;
   ID_EXRegisters& id_ex;
   const M_WBRegisters& m_wb;
 
   RegisterFile& regfile;
+  FloatRegisterFile& floatRegfile;
   InstructionDecoder& decoder;
+  Scoreboard& scoreboard;
+  CSRFile& csrFile;
 
   uint64_t& nInstrIssued;
   uint64_t& nStalls;
+  CycleAccounting& cycles;
   PipelineControl& control;
+  unsigned fetchStages;
+  SyscallProxy* syscalls{}; /* no ownership, only in Linux user mode */
 
   bool debugMode;
 
+  uint64_t seq{};
   MemAddress PC{};
+  MemAddress predictedPC{};
   uint32_t instructionWord{};
+  bool fetchFailed{};
   ControlSignals decodedControl{};
+  RegNumber rd{};
+  RegNumber rs1{};
+  RegNumber rs2{};
+  RegNumber rs3{};
   RegValue readData1{};
   RegValue readData2{};
+  RegValue readData3{};
+  Hazard hazard{};
+  unsigned squashCycles{}; /* bubbles left from the last flush of IF */
+
+  void accountCycle();
 };
 
 /*
@@ -231,34 +436,75 @@ private:
 
 class ExecuteStage : public Stage {
 public:
+  /* Results are forwarded from EX_M and from the registers following
+   * the memory stages, given youngest first.
+   */
   ExecuteStage(bool pipelining, const ID_EXRegisters& id_ex,
-               EX_MRegisters& ex_m, const M_WBRegisters& m_wb, MemAddress& PC,
-               PipelineControl& control)
-      : Stage(pipelining), id_ex(id_ex), ex_m(ex_m), prev_m_wb(m_wb), alu(),
-        PCRef(PC), control(control)
+               EX_MRegisters& ex_m,
+               std::vector<const M_WBRegisters*> memLatches, MemAddress& PC,
+               const RegisterFile& regfile, FloatStatus& fcsr,
+               CSRFile& csrFile, PipelineControl& control,
+               BranchPredictor& predictor)
+      : Stage(pipelining), id_ex(id_ex), ex_m(ex_m),
+        memLatches(std::move(memLatches)), alu(), fpu(), PCRef(PC),
+        regfile(regfile), fcsr(fcsr), csrFile(csrFile), control(control),
+        predictor(predictor)
   {
   }
 
+  ExecuteStage(const ExecuteStage&) = delete;
+  ExecuteStage& operator=(const ExecuteStage&) = delete;
+
   void propagate() override;
   void clockPulse() override;
 
+  void setSyscallProxy(SyscallProxy* proxy) { syscalls = proxy; }
+  void setIdleMonitor(IdleMonitor* monitor) { idleMonitor = monitor; }
+
 private:
   const ID_EXRegisters& id_ex;
   EX_MRegisters& ex_m;
-  const M_WBRegisters& prev_m_wb;
+  std::vector<const M_WBRegisters*> memLatches;
 
   ALU alu;
+  FPU fpu;
   MemAddress& PCRef;
+  const RegisterFile& regfile; /* arguments of system calls */
+  FloatStatus& fcsr;
+  CSRFile& csrFile;
   PipelineControl& control;
+  BranchPredictor& predictor;
+  SyscallProxy* syscalls{}; /* no ownership, only in Linux user mode */
+  IdleMonitor* idleMonitor{}; /* no ownership */
   bool pcWriteEnable{};
   MemAddress nextPC{};
 
+  /* Fetch continued at the wrong address and has to be redirected. */
+  bool redirect{};
+  MemAddress actualNextPC{};
+  bool isControlTransfer{};
+  bool isConditional{};
+  bool taken{};
+
+  uint64_t seq{};
   MemAddress PC{};
   RegValue aluResult{};
   RegValue writeData{};
   RegNumber nextRD{};
   ControlSignals nextControl{};
-
+  uint8_t floatFlags{}; /* exception flags raised by the FPU */
+  bool csrWrite{};
+  uint16_t csr{};
+  RegValue csrValue{}; /* value written to csr */
+  uint64_t trapCause{}; /* mcause of the trap to take, 0 if none */
+  std::string_view trapReason{};
+  bool trapReturn{};
+  bool isLoopBack{};
+
+  RegValue forward(RegNumber reg, RegValue value) const;
+  RegValue systemCall();
+  RoundingMode getRoundingMode(uint8_t rm) const;
+  void raiseException(uint64_t cause, const char* reason);
   bool evaluateBranch(uint8_t funct3, RegValue lhs, RegValue rhs) const;
   MemAddress computePCRelativeTarget(MemAddress base, int64_t offset) const;
 };
@@ -270,8 +516,9 @@ private:
 class MemoryStage : public Stage {
 public:
   MemoryStage(bool pipelining, const EX_MRegisters& ex_m, M_WBRegisters& m_wb,
-              DataMemory dataMemory)
-      : Stage(pipelining), ex_m(ex_m), m_wb(m_wb), dataMemory(dataMemory)
+              DataMemory dataMemory, VectorUnit& vectorUnit)
+      : Stage(pipelining), ex_m(ex_m), m_wb(m_wb), dataMemory(dataMemory),
+        vectorUnit(vectorUnit)
   {
   }
 
@@ -283,9 +530,12 @@ private:
   M_WBRegisters& m_wb;
 
   DataMemory dataMemory;
+  VectorUnit& vectorUnit;
 
+  uint64_t seq{};
   MemAddress PC{};
   RegValue aluResult{};
+  RegValue writeData{};
   RegValue memData{};
   RegNumber nextRD{};
   ControlSignals nextControl{};
@@ -298,9 +548,10 @@ private:
 class WriteBackStage : public Stage {
 public:
   WriteBackStage(bool pipelining, const M_WBRegisters& m_wb,
-                 RegisterFile& regfile, uint64_t& nInstrCompleted)
+                 RegisterFile& regfile, FloatRegisterFile& floatRegfile,
+                 uint64_t& nInstrCompleted)
       : Stage(pipelining), m_wb(m_wb), regfile(regfile),
-        nInstrCompleted(nInstrCompleted)
+        floatRegfile(floatRegfile), nInstrCompleted(nInstrCompleted)
   {
   }
 
@@ -311,6 +562,7 @@ private:
   const M_WBRegisters& m_wb;
 
   RegisterFile& regfile;
+  FloatRegisterFile& floatRegfile;
 
   /* TODO add other necessary fields/buffers and components */
 
@@ -23,6 +23,11 @@ public:
 
   bool shouldHalt() const { return shouldHaltFlag; }
 
+  /* Halt without a write to the module, when the program exits by a
+   * system call.
+   */
+  void halt() { shouldHaltFlag = true; }
+
   /* MemoryInterface */
   uint8_t readByte(MemAddress addr) override;
   uint16_t readHalfWord(MemAddress addr) override;
@@ -0,0 +1,536 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    syscall-proxy.cc - Linux system calls for programs in user mode.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "syscall-proxy.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/* System call numbers of the RV64 Linux ABI (asm-generic). */
+enum SyscallNumber : RegValue {
+  SysIoctl = 29,
+  SysOpenAt = 56,
+  SysClose = 57,
+  SysLseek = 62,
+  SysRead = 63,
+  SysWrite = 64,
+  SysReadv = 65,
+  SysWritev = 66,
+  SysFstat = 80,
+  SysExit = 93,
+  SysExitGroup = 94,
+  SysSetTidAddress = 96,
+  SysClockGetTime = 113,
+  SysBrk = 214,
+  SysMunmap = 215,
+  SysMmap = 222
+};
+
+/* errno values of Linux, which the guest expects whatever the host. */
+enum LinuxError : int {
+  LinuxEBADF = 9,
+  LinuxENOMEM = 12,
+  LinuxEFAULT = 14,
+  LinuxENODEV = 19,
+  LinuxEINVAL = 22,
+  LinuxENOTTY = 25,
+  LinuxENOSYS = 38
+};
+
+/* Flags of mmap and openat, and the values of the auxiliary vector. */
+constexpr RegValue MapFixed = 0x10;
+constexpr RegValue MapAnonymous = 0x20;
+constexpr int64_t AtFdCwd = -100;
+
+constexpr uint64_t AuxNull = 0;
+constexpr uint64_t AuxPageSize = 6;
+constexpr uint64_t AuxRandom = 25;
+
+/* struct stat of the RV64 Linux ABI. */
+struct GuestStat {
+  uint64_t dev;
+  uint64_t ino;
+  uint32_t mode;
+  uint32_t nlink;
+  uint32_t uid;
+  uint32_t gid;
+  uint64_t rdev;
+  uint64_t pad1;
+  int64_t size;
+  int32_t blksize;
+  int32_t pad2;
+  int64_t blocks;
+  int64_t atime;
+  uint64_t atimeNsec;
+  int64_t mtime;
+  uint64_t mtimeNsec;
+  int64_t ctime;
+  uint64_t ctimeNsec;
+  uint32_t unused[2];
+};
+
+static_assert(sizeof(GuestStat) == 128, "struct stat of RV64 Linux");
+
+constexpr MemAddress
+roundUp(MemAddress addr, size_t alignment)
+{
+  return (addr + alignment - 1) & ~static_cast<MemAddress>(alignment - 1);
+}
+
+RegValue
+error(int number)
+{
+  return static_cast<RegValue>(-static_cast<int64_t>(number));
+}
+
+/* Result of a host system call, errno is assumed to match Linux. */
+RegValue
+hostResult(int64_t result)
+{
+  return result < 0 ? error(errno) : static_cast<RegValue>(result);
+}
+
+std::unique_ptr<Memory>
+createMemory(const std::string& name, MemAddress base, size_t size)
+{
+  constexpr size_t align = SyscallProxy::PageSize;
+
+  auto* data = new (std::align_val_t{align}, std::nothrow) std::byte[size]();
+  if (!data)
+    throw std::runtime_error("Could not allocate the " + name + ".");
+
+  auto memory = std::make_unique<Memory>(name, data, base, size, align);
+  memory->setMayWrite(true);
+  return memory;
+}
+
+} // namespace
+
+SyscallProxy::SyscallProxy(MemoryBus& bus, SysStatus& sysStatus,
+                           MemAddress programEnd)
+    : bus{bus}, sysStatus{sysStatus}, heapBase{roundUp(programEnd, PageSize)},
+      programBreak{heapBase}, mmapBase{heapBase + HeapSize}
+{
+#ifdef _MSC_VER
+  throw std::runtime_error("Linux user mode requires a POSIX host.");
+#endif
+
+  if (mmapBase > StackTop - StackSize)
+    throw std::runtime_error("Program overlaps the user mode stack.");
+
+  bus.addClient(createMemory("stack", StackTop - StackSize, StackSize));
+  bus.addClient(createMemory("heap", heapBase, HeapSize));
+}
+
+/* The strings are copied to the top of the stack, followed by a block of
+ * random bytes for AT_RANDOM (a fixed pattern, to keep runs
+ * reproducible). Below them, at the 16-byte aligned stack pointer, are
+ * argc, the argv and envp arrays and the auxiliary vector.
+ */
+MemAddress
+SyscallProxy::setupStack(const std::vector<std::string>& args,
+                         const std::vector<std::string>& env)
+{
+  MemAddress sp = StackTop;
+
+  auto push = [this, &sp](const void* data, size_t size) {
+    std::byte* dest = bus.getHostPointer(sp - size, size, true);
+    if (!dest)
+      throw std::runtime_error("Program arguments do not fit on the stack.");
+
+    sp -= size;
+    std::memcpy(dest, data, size);
+    return sp;
+  };
+
+  std::vector<uint64_t> words{args.size()};
+
+  for (const auto& arg : args)
+    words.push_back(push(arg.c_str(), arg.size() + 1));
+  words.push_back(0);
+  for (const auto& var : env)
+    words.push_back(push(var.c_str(), var.size() + 1));
+  words.push_back(0);
+
+  uint8_t random[16];
+  for (size_t i = 0; i < sizeof(random); ++i)
+    random[i] = static_cast<uint8_t>(0x5A ^ (i * 0x11));
+  const MemAddress randomAddr = push(random, sizeof(random));
+
+  words.insert(words.end(), {AuxPageSize, PageSize, AuxRandom, randomAddr,
+                             AuxNull, 0});
+
+  const size_t size = words.size() * sizeof(uint64_t);
+  sp = ((sp - size) & ~static_cast<MemAddress>(15)) + size;
+  return push(words.data(), size);
+}
+
+RegValue
+SyscallProxy::call(RegValue number, const SyscallArguments& args)
+{
+  ++nCalls;
+
+#ifdef _MSC_VER
+  return error(LinuxENOSYS);
+#else
+  switch (number) {
+  case SysRead:
+    return doRead(args);
+  case SysWrite:
+    return doWrite(args);
+  case SysReadv:
+    return doVectorIO(args, false);
+  case SysWritev:
+    return doVectorIO(args, true);
+  case SysOpenAt:
+    return doOpenAt(args);
+  case SysClose:
+    return doClose(args);
+  case SysLseek:
+    return doSeek(args);
+  case SysFstat:
+    return doStat(args);
+  case SysBrk:
+    return doBreak(args);
+  case SysMmap:
+    return doMap(args);
+  case SysMunmap:
+    return doUnmap(args);
+  case SysExit:
+  case SysExitGroup:
+    return doExit(args);
+  case SysClockGetTime:
+    return doClockGetTime(args);
+
+  /* A single thread; terminals are not emulated. */
+  case SysSetTidAddress:
+    return 1;
+  case SysIoctl:
+    return error(LinuxENOTTY);
+
+  default:
+    return error(LinuxENOSYS);
+  }
+#endif
+}
+
+/*
+ * Private methods
+ */
+
+int
+SyscallProxy::getHostFile(RegValue fd) const
+{
+  return fd < files.size() ? files[fd] : -1;
+}
+
+/* As on Linux, the lowest free descriptor is used. */
+RegValue
+SyscallProxy::allocateFile(int hostFile)
+{
+  auto it = std::find(files.begin(), files.end(), -1);
+  if (it == files.end())
+    it = files.insert(files.end(), -1);
+
+  *it = hostFile;
+  return it - files.begin();
+}
+
+bool
+SyscallProxy::readString(MemAddress addr, std::string& str)
+{
+  constexpr size_t MaxLength = 4096;
+
+  str.clear();
+  for (size_t i = 0; i < MaxLength; ++i) {
+    const std::byte* c = bus.getHostPointer(addr + i, 1, false);
+    if (!c)
+      return false;
+    if (*c == std::byte{0})
+      return true;
+    str.push_back(static_cast<char>(*c));
+  }
+
+  return false;
+}
+
+#ifndef _MSC_VER
+
+RegValue
+SyscallProxy::doRead(const SyscallArguments& args)
+{
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+  if (args[2] == 0)
+    return 0;
+
+  std::byte* buffer = bus.getHostPointer(args[1], args[2], true);
+  if (!buffer)
+    return error(LinuxEFAULT);
+
+  return hostResult(::read(file, buffer, args[2]));
+}
+
+RegValue
+SyscallProxy::doWrite(const SyscallArguments& args)
+{
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+  if (args[2] == 0)
+    return 0;
+
+  const std::byte* buffer = bus.getHostPointer(args[1], args[2], false);
+  if (!buffer)
+    return error(LinuxEFAULT);
+
+  return hostResult(::write(file, buffer, args[2]));
+}
+
+/* readv and writev; musl writes to stdio streams with writev. */
+RegValue
+SyscallProxy::doVectorIO(const SyscallArguments& args, bool write)
+{
+  constexpr RegValue MaxVectors = 1024;
+
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+  if (args[2] > MaxVectors)
+    return error(LinuxEINVAL);
+
+  const std::byte* guestVectors =
+      bus.getHostPointer(args[1], args[2] * 2 * sizeof(uint64_t), false);
+  if (!guestVectors && args[2] > 0)
+    return error(LinuxEFAULT);
+
+  std::vector<struct iovec> vectors(args[2]);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    uint64_t base, length;
+    std::memcpy(&base, guestVectors + 16 * i, sizeof(base));
+    std::memcpy(&length, guestVectors + 16 * i + 8, sizeof(length));
+
+    vectors[i] = {nullptr, 0};
+    if (length == 0)
+      continue;
+
+    std::byte* buffer = bus.getHostPointer(base, length, !write);
+    if (!buffer)
+      return error(LinuxEFAULT);
+    vectors[i] = {buffer, length};
+  }
+
+  const int count = static_cast<int>(vectors.size());
+  return hostResult(write ? ::writev(file, vectors.data(), count)
+                          : ::readv(file, vectors.data(), count));
+}
+
+RegValue
+SyscallProxy::doOpenAt(const SyscallArguments& args)
+{
+  /* The access mode is the same on all hosts, other flags differ. */
+  static constexpr struct {
+    RegValue guest;
+    int host;
+  } openFlags[] = {{0100, O_CREAT},       {0200, O_EXCL},
+                   {0400, O_NOCTTY},      {01000, O_TRUNC},
+                   {02000, O_APPEND},     {04000, O_NONBLOCK},
+                   {0200000, O_DIRECTORY}, {0400000, O_NOFOLLOW},
+                   {02000000, O_CLOEXEC}};
+
+  int directory = AT_FDCWD;
+  if (static_cast<int64_t>(args[0]) != AtFdCwd) {
+    directory = getHostFile(args[0]);
+    if (directory < 0)
+      return error(LinuxEBADF);
+  }
+
+  std::string path;
+  if (!readString(args[1], path))
+    return error(LinuxEFAULT);
+
+  int flags = static_cast<int>(args[2] & 0x3);
+  for (const auto& flag : openFlags)
+    if (args[2] & flag.guest)
+      flags |= flag.host;
+
+  const int file = ::openat(directory, path.c_str(), flags,
+                            static_cast<mode_t>(args[3]));
+  if (file < 0)
+    return error(errno);
+
+  return allocateFile(file);
+}
+
+/* The standard streams are not closed on the host, the emulator still
+ * uses them.
+ */
+RegValue
+SyscallProxy::doClose(const SyscallArguments& args)
+{
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+
+  files[args[0]] = -1;
+  if (args[0] <= 2)
+    return 0;
+
+  return hostResult(::close(file));
+}
+
+RegValue
+SyscallProxy::doSeek(const SyscallArguments& args)
+{
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+
+  return hostResult(::lseek(file, static_cast<off_t>(args[1]),
+                            static_cast<int>(args[2])));
+}
+
+RegValue
+SyscallProxy::doStat(const SyscallArguments& args)
+{
+  const int file = getHostFile(args[0]);
+  if (file < 0)
+    return error(LinuxEBADF);
+
+  std::byte* buffer = bus.getHostPointer(args[1], sizeof(GuestStat), true);
+  if (!buffer)
+    return error(LinuxEFAULT);
+
+  struct stat hostStat;
+  if (::fstat(file, &hostStat) < 0)
+    return error(errno);
+
+  /* Timestamps are passed in whole seconds. */
+  GuestStat guestStat{};
+  guestStat.dev = hostStat.st_dev;
+  guestStat.ino = hostStat.st_ino;
+  guestStat.mode = hostStat.st_mode;
+  guestStat.nlink = hostStat.st_nlink;
+  guestStat.uid = hostStat.st_uid;
+  guestStat.gid = hostStat.st_gid;
+  guestStat.rdev = hostStat.st_rdev;
+  guestStat.size = hostStat.st_size;
+  guestStat.blksize = hostStat.st_blksize;
+  guestStat.blocks = hostStat.st_blocks;
+  guestStat.atime = hostStat.st_atime;
+  guestStat.mtime = hostStat.st_mtime;
+  guestStat.ctime = hostStat.st_ctime;
+  std::memcpy(buffer, &guestStat, sizeof(guestStat));
+
+  return 0;
+}
+
+/* brk returns the new program break, or the current one when the
+ * requested break is outside of the heap. Memory released by lowering
+ * the break is cleared when it is allocated again.
+ */
+RegValue
+SyscallProxy::doBreak(const SyscallArguments& args)
+{
+  const MemAddress request = args[0];
+  if (request < heapBase || request > mmapBase)
+    return programBreak;
+
+  if (request > programBreak)
+    std::fill_n(bus.getHostPointer(programBreak, request - programBreak, true),
+                request - programBreak, std::byte{0});
+  programBreak = request;
+  return programBreak;
+}
+
+/* Only anonymous mappings are supported, at an address chosen by the
+ * proxy.
+ */
+RegValue
+SyscallProxy::doMap(const SyscallArguments& args)
+{
+  const RegValue flags = args[3];
+  if (!(flags & MapAnonymous))
+    return error(LinuxENODEV);
+  if ((flags & MapFixed) || args[1] == 0)
+    return error(LinuxEINVAL);
+
+  const MemAddress limit = roundUp(programBreak, PageSize);
+  if (args[1] > HeapSize || roundUp(args[1], PageSize) > mmapBase - limit)
+    return error(LinuxENOMEM);
+
+  const size_t length = roundUp(args[1], PageSize);
+
+  mmapBase -= length;
+  std::fill_n(bus.getHostPointer(mmapBase, length, true), length,
+              std::byte{0});
+  return mmapBase;
+}
+
+/* Only the most recent mapping is returned to the heap. */
+RegValue
+SyscallProxy::doUnmap(const SyscallArguments& args)
+{
+  if (args[0] == mmapBase)
+    mmapBase = std::min(mmapBase + roundUp(args[1], PageSize),
+                        heapBase + HeapSize);
+
+  return 0;
+}
+
+RegValue
+SyscallProxy::doExit(const SyscallArguments& args)
+{
+  exited = true;
+  exitStatus = static_cast<int>(args[0] & 0xFF);
+  sysStatus.halt();
+  return 0;
+}
+
+RegValue
+SyscallProxy::doClockGetTime(const SyscallArguments& args)
+{
+  clockid_t clock;
+  switch (args[0]) {
+  case 0:
+    clock = CLOCK_REALTIME;
+    break;
+  case 1:
+    clock = CLOCK_MONOTONIC;
+    break;
+  default:
+    return error(LinuxEINVAL);
+  }
+
+  std::byte* buffer = bus.getHostPointer(args[1], 2 * sizeof(int64_t), true);
+  if (!buffer)
+    return error(LinuxEFAULT);
+
+  struct timespec time;
+  if (::clock_gettime(clock, &time) < 0)
+    return error(errno);
+
+  const int64_t guestTime[2] = {time.tv_sec, time.tv_nsec};
+  std::memcpy(buffer, guestTime, sizeof(guestTime));
+  return 0;
+}
+
+#endif /* _MSC_VER */
@@ -0,0 +1,98 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    syscall-proxy.h - Linux system calls for programs in user mode.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SYSCALL_PROXY_H__
+#define __SYSCALL_PROXY_H__
+
+#include "arch.h"
+#include "memory-bus.h"
+#include "sys-status.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+/* Arguments a0 to a5 of a system call. */
+using SyscallArguments = std::array<RegValue, 6>;
+
+/* In Linux user mode, ecall is a system call of the RV64 Linux ABI. The
+ * proxy implements the subset used by the C libraries (newlib and musl)
+ * of statically linked programs by calling the corresponding host system
+ * calls. Buffers are passed to the host in place, through the host memory
+ * that holds guest memory. Unsupported system calls return -ENOSYS.
+ *
+ * The proxy adds a stack and a heap to the memory bus. The heap follows
+ * the program: brk grows it upwards, anonymous mmaps are allocated from
+ * its end downwards.
+ */
+class SyscallProxy {
+public:
+  static constexpr RegNumber NumberRegister = 17; /* a7 */
+  static constexpr RegNumber FirstArgument = 10;  /* a0, also the result */
+
+  static constexpr MemAddress StackTop = 0x80000000;
+  static constexpr size_t StackSize = 8 << 20;
+  static constexpr size_t HeapSize = 64 << 20;
+  static constexpr size_t PageSize = 4096;
+
+  SyscallProxy(MemoryBus& bus, SysStatus& sysStatus, MemAddress programEnd);
+
+  SyscallProxy(const SyscallProxy&) = delete;
+  SyscallProxy& operator=(const SyscallProxy&) = delete;
+
+  /* Write argc, argv, envp and the auxiliary vector to the top of the
+   * stack, as the kernel does on exec. Returns the initial stack pointer.
+   */
+  MemAddress setupStack(const std::vector<std::string>& args,
+                        const std::vector<std::string>& env);
+
+  /* Perform system call number with the given arguments, returns the
+   * value of a0: the result, or a negated Linux errno value.
+   */
+  RegValue call(RegValue number, const SyscallArguments& args);
+
+  bool hasExited() const { return exited; }
+  int getExitStatus() const { return exitStatus; }
+
+  uint64_t getCallCount() const { return nCalls; }
+
+private:
+  MemoryBus& bus;
+  SysStatus& sysStatus;
+
+  const MemAddress heapBase;
+  MemAddress programBreak;
+  MemAddress mmapBase; /* lowest address allocated by mmap */
+
+  /* Host file descriptors of the guest file descriptors, -1 for closed
+   * descriptors. The standard streams are shared with the emulator.
+   */
+  std::vector<int> files{0, 1, 2};
+
+  bool exited{};
+  int exitStatus{};
+  uint64_t nCalls{};
+
+  int getHostFile(RegValue fd) const;
+  RegValue allocateFile(int hostFile);
+  bool readString(MemAddress addr, std::string& str);
+
+  RegValue doRead(const SyscallArguments& args);
+  RegValue doWrite(const SyscallArguments& args);
+  RegValue doVectorIO(const SyscallArguments& args, bool write);
+  RegValue doOpenAt(const SyscallArguments& args);
+  RegValue doClose(const SyscallArguments& args);
+  RegValue doSeek(const SyscallArguments& args);
+  RegValue doStat(const SyscallArguments& args);
+  RegValue doBreak(const SyscallArguments& args);
+  RegValue doMap(const SyscallArguments& args);
+  RegValue doUnmap(const SyscallArguments& args);
+  RegValue doExit(const SyscallArguments& args);
+  RegValue doClockGetTime(const SyscallArguments& args);
+};
+
+#endif /* __SYSCALL_PROXY_H__ */
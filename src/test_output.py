@@ -29,8 +29,10 @@ def posix_nt(posix, nt):
     return posix if os.name == "posix" else nt
 
 
+# The output is compared byte for byte, it may contain binary data such as
+# a captured video.
 def parse_test(testfile):
-    with testfile.open() as fh:
+    with testfile.open(encoding="latin-1") as fh:
         args = fh.readline().rstrip("\n")
         args = args.split(" ")
         output = fh.read()
@@ -156,8 +158,8 @@ for test in all_tests:
     fail_detail = ""
 
     if success:
-        tmp = normalize_output(result.stdout.decode())
-        tmp += normalize_output(result.stderr.decode())
+        tmp = normalize_output(result.stdout.decode("latin-1"))
+        tmp += normalize_output(result.stderr.decode("latin-1"))
 
         if output != tmp:
             success = False
@@ -0,0 +1,60 @@
+# Test of the RV64A atomic instructions. As in load.s, R1 is initialized
+# with the address of A (0x11100, 69888 decimal). The reservation of a
+# load reserved is lost when its double word is written, but not when
+# a neighbouring double word is written.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.dword	10
+	.dword	0
+	.int	-5, 7
+	.dword	0x8000000000000000
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	lr.d	x2, (x1)		# 10
+	addi	x3, x2, 1		# 11
+	sc.d	x4, x3, (x1)		# success: 0
+	sc.d	x5, x3, (x1)		# no reservation: 1
+	lr.d	x6, (x1)		# 11
+	sd	x0, 8(x1)
+	sc.d	x7, x2, (x1)		# success: 0
+	lr.d	x8, (x1)		# 10
+	sw	x3, 4(x1)
+	sc.d	x9, x0, (x1)		# reservation lost: 1
+	ld	x10, (x1)		# 0xb0000000a
+
+	addi	x11, x1, 16
+	li	x12, 3
+	li	x26, -1
+	amoadd.w	x13, x12, (x11)		# -5, A[4] = -2
+	amomin.w	x14, x12, (x11)		# -2
+	amominu.w	x15, x12, (x11)		# -2, A[4] = 3
+	amomax.w	x16, x26, (x11)		# 3
+	addi	x17, x11, 4
+	amoswap.w	x18, x12, (x17)		# 7, A[5] = 3
+	amoxor.w	x19, x18, (x17)		# 3, A[5] = 4
+	amoor.w	x20, x12, (x17)		# 4, A[5] = 7
+	amoand.w	x21, x12, (x17)		# 7, A[5] = 3
+	lw	x22, (x17)		# 3
+
+	addi	x23, x1, 24
+	amomax.d	x24, x12, (x23)		# 0x8000000000000000, A[3] = 3
+	amomaxu.d	x25, x26, (x23)		# 3, A[3] = -1
+	amomin.d	x27, x12, (x23)		# -1
+	amoadd.d	x28, x12, (x23)		# -1, A[3] = 2
+	ld	x29, (x23)		# 2
+	lr.w	x30, (x11)		# 3
+	sc.w	x31, x12, (x11)		# success: 0
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,51 @@
+# Test of the Zba and Zbb bit-manipulation instructions. As in load.s, R1
+# is initialized with the address of A (0x11100, 69888 decimal).
+
+	.data
+	.align 8
+	.local	A
+A:
+	.dword	0x0123456789ab80f0
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	addi	x2, x0, -8		# 0xfffffffffffffff8
+	addi	x3, x0, 3
+	sh1add	x4, x3, x1		# 0x11106
+	sh2add	x5, x3, x1		# 0x1110c
+	sh3add	x6, x3, x1		# 0x11118
+	add.uw	x7, x2, x3		# 0xfffffffb
+	sh1add.uw	x8, x2, x0	# 0x1fffffff0
+	slli.uw	x9, x2, 4		# 0xfffffff80
+	andn	x10, x1, x3		# 0x11100
+	orn	x11, x0, x3		# 0xfffffffffffffffc
+	xnor	x12, x2, x3		# 4
+	clz	x13, x1			# 47
+	ctz	x14, x1			# 8
+	cpop	x15, x1			# 3
+	clzw	x16, x3			# 30
+	ctzw	x17, x0			# 32
+	cpopw	x18, x2			# 29
+	min	x19, x2, x3		# -8
+	minu	x20, x2, x3		# 3
+	max	x21, x2, x3		# 3
+	maxu	x22, x2, x3		# 0xfffffffffffffff8
+	ld	x24, (x1)		# 0x0123456789ab80f0
+	sext.b	x23, x24		# 0xfffffffffffffff0
+	sext.h	x25, x24		# 0xffffffffffff80f0
+	zext.h	x26, x2			# 0xfff8
+	rev8	x27, x24		# 0xf080ab8967452301
+	orc.b	x28, x1			# 0xffff00
+	rol	x29, x24, x3		# 0x091a2b3c4d5c0780
+	rori	x30, x24, 8		# 0xf00123456789ab80
+	rorw	x31, x24, x3		# 0x1135701e
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,37 @@
+# Test of the Zbs single-bit instructions and the word rotates. As in
+# load.s, R1 is initialized with the address of A (0x11100, 69888
+# decimal). Bit indices use the low six bits of the operand.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.dword	0x0123456789ab80f0
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	ld	x2, (x1)		# 0x0123456789ab80f0
+	addi	x3, x0, 63
+	addi	x4, x0, 4
+	bset	x5, x0, x3		# 0x8000000000000000
+	bclr	x6, x2, x4		# 0x0123456789ab80e0
+	binv	x7, x2, x3		# 0x8123456789ab80f0
+	bext	x8, x2, x4		# 1
+	bseti	x9, x0, 40		# 0x10000000000
+	bclri	x10, x2, 56		# 0x0023456789ab80f0
+	binvi	x11, x2, 0		# 0x0123456789ab80f1
+	bexti	x12, x2, 3		# 0
+	rolw	x13, x2, x4		# 0xffffffff9ab80f08
+	roriw	x14, x2, 4		# 0x089ab80f
+	addi	x16, x0, 65
+	bset	x15, x0, x16		# 2
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,74 @@
+# Test of the block device: two sectors of tests/block.img are read into
+# memory and written to the serial interface. The program waits for the
+# completion interrupt with wfi. A read beyond the end of the image is
+# rejected.
+
+	.data
+error:
+	.asciz	"rejected\n"
+
+	.bss
+	.align	3
+buffer:
+	.space	1024
+
+	.text
+	.globl	_start
+_start:
+	li	s0, 0x3000000		# block device
+	li	s1, 0x200		# serial
+	li	t0, 0x800		# MEIE
+	csrw	mie, t0
+	li	t0, 1
+	sd	t0, 0x30(s0)		# interrupt enable
+
+	sd	zero, 0x00(s0)		# sector
+	li	t0, 2
+	sd	t0, 0x08(s0)		# count
+	la	t0, buffer
+	sd	t0, 0x10(s0)		# buffer
+	li	t0, 1
+	sd	t0, 0x18(s0)		# read
+1:	wfi
+	ld	t0, 0x20(s0)
+	andi	t0, t0, 2		# done
+	beqz	t0, 1b
+	sd	zero, 0x20(s0)		# acknowledge
+
+	la	a0, buffer
+	call	print
+	la	a0, buffer + 512
+	call	print
+
+	ld	t0, 0x28(s0)		# capacity
+	sd	t0, 0x00(s0)
+	li	t0, 1
+	sd	t0, 0x08(s0)
+	sd	t0, 0x18(s0)		# read past the end
+1:	wfi
+	ld	t0, 0x20(s0)
+	andi	t1, t0, 2
+	beqz	t1, 1b
+	andi	t0, t0, 4		# error
+	sd	zero, 0x20(s0)
+	beqz	t0, done
+	la	a0, error
+	call	print
+
+done:
+	li	t2, 0x278		# system status: halt
+	sw	zero, 0(t2)
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+
+print:
+	lbu	t1, 0(a0)
+	beqz	t1, 1f
+	sb	t1, 0(s1)
+	addi	a0, a0, 1
+	j	print
+1:	ret
@@ -0,0 +1,82 @@
+# Compressed instructions. The pre conditions set x8 (s0) to the array
+# A and x2 (sp) to the second element of A. The 32-bit instructions in
+# between are not aligned to 4 bytes.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.dword 10, 20, 30, 40, 50, 60, 70, 80
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	c.nop
+	c.li	x10,5
+	c.addi	x10,3		# 8
+	c.lui	x17,1		# 0x1000
+	c.mv	x12,x10
+	c.add	x12,x10		# 16
+	c.slli	x12,34		# 0x4000000000
+	.option push
+	.option norvc
+	addi	x13,x0,-1	# 32-bit instruction at 2 mod 4
+	.option pop
+	c.srli	x13,60		# 15
+	c.ld	x14,8(x8)	# 20
+	c.lw	x15,16(x8)	# 30
+	c.sub	x15,x14		# 10
+	c.sd	x15,0(x8)	# A[0] = 10
+	c.ldsp	x16,16(x2)	# A[3] = 40
+	c.sdsp	x10,8(x2)	# A[2] = 8
+	c.ld	x9,16(x8)	# 8
+	c.addi16sp x2,16	# A + 24
+	c.addi4spn x11,x2,8	# A + 32
+	c.lwsp	x18,8(x2)	# 50
+	c.swsp	x18,0(x2)	# A[3] = 50
+	c.addiw	x18,-32		# 18
+	c.andi	x13,6		# 6
+	c.addw	x12,x10		# 8
+	c.subw	x12,x13		# 2
+	c.xor	x12,x10		# 10
+	c.or	x12,x9		# 10
+	c.and	x12,x13		# 2
+	c.li	x9,-20
+	c.srai	x9,1		# -10
+	c.li	x14,4
+	c.li	x15,0
+loop:
+	c.add	x15,x14
+	c.addi	x14,-1
+	c.bnez	x14,loop	# x15 = 10
+	c.beqz	x14,skip
+	c.li	x20,1
+skip:
+	c.j	over
+	c.li	x20,2
+func:
+	c.li	x22,7
+	c.jr	x1
+over:
+	.option push
+	.option norvc
+	jal	x1,func
+	.option pop
+	c.mv	x23,x22		# 7
+	c.nop
+	c.nop
+	c.nop
+	c.nop
+	c.nop
+	.option push
+	.option norvc
+	nop
+	nop
+	nop
+	nop
+	nop
+	.option pop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,53 @@
+# Test of the Zicsr instructions. As in load.s, R1 is initialized with the
+# address of A (0x11100, 69888 decimal). The counters depend on the
+# timing model, only the number of instructions retired between two reads
+# is fixed.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.double	1.0, 0.0
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	rdinstret	x2
+	rdcycle	x3
+	addi	x4, x0, 1
+	addi	x4, x4, 1
+	rdinstret	x5
+	rdcycle	x6
+	rdtime	x7
+	sub	x2, x5, x2		# 4 instructions retired
+	sltu	x3, x6, x3		# 0, cycle does not decrease
+	sltu	x7, x7, x6		# 0, nor does time
+
+	fld	f1, 0(x1)
+	fld	f2, 8(x1)
+	fdiv.d	f3, f1, f2
+	frflags	x8			# 0x08, divide by zero
+	csrrsi	x9, fflags, 0x01	# 0x08
+	csrrci	x10, fflags, 0x08	# 0x09
+	frflags	x11			# 0x01
+	fsrmi	x12, 2			# 0, was RNE
+	frrm	x13			# 2, RDN
+	fdiv.d	f4, f1, f2, rne
+	frcsr	x14			# 0x49
+	addi	x15, x0, 0x20
+	csrrw	x15, fcsr, x15		# 0x49
+	frcsr	x16			# 0x20
+	csrrs	x17, frm, x0		# 1
+
+	vsetivli	x18, 3, e32, m1, ta, ma
+	csrr	x19, vl			# 3
+	csrr	x20, vtype		# 0xd0
+	csrr	x21, vlenb		# 16
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word 0xddffccff
@@ -0,0 +1,90 @@
+# Test of the DMA engine: a single block copy, a chain of two descriptors
+# that gathers two blocks, and a copy to the text segment and a copy with a
+# length that wraps around the address space, which are rejected. The program polls the status register for completion.
+
+	.data
+	.align	3
+src:
+	.dword	1, 2, 3, 4, 5, 6, 7, 8
+desc0:
+	.dword	src, dst2, 16, desc1
+desc1:
+	.dword	src + 48, dst2 + 16, 16, 0
+
+	.bss
+	.align	3
+dst:
+	.space	64
+dst2:
+	.space	32
+
+	.text
+	.globl	_start
+_start:
+	li	s0, 0x3001000		# DMA engine
+	la	t0, src
+	sd	t0, 0x00(s0)		# source
+	la	t0, dst
+	sd	t0, 0x08(s0)		# destination
+	li	t0, 64
+	sd	t0, 0x10(s0)		# length
+	li	t0, 1
+	sd	t0, 0x18(s0)		# start
+	call	wait
+	sd	zero, 0x20(s0)		# acknowledge
+	la	a0, dst
+	li	a1, 8
+	call	sum
+	mv	s2, a0			# 36
+
+	la	t0, desc0
+	sd	t0, 0x00(s0)
+	li	t0, 3
+	sd	t0, 0x18(s0)		# start a chain
+	call	wait
+	sd	zero, 0x20(s0)
+	la	a0, dst2
+	li	a1, 4
+	call	sum
+	mv	s3, a0			# 1 + 2 + 7 + 8 = 18
+
+	la	t0, _start
+	sd	t0, 0x08(s0)		# destination in the text segment
+	li	t0, 1
+	sd	t0, 0x18(s0)
+	call	wait
+	mv	s4, a0			# done and error
+	sd	zero, 0x20(s0)
+	ld	s5, 0x20(s0)		# 0 after the acknowledgement
+
+	la	t0, dst
+	sd	t0, 0x08(s0)
+	li	t0, -16
+	sd	t0, 0x10(s0)		# length
+	li	t0, 1
+	sd	t0, 0x18(s0)
+	call	wait
+	mv	s6, a0			# done and error
+	sd	zero, 0x20(s0)
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+
+wait:
+	ld	a0, 0x20(s0)
+	andi	t0, a0, 2
+	beqz	t0, wait
+	ret
+
+sum:
+	li	t0, 0
+1:	ld	t1, 0(a0)
+	add	t0, t0, t1
+	addi	a0, a0, 8
+	addi	a1, a1, -1
+	bnez	a1, 1b
+	mv	a0, t0
+	ret
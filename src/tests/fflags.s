@@ -0,0 +1,40 @@
+# Test of the accrued exception flags in fflags. As in load.s, R1 is
+# initialized with the address of A (0x11100, 69888 decimal). Every
+# floating-point instruction adds its flags: NX (0x01), DZ (0x08) and NV
+# (0x10) accumulate until fsflags clears them.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.double	1.0, 3.0, 0.0, -1.0
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	fld	f1, 0(x1)
+	fld	f2, 8(x1)
+	fld	f3, 16(x1)
+	fld	f4, 24(x1)
+	frflags	x2			# 0
+	fdiv.d	f5, f1, f2		# 1/3: inexact
+	frflags	x3			# NX
+	fdiv.d	f6, f1, f3		# 1/0: divide by zero
+	frflags	x4			# NX | DZ
+	fsqrt.d	f7, f4			# sqrt(-1): invalid
+	frflags	x5			# NX | DZ | NV
+	fadd.d	f8, f1, f1		# exact, no flags
+	fsflags	x6, x0			# NX | DZ | NV, cleared
+	frflags	x7			# 0
+	fadd.d	f9, f1, f2		# exact
+	csrr	x8, fcsr		# 0
+	fdiv.d	f10, f1, f3		# divide by zero
+	frflags	x9			# DZ
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
@@ -0,0 +1,81 @@
+# Test of the RV64F and RV64D instructions. As in load.s, R1 is
+# initialized with the address of A (0x11100, 69888 decimal). Results are
+# moved to the integer registers to be verified. Single-precision values
+# are NaN-boxed in the floating-point registers.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.double	1.5, 2.25, -3.0
+	.float	1.0, 3.0
+	.dword	0, 0
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	fld	f1, 0(x1)
+	fld	f2, 8(x1)
+	fld	f3, 16(x1)
+	fadd.d	f4, f1, f2
+	fmv.x.d	x2, f4			# 3.75
+	fmul.d	f5, f1, f3
+	fmv.x.d	x3, f5			# -4.5
+	fdiv.d	f6, f2, f1
+	fmv.x.d	x4, f6			# 1.5
+	fmadd.d	f7, f1, f2, f3
+	fmv.x.d	x5, f7			# 0.375
+	fsqrt.d	f8, f2
+	feq.d	x6, f8, f1		# 1
+	flt.d	x7, f3, f1		# 1
+	fcvt.l.d	x8, f5		# -4, ties to even
+	fcvt.l.d	x9, f5, rdn	# -5
+	fcvt.w.d	x10, f5, rtz	# -4
+	fcvt.wu.d	x11, f3		# invalid: 0
+
+	flw	f9, 24(x1)
+	flw	f10, 28(x1)
+	fdiv.s	f11, f9, f10
+	fmv.x.w	x12, f11		# 1/3 rounded up
+	fdiv.s	f12, f9, f10, rtz
+	fmv.x.d	x13, f12		# 1/3 rounded down, boxed
+	fcvt.d.s	f13, f11
+	fmv.x.d	x14, f13
+	fcvt.s.d	f14, f2
+	fsgnjn.s	f14, f14, f14
+	fmv.x.w	x15, f14		# -2.25
+	fcvt.d.l	f15, x9
+	fmv.x.d	x16, f15		# -5.0
+	fmin.d	f16, f1, f3
+	fmv.x.d	x17, f16		# -3.0
+
+	fsub.d	f17, f3, f3
+	fdiv.d	f18, f1, f17
+	fmv.x.d	x18, f18		# +inf
+	fsub.d	f19, f18, f18
+	fmv.x.d	x19, f19		# canonical NaN
+	fclass.d	x20, f18	# positive infinity
+	fmax.d	f20, f19, f1
+	fmv.x.d	x21, f20		# 1.5
+
+	fsw	f11, 32(x1)
+	lw	x22, 32(x1)
+	fsd	f5, 40(x1)
+	ld	x23, 40(x1)
+
+	fmv.d.x	f21, x2
+	fadd.s	f22, f21, f9
+	fmv.x.d	x24, f22		# not boxed: canonical NaN
+	fcvt.s.w	f23, x10
+	fclass.s	x25, f23	# negative normal
+	fcvt.l.d	x26, f19	# NaN: largest integer
+	fcvt.lu.d	x27, f3		# invalid: 0
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
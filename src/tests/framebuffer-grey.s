@@ -0,0 +1,36 @@
+# Test of the framebuffer capture in Y8 mode: a 19x2 frame is drawn, so
+# that the grey kernel converts 16 pixels at once and the rest one at a
+# time. With a capture interval of 1000 cycles, the full frame is
+# captured first. Then a single pixel of the second row is changed, which
+# is captured at the halt by converting only that row again.
+
+	.text
+	.globl	_start
+_start:
+	li	s0, 0x800		# framebuffer control
+	sw	zero, 0x04(s0)		# mode: Y8
+	li	t0, 19
+	sw	t0, 0x08(s0)		# resx
+	li	t0, 2
+	sw	t0, 0x0c(s0)		# resy
+	li	t0, 1
+	sw	t0, 0x00(s0)		# enable
+
+	li	s1, 0x1000000		# framebuffer memory
+	li	t0, 0			# pixel
+	li	t1, 38			# number of pixels
+1:	addi	t2, t0, 0x30		# grey level
+	add	t3, s1, t0
+	sb	t2, 0(t3)
+	addi	t0, t0, 1
+	bne	t0, t1, 1b
+
+	li	t0, 1000		# wait for the capture
+2:	addi	t0, t0, -1
+	bnez	t0, 2b
+
+	li	t0, 0x70
+	sb	t0, 37(s1)		# last pixel of the second row
+
+	li	t0, 0x278
+	sw	zero, 0(t0)
@@ -0,0 +1,37 @@
+# Test of the framebuffer capture in indexed mode: a 37x2 frame is drawn
+# with four palette entries, so that the palette kernel converts 8 pixels
+# at once and the remaining 2 one at a time. Captured as a Y4M video, all
+# three planes consist of printable characters.
+
+	.text
+	.globl	_start
+_start:
+	li	s0, 0x800		# framebuffer control
+	li	t0, 1
+	sw	t0, 0x04(s0)		# mode: 8-bit indexed
+	li	t0, 37
+	sw	t0, 0x08(s0)		# resx
+	li	t0, 2
+	sw	t0, 0x0c(s0)		# resy
+	li	t0, 1
+	sw	t0, 0x00(s0)		# enable
+	li	t0, 0x105020ff
+	sw	t0, 0x10(s0)		# palette[0]: RGBA 16, 80, 32, 255
+	li	t0, 0x00a010ff
+	sw	t0, 0x14(s0)		# palette[1]: RGBA 0, 160, 16, 255
+	li	t0, 0x406050ff
+	sw	t0, 0x18(s0)		# palette[2]: RGBA 64, 96, 80, 255
+	li	t0, 0x10b070ff
+	sw	t0, 0x1c(s0)		# palette[3]: RGBA 16, 176, 112, 255
+
+	li	s1, 0x1000000		# framebuffer memory
+	li	t0, 0			# pixel
+	li	t1, 74			# number of pixels
+1:	andi	t2, t0, 3		# palette index
+	add	t3, s1, t0
+	sb	t2, 0(t3)
+	addi	t0, t0, 1
+	bne	t0, t1, 1b
+
+	li	t0, 0x278
+	sw	zero, 0(t0)
@@ -0,0 +1,25 @@
+# Test of the framebuffer capture: a 4x2 frame in indexed mode is drawn
+# with a dark green palette entry. Captured as a Y4M video, all three
+# planes consist of printable characters.
+
+	.text
+	.globl	_start
+_start:
+	li	s0, 0x800		# framebuffer control
+	li	t0, 1
+	sw	t0, 0x04(s0)		# mode: 8-bit indexed
+	li	t0, 4
+	sw	t0, 0x08(s0)		# resx
+	li	t0, 2
+	sw	t0, 0x0c(s0)		# resy
+	li	t0, 1
+	sw	t0, 0x00(s0)		# enable
+	li	t0, 0x006400ff
+	sw	t0, 0x14(s0)		# palette[1]: RGBA 0, 100, 0, 255
+
+	li	s1, 0x1000000		# framebuffer memory
+	li	t0, 0x0101010101010101
+	sd	t0, 0(s1)		# all pixels use palette[1]
+
+	li	t0, 0x278
+	sw	zero, 0(t0)
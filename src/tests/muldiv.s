@@ -0,0 +1,37 @@
+# M extension, including the corner cases of division. The divisions
+# by zero and the signed overflow cases must not trap.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	mul	x10,x1,x2
+	mulh	x11,x1,x2
+	mulhsu	x12,x1,x2
+	mulhu	x13,x1,x2
+	div	x14,x1,x3
+	divu	x15,x1,x3
+	rem	x16,x1,x3
+	remu	x17,x1,x3
+	div	x18,x1,x0	# division by zero
+	rem	x19,x1,x0
+	divu	x20,x1,x0
+	remu	x21,x1,x0
+	div	x22,x4,x5	# signed overflow
+	rem	x23,x4,x5
+	mulw	x24,x1,x2
+	divw	x25,x1,x3
+	divuw	x26,x1,x3
+	remw	x27,x1,x3
+	remuw	x28,x1,x3
+	divw	x29,x6,x5	# signed overflow
+	remw	x30,x6,x5
+	divuw	x31,x1,x0	# division by zero
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,35 @@
+# Test of serial input: the received bytes are written back in upper
+# case, until the end of the input.
+
+	.text
+	.globl	_start
+_start:
+	li	t2, 0x200		# serial
+	li	t3, 'a'
+	li	t4, 'z'
+	li	s0, 0			# number of bytes
+loop:
+	lbu	t0, 1(t2)		# status
+	andi	t1, t0, 1		# RxReady
+	bnez	t1, receive
+	andi	t1, t0, 2		# RxEnded
+	beqz	t1, loop
+	j	done
+receive:
+	lbu	t0, 0(t2)
+	addi	s0, s0, 1
+	bltu	t0, t3, send
+	bltu	t4, t0, send
+	addi	t0, t0, -32
+send:
+	sb	t0, 0(t2)
+	j	loop
+done:
+	li	t2, 0x278		# system status: halt
+	sw	zero, 0(t2)
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
@@ -0,0 +1,27 @@
+# Test of the serial interface: the last line of output does not end
+# with a newline, it is written when the program halts.
+
+	.data
+msg:
+	.asciz	"line\npartial"
+
+	.text
+	.globl	_start
+_start:
+	la	t0, msg
+	li	t2, 0x200		# serial
+loop:
+	lbu	t1, 0(t0)
+	beqz	t1, done
+	sb	t1, 0(t2)
+	addi	t0, t0, 1
+	j	loop
+done:
+	li	t2, 0x278		# system status: halt
+	sw	zero, 0(t2)
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
@@ -0,0 +1,61 @@
+# Test of the CLINT. A software interrupt is raised by writing msip, then
+# a timer interrupt by setting mtimecmp 50 ticks ahead. The handler counts
+# the interrupts per cause and clears the interrupt it took. mtime is 1
+# tick per cycle, the latency of the interrupts depends on the model.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	la	x5, handler
+	csrw	mtvec, x5
+	li	x20, 0x2000000		# CLINT
+	li	x21, 0x2004000		# mtimecmp
+	li	x22, 0x200bff8		# mtime
+	li	x5, 0x88		# MSIE, MTIE
+	csrw	mie, x5
+	csrsi	mstatus, 8		# MIE
+	j	main
+
+handler:
+	csrr	x6, mcause
+	andi	x6, x6, 0xff
+	li	x7, 3
+	bne	x6, x7, timer
+	addi	x10, x10, 1		# software interrupt
+	sw	zero, 0(x20)
+	mret
+timer:
+	addi	x11, x11, 1		# timer interrupt
+	ld	x12, 0(x22)		# mtime
+	sub	x12, x12, x13		# ticks since mtimecmp
+	li	x7, -1
+	sd	x7, 0(x21)
+	mret
+
+main:
+	li	x5, 1
+	sw	x5, 0(x20)		# msip
+1:	beqz	x10, 1b
+	lw	x14, 0(x20)		# 0, cleared by the handler
+
+	ld	x15, 0(x22)		# mtime
+	csrr	x16, time
+	sub	x16, x16, x15		# time reads mtime, a few ticks later
+	sltiu	x16, x16, 64
+
+	ld	x13, 0(x22)
+	addi	x13, x13, 50
+	sd	x13, 0(x21)
+wait:
+	beqz	x11, wait
+	sltiu	x12, x12, 64		# the interrupt is taken in time
+
+	lw	x17, 4(x21)		# upper half of mtimecmp, all ones
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word 0xddffccff
@@ -0,0 +1,51 @@
+# Test of machine-mode traps. Every trap enters the handler, which counts
+# the traps, adds up their causes and returns to the instruction after
+# the one that trapped. The instruction that traps has no effect.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	la	x5, handler
+	csrw	mtvec, x5
+	csrsi	mstatus, 8		# MIE
+	j	main
+
+handler:
+	csrr	x6, mcause
+	csrr	x7, mepc
+	csrr	x8, mstatus		# 0x1880, MIE cleared and saved in MPIE
+	addi	x10, x10, 1
+	add	x12, x12, x6
+	addi	x7, x7, 4
+	csrw	mepc, x7
+	mret
+
+main:
+	addi	x9, x0, 7
+	la	x13, site
+
+site:
+	ecall				# cause 11
+	addi	x11, x11, 1
+	sub	x14, x7, x13		# 4, mepc was the address of the ecall
+	ebreak				# cause 3
+	addi	x11, x11, 1
+	.word	0xffffffff		# illegal instruction, cause 2
+	addi	x11, x11, 1
+	.word	0x023150d3		# fadd.d with rounding mode 5, cause 2
+	addi	x11, x11, 1
+	.word	0xc0049073		# csrw cycle, x9: read-only, cause 2
+	addi	x11, x11, 1
+	csrr	x16, mstatus		# 0x1888, MIE restored by mret
+	csrw	mscratch, x9
+	csrr	x17, mscratch		# 7
+	csrr	x18, mtval		# 0
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word 0xddffccff
+
@@ -0,0 +1,189 @@
+# Test of Linux user mode, with the arguments "hello world".
+# The program prints its arguments and the first line of this file, and
+# checks the results of the other system calls. The output ends with
+# "writev ok" when all checks pass.
+
+	.macro	sys number
+	li	a7, \number
+	ecall
+	.endm
+
+	.macro	print str, len
+	li	a0, 1
+	la	a1, \str
+	li	a2, \len
+	sys	64			# write
+	.endm
+
+	.data
+	.align 8
+path:
+	.asciz	"tests/user.s"
+newline:
+	.ascii	"\n"
+ok:
+	.ascii	"ok\n"
+failed:
+	.ascii	"failed\n"
+writev:
+	.ascii	"writev "
+iov:
+	.dword	writev, 7, ok, 3
+	.bss
+	.align 8
+stat:
+	.zero	128
+time:
+	.zero	16
+buffer:
+	.zero	64
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	ld	s0, 0(sp)		# argc
+	li	t0, 3
+	bne	s0, t0, fail
+
+	ld	a0, 16(sp)		# argv[1]
+	call	puts
+	ld	a0, 24(sp)		# argv[2]
+	call	puts
+	ld	t0, 32(sp)		# argv[3] is NULL, followed by envp
+	bnez	t0, fail
+
+	li	a0, -100		# AT_FDCWD
+	la	a1, path
+	li	a2, 0			# O_RDONLY
+	sys	56			# openat
+	li	t0, 3
+	bne	a0, t0, fail
+	mv	s1, a0
+
+	mv	a0, s1
+	la	a1, stat
+	sys	80			# fstat
+	bnez	a0, fail
+	la	t0, stat
+	ld	s2, 48(t0)		# st_size
+
+	mv	a0, s1
+	la	a1, buffer
+	li	a2, 63
+	sys	63			# read
+	li	t0, 63
+	bne	a0, t0, fail
+	la	a0, buffer
+	call	puts			# first line
+
+	mv	a0, s1
+	li	a1, 0
+	li	a2, 2			# SEEK_END
+	sys	62			# lseek
+	bne	a0, s2, fail
+
+	mv	a0, s1
+	sys	57			# close
+	bnez	a0, fail
+	li	a0, 99
+	la	a1, buffer
+	li	a2, 1
+	sys	63			# read from a closed file
+	li	t0, -9			# EBADF
+	bne	a0, t0, fail
+
+	li	a0, 0
+	la	a1, buffer
+	li	a2, -16
+	sys	63			# read beyond the end of memory
+	li	t0, -14			# EFAULT
+	bne	a0, t0, fail
+	li	a0, 1
+	la	a1, buffer
+	li	a2, -16
+	sys	64			# write beyond the end of memory
+	li	t0, -14			# EFAULT
+	bne	a0, t0, fail
+
+	li	a0, 0
+	sys	214			# brk
+	mv	s3, a0
+	li	t0, 8192
+	add	a0, s3, t0
+	sys	214
+	li	t0, 8192
+	add	t0, s3, t0
+	bne	a0, t0, fail
+	sd	t0, -8(t0)
+	ld	t1, -8(t0)
+	bne	t0, t1, fail
+
+	li	a0, 0
+	li	a1, 10000
+	li	a2, 3			# PROT_READ | PROT_WRITE
+	li	a3, 0x22		# MAP_PRIVATE | MAP_ANONYMOUS
+	li	a4, -1
+	li	a5, 0
+	sys	222			# mmap
+	slli	t0, a0, 52		# page aligned
+	bnez	t0, fail
+	bltu	a0, s3, fail
+	mv	s4, a0
+	li	t0, 9992
+	add	t0, s4, t0
+	ld	t1, 0(t0)		# cleared
+	bnez	t1, fail
+	sd	t0, 0(t0)
+	mv	a0, s4
+	li	a1, 10000
+	sys	215			# munmap
+	bnez	a0, fail
+
+	li	a0, 1			# CLOCK_MONOTONIC
+	la	a1, time
+	sys	113			# clock_gettime
+	bnez	a0, fail
+	la	t0, time
+	ld	t1, 0(t0)
+	ld	t2, 8(t0)
+	or	t1, t1, t2
+	beqz	t1, fail
+	li	t1, 0			# keep the register dump reproducible
+	li	t2, 0
+
+	sys	1234			# unknown
+	li	t0, -38			# ENOSYS
+	bne	a0, t0, fail
+
+	li	a0, 1
+	la	a1, iov
+	li	a2, 2
+	sys	66			# writev
+	li	t0, 10
+	bne	a0, t0, fail
+
+	li	a0, 0
+	sys	93			# exit
+
+fail:
+	print	failed, 7
+	li	a0, 1
+	sys	93
+
+# Print the string at a0 up to the first newline or NUL, and a newline.
+puts:
+	mv	t0, a0
+1:	lbu	t1, 0(t0)
+	beqz	t1, 2f
+	li	t2, 10
+	beq	t1, t2, 2f
+	addi	t0, t0, 1
+	j	1b
+2:	mv	a1, a0
+	sub	a2, t0, a0
+	li	a0, 1
+	sys	64
+	print	newline, 1
+	ret
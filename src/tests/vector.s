@@ -0,0 +1,75 @@
+# Test of the vector instructions, with the default VLEN of 128 bits. As
+# in load.s, R1 is initialized with the address of A (0x11100, 69888
+# decimal). C is used for the results of stores.
+
+	.data
+	.align 8
+	.local	A
+A:
+	.word	1, 2, 3, 4, 5, 6, 7, 8
+	.word	10, 20, 30, 40, 50, 60, 70, 80
+C:
+	.zero	32
+	.size	A, .-A
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	addi	x2, x0, 5
+	vsetvli	x3, x2, e32, m1, ta, ma		# VLMAX 4
+	vsetvli	x4, x2, e32, m2, ta, ma		# 5
+	vle32.v	v2, (x1)			# 1, 2, 3, 4, 5
+	addi	x5, x1, 32
+	vle32.v	v4, (x5)			# 10, 20, 30, 40, 50
+	vadd.vv	v6, v2, v4			# 11, 22, 33, 44, 55
+	vmv.s.x	v8, x0
+	vredsum.vs	v8, v6, v8		# 165
+	vmv.x.s	x6, v8
+	vmul.vx	v10, v2, x2			# 5, 10, 15, 20, 25
+	vrsub.vi	v12, v2, 10		# 9, 8, 7, 6, 5
+	vsub.vv	v14, v4, v2			# 9, 18, 27, 36, 45
+	vredsum.vs	v16, v12, v14		# 35 + 9
+	vmv.x.s	x7, v16
+	addi	x8, x1, 64
+	vse32.v	v10, (x8)
+	# Strided byte loads of the low bytes of all 16 words
+	vsetivli	x9, 16, e8, m1, tu, mu
+	addi	x10, x0, 4
+	vlse8.v	v16, (x1), x10
+	vredsum.vs	v17, v16, v0		# 396 modulo 256, sign-extended
+	vmv.x.s	x11, v17
+	vmul.vv	v18, v16, v16
+	vmv.s.x	v19, x0
+	vredsum.vs	v19, v18, v19		# 20604 modulo 256
+	vmv.x.s	x12, v19
+	vsetvli	x13, x0, e64, m4, ta, ma	# VLMAX 8
+	vmv.v.i	v20, -3
+	vmv.v.i	v24, 0
+	vredsum.vs	v24, v20, v24		# -24
+	vmv.x.s	x14, v24
+	vmv.v.x	v24, x1
+	vxor.vv	v24, v24, v20
+	vmv.x.s	x15, v24			# 0x11100 ^ -3
+	vand.vi	v28, v24, 15
+	vor.vx	v28, v28, x2
+	vredor.vs	v1, v28, v28		# 13
+	vmv.x.s	x16, v1
+	addi	x17, x0, 0x10			# e32, m1
+	vsetvl	x18, x2, x17			# 4
+	vsetvli	x19, x2, e64, mf8, ta, ma	# vill: 0
+	vsetivli	x0, 3, e32, m1, ta, ma
+	addi	x20, x0, 8
+	vsse32.v	v10, (x8), x20		# 5, 10, 15 every 8 bytes
+	ld	x21, 64(x1)			# 10, 5
+	lw	x22, 72(x1)			# 10
+	lw	x23, 80(x1)			# 15
+	lw	x24, 76(x1)			# 20
+	vsetvli	x25, x0, e16, mf2, ta, ma	# VLMAX 4
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word	0xddffccff
+	.size	_start, .-_start
@@ -0,0 +1,51 @@
+# Test of waiting for the CLINT timer. wfi is executed with only the timer
+# interrupt enabled in mie, so it returns without taking the interrupt
+# once mtime reaches mtimecmp. Next, the program spins until the handler
+# of the timer interrupt sets a flag. Both waits are fast-forwarded to the
+# timer event, unless the model simulates every cycle.
+
+	.text
+	.align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	la	x5, handler
+	csrw	mtvec, x5
+	li	x21, 0x2004000		# mtimecmp
+	li	x22, 0x200bff8		# mtime
+	li	x6, 100000
+	li	x5, 0x80		# MTIE
+	csrw	mie, x5
+
+	ld	x13, 0(x22)
+	add	x13, x13, x6
+	sd	x13, 0(x21)
+1:	wfi
+	ld	x10, 0(x22)
+	bltu	x10, x13, 1b
+	li	x10, 1			# woken at mtimecmp
+	csrr	x14, mcause		# 0, no trap was taken
+	li	x7, -1
+	sd	x7, 0(x21)
+
+	csrsi	mstatus, 8		# MIE
+	ld	x13, 0(x22)
+	add	x13, x13, x6
+	sd	x13, 0(x21)
+wait:
+	beqz	x11, wait
+	sltu	x12, x12, x13
+	xori	x12, x12, 1		# the interrupt is not taken early
+	nop
+	nop
+	nop
+	nop
+	nop
+	.word 0xddffccff
+
+handler:
+	addi	x11, x11, 1
+	ld	x12, 0(x22)		# mtime
+	li	x7, -1
+	sd	x7, 0(x21)
+	mret
@@ -0,0 +1,305 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    vector-kernels.cc - Host SIMD kernels of the vector unit.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "vector-kernels.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/* GCC and Clang only allow the intrinsics of the instruction sets that a
+ * function is compiled for, MSVC allows all of them in any function. The
+ * emulator itself is compiled for the baseline instruction set.
+ */
+#ifdef _MSC_VER
+#define TARGET_SSE42
+#define TARGET_AVX2
+#else
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+template <typename T>
+T
+loadElement(const uint8_t* p)
+{
+  T value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+template <typename T>
+void
+storeElement(uint8_t* p, T value)
+{
+  std::memcpy(p, &value, sizeof(value));
+}
+
+template <KernelOp Op, typename T>
+T
+apply(T a, T b)
+{
+  if constexpr (Op == KernelOp::Add)
+    return static_cast<T>(a + b);
+  else if constexpr (Op == KernelOp::Sub)
+    return static_cast<T>(a - b);
+  /* Multiply as 64-bit values, the operands would be promoted to int. */
+  else if constexpr (Op == KernelOp::Mul)
+    return static_cast<T>(static_cast<uint64_t>(a) * b);
+  else if constexpr (Op == KernelOp::And)
+    return a & b;
+  else if constexpr (Op == KernelOp::Or)
+    return a | b;
+  else
+    return a ^ b;
+}
+
+/* One element at a time; also handles the remaining elements of the SIMD
+ * kernels.
+ */
+template <KernelOp Op, typename T>
+struct ScalarKernel {
+  static void run(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n)
+  {
+    for (size_t i = 0; i < n * sizeof(T); i += sizeof(T)) {
+      const T x = loadElement<T>(a + i);
+      const T y = loadElement<T>(b + i);
+      storeElement<T>(dst + i, apply<Op, T>(x, y));
+    }
+  }
+};
+
+#ifdef HAVE_X86_KERNELS
+
+/* SSE has no multiplication of 8-bit and 64-bit lanes. Bytes are
+ * multiplied as the low and high halves of 16-bit lanes; 64-bit lanes
+ * from the 32-bit partial products, of which only the low 64 bits of the
+ * result are needed.
+ */
+template <KernelOp Op, typename T>
+TARGET_SSE42 __m128i
+apply128(__m128i a, __m128i b)
+{
+  constexpr size_t width = sizeof(T);
+
+  if constexpr (Op == KernelOp::Add) {
+    if constexpr (width == 1)
+      return _mm_add_epi8(a, b);
+    else if constexpr (width == 2)
+      return _mm_add_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm_add_epi32(a, b);
+    else
+      return _mm_add_epi64(a, b);
+  } else if constexpr (Op == KernelOp::Sub) {
+    if constexpr (width == 1)
+      return _mm_sub_epi8(a, b);
+    else if constexpr (width == 2)
+      return _mm_sub_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm_sub_epi32(a, b);
+    else
+      return _mm_sub_epi64(a, b);
+  } else if constexpr (Op == KernelOp::Mul) {
+    if constexpr (width == 1) {
+      const __m128i even = _mm_mullo_epi16(a, b);
+      const __m128i odd =
+          _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+      return _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0xFF)),
+                          _mm_slli_epi16(odd, 8));
+    } else if constexpr (width == 2)
+      return _mm_mullo_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm_mullo_epi32(a, b);
+    else {
+      const __m128i low = _mm_mul_epu32(a, b);
+      const __m128i cross =
+          _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                        _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+      return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+    }
+  } else if constexpr (Op == KernelOp::And)
+    return _mm_and_si128(a, b);
+  else if constexpr (Op == KernelOp::Or)
+    return _mm_or_si128(a, b);
+  else
+    return _mm_xor_si128(a, b);
+}
+
+template <KernelOp Op, typename T>
+TARGET_AVX2 __m256i
+apply256(__m256i a, __m256i b)
+{
+  constexpr size_t width = sizeof(T);
+
+  if constexpr (Op == KernelOp::Add) {
+    if constexpr (width == 1)
+      return _mm256_add_epi8(a, b);
+    else if constexpr (width == 2)
+      return _mm256_add_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm256_add_epi32(a, b);
+    else
+      return _mm256_add_epi64(a, b);
+  } else if constexpr (Op == KernelOp::Sub) {
+    if constexpr (width == 1)
+      return _mm256_sub_epi8(a, b);
+    else if constexpr (width == 2)
+      return _mm256_sub_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm256_sub_epi32(a, b);
+    else
+      return _mm256_sub_epi64(a, b);
+  } else if constexpr (Op == KernelOp::Mul) {
+    if constexpr (width == 1) {
+      const __m256i even = _mm256_mullo_epi16(a, b);
+      const __m256i odd =
+          _mm256_mullo_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+      return _mm256_or_si256(_mm256_and_si256(even, _mm256_set1_epi16(0xFF)),
+                             _mm256_slli_epi16(odd, 8));
+    } else if constexpr (width == 2)
+      return _mm256_mullo_epi16(a, b);
+    else if constexpr (width == 4)
+      return _mm256_mullo_epi32(a, b);
+    else {
+      const __m256i low = _mm256_mul_epu32(a, b);
+      const __m256i cross =
+          _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                           _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+      return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+    }
+  } else if constexpr (Op == KernelOp::And)
+    return _mm256_and_si256(a, b);
+  else if constexpr (Op == KernelOp::Or)
+    return _mm256_or_si256(a, b);
+  else
+    return _mm256_xor_si256(a, b);
+}
+
+template <KernelOp Op, typename T>
+struct SSEKernel {
+  TARGET_SSE42 static void
+  run(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n)
+  {
+    const size_t bytes = n * sizeof(T);
+    size_t i = 0;
+    for (; i + sizeof(__m128i) <= bytes; i += sizeof(__m128i)) {
+      const __m128i x =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      const __m128i y =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                       apply128<Op, T>(x, y));
+    }
+    ScalarKernel<Op, T>::run(dst + i, a + i, b + i, (bytes - i) / sizeof(T));
+  }
+};
+
+template <KernelOp Op, typename T>
+struct AVX2Kernel {
+  TARGET_AVX2 static void
+  run(uint8_t* dst, const uint8_t* a, const uint8_t* b, size_t n)
+  {
+    const size_t bytes = n * sizeof(T);
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= bytes; i += sizeof(__m256i)) {
+      const __m256i x =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      const __m256i y =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                          apply256<Op, T>(x, y));
+    }
+    SSEKernel<Op, T>::run(dst + i, a + i, b + i, (bytes - i) / sizeof(T));
+  }
+};
+
+#endif /* HAVE_X86_KERNELS */
+
+template <template <KernelOp, typename> class Kernel, KernelOp Op>
+constexpr std::array<VectorKernel, 4>
+kernelsForWidths()
+{
+  return {Kernel<Op, uint8_t>::run, Kernel<Op, uint16_t>::run,
+          Kernel<Op, uint32_t>::run, Kernel<Op, uint64_t>::run};
+}
+
+template <template <KernelOp, typename> class Kernel>
+VectorKernels
+makeKernels(const char* isa)
+{
+  return {isa,
+          {kernelsForWidths<Kernel, KernelOp::Add>(),
+           kernelsForWidths<Kernel, KernelOp::Sub>(),
+           kernelsForWidths<Kernel, KernelOp::Mul>(),
+           kernelsForWidths<Kernel, KernelOp::And>(),
+           kernelsForWidths<Kernel, KernelOp::Or>(),
+           kernelsForWidths<Kernel, KernelOp::Xor>()}};
+}
+
+VectorKernels
+selectKernels()
+{
+#ifdef HAVE_X86_KERNELS
+  if (hostSupportsAVX2())
+    return makeKernels<AVX2Kernel>("AVX2");
+  if (hostSupportsSSE42())
+    return makeKernels<SSEKernel>("SSE4.2");
+#endif
+  return makeKernels<ScalarKernel>("scalar");
+}
+
+} // namespace
+
+#ifdef HAVE_X86_KERNELS
+
+bool
+hostSupportsSSE42()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return info[2] & (1 << 20);
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+bool
+hostSupportsAVX2()
+{
+#ifdef _MSC_VER
+  /* The operating system also has to preserve the YMM registers. */
+  int info[4];
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+const VectorKernels&
+getVectorKernels()
+{
+  static const VectorKernels kernels = selectKernels();
+  return kernels;
+}
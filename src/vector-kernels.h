@@ -0,0 +1,52 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    vector-kernels.h - Host SIMD kernels of the vector unit.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __VECTOR_KERNELS_H__
+#define __VECTOR_KERNELS_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class KernelOp { Add, Sub, Mul, And, Or, Xor, LAST };
+
+/* Computes dst[i] = a[i] op b[i] for n elements, which are stored
+ * little-endian as in the vector registers. dst may be equal to a or b,
+ * but may not overlap them otherwise.
+ */
+using VectorKernel = void (*)(uint8_t* dst, const uint8_t* a,
+                              const uint8_t* b, size_t n);
+
+/* The kernels of a single host instruction set, for every operation and
+ * element width.
+ */
+struct VectorKernels {
+  const char* isa;
+  std::array<std::array<VectorKernel, 4>, static_cast<size_t>(KernelOp::LAST)>
+      kernels;
+
+  /* The element width is given as log2 of its size in bytes. */
+  VectorKernel get(KernelOp op, unsigned widthLog2) const
+  {
+    return kernels[static_cast<size_t>(op)][widthLog2];
+  }
+};
+
+#if defined(__x86_64__) || defined(_M_X64)
+/* Whether the host supports the instruction sets, as well as the operating
+ * system.
+ */
+bool hostSupportsSSE42();
+bool hostSupportsAVX2();
+#endif
+
+/* The kernels for the best instruction set that the host supports: AVX2,
+ * SSE4.2 or plain C++. This is determined once, at the first call.
+ */
+const VectorKernels& getVectorKernels();
+
+#endif /* __VECTOR_KERNELS_H__ */
@@ -0,0 +1,330 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    vector-unit.cc - Vector unit, a subset of the V extension.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "vector-unit.h"
+
+#include "inst-decoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t NumVectorRegs = 32;
+
+/* vtype after an unsupported configuration was requested. */
+constexpr RegValue VTypeIllegal = RegValue{1} << 63;
+
+uint64_t
+readElement(MemoryBus& bus, MemAddress addr, unsigned size)
+{
+  switch (size) {
+  case 1:
+    return bus.readByte(addr);
+  case 2:
+    return bus.readHalfWord(addr);
+  case 4:
+    return bus.readWord(addr);
+  default:
+    return bus.readDoubleWord(addr);
+  }
+}
+
+void
+writeElement(MemoryBus& bus, MemAddress addr, unsigned size, uint64_t value)
+{
+  switch (size) {
+  case 1:
+    bus.writeByte(addr, value);
+    break;
+  case 2:
+    bus.writeHalfWord(addr, value);
+    break;
+  case 4:
+    bus.writeWord(addr, value);
+    break;
+  default:
+    bus.writeDoubleWord(addr, value);
+    break;
+  }
+}
+
+/* Elements are stored little-endian in the vector registers. */
+uint64_t
+getElement(const uint8_t* element, unsigned size)
+{
+  uint64_t value = 0;
+  for (unsigned i = 0; i < size; ++i)
+    value |= static_cast<uint64_t>(element[i]) << (8 * i);
+  return value;
+}
+
+void
+setElement(uint8_t* element, unsigned size, uint64_t value)
+{
+  for (unsigned i = 0; i < size; ++i)
+    element[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+KernelOp
+getKernelOp(VectorOp op)
+{
+  switch (op) {
+  case VectorOp::Add:
+  case VectorOp::ReduceSum:
+    return KernelOp::Add;
+  case VectorOp::Sub:
+  case VectorOp::ReverseSub:
+    return KernelOp::Sub;
+  case VectorOp::Mul:
+    return KernelOp::Mul;
+  case VectorOp::And:
+  case VectorOp::ReduceAnd:
+    return KernelOp::And;
+  case VectorOp::Or:
+  case VectorOp::ReduceOr:
+    return KernelOp::Or;
+  case VectorOp::Xor:
+  case VectorOp::ReduceXor:
+    return KernelOp::Xor;
+  default:
+    throw std::logic_error("Unknown vector operation");
+  }
+}
+
+} // namespace
+
+VectorUnit::VectorUnit(MemoryBus& bus, unsigned vlen)
+    : bus{bus}, kernels{getVectorKernels()}, vlenb{vlen / 8},
+      registers(NumVectorRegs * vlenb), scratch(8 * vlenb),
+      vtype{VTypeIllegal}
+{
+  if (vlen < 64 || vlen > 65536 || (vlen & (vlen - 1)) != 0)
+    throw std::runtime_error("vector length must be a power of two from 64 "
+                             "to 65536 bits");
+}
+
+/* LMUL in eighths, 0 for the reserved encoding. */
+unsigned
+VectorUnit::getLMULEighths() const
+{
+  const unsigned vlmul = vtype & 0x7;
+  if (vlmul < 4)
+    return 8U << vlmul;
+  if (vlmul > 4)
+    return 1U << (vlmul - 5);
+  return 0;
+}
+
+/* Sets vtype and returns the new vl, which is the AVL up to VLMAX.
+ * Unsupported configurations set vill instead.
+ */
+RegValue
+VectorUnit::setVectorLength(RegValue avl, RegValue newType, bool keepVL)
+{
+  vtype = newType;
+
+  /* Fractional LMUL has to leave room for an element of ELEN (64) bits. */
+  const unsigned lmul = getLMULEighths();
+  if ((newType >> 8) != 0 || ((newType >> 3) & 0x7) > 3 || lmul == 0 ||
+      getSEW() > lmul) {
+    vtype = VTypeIllegal;
+    vl = 0;
+    return vl;
+  }
+
+  const RegValue vlmax = RegValue{vlenb} * lmul / (getSEW() * 8);
+  vl = std::min(keepVL ? vl : avl, vlmax);
+  return vl;
+}
+
+/* The register group starting at reg that holds elements of eew bytes,
+ * which consists of EEW / SEW * LMUL registers.
+ */
+uint8_t*
+VectorUnit::getGroup(uint8_t reg, unsigned eew)
+{
+  const unsigned lmul = getLMULEighths();
+  if (eew * lmul < getSEW() || eew * lmul > 64 * getSEW())
+    throw IllegalInstruction("Unsupported vector element width");
+
+  const unsigned count = std::max(eew * lmul / getSEW() / 8, 1U);
+  if (reg % count != 0 || reg + count > NumVectorRegs)
+    throw IllegalInstruction("Invalid vector register group");
+
+  return registers.data() + reg * vlenb;
+}
+
+/* The second source operand: vs1, or a scalar or immediate that is
+ * replicated into every element.
+ */
+const uint8_t*
+VectorUnit::getOperand(const VectorInstruction& instruction,
+                       RegValue rs1Value)
+{
+  const unsigned sew = getSEW();
+  if (instruction.source == VectorSource::Vector)
+    return getGroup(instruction.vs1, sew);
+
+  const RegValue value = instruction.source == VectorSource::Scalar
+                             ? rs1Value
+                             : static_cast<RegValue>(instruction.immediate);
+  for (RegValue i = 0; i < vl; ++i)
+    setElement(scratch.data() + i * sew, sew, value);
+  return scratch.data();
+}
+
+RegValue
+VectorUnit::execute(const VectorInstruction& instruction, RegValue rs1Value,
+                    RegValue rs2Value)
+{
+  switch (instruction.op) {
+  case VectorOp::None:
+    return 0;
+
+  /* With rs1 = x0 the AVL is VLMAX, unless rd is x0 as well: then vl is
+   * kept.
+   */
+  case VectorOp::SetVL:
+  case VectorOp::SetVLFromRegister: {
+    const RegValue newType = instruction.op == VectorOp::SetVL
+                                 ? static_cast<RegValue>(instruction.immediate)
+                                 : rs2Value;
+    if (instruction.source == VectorSource::Immediate)
+      return setVectorLength(instruction.vs1, newType, false);
+    if (instruction.vs1 != 0)
+      return setVectorLength(rs1Value, newType, false);
+    return setVectorLength(~RegValue{0}, newType, instruction.vd == 0);
+  }
+
+  default:
+    break;
+  }
+
+  if (vtype & VTypeIllegal)
+    throw IllegalInstruction("Vector instruction with illegal vtype");
+  if (instruction.masked)
+    throw IllegalInstruction("Masked vector instructions are not supported");
+
+  const unsigned sew = getSEW();
+
+  switch (instruction.op) {
+  case VectorOp::Load:
+  case VectorOp::Store:
+    loadStore(instruction, rs1Value, rs2Value);
+    break;
+
+  case VectorOp::ReduceSum:
+  case VectorOp::ReduceAnd:
+  case VectorOp::ReduceOr:
+  case VectorOp::ReduceXor:
+    reduce(instruction);
+    break;
+
+  /* Element 0, also when vl is 0; sign-extended. */
+  case VectorOp::MoveToScalar: {
+    const unsigned shift = 64 - 8 * sew;
+    const uint64_t value =
+        getElement(registers.data() + instruction.vs2 * vlenb, sew);
+    ++nElementOps;
+    return static_cast<RegValue>(static_cast<int64_t>(value << shift) >>
+                                 shift);
+  }
+
+  case VectorOp::MoveFromScalar:
+    if (vl > 0) {
+      setElement(registers.data() + instruction.vd * vlenb, sew, rs1Value);
+      ++nElementOps;
+    }
+    break;
+
+  default:
+    arithmetic(instruction, rs1Value);
+    break;
+  }
+
+  return 0;
+}
+
+void
+VectorUnit::loadStore(const VectorInstruction& instruction, RegValue base,
+                      RegValue stride)
+{
+  const unsigned eew = instruction.eew;
+  uint8_t* data = getGroup(instruction.vd, eew);
+  if (!instruction.strided)
+    stride = eew;
+
+  for (RegValue i = 0; i < vl; ++i) {
+    const MemAddress addr = base + i * stride;
+    uint8_t* element = data + i * eew;
+
+    if (instruction.op == VectorOp::Load)
+      setElement(element, eew, readElement(bus, addr, eew));
+    else
+      writeElement(bus, addr, eew, getElement(element, eew));
+  }
+
+  nElementOps += vl;
+}
+
+void
+VectorUnit::arithmetic(const VectorInstruction& instruction,
+                       RegValue rs1Value)
+{
+  const unsigned sew = getSEW();
+  uint8_t* vd = getGroup(instruction.vd, sew);
+  const uint8_t* operand = getOperand(instruction, rs1Value);
+
+  nElementOps += vl;
+
+  if (instruction.op == VectorOp::Move) {
+    std::memmove(vd, operand, vl * sew);
+    return;
+  }
+
+  const uint8_t* vs2 = getGroup(instruction.vs2, sew);
+  const VectorKernel kernel =
+      kernels.get(getKernelOp(instruction.op), (vtype >> 3) & 0x7);
+
+  if (instruction.op == VectorOp::ReverseSub)
+    kernel(vd, operand, vs2, vl);
+  else
+    kernel(vd, vs2, operand, vl);
+}
+
+/* The elements of vs2 are combined pairwise by the kernel, halving their
+ * number in every step. The result is combined with element 0 of vs1 and
+ * written to element 0 of vd; these are single registers, regardless of
+ * LMUL. Nothing is written when vl is 0.
+ */
+void
+VectorUnit::reduce(const VectorInstruction& instruction)
+{
+  if (vl == 0)
+    return;
+
+  const unsigned sew = getSEW();
+  const uint8_t* vs2 = getGroup(instruction.vs2, sew);
+  const VectorKernel kernel =
+      kernels.get(getKernelOp(instruction.op), (vtype >> 3) & 0x7);
+
+  uint8_t* partial = scratch.data();
+  std::memcpy(partial, vs2, vl * sew);
+
+  for (RegValue n = vl; n > 1;) {
+    const RegValue half = n / 2;
+    kernel(partial, partial, partial + (n - half) * sew, half);
+    n -= half;
+  }
+
+  kernel(registers.data() + instruction.vd * vlenb,
+         registers.data() + instruction.vs1 * vlenb, partial, 1);
+
+  nElementOps += vl;
+}
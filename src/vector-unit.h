@@ -0,0 +1,122 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    vector-unit.h - Vector unit, a subset of the V extension.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __VECTOR_UNIT_H__
+#define __VECTOR_UNIT_H__
+
+#include "arch.h"
+#include "memory-bus.h"
+#include "vector-kernels.h"
+
+#include <vector>
+
+enum class VectorOp {
+  None,
+  SetVL,             /* vsetvli, vsetivli: vtype from the immediate */
+  SetVLFromRegister, /* vsetvl: vtype from rs2 */
+  Load,
+  Store,
+  Add,
+  Sub,
+  ReverseSub,
+  Mul,
+  And,
+  Or,
+  Xor,
+  Move, /* vmv.v.v, vmv.v.x, vmv.v.i */
+  ReduceSum,
+  ReduceAnd,
+  ReduceOr,
+  ReduceXor,
+  MoveToScalar,  /* vmv.x.s */
+  MoveFromScalar /* vmv.s.x */
+};
+
+/* Second source operand of arithmetic instructions, or the AVL of
+ * vsetvli (Scalar) and vsetivli (Immediate).
+ */
+enum class VectorSource : uint8_t { Vector, Scalar, Immediate };
+
+/* The fields of a vector instruction that are needed for its execution,
+ * taken along through the pipeline with the control signals.
+ */
+struct VectorInstruction {
+  VectorOp op{VectorOp::None};
+  VectorSource source{VectorSource::Vector};
+  uint8_t vd{}; /* also the source of stores, vs3 */
+  uint8_t vs1{};
+  uint8_t vs2{};
+  uint8_t eew{}; /* element width of loads and stores, in bytes */
+  bool strided{};
+  bool masked{};
+  int64_t immediate{}; /* simm5, or the vtype of vsetvli and vsetivli */
+};
+
+/* The vector unit holds the vector registers and the vl and vtype
+ * registers and executes the vector instructions: configuration,
+ * unit-stride and strided loads and stores, and integer add, subtract,
+ * multiply, bitwise logical operations and reductions on elements of 8 to
+ * 64 bits. Masked instructions are not supported. vstart is always 0 and
+ * the elements past vl are left undisturbed.
+ *
+ * All vector instructions execute in the MEM stage, in program order, so
+ * the vector registers need no forwarding. The scalar operands are
+ * forwarded as usual; a scalar result is written back like loaded data.
+ *
+ * The arithmetic is performed on whole register groups at once by the
+ * host SIMD kernels, see vector-kernels.h.
+ */
+class VectorUnit {
+public:
+  /* The length of a vector register, VLEN, is given in bits. */
+  VectorUnit(MemoryBus& bus, unsigned vlen);
+
+  /* Executes the instruction, with the values of the scalar operands rs1
+   * and rs2. Returns the value to write to rd, for the instructions that
+   * write one.
+   */
+  RegValue execute(const VectorInstruction& instruction, RegValue rs1Value,
+                   RegValue rs2Value);
+
+  RegValue getVL() const { return vl; }
+  RegValue getVType() const { return vtype; }
+  unsigned getVLENB() const { return vlenb; }
+
+  /* Number of elements processed by vector instructions. */
+  uint64_t getElementOperations() const { return nElementOps; }
+
+  /* The host instruction set used by the kernels. */
+  const char* getKernelISA() const { return kernels.isa; }
+
+private:
+  MemoryBus& bus;
+  const VectorKernels& kernels;
+
+  unsigned vlenb; /* VLEN in bytes */
+  std::vector<uint8_t> registers;
+  std::vector<uint8_t> scratch;
+
+  RegValue vl{};
+  RegValue vtype;
+
+  uint64_t nElementOps{};
+
+  unsigned getSEW() const { return 1U << ((vtype >> 3) & 0x7); }
+  unsigned getLMULEighths() const;
+
+  RegValue setVectorLength(RegValue avl, RegValue newType, bool keepVL);
+  uint8_t* getGroup(uint8_t reg, unsigned eew);
+  const uint8_t* getOperand(const VectorInstruction& instruction,
+                            RegValue rs1Value);
+
+  void loadStore(const VectorInstruction& instruction, RegValue base,
+                 RegValue stride);
+  void arithmetic(const VectorInstruction& instruction, RegValue rs1Value);
+  void reduce(const VectorInstruction& instruction);
+};
+
+#endif /* __VECTOR_UNIT_H__ */